@@ -8,6 +8,9 @@
 
 #if !_WIN32
 #include <time.h>					// for Linux version of GetTickCount()
+#include <unistd.h>					// for pread()
+#include <errno.h>
+#include <sys/mman.h>				// for mmap()
 #endif
 
 #if VSTUDIO_INTEGRATION
@@ -102,7 +105,8 @@ void appError(const char *fmt, ...)
 }
 
 
-static char NotifyHeader[512];
+// Thread-local, so packages exported in parallel have their own header
+static thread_local char NotifyHeader[512];
 
 void appSetNotifyHeader(const char *fmt, ...)
 {
@@ -708,6 +712,39 @@ unsigned appGetFileType(const char *filename)
 
 #if !_WIN32
 
+int appReadFileAt(FILE* f, int64 Pos, void* Data, int Size)
+{
+	int fd = fileno(f);
+	int BytesRead = 0;
+	while (BytesRead < Size)
+	{
+		ssize_t Result = pread(fd, OffsetPointer(Data, BytesRead), Size - BytesRead, Pos + BytesRead);
+		if (Result < 0 && errno == EINTR) continue;
+		if (Result <= 0) break;
+		BytesRead += (int)Result;
+	}
+	return BytesRead;
+}
+
+const void* appMapFile(FILE* f, int64 Size)
+{
+	if (Size <= 0 || (uint64)Size > (size_t)-1) return NULL;
+	void* Data = mmap(NULL, (size_t)Size, PROT_READ, MAP_SHARED, fileno(f), 0);
+	return (Data != MAP_FAILED) ? Data : NULL;
+}
+
+void appUnmapFile(const void* Data, int64 Size)
+{
+	munmap(const_cast<void*>(Data), (size_t)Size);
+}
+
+uint64 appMicroseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)(ts.tv_nsec / 1000) + ((uint64)ts.tv_sec * 1000000ull);
+}
+
 // POSIX version of GetTickCount()
 unsigned long GetTickCount()
 {
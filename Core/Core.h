@@ -336,6 +336,16 @@ void appParseResponseFile(const char* filename, int& outArgc, const char**& outA
 // and FS_DIR if this is a directory
 unsigned appGetFileType(const char *filename);
 
+// Read data from the specified file position. This function doesn't use stdio buffers and doesn't
+// depend on current file position, so it could be called from different threads for the same file.
+// Returns number of bytes read.
+int appReadFileAt(FILE* f, int64 Pos, void* Data, int Size);
+
+// Map the whole file into memory for reading. Returns NULL when mapping is not possible, in this case
+// caller should fall back to regular file reading. The mapping remains valid after closing the file.
+const void* appMapFile(FILE* f, int64 Size);
+void appUnmapFile(const void* Data, int64 Size);
+
 
 // Memory management
 
@@ -648,6 +658,9 @@ extern bool GUseDebugger;
 #	define appMilliseconds()		GetTickCount()
 #endif // RENDERING
 
+// High resolution timer, for profiling purposes
+uint64 appMicroseconds();
+
 
 #if _WIN32
 
@@ -2,10 +2,13 @@
 
 #ifdef _WIN32
 
-#if WIN32_USE_SEH
 #define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#if WIN32_USE_SEH
 #define _WIN32_WINDOWS 0x0500		// for IsDebuggerPresent()
+#endif
 #include <windows.h>
+#include <io.h>						// for _get_osfhandle()
+#if WIN32_USE_SEH
 #include <float.h>					// for _clearfp()
 #endif // WIN32_USE_SEH
 
@@ -527,6 +530,49 @@ void appCopyTextToClipboard(const char* text)
 }
 
 
+int appReadFileAt(FILE* f, int64 Pos, void* Data, int Size)
+{
+	// Note: for synchronous file handles ReadFile() with OVERLAPPED structure reads data from the
+	// specified position, but also moves the file pointer.
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f));
+	OVERLAPPED Overlapped;
+	memset(&Overlapped, 0, sizeof(Overlapped));
+	Overlapped.Offset = (DWORD)Pos;
+	Overlapped.OffsetHigh = (DWORD)(Pos >> 32);
+	DWORD BytesRead = 0;
+	if (!ReadFile(hFile, Data, Size, &BytesRead, &Overlapped))
+		return 0;
+	return BytesRead;
+}
+
+uint64 appMicroseconds()
+{
+	static LARGE_INTEGER Frequency = { 0 };
+	if (Frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&Frequency);
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+	return (uint64)(Counter.QuadPart / Frequency.QuadPart * 1000000 + (Counter.QuadPart % Frequency.QuadPart) * 1000000 / Frequency.QuadPart);
+}
+
+const void* appMapFile(FILE* f, int64 Size)
+{
+	if (Size <= 0 || (uint64)Size > (size_t)-1) return NULL;
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f));
+	HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping) return NULL;
+	const void* Data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, (SIZE_T)Size);
+	// The view holds a reference to the mapping object, so its handle is no longer needed
+	CloseHandle(hMapping);
+	return Data;
+}
+
+void appUnmapFile(const void* Data, int64 Size)
+{
+	UnmapViewOfFile(Data);
+}
+
+
 #if defined(OLDCRT) && (_MSC_VER  >= 1900)
 
 // Support OLDCRT with VC2015 or newer. VC2015 switched to another CRT model called "Universal CRT".
@@ -108,6 +108,11 @@ void CSemaphore::Wait()
 #endif
 }
 
+bool CSemaphore::TryWait()
+{
+	return WaitForSingleObject(data, 0) == WAIT_OBJECT_0;
+}
+
 CThread::CThread()
 {
 	InterlockedIncrement(&NumThreads);
@@ -152,6 +157,8 @@ void CThread::Start()
 #include <pthread.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <time.h>
+#include <errno.h>
 
 CMutex::CMutex()
 {
@@ -210,6 +217,11 @@ void CSemaphore::Wait()
 	sem_wait((sem_t*)data);
 }
 
+bool CSemaphore::TryWait()
+{
+	return sem_trywait((sem_t*)data) == 0;
+}
+
 CThread::CThread()
 {
 	bStarted = false;
@@ -236,7 +248,12 @@ void CThread::Start()
 
 /*static*/ void CThread::Sleep(int milliseconds)
 {
-	SDL_Delay(milliseconds); //todo: implement in other way
+	// Don't use SDL_Delay(): SDL is not available in builds without RENDERING
+	struct timespec ts;
+	ts.tv_sec = milliseconds / 1000;
+	ts.tv_nsec = (milliseconds % 1000) * 1000000;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+	{}
 }
 
 /*static*/ int CThread::GetLogicalCPUCount()
@@ -300,262 +317,274 @@ namespace ThreadPool
 
 #define MAX_POOL_THREADS 64
 
-// Task queue
-namespace Queue
-{
-
 struct CTask
 {
 	ThreadTask	task;
 	void*		data;
 	CSemaphore* fence;
+};
 
-	void Exec()
+// Task queue. The owner thread takes tasks from the back of the queue, so recently created tasks
+// are executed first, and their data is still in cache. Other threads steal tasks from the front.
+class CTaskQueue
+{
+public:
+	CMutex		Mutex;
+	CTask*		Items = NULL;
+	int			Capacity = 0;
+	int			Head = 0;
+	volatile int Count = 0;
+
+	// Statistics
+	volatile int32 NumExecuted = 0;
+	volatile int32 NumStolen = 0;
+	volatile int32 NumSleeps = 0;
+
+	void PushBack(const CTask& Task)
 	{
-		guard(QueueTask::Exec);
-		task(data);
-		if (fence) fence->Signal();
-		unguard;
+		CMutex::ScopedLock Lock(Mutex);
+		if (Count == Capacity)
+		{
+			// Grow the ring buffer, keep items order
+			int NewCapacity = max(Capacity * 2, 16);
+			CTask* NewItems = (CTask*)appMallocNoInit(NewCapacity * sizeof(CTask));
+			for (int i = 0; i < Count; i++)
+				NewItems[i] = Items[(Head + i) % Capacity];
+			if (Items) appFree(Items);
+			Items = NewItems;
+			Capacity = NewCapacity;
+			Head = 0;
+		}
+		Items[(Head + Count) % Capacity] = Task;
+		Count++;
 	}
-};
-
-
-CMutex Mutex;
-static CTask Queue[MAX_POOL_THREADS / 2];
-static int QueueSize = 0;
 
-// This function returns false if queue size wasn't enough for returning immediately
-bool PutToQueue(ThreadTask task, void* data, CSemaphore* fence)
-{
-	guard(Queue::PutToQueue);
+	bool PopBack(CTask& Task)
+	{
+		if (!Count) return false;
+		CMutex::ScopedLock Lock(Mutex);
+		if (!Count) return false;
+		Count--;
+		Task = Items[(Head + Count) % Capacity];
+		return true;
+	}
 
-	// Get size of queue
-	static int MaxQueueSize = -1;
-	if (MaxQueueSize < 0)
+	bool PopFront(CTask& Task)
 	{
-		MaxQueueSize = CThread::GetLogicalCPUCount() * 2;
-		if (MaxQueueSize > ARRAY_COUNT(Queue))
-			MaxQueueSize = ARRAY_COUNT(Queue);
+		if (!Count) return false;
+		CMutex::ScopedLock Lock(Mutex);
+		if (!Count) return false;
+		Task = Items[Head];
+		Head = (Head + 1) % Capacity;
+		Count--;
+		return true;
 	}
+};
 
-	CTask ToExec;
+// Queue with index 0 is shared by all threads which are not in pool, other queues are owned by pool threads
+static CTaskQueue Queues[MAX_POOL_THREADS + 1];
+static int NumPoolThreads = 0;
+static int MaxQueuedTasks = 0;
 
-	{ // Lock scope
-		CMutex::ScopedLock Lock(Mutex);
+static thread_local int CurrentQueue = 0;
 
-		if (QueueSize < MaxQueueSize)
-		{
-			// Just put task to queue and return
-			CTask& Item = Queue[QueueSize++];
-			Item.task = task;
-			Item.data = data;
-			Item.fence = fence;
-			return true;
-		}
+static volatile int32 NumQueuedTasks = 0;		// tasks waiting in queues
+static volatile int32 NumPendingTasks = 0;		// queued and executing tasks
+static volatile int32 NumBusyThreads = 0;		// pool threads executing tasks
+static volatile int32 NumSleepingThreads = 0;
+static CSemaphore WakeSignal;
+static volatile bool bShutdown = false;
+static CSemaphore ExitSignal;					// signaled by every pool thread on exit after shutdown
 
-		// There's not enough space in queue, execute the first item and put new one to the queue's back
+// Waiting for all tasks completion
+static CMutex IdleMutex;
+static CSemaphore IdleSignal;
+static int NumIdleWaiters = 0;
 
-		// Grab the first item from queue
-		ToExec = Queue[0];
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * (QueueSize - 1));
+static void ExecuteTask(const CTask& Task)
+{
+	guard(ThreadPool::ExecuteTask);
 
-		// Put new item
-		CTask& Item = Queue[QueueSize - 1];
-		Item.task = task;
-		Item.data = data;
-		Item.fence = fence;
-	}
+	int QueueIndex = CurrentQueue;
+	if (QueueIndex) InterlockedIncrement(&NumBusyThreads);
 
-	// Execute the first item in current thread
-	ToExec.Exec();
+	Task.task(Task.data);
+	if (Task.fence) Task.fence->Signal();
 
-	// Indicate that we didn't put task to pool, but executed something
-	return false;
+	if (QueueIndex) InterlockedDecrement(&NumBusyThreads);
+	InterlockedIncrement(&Queues[QueueIndex].NumExecuted);
+
+	if (InterlockedDecrement(&NumPendingTasks) == 0)
+	{
+		// Wake up threads waiting in WaitForCompletion()
+		int NumWaiters;
+		{
+			CMutex::ScopedLock Lock(IdleMutex);
+			NumWaiters = NumIdleWaiters;
+			NumIdleWaiters = 0;
+		}
+		while (NumWaiters-- > 0)
+			IdleSignal.Signal();
+	}
 
 	unguard;
 }
 
-bool GetFromQueue(CTask& item)
+bool RunPendingTask()
 {
-	CMutex::ScopedLock Lock(Mutex);
-
-	if (!QueueSize)
-		return false;
-
-	item = Queue[0];
-	if (--QueueSize)
+	int QueueIndex = CurrentQueue;
+	CTask Task;
+	if (!Queues[QueueIndex].PopBack(Task))
 	{
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * QueueSize);
+		// Own queue is empty, steal a task from another thread
+		int NumQueues = NumPoolThreads + 1;
+		int i;
+		for (i = 1; i < NumQueues; i++)
+		{
+			if (Queues[(QueueIndex + i) % NumQueues].PopFront(Task))
+				break;
+		}
+		if (i >= NumQueues)
+			return false;
+		InterlockedIncrement(&Queues[QueueIndex].NumStolen);
 	}
-
+	InterlockedDecrement(&NumQueuedTasks);
+	ExecuteTask(Task);
 	return true;
 }
 
-} // namespace Queue
-
-
 // Thread for the pool
 class CPoolThread : public CThread
 {
 public:
-	// Flag showing if this thead is doing something or not
-	bool bBusy = false;
-	bool bShutdown = false;
-
-	void AssignTaskAndWake(ThreadTask inTask, void* inData, CSemaphore* inFence)
-	{
-		task = inTask;
-		taskData = inData;
-		fence = inFence;
-		sem.Signal();
-	}
-
-	void Shutdown()
-	{
-		bShutdown = true;
-		sem.Signal();
-	}
+	CPoolThread(int InQueueIndex)
+	: QueueIndex(InQueueIndex)
+	{}
 
 protected:
 	virtual void Run()
 	{
-		bBusy = false;
+		CurrentQueue = QueueIndex;
 
-		while (true)
+		while (!bShutdown)
 		{
-			// Wait for signal to start
-			sem.Wait();
-			if (bShutdown) break;
-
-			// Execute task
-			bBusy = true;
-			task(taskData);
-			if (fence) fence->Signal();
-
-			// See if there's something in the queue to execute
-			Queue::CTask task;
-			while (Queue::GetFromQueue(task))
+			if (RunPendingTask())
+				continue;
+
+			// Nothing to do, go to sleep. Verify the queue after announcing the sleep, so a task
+			// which was added at the same time will not be missed.
+			InterlockedIncrement(&NumSleepingThreads);
+			if (NumQueuedTasks > 0 || bShutdown)
 			{
-				task.Exec();
+				InterlockedDecrement(&NumSleepingThreads);
+				continue;
 			}
-
-			// Return thread to pool
-			bBusy = false;
-			InterlockedDecrement(&NumWorkingThreads);
+			InterlockedIncrement(&Queues[QueueIndex].NumSleeps);
+			WakeSignal.Wait();
+			InterlockedDecrement(&NumSleepingThreads);
 		}
 		//todo: May be CThread should destroy itself when worker function completed? Just not using CThread anywhere else.
 		delete this;
+		ExitSignal.Signal();
 	}
 
-	// Executed code
-	ThreadTask task;
-	// Pointer to task context
-	void* taskData;
-	// Object used to signal execution end
-	CSemaphore* fence;
-	// Semaphore used to wake up the thread
-	CSemaphore sem;
-
-public:
-	// Statics
-	// Number of awake threads
-	static volatile int NumWorkingThreads;
+	int QueueIndex;
 };
 
-volatile int CPoolThread::NumWorkingThreads = 0;
-
-// Thread pool itself
-namespace Pool
+static void StartPool()
 {
+	static volatile bool bStarted = false;
+	if (bStarted) return;
 
-static CPoolThread* Pool[MAX_POOL_THREADS];
-static int NumPoolThreads = 0;
-static CMutex Mutex;
+	static CMutex Mutex;
+	CMutex::ScopedLock Lock(Mutex);
+	if (bStarted) return;
 
-CPoolThread* AllocateFreeThread()
-{
-	CMutex::ScopedLock lock(Mutex);
+	int MaxThreads = CThread::GetLogicalCPUCount();
+	MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
+	--MaxThreads; // exclude main thread
+	if (!GEnableThreads) MaxThreads = 0;
+	MaxQueuedTasks = CThread::GetLogicalCPUCount() * 2;
 
-	// Find idle thread
-	for (int i = 0; i < NumPoolThreads; i++)
+	for (int i = 0; i < MaxThreads; i++)
 	{
-		CPoolThread* Thread = Pool[i];
-		if (!Thread->bBusy)
-		{
-			Thread->bBusy = true;
-			InterlockedIncrement(&CPoolThread::NumWorkingThreads);
-			return Thread;
-		}
-	}
-
-	static int MaxThreads = -1;
-	if (MaxThreads < 0)
-	{
-		MaxThreads = CThread::GetLogicalCPUCount();
-		MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
-		--MaxThreads; // exclude main thread
-		if (!GEnableThreads) MaxThreads = 0;
-
-		// Put Shutdown function to 'atexit' sequence
-		atexit(ThreadPool::Shutdown);
+		CPoolThread* Thread = new CPoolThread(i + 1);
+		Thread->Start();
 	}
+	NumPoolThreads = MaxThreads;
 
-	// Create new thread, if can
-	if (NumPoolThreads < MaxThreads)
-	{
-		CPoolThread* NewThread = new CPoolThread();
-
-		NewThread->bBusy = true;
-		Pool[NumPoolThreads++] = NewThread;
-		InterlockedIncrement(&CPoolThread::NumWorkingThreads);
+	// Put Shutdown function to 'atexit' sequence
+	atexit(ThreadPool::Shutdown);
 
-		NewThread->Start();
-		return NewThread;
-	}
-
-	// No free threads, and can't allocate a new one
-	return NULL;
+	bStarted = true;
 }
 
-} // namespace Pool
-
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence, bool allowQueue)
 {
-	CPoolThread* thread = Pool::AllocateFreeThread();
-	if (thread)
+	guard(ThreadPool::ExecuteInThread);
+
+	StartPool();
+
+	if (!NumPoolThreads)
 	{
-		thread->AssignTaskAndWake(task, taskData, fence);
+		if (!allowQueue) return false;
+		// Threading is disabled, execute task immediately
+		task(taskData);
+		if (fence) fence->Signal();
 		return true;
 	}
-	else if (allowQueue)
+
+	if (!allowQueue)
 	{
-		Queue::PutToQueue(task, taskData, fence);
-		//todo: it is possible that after AllocateFreeThread() call buf before PutToQueue completion, one
-		//todo: of the worker threads will be returned to pool
-		return true;
+		// Verify if there's a free thread
+		if (NumBusyThreads + NumQueuedTasks >= NumPoolThreads)
+			return false;
 	}
-	else
+	else if (NumQueuedTasks >= MaxQueuedTasks)
 	{
-		return false;
+		// There's too many queued tasks, help with executing them. This limits the amount of memory
+		// held by queued tasks.
+		RunPendingTask();
 	}
+
+	CTask Task;
+	Task.task = task;
+	Task.data = taskData;
+	Task.fence = fence;
+	InterlockedIncrement(&NumPendingTasks);
+	Queues[CurrentQueue].PushBack(Task);
+	InterlockedIncrement(&NumQueuedTasks);
+
+	// Wake up a sleeping thread
+	if (NumSleepingThreads > 0)
+		WakeSignal.Signal();
+
+	return true;
+
+	unguard;
 }
 
 void WaitForCompletion()
 {
 	guard(ThreadPool::WaitForCompletion);
 
-	// Execute tasks from the queue if any
-	Queue::CTask task;
-	while (Queue::GetFromQueue(task))
-	{
-		task.Exec();
-	}
+	assert(CurrentQueue == 0);
 
-	// Wait for all threads to go to the idle state
-	while (CPoolThread::NumWorkingThreads > 0)
+	while (true)
 	{
-		CThread::Sleep(20);
+		// Execute tasks from the queues if any
+		while (RunPendingTask())
+		{}
+
+		// Wait for executing tasks
+		{
+			CMutex::ScopedLock Lock(IdleMutex);
+			if (NumPendingTasks == 0) break;
+			NumIdleWaiters++;
+		}
+		IdleSignal.Wait();
 	}
+
 	unguard;
 }
 
@@ -570,59 +599,86 @@ void Shutdown()
 	}
 
 	WaitForCompletion();
-	int NumThreadsAfterShutdown = CThread::NumThreads - Pool::NumPoolThreads;
+	int NumThreadsAfterShutdown = CThread::NumThreads - NumPoolThreads;
 
 	// Signal to all threads to shutdown
-	for (int i = 0; i < Pool::NumPoolThreads; i++)
+	bShutdown = true;
+	for (int i = 0; i < NumPoolThreads; i++)
 	{
-		CPoolThread* Thread = Pool::Pool[i];
-		Thread->Shutdown();
+		WakeSignal.Signal();
 	}
 
-	// Wait them to terminate
-	int NumAttempts = 200;
-	while (CThread::NumThreads > NumThreadsAfterShutdown && NumAttempts-- > 0)
+	// Wait them to terminate. All tasks are completed, so threads are leaving immediately.
+	for (int i = 0; i < NumPoolThreads; i++)
 	{
-		CThread::Sleep(20);
+		ExitSignal.Wait();
 	}
-	if (NumAttempts == 0)
+	assert(CThread::NumThreads == NumThreadsAfterShutdown);
+
+	unguard;
+}
+
+void PrintStats()
+{
+	int NumExecuted = 0, NumStolen = 0;
+	for (int i = 0; i <= NumPoolThreads; i++)
 	{
-		appPrintf("Warning: unable to shutdown %d threads\n", CThread::NumThreads);
+		NumExecuted += Queues[i].NumExecuted;
+		NumStolen += Queues[i].NumStolen;
 	}
+	if (!NumExecuted) return;
 
-	unguard;
+	appPrintf("Thread pool: %d threads, %d tasks executed, %d stolen\n", NumPoolThreads, NumExecuted, NumStolen);
+	for (int i = 0; i <= NumPoolThreads; i++)
+	{
+		const CTaskQueue& Q = Queues[i];
+		if (i == 0)
+			appPrintf("  non-pool threads: %d tasks, %d stolen\n", Q.NumExecuted, Q.NumStolen);
+		else
+			appPrintf("  thread %d: %d tasks, %d stolen, %d sleeps\n", i, Q.NumExecuted, Q.NumStolen, Q.NumSleeps);
+	}
 }
 
 } // namespace ThreadPool
 
 
 /*-----------------------------------------------------------------------------
-	ParallelFor
+	CTaskGroup
 -----------------------------------------------------------------------------*/
 
-namespace ParallelForImpl
+void CTaskGroup::Wait()
 {
+	guard(CTaskGroup::Wait);
 
-ParallelForBase::ParallelForBase(int inCount)
-: numActiveThreads(0)
-, bAllSentToThreads(false)
-, currentIndex(0)
-, lastIndex(inCount)
-{}
-
-ParallelForBase::~ParallelForBase()
-{
-	// Wait for completion: the last thread which will complete the job will
-	// signal 'endSignal' about completion.
-	if (numActiveThreads)
+	// Each completed task signals the semaphore once
+	while (NumTasks > 0)
 	{
-		guard(ParallelForWait);
-		endSignal.Wait();
-		unguard;
+		if (!Done.TryWait())
+		{
+			// Do something useful while tasks of this group are executed
+			if (ThreadPool::RunPendingTask())
+				continue;
+			Done.Wait();
+		}
+		InterlockedDecrement(&NumTasks);
 	}
+
+	unguard;
 }
 
-void ParallelForBase::Start(ThreadPool::ThreadTask worker)
+
+/*-----------------------------------------------------------------------------
+	ParallelFor
+-----------------------------------------------------------------------------*/
+
+namespace ParallelForImpl
+{
+
+ParallelForBase::ParallelForBase(int inCount)
+: currentIndex(0)
+, lastIndex(inCount)
+, step(1)
+, numThreads(0)
 {
 	if (lastIndex == 0)
 		return;
@@ -634,7 +690,7 @@ void ParallelForBase::Start(ThreadPool::ThreadTask worker)
 	if (step < 20) step = 20; //?? should override for slow tasks, e.g. processing 10 items 1 second each
 
 	// Divide index count by 'step' with rounding up
-	int numThreads = (lastIndex + step - 1) / step;
+	numThreads = (lastIndex + step - 1) / step;
 
 	// Recompute step to avoid having tiny last step
 	step = (lastIndex + numThreads - 1) / numThreads;
@@ -647,55 +703,6 @@ void ParallelForBase::Start(ThreadPool::ThreadTask worker)
 #if DEBUG_PARALLEL_FOR
 	printf("ParallelFor: %d, %d, step %d (thread %d)\n", currentIndex, lastIndex, step, CThread::CurrentId()&255);
 #endif
-
-	// Allocate threads, exclude 1 thread for the thread executing ParallelFor
-
-	// Reserve 1 "active thread", so if the 1st spawned thread will finish the job before
-	// we'll be able to spawn anything else - it won't send "completed" signal.
-	InterlockedIncrement(&numActiveThreads);
-
-	// Spawn as many threads as planned. Stop allocating new threads if job will be completed
-	// faster than planned (verify bAllSentToThreads as a loop condition).
-	for (int i = 0; i < numThreads - 1 && !bAllSentToThreads; i++)
-	{
-		// Just in case, increment thread count before starting a thread, so we'll avoid
-		// the situation when worker thread will execute everything before we'll return
-		// to the invoker (main) thread and increment count.
-		InterlockedIncrement(&numActiveThreads);
-		if (!ThreadPool::ExecuteInThread(worker, this))
-		{
-			// All threads has been allocated, can't spawn more.
-			// Decrement the thread count as we've failed to use new thread.
-			InterlockedDecrement(&numActiveThreads);
-			break;
-		}
-	}
-
-	// Remove thread "reservation". If at this moment everything has been completed, the
-	// value goes to zero, and we'll not perform waiting for completion in destructor. If
-	// something is still works, then we'll wait, and the worker thread will send a signal
-	// when count finally decremented to 0.
-	InterlockedDecrement(&numActiveThreads);
-}
-
-bool ParallelForBase::GrabInterval(int& idx1, int& idx2)
-{
-	CMutex::ScopedLock lock(mutex);
-	idx1 = currentIndex;
-	if (idx1 >= lastIndex)
-	{
-		// All items were sent to threads
-		bAllSentToThreads = true;
-		return false;
-	}
-	idx2 = idx1 + step;
-	if (idx2 > lastIndex)
-		idx2 = lastIndex;
-	currentIndex = idx2;
-#if DEBUG_PARALLEL_FOR
-	printf("thread %d: GET %d .. %d [%d]\n", CThread::CurrentId()&255, idx1, idx2, idx2 - idx1);
-#endif
-	return true;
 }
 
 } // namespace ParallelForImpl
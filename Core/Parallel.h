@@ -62,6 +62,8 @@ public:
 
 	void Signal();
 	void Wait();
+	// Returns false when semaphore is not signaled, without waiting
+	bool TryWait();
 
 protected:
 
@@ -193,6 +195,20 @@ FORCEINLINE uint64 InterlockedAdd(volatile uint64* Value, int64 Amount)
 	return (uint64)::_InterlockedExchangeAdd64((__int64*)Value, (__int64)Amount);
 }
 
+#else // _WIN64
+
+// There's no 64-bit add instruction on x86, use compare-exchange loop
+
+FORCEINLINE int64 InterlockedAdd(volatile int64* Value, int64 Amount)
+{
+	__int64 Old;
+	do
+	{
+		Old = *Value;
+	} while (::_InterlockedCompareExchange64((__int64*)Value, Old + Amount, Old) != Old);
+	return (int64)Old;
+}
+
 #endif // _WIN64
 
 #else // _WIN32
@@ -265,16 +281,36 @@ FORCEINLINE uint64 InterlockedAdd(volatile uint64* Value, int64 Amount)
 
 #endif // _WIN32
 
+// Full memory barrier: memory writes made before the barrier become visible to other threads
+// before any writes made after it.
+FORCEINLINE void appMemoryBarrier()
+{
+#ifdef _MSC_VER
+	_ReadWriteBarrier();
+	_mm_mfence();
+#else
+	__sync_synchronize();
+#endif
+}
+
 /*-----------------------------------------------------------------------------
 	Thread pool
 -----------------------------------------------------------------------------*/
 
+// Thread pool is a work-stealing scheduler. Each pool thread has its own task queue, tasks
+// created inside a pool thread are put there, and tasks created by any other thread are put
+// into a shared queue. Idle threads take tasks from other queues. Threads waiting for tasks
+// (see CTaskGroup) are executing queued tasks instead of sleeping, so task could start nested
+// tasks and wait for them without a risk of exhausting the pool.
+
 namespace ThreadPool
 {
 
 typedef void (*ThreadTask)(void*);
 
-// Execute ThreadTask in thread. Return false if there's no free threads
+// Execute ThreadTask in thread. Return false if there's no free threads. When 'allowQueue' is true,
+// the task is put into queue, and the function always returns true. When there's too many queued
+// tasks, caller executes one of them before returning.
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence = NULL, bool allowQueue = false);
 
 #define TryExecuteInThread(...) TryExecuteInThreadImpl(__FUNCTION__, __VA_ARGS__)
@@ -324,12 +360,46 @@ FORCEINLINE void TryExecuteInThreadImpl(F& task, CSemaphore* fence = NULL, bool
 	static_assert(sizeof(task) == 0, "TryExecuteInThread can't accept lvalue");
 }
 
+// Execute one queued task in the current thread. Returns false if there was nothing to execute.
+bool RunPendingTask();
+
+// Wait until all queued tasks are completed. Should not be called from pool threads.
 void WaitForCompletion();
 
 void Shutdown();
 
+void PrintStats();
+
 }
 
+// A set of tasks which could be waited for. Tasks could be added from any thread, but Wait()
+// should be called by the thread which owns the group.
+class CTaskGroup
+{
+public:
+	CTaskGroup()
+	: NumTasks(0)
+	{}
+	~CTaskGroup()
+	{
+		Wait();
+	}
+
+	template<typename F>
+	FORCEINLINE void Run(F&& Func)
+	{
+		InterlockedIncrement(&NumTasks);
+		ThreadPool::TryExecuteInThread(MoveTemp(Func), &Done, true);
+	}
+
+	// Wait for completion of all tasks, executing queued tasks while waiting
+	void Wait();
+
+protected:
+	volatile int32 NumTasks;
+	CSemaphore Done;
+};
+
 /*-----------------------------------------------------------------------------
 	ParallelFor
 -----------------------------------------------------------------------------*/
@@ -342,20 +412,24 @@ namespace ParallelForImpl
 class ParallelForBase
 {
 public:
-	CMutex mutex;
-	CSemaphore endSignal;
-	int8 numActiveThreads;
-	bool bAllSentToThreads;
-	int currentIndex;
+	volatile int32 currentIndex;
 	int lastIndex;
 	int step;
+	int numThreads;
 
 	ParallelForBase(int inCount);
-	~ParallelForBase();
-
-	void Start(::ThreadPool::ThreadTask worker);
 
-	bool GrabInterval(int& idx1, int& idx2);
+	FORCEINLINE bool GrabInterval(int& idx1, int& idx2)
+	{
+		idx1 = InterlockedAdd(&currentIndex, step);
+		if (idx1 >= lastIndex)
+			return false;
+		idx2 = min(idx1 + step, lastIndex);
+	#if DEBUG_PARALLEL_FOR
+		printf("thread %d: GET %d .. %d [%d]\n", CThread::CurrentId()&255, idx1, idx2, idx2 - idx1);
+	#endif
+		return true;
+	}
 };
 
 template<typename F>
@@ -370,16 +444,26 @@ public:
 	{
 		guard(ParallelFor);
 
-		Start(PoolThreadWorker);
+		CTaskGroup Group;
+		// Threads started after the work has been completed will just return
+		for (int i = 1; i < numThreads; i++)
+		{
+			Group.Run([this]() { ExecuteAll(); });
+		}
+		// Add processing for the current thread
+		ExecuteAll();
+		Group.Wait();
+
+		unguard;
+	}
 
-		// Add processing for main thread
+	FORCEINLINE void ExecuteAll()
+	{
 		int idx1, idx2;
 		while (GrabInterval(idx1, idx2))
 		{
 			ExecuteRange(idx1, idx2);
-			//todo: may be periodically check if one of threads were released from another work and can be picked up?
 		}
-		unguard;
 	}
 
 	FORCEINLINE void ExecuteRange(int idx1, int idx2)
@@ -392,41 +476,43 @@ public:
 		}
 		unguardf("%d [%d,%d]/%d", idx, idx1, idx2, lastIndex);
 	}
+};
 
-	static void PoolThreadWorker(void* data)
-	{
-		guard(PoolThreadWorker);
+} // namespace ParallelForImpl
 
-	#if DEBUG_PARALLEL_FOR
-		printf("...... %d: started\n", CThread::CurrentId()&255);
-	#endif
+template<typename F>
+FORCEINLINE void ParallelFor(int Count, F&& Func)
+{
+	ParallelForImpl::ParallelForWorker<F> Worker(Count, MoveTemp(Func));
+}
 
-		ParallelForWorker& w = *(ParallelForWorker*)data;
+// ParallelFor version for a small number of slow items (e.g. file operations): items are grabbed
+// by threads one by one, so even 2 items could be processed in parallel.
+template<typename F>
+FORCEINLINE void ParallelForSlow(int Count, F&& Func)
+{
+	guard(ParallelForSlow);
 
-		int idx1, idx2;
-		while (w.GrabInterval(idx1, idx2))
+	int NumThreads = min(CThread::GetLogicalCPUCount(), Count);
+	volatile int32 NextIndex = 0;
+	auto Worker = [&Func, Count, &NextIndex]()
+	{
+		int Index;
+		while ((Index = InterlockedIncrement(&NextIndex) - 1) < Count)
 		{
-			w.ExecuteRange(idx1, idx2);
+			Func(Index);
 		}
+	};
 
-		// End the thread, send signal if this was the last allocated thread
-		if (InterlockedDecrement(&w.numActiveThreads) == 0)
-			w.endSignal.Signal();
-
-	#if DEBUG_PARALLEL_FOR
-		printf("...... %d: finished\n", CThread::CurrentId()&255);
-	#endif
-
-		unguard;
+	CTaskGroup Group;
+	for (int i = 1; i < NumThreads; i++)
+	{
+		Group.Run([&Worker]() { Worker(); });
 	}
-};
+	Worker();
+	Group.Wait();
 
-} // namespace ParallelForImpl
-
-template<typename F>
-FORCEINLINE void ParallelFor(int Count, F&& Func)
-{
-	ParallelForImpl::ParallelForWorker<F> Worker(Count, MoveTemp(Func));
+	unguard;
 }
 
 
@@ -461,6 +547,13 @@ FORCEINLINE void ParallelFor(int Count, F&& Func)
 		Func(i);
 }
 
+template<typename F>
+FORCEINLINE void ParallelForSlow(int Count, F&& Func)
+{
+	for (int i = 0; i < Count; i++)
+		Func(i);
+}
+
 #endif // THREADING
 
 #endif // __PARALLEL_H__
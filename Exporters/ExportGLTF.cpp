@@ -102,6 +102,10 @@ struct BufferData
 	FString BoundsMin;
 	FString BoundsMax;
 
+	// Used by GLTFExportContext to find duplicate blocks
+	uint64 Hash;
+	int HashNext;
+
 	BufferData()
 	: Data(NULL)
 	, DataSize(0)
@@ -142,6 +146,31 @@ struct BufferData
 		FillPtr += sizeof(T);
 	}
 
+	uint64 ComputeHash() const
+	{
+		// Mix metadata first, so blocks with the same data but different layout will be separated
+		uint64 h = (uint64)DataSize * 0x9E3779B97F4A7C15ull;
+		h ^= ((uint64)Count << 32) | (ComponentType << 1) | (bNormalized ? 1 : 0);
+		for (const char* s = Type; *s; s++)
+		{
+			h = (h ^ (byte)*s) * 0x100000001B3ull;
+		}
+		// Data is allocated with 16 byte alignment, and its size is aligned by 4
+		const uint64* p = (const uint64*)Data;
+		int NumWords = DataSize / 8;
+		for (int i = 0; i < NumWords; i++)
+		{
+			h = (h ^ p[i]) * 0x9E3779B97F4A7C15ull;
+			h ^= h >> 29;
+		}
+		if (DataSize & 4)
+		{
+			h = (h ^ *(const uint32*)(Data + DataSize - 4)) * 0x9E3779B97F4A7C15ull;
+			h ^= h >> 29;
+		}
+		return h;
+	}
+
 	bool IsSameAs(const BufferData& Other) const
 	{
 		// Compare metadata
@@ -160,9 +189,15 @@ struct GLTFExportContext
 	const char* MeshName;
 	const CSkeletalMesh* SkelMesh;
 	const CStaticMesh* StatMesh;
+	bool bBinary;					// writing glb file
 
 	TArray<BufferData> Data;
 
+	// Hash table for data blocks, holds (index+1) of the most recently added block with the
+	// same hash value, so zero-filled table is empty. Chains are linked with BufferData::HashNext.
+	enum { DATA_HASH_SIZE = 4096 };
+	int DataHash[DATA_HASH_SIZE];
+
 	GLTFExportContext()
 	{
 		memset(this, 0, sizeof(*this));
@@ -173,23 +208,27 @@ struct GLTFExportContext
 		return SkelMesh != NULL;
 	}
 
-	// Compare last item of Data with other itest starting with FirstDataIndex, drop the data
+	// Compare last item of Data with other items starting with FirstDataIndex, drop the data
 	// if same data block found and return its index. If no matching data were found, return
-	// index of that last data.
+	// index of that last data. Only blocks passed through this function are used for search.
 	int GetFinalIndexForLastBlock(int FirstDataIndex)
 	{
 		int LastIndex = Data.Num()-1;
-		const BufferData& LastData = Data[LastIndex];
-		for (int index = FirstDataIndex; index < LastIndex; index++)
+		BufferData& LastData = Data[LastIndex];
+		LastData.Hash = LastData.ComputeHash();
+		int HashIndex = LastData.Hash & (DATA_HASH_SIZE - 1);
+		for (int index = DataHash[HashIndex] - 1; index >= 0; index = Data[index].HashNext)
 		{
-			if (LastData.IsSameAs(Data[index]))
+			if (index >= FirstDataIndex && Data[index].Hash == LastData.Hash && LastData.IsSameAs(Data[index]))
 			{
 				// Found matching data
 				Data.RemoveAt(LastIndex);
 				return index;
 			}
 		}
-		// Not found
+		// Not found, add to the hash
+		LastData.HashNext = DataHash[HashIndex] - 1;
+		DataHash[HashIndex] = LastIndex + 1;
 		return LastIndex;
 	}
 };
@@ -641,6 +680,7 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 	for (int SeqIndex = 0; SeqIndex < Anim->Sequences.Num(); SeqIndex++)
 	{
 		const CAnimSequence &Seq = *Anim->Sequences[SeqIndex];
+		CAnimTracksLock TracksLock(&Seq);
 
 		Ar.Printf(
 			"    {\n"
@@ -815,7 +855,7 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 	unguard;
 }
 
-static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, FArchive& Ar, FArchive& Ar2)
+static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, FArchive& Ar)
 {
 	guard(ExportMeshLod);
 
@@ -897,15 +937,30 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 		bufferLength += Context.Data[i].DataSize;
 	}
 
-	Ar.Printf(
-		"  \"buffers\" : [\n"
-		"    {\n"
-		"      \"uri\" : \"%s.bin\",\n"
-		"      \"byteLength\" : %d\n"
-		"    }\n"
-		"  ],\n",
-		Context.MeshName, bufferLength
-	);
+	if (!Context.bBinary)
+	{
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"uri\" : \"%s.bin\",\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			Context.MeshName, bufferLength
+		);
+	}
+	else
+	{
+		// glb: buffer 0 refers to the BIN chunk
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			bufferLength
+		);
+	}
 
 	// Write bufferViews
 	Ar.Printf(
@@ -970,7 +1025,14 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 		"  ]\n"
 	);
 
-	// Write binary data
+	// Closing brace
+	Ar.Printf("}\n");
+
+	unguard;
+}
+
+static void WriteBufferData(const GLTFExportContext& Context, FArchive& Ar)
+{
 	guard(WriteBIN);
 	for (int i = 0; i < Context.Data.Num(); i++)
 	{
@@ -978,12 +1040,69 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 #if MAX_DEBUG
 		assert(B.FillCount == B.Count);
 #endif
-		Ar2.Serialize(B.Data, B.DataSize);
+		Ar.Serialize(B.Data, B.DataSize);
 	}
 	unguard;
+}
 
-	// Closing brace
-	Ar.Printf("}\n");
+// Export a single mesh LOD either as .gltf with external .bin buffer, or as .glb file
+static void ExportMeshLodFile(GLTFExportContext& Context, const UObject* OriginalMesh, const CBaseMeshLod& Lod, const CMeshVertex* Verts)
+{
+	guard(ExportMeshLodFile);
+
+	if (!GExportGLB)
+	{
+		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", Context.MeshName);
+		if (Ar)
+		{
+			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", Context.MeshName);
+			assert(Ar2);
+			ExportMeshLod(Context, Lod, Verts, *Ar);
+			WriteBufferData(Context, *Ar2);
+			delete Ar;
+			delete Ar2;
+		}
+		return;
+	}
+
+	FArchive* Ar = CreateExportArchive(OriginalMesh, 0, "%s.glb", Context.MeshName);
+	if (!Ar) return;
+
+	// JSON chunk should be complete before writing the header, because the header holds the
+	// file size. Binary data is written directly from data blocks.
+	Context.bBinary = true;
+	FMemWriter JsonAr;
+	ExportMeshLod(Context, Lod, Verts, JsonAr);
+	// JSON chunk is padded with spaces
+	while (JsonAr.GetFileSize() & 3)
+	{
+		JsonAr.Printf(" ");
+	}
+
+	uint32 JsonLength = JsonAr.GetFileSize();
+	uint32 BinLength = 0;
+	for (int i = 0; i < Context.Data.Num(); i++)
+	{
+		BinLength += Context.Data[i].DataSize;		// each block is already aligned by 4
+	}
+
+	// glb header
+	uint32 Magic = BYTES4('g','l','T','F');
+	uint32 Version = 2;
+	uint32 TotalLength = 12 + (8 + JsonLength) + (8 + BinLength);
+	*Ar << Magic << Version << TotalLength;
+
+	// JSON chunk
+	uint32 ChunkType = BYTES4('J','S','O','N');
+	*Ar << JsonLength << ChunkType;
+	Ar->Serialize((void*)JsonAr.GetData().GetData(), JsonLength);
+
+	// BIN chunk
+	ChunkType = BYTES4('B','I','N',0);
+	*Ar << BinLength << ChunkType;
+	WriteBufferData(Context, *Ar);
+
+	delete Ar;
 
 	unguard;
 }
@@ -1011,19 +1130,10 @@ void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", meshName);
-		if (Ar)
-		{
-			GLTFExportContext Context;
-			Context.MeshName = meshName;
-			Context.SkelMesh = Mesh;
-
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
-			delete Ar;
-			delete Ar2;
-		}
+		GLTFExportContext Context;
+		Context.MeshName = meshName;
+		Context.SkelMesh = Mesh;
+		ExportMeshLodFile(Context, OriginalMesh, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts);
 	}
 
 	unguard;
@@ -1053,19 +1163,10 @@ void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", meshName);
-		if (Ar)
-		{
-			GLTFExportContext Context;
-			Context.MeshName = meshName;
-			Context.StatMesh = Mesh;
-
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
-			delete Ar;
-			delete Ar2;
-		}
+		GLTFExportContext Context;
+		Context.MeshName = meshName;
+		Context.StatMesh = Mesh;
+		ExportMeshLodFile(Context, OriginalMesh, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts);
 	}
 
 	unguard;
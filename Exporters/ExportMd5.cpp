@@ -308,6 +308,7 @@ void ExportMd5Anim(const CAnimSet *Anim)
 	{
 		int i;
 		const CAnimSequence &S = *Anim->Sequences[AnimIndex];
+		CAnimTracksLock TracksLock(&S);
 
 		FArchive *Ar = CreateExportArchive(OriginalAnim, FAO_TextFile, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
 		if (!Ar)
@@ -348,7 +349,9 @@ void ExportMd5Anim(const CAnimSet *Anim)
 			Ar->Printf("\t( -100 -100 -100 ) ( 100 100 100 )\n");	//!! dummy
 		Ar->Printf("}\n\n");
 
-		// baseframe and frames
+		// baseframe and frames; frames are sampled sequentially, use cursors to avoid searching for keys
+		TArray<CAnimTrackCursor> Cursors;
+		Cursors.AddDefaulted(numBones);
 		for (int Frame = -1; Frame < S.NumFrames; Frame++)
 		{
 			int t = Frame;
@@ -364,7 +367,7 @@ void ExportMd5Anim(const CAnimSet *Anim)
 			{
 				CVec3 BP;
 				CQuat BO;
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO, &Cursors[b]);
 				if (!b) BO.Conjugate();			// root bone
 #if MIRROR_MESH
 				BO.y  *= -1;
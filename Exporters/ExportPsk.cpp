@@ -79,8 +79,7 @@ static void ExportCommonMeshData
 {
 	guard(ExportCommonMeshData);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader MainHdr, PtsHdr, WedgHdr, FacesHdr, MatrHdr;
+	VChunkHeader MainHdr, PtsHdr, WedgHdr, FacesHdr, MatrHdr;
 	int i;
 
 #define SECT(n)		(Sections + n)
@@ -256,7 +255,7 @@ static void ExportVertexColors(FArchive &Ar, const FColor* Colors, int NumVerts)
 
 	if (!Colors) return;
 
-	static VChunkHeader ColorHdr;
+	VChunkHeader ColorHdr;
 	ColorHdr.DataCount = NumVerts;
 	ColorHdr.DataSize  = sizeof(FColor);
 
@@ -276,7 +275,7 @@ static void ExportExtraUV
 {
 	guard(ExportExtraUV);
 
-	static VChunkHeader UVHdr;
+	VChunkHeader UVHdr;
 	UVHdr.DataCount = NumVerts;
 	UVHdr.DataSize  = sizeof(VMeshUV);
 
@@ -311,8 +310,7 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 {
 	guard(ExportSkeletalMeshLod);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader BoneHdr, InfHdr;
+	VChunkHeader BoneHdr, InfHdr;
 
 	int i, j;
 	CVertexShare Share;
@@ -323,7 +321,8 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 	// normal, but belongs to different bones.
 //	appResetProfiler();
 	guard(WeldVerts);
-	Share.Prepare(Lod.Verts, Lod.NumVerts, sizeof(CSkelMeshVertex));
+	TArray<uint32> WeightsHash;
+	WeightsHash.AddUninitialized(Lod.NumVerts);
 	for (i = 0; i < Lod.NumVerts; i++)
 	{
 		const CSkelMeshVertex &S = Lod.Verts[i];
@@ -332,11 +331,12 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 		// these vertices were duplicated by copying). Doing more complicated comparison
 		// will reduce performance with possibly reducing size of exported mesh by a few
 		// more vertices.
-		uint32 WeightsHash = S.PackedWeights;
+		uint32 Hash = S.PackedWeights;
 		for (j = 0; j < ARRAY_COUNT(S.Bone); j++)
-			WeightsHash ^= S.Bone[j] << j;
-		Share.AddVertex(S.Position, S.Normal, WeightsHash);
+			Hash ^= S.Bone[j] << j;
+		WeightsHash[i] = Hash;
 	}
+	Share.WeldVertices(Lod.Verts, Lod.NumVerts, sizeof(CSkelMeshVertex), WeightsHash.GetData());
 	unguard;
 //	appPrintProfiler();
 //	appPrintf("%d wedges were welded into %d verts\n", Lod.NumVerts, Share.Points.Num());
@@ -544,8 +544,7 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 	if (!Ar0) return;
 	FArchive &Ar = *Ar0;						// use "Ar << obj" instead of "(*Ar) << obj"
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader MainHdr, BoneHdr, AnimHdr, KeyHdr, ScaleKeysHdr;
+	VChunkHeader MainHdr, BoneHdr, AnimHdr, KeyHdr, ScaleKeysHdr;
 	int i;
 
 	MainHdr.TypeFlag = PSA_VERSION;
@@ -619,6 +618,10 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 	{
 		guard(Sequence);
 		const CAnimSequence &S = *Anim->Sequences[i];
+		CAnimTracksLock TracksLock(&S);
+		// frames are sampled sequentially, use cursors to avoid searching for keys
+		TArray<CAnimTrackCursor> Cursors;
+		Cursors.AddDefaulted(numBones);
 		for (int t = 0; t < S.NumFrames; t++)
 		{
 			for (int b = 0; b < numBones; b++)
@@ -629,7 +632,7 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 
 				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
 				BO.Set(0, 0, 0, 1);
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO, &Cursors[b]);
 
 				K.Position    = (FVector&) BP;
 				K.Orientation = (FQuat&)   BO;
@@ -734,6 +737,7 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 			for (i = 0; i < numAnims; i++)
 			{
 				const CAnimSequence &S = *Anim->Sequences[i];
+				CAnimTracksLock TracksLock(&S);
 				for (int b = 0; b < numBones; b++)
 				{
 #define FLAG_NO_TRANSLATION		1
@@ -832,20 +836,14 @@ static void ExportStaticMeshLod(const CStaticMeshLod &Lod, FArchive &Ar)
 {
 	guard(ExportStaticMeshLod);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader BoneHdr, InfHdr;
+	VChunkHeader BoneHdr, InfHdr;
 
 	CVertexShare Share;
 
 	// weld vertices
 //	appResetProfiler();
 	guard(WeldVerts);
-	Share.Prepare(Lod.Verts, Lod.NumVerts, sizeof(CStaticMeshVertex));
-	for (int i = 0; i < Lod.NumVerts; i++)
-	{
-		const CMeshVertex &S = Lod.Verts[i];
-		Share.AddVertex(S.Position, S.Normal);
-	}
+	Share.WeldVertices(Lod.Verts, Lod.NumVerts, sizeof(CStaticMeshVertex));
 	unguard;
 //	appPrintProfiler();
 //	appPrintf("%d wedges were welded into %d verts\n", Lod.NumVerts, Share.Points.Num());
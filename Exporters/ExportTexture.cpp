@@ -44,6 +44,7 @@ struct GCC_PACK tgaHdr_t
 bool GNoTgaCompress = false;
 bool GExportPNG = false;
 bool GExportDDS = false;
+bool GExportKTX2 = false;
 
 //?? place this function outside (cannot place to Core - using FArchive)
 
@@ -239,49 +240,297 @@ static void WriteHDR(FArchive &Ar, int width, int height, byte *pic)
 }
 
 
-static void WriteDDS(FArchive& Ar, const CTextureData& TexData, int Slice)
+/*-----------------------------------------------------------------------------
+	Compressed texture passthrough (DDS and KTX2)
+-----------------------------------------------------------------------------*/
+
+// Size of a single slice of the mip level in bytes
+static int GetMipSliceSize(ETexturePixelFormat Format, int USize, int VSize)
 {
-	guard(WriteDDS);
+	const CPixelFormatInfo& Info = PixelFormatInfo[Format];
+	int NumBlocksX = (USize + Info.BlockSizeX - 1) / Info.BlockSizeX;
+	int NumBlocksY = (VSize + Info.BlockSizeY - 1) / Info.BlockSizeY;
+	return NumBlocksX * NumBlocksY * Info.BytesPerBlock;
+}
 
-	if (!TexData.Mips.Num()) return;
-	const CMipMap& Mip = TexData.Mips[0];
+// Find number of mips which could be written as a complete mip chain: every level should be
+// a half of the previous one, and should have data for all slices. Stop at the first missing mip.
+// Maximal number of mips in a valid chain: a 2^31 texture has 32 levels. File writers are using
+// fixed-size arrays for the level index.
+#define MAX_PASSTHROUGH_MIPS				32
 
-	unsigned fourCC = TexData.GetFourCC();
+static int GetPassthroughMipCount(const CTextureData& TexData, int NumSlices)
+{
+	int NumMips = 0;
+	for (int MipLevel = 0; MipLevel < TexData.Mips.Num() && MipLevel < MAX_PASSTHROUGH_MIPS; MipLevel++)
+	{
+		const CMipMap& Mip = TexData.Mips[MipLevel];
+		if (MipLevel > 0)
+		{
+			const CMipMap& PrevMip = TexData.Mips[MipLevel - 1];
+			if (PrevMip.USize == 1 && PrevMip.VSize == 1)
+				break;		// malformed texture, mip chain ends with 1x1
+			if (Mip.USize != max(PrevMip.USize / 2, 1) || Mip.VSize != max(PrevMip.VSize / 2, 1))
+				break;
+		}
+		if (!Mip.CompressedData || Mip.DataSize / NumSlices < GetMipSliceSize(TexData.Format, Mip.USize, Mip.VSize))
+			break;
+		NumMips++;
+	}
+	return NumMips;
+}
+
+// Slices are stored one after another inside each mip, the same way as CTextureData::Decompress() expects
+static const byte* GetMipSliceData(const CMipMap& Mip, int Slice, int NumSlices)
+{
+	return Mip.CompressedData + Mip.DataSize / NumSlices * Slice;
+}
 
-	// code from CTextureData::Decompress()
-	if (!fourCC)
-		appError("unknown texture format %d \n", TexData.Format);	// should not happen - IsDXT() should not pass execution here
+#define DXGI_FORMAT_BC6H_UF16				95
+#define DXGI_FORMAT_BC7_UNORM				98
+#define DDS_RESOURCE_MISC_TEXTURECUBE		4
 
-	int DataSize = Mip.DataSize;
-	const byte* DataPtr = Mip.CompressedData;
-	if (Slice >= 0)
+// Formats which has no FourCC code are written with DX10 header
+static unsigned GetDXGIFormat(ETexturePixelFormat Format)
+{
+	switch (Format)
 	{
-		DataSize /= 6;
-		DataPtr += Slice * DataSize;
+	case TPF_BC6H:
+		return DXGI_FORMAT_BC6H_UF16;
+	case TPF_BC7:
+		return DXGI_FORMAT_BC7_UNORM;
+	default:
+		return 0;
 	}
+}
+
+static bool CanExportDDS(ETexturePixelFormat Format)
+{
+	return PixelFormatInfo[Format].IsDXT() || GetDXGIFormat(Format) != 0;
+}
+
+static void WriteDDS(FArchive& Ar, const CTextureData& TexData, int NumSlices)
+{
+	guard(WriteDDS);
+
+	int NumMips = GetPassthroughMipCount(TexData, NumSlices);
+	if (!NumMips)
+		appError("texture data is too small");		// should not happen - checked by CTextureExportWorker
+
+	const CMipMap& Mip = TexData.Mips[0];
 
 	nv::DDSHeader header;
-	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
+	unsigned fourCC = TexData.GetFourCC();
+	unsigned DXGIFormat = GetDXGIFormat(TexData.Format);
+	if (fourCC)
+	{
+		header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
+	}
+	else
+	{
+		header.setFourCC('D', 'X', '1', '0');
+		header.setDX10Format(DXGIFormat);
+		header.setTexture2D();
+		header.header10.arraySize = 1;
+	}
 //	header.setPixelFormat(32, 0xFF, 0xFF << 8, 0xFF << 16, 0xFF << 24);	// bit count and per-channel masks
 	//!! Note: should use setFourCC for compressed formats, and setPixelFormat for uncompressed - these functions are
 	//!! incompatible. When fourcc is used, color masks are zero, and vice versa.
 	header.setWidth(Mip.USize);
 	header.setHeight(Mip.VSize);
+	if (NumSlices == 6)
+	{
+		header.setTextureCube();
+		// nvtt puts number of faces here, but DX10 expects number of cubes
+		header.header10.arraySize = 1;
+		header.header10.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+	}
+	header.setMipmapCount(NumMips);					// should be called after setTextureCube(), it depends on caps
 //	header.setNormalFlag(TexData.Format == TPF_DXT5N || TexData.Format == TPF_3DC); -- required for decompression only
-	header.setLinearSize(DataSize);
+	header.setLinearSize(GetMipSliceSize(TexData.Format, Mip.USize, Mip.VSize));
+
+	byte headerBuffer[148];							// DDS header is 128 bytes long, plus 20 bytes for DX10 extension
+	memset(headerBuffer, 0, sizeof(headerBuffer));
+	int headerSize = WriteDDSHeader(headerBuffer, header);
+	Ar.Serialize(headerBuffer, headerSize);
+
+	// DDS stores complete mip chain for every cubemap face
+	for (int Slice = 0; Slice < NumSlices; Slice++)
+	{
+		for (int MipLevel = 0; MipLevel < NumMips; MipLevel++)
+		{
+			const CMipMap& SliceMip = TexData.Mips[MipLevel];
+			int SliceSize = GetMipSliceSize(TexData.Format, SliceMip.USize, SliceMip.VSize);
+			Ar.Serialize(const_cast<byte*>(GetMipSliceData(SliceMip, Slice, NumSlices)), SliceSize);
+		}
+	}
 
-	byte headerBuffer[128];							// DDS header is 128 bytes long
-	memset(headerBuffer, 0, 128);
-	WriteDDSHeader(headerBuffer, header);
-	Ar.Serialize(headerBuffer, 128);
-	Ar.Serialize(const_cast<byte*>(DataPtr), DataSize);
+	unguard;
+}
+
+// KTX2 data format descriptor constants, see Khronos Data Format Specification
+#define KHR_DF_MODEL_BC1A					128
+#define KHR_DF_MODEL_BC2					129
+#define KHR_DF_MODEL_BC3					130
+#define KHR_DF_MODEL_BC4					131
+#define KHR_DF_MODEL_BC5					132
+#define KHR_DF_MODEL_BC6H					133
+#define KHR_DF_MODEL_BC7					134
+#define KHR_DF_MODEL_ETC2					161
+#define KHR_DF_MODEL_ASTC					162
+#define KHR_DF_PRIMARIES_BT709				1
+#define KHR_DF_TRANSFER_LINEAR				1
+#define KHR_DF_SAMPLE_DATATYPE_FLOAT		0x80
+
+struct CKTX2FormatInfo
+{
+	ETexturePixelFormat	Format;
+	uint32				VkFormat;
+	byte				ColorModel;
+	byte				NumSamples;			// 1 sample covers the whole block, 2 samples are 64 bits each
+	byte				Channels[2];		// channel ids of samples, with sample datatype qualifiers
+};
+
+static const CKTX2FormatInfo KTX2Formats[] =
+{
+	// Format			VkFormat	ColorModel				Samples	Channels
+	{ TPF_DXT1,			133,		KHR_DF_MODEL_BC1A,		1,		{ 1 }		},	// BC1_RGBA_UNORM, channel = ALPHAPRESENT
+	{ TPF_DXT3,			135,		KHR_DF_MODEL_BC2,		2,		{ 15, 0 }	},	// BC2_UNORM, alpha + color
+	{ TPF_DXT5,			137,		KHR_DF_MODEL_BC3,		2,		{ 15, 0 }	},	// BC3_UNORM, alpha + color
+	{ TPF_DXT5N,		137,		KHR_DF_MODEL_BC3,		2,		{ 15, 0 }	},
+	{ TPF_BC4,			139,		KHR_DF_MODEL_BC4,		1,		{ 0 }		},	// BC4_UNORM
+	{ TPF_BC5,			141,		KHR_DF_MODEL_BC5,		2,		{ 0, 1 }	},	// BC5_UNORM, red + green
+	{ TPF_BC6H,			143,		KHR_DF_MODEL_BC6H,		1,		{ KHR_DF_SAMPLE_DATATYPE_FLOAT }	},	// BC6H_UFLOAT
+	{ TPF_BC7,			145,		KHR_DF_MODEL_BC7,		1,		{ 0 }		},	// BC7_UNORM
+#if SUPPORT_ANDROID
+	{ TPF_ETC1,			147,		KHR_DF_MODEL_ETC2,		1,		{ 2 }		},	// ETC2_R8G8B8_UNORM is a superset of ETC1
+	{ TPF_ETC2_RGB,		147,		KHR_DF_MODEL_ETC2,		1,		{ 2 }		},	// ETC2_R8G8B8_UNORM, channel = COLOR
+	{ TPF_ETC2_RGBA,	151,		KHR_DF_MODEL_ETC2,		2,		{ 15, 2 }	},	// ETC2_R8G8B8A8_UNORM, alpha + color
+	{ TPF_ASTC_4x4,		157,		KHR_DF_MODEL_ASTC,		1,		{ 0 }		},	// ASTC_4x4_UNORM
+	{ TPF_ASTC_6x6,		165,		KHR_DF_MODEL_ASTC,		1,		{ 0 }		},	// ASTC_6x6_UNORM
+	{ TPF_ASTC_8x8,		171,		KHR_DF_MODEL_ASTC,		1,		{ 0 }		},	// ASTC_8x8_UNORM
+	{ TPF_ASTC_10x10,	179,		KHR_DF_MODEL_ASTC,		1,		{ 0 }		},	// ASTC_10x10_UNORM
+	{ TPF_ASTC_12x12,	183,		KHR_DF_MODEL_ASTC,		1,		{ 0 }		},	// ASTC_12x12_UNORM
+#endif // SUPPORT_ANDROID
+};
+
+static const CKTX2FormatInfo* FindKTX2Format(ETexturePixelFormat Format)
+{
+	for (const CKTX2FormatInfo& Info : KTX2Formats)
+	{
+		if (Info.Format == Format)
+			return &Info;
+	}
+	return NULL;
+}
+
+static void WriteKTX2(FArchive& Ar, const CTextureData& TexData, int NumSlices)
+{
+	guard(WriteKTX2);
+
+	int NumMips = GetPassthroughMipCount(TexData, NumSlices);
+	if (!NumMips)
+		appError("texture data is too small");		// should not happen - checked by CTextureExportWorker
+
+	const CKTX2FormatInfo* Info = FindKTX2Format(TexData.Format);
+	assert(Info);
+	const CPixelFormatInfo& FormatInfo = PixelFormatInfo[TexData.Format];
+
+	// Data format descriptor: total size, basic descriptor block header, samples
+	uint32 Dfd[1 + 6 + 4 * 2];
+	int DfdWords = 1 + 6 + 4 * Info->NumSamples;
+	memset(Dfd, 0, sizeof(Dfd));
+	Dfd[0] = DfdWords * 4;
+	Dfd[1] = 0;										// vendorId = KHRONOS, descriptorType = BASICFORMAT
+	Dfd[2] = 2 | ((DfdWords - 1) * 4) << 16;		// versionNumber = 1.3, descriptorBlockSize
+	Dfd[3] = Info->ColorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16);
+	Dfd[4] = (FormatInfo.BlockSizeX - 1) | ((FormatInfo.BlockSizeY - 1) << 8);
+	Dfd[5] = FormatInfo.BytesPerBlock;				// bytesPlane0
+	int SampleBits = FormatInfo.BytesPerBlock * 8 / Info->NumSamples;
+	for (int Sample = 0; Sample < Info->NumSamples; Sample++)
+	{
+		uint32* s = &Dfd[7 + Sample * 4];
+		byte Channel = Info->Channels[Sample];
+		s[0] = (Sample * SampleBits) | ((SampleBits - 1) << 16) | (Channel << 24);
+		if (Channel & KHR_DF_SAMPLE_DATATYPE_FLOAT)
+		{
+			s[2] = 0;								// 0.0f
+			s[3] = 0x3F800000;						// 1.0f
+		}
+		else
+		{
+			s[2] = 0;
+			s[3] = 0xFFFFFFFF;
+		}
+	}
+
+	// Compute file layout: header, level index, DFD, then mip levels from the smallest one;
+	// every level is aligned to the block size
+	int HeaderSize = 80 + NumMips * 24;
+	assert(NumMips <= MAX_PASSTHROUGH_MIPS);
+	uint64 LevelOffsets[MAX_PASSTHROUGH_MIPS];
+	uint64 LevelSizes[MAX_PASSTHROUGH_MIPS];
+	uint64 DataEnd = HeaderSize + Dfd[0];
+	for (int MipLevel = NumMips - 1; MipLevel >= 0; MipLevel--)
+	{
+		const CMipMap& Mip = TexData.Mips[MipLevel];
+		DataEnd = Align(DataEnd, FormatInfo.BytesPerBlock);
+		LevelOffsets[MipLevel] = DataEnd;
+		LevelSizes[MipLevel] = (uint64)GetMipSliceSize(TexData.Format, Mip.USize, Mip.VSize) * NumSlices;
+		DataEnd += LevelSizes[MipLevel];
+	}
+
+	static const byte Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	Ar.Serialize(const_cast<byte*>(Identifier), sizeof(Identifier));
+	uint32 VkFormat = Info->VkFormat;
+	uint32 TypeSize = 1;
+	uint32 PixelWidth = TexData.Mips[0].USize;
+	uint32 PixelHeight = TexData.Mips[0].VSize;
+	uint32 PixelDepth = 0;
+	uint32 LayerCount = 0;
+	uint32 FaceCount = NumSlices;
+	uint32 LevelCount = NumMips;
+	uint32 SupercompressionScheme = 0;
+	Ar << VkFormat << TypeSize << PixelWidth << PixelHeight << PixelDepth << LayerCount << FaceCount << LevelCount << SupercompressionScheme;
+	// Index
+	uint32 DfdOffset = HeaderSize;
+	uint32 DfdSize = Dfd[0];
+	uint32 KvdOffset = 0, KvdSize = 0;
+	uint64 SgdOffset = 0, SgdSize = 0;
+	Ar << DfdOffset << DfdSize << KvdOffset << KvdSize << SgdOffset << SgdSize;
+	for (int MipLevel = 0; MipLevel < NumMips; MipLevel++)
+	{
+		// byteOffset, byteLength, uncompressedByteLength
+		Ar << LevelOffsets[MipLevel] << LevelSizes[MipLevel] << LevelSizes[MipLevel];
+	}
+	for (int i = 0; i < DfdWords; i++)
+		Ar << Dfd[i];
+
+	uint64 Pos = HeaderSize + Dfd[0];
+	for (int MipLevel = NumMips - 1; MipLevel >= 0; MipLevel--)
+	{
+		static byte Padding[16];
+		int PadSize = int(LevelOffsets[MipLevel] - Pos);
+		if (PadSize) Ar.Serialize(Padding, PadSize);
+		// Faces are stored inside of each mip level
+		const CMipMap& Mip = TexData.Mips[MipLevel];
+		int SliceSize = GetMipSliceSize(TexData.Format, Mip.USize, Mip.VSize);
+		for (int Slice = 0; Slice < NumSlices; Slice++)
+			Ar.Serialize(const_cast<byte*>(GetMipSliceData(Mip, Slice, NumSlices)), SliceSize);
+		Pos = LevelOffsets[MipLevel] + LevelSizes[MipLevel];
+	}
 
 	unguard;
 }
 
-static void ExportDDS_Worker(FArchive& Ar, CTextureData& TexData, byte* /*pic*/, int Slice)
+static void ExportDDS_Worker(FArchive& Ar, CTextureData& TexData, byte* /*pic*/, int NumSlices)
 {
-	WriteDDS(Ar, TexData, Slice);
+	WriteDDS(Ar, TexData, NumSlices);
+}
+
+static void ExportKTX2_Worker(FArchive& Ar, CTextureData& TexData, byte* /*pic*/, int NumSlices)
+{
+	WriteKTX2(Ar, TexData, NumSlices);
 }
 
 static void ExportHDR_Worker(FArchive& Ar, CTextureData& TexData, byte* pic, int /*Slice*/)
@@ -318,6 +567,7 @@ struct CTextureExportWorker
 {
 	CTextureData TexData;
 	FArchive* Ar = NULL;
+	// 'slice' is slice index for decompressed data, or number of slices for compressed data passthrough
 	void (*Func)(FArchive& Ar, CTextureData& TexData, byte* pic, int slice) = NULL;
 	bool bFail = false;
 	bool bNeedDecompressedData = true;
@@ -357,7 +607,13 @@ struct CTextureExportWorker
 
 		const char* Ext = NULL;
 
-		if (GExportDDS && PixelFormatInfo[Format].IsDXT())
+		if (GExportKTX2 && FindKTX2Format(Format))
+		{
+			Func = ExportKTX2_Worker;
+			bNeedDecompressedData = false;
+			Ext = "ktx2";
+		}
+		else if (GExportDDS && CanExportDDS(Format))
 		{
 			Func = ExportDDS_Worker;
 			bNeedDecompressedData = false;
@@ -379,14 +635,15 @@ struct CTextureExportWorker
 			Ext = "tga";
 		}
 
-		if (!HasSlices)
+		ExportExt = Ext;
+		if (!HasSlices || !bNeedDecompressedData)
 		{
+			// Compressed data passthrough writes all mips and cubemap faces into a single file
 			Ar = CreateExportArchive(Tex, 0, "%s.%s", Tex->Name, Ext);
 		}
 		else
 		{
 			ExportPath = GetExportPath(Tex);
-			ExportExt = Ext;
 			Ar = CreateExportArchive(Tex, 0, "%s/Side_0.%s", Tex->Name, Ext);
 		}
 
@@ -396,8 +653,13 @@ struct CTextureExportWorker
 			return false;
 		}
 
-		// Get texture data in context of the main thread: it's fast anyway
-		if (!Tex->GetTextureData(TexData) || TexData.Mips.Num() == 0)
+		// Get texture data in context of the calling thread, which could be an export batch thread: bulk
+		// data is read with pooled readers, see UnPackage::AcquireBulkReader(). Load only mips which will be
+		// exported: the first one, or the whole mip chain for compressed data passthrough.
+		bool bHasMips = Tex->GetTextureData(TexData);
+		if (bHasMips)
+			bHasMips = bNeedDecompressedData ? TexData.LoadFirstMip() : TexData.LoadAllMips();
+		if (!bHasMips)
 		{
 			appPrintf("WARNING: texture %s has no valid mipmaps\n", Tex->Name);
 			bFail = true;
@@ -413,7 +675,7 @@ struct CTextureExportWorker
 
 	void operator()()
 	{
-		int SliceCount = HasSlices ? 6 : 1;
+		int SliceCount = (HasSlices && bNeedDecompressedData) ? 6 : 1;
 		for (int Slice = 0; Slice < SliceCount; Slice++)
 		{
 			if (Slice >= 1)
@@ -455,6 +717,13 @@ struct CTextureExportWorker
 				}
 			}
 
+			int NumPassthroughSlices = HasSlices ? 6 : 1;
+			if (!bFail && !bNeedDecompressedData && !GetPassthroughMipCount(TexData, NumPassthroughSlices))
+			{
+				bFail = true;
+				appPrintf("WARNING: texture %s has no complete mip data for %s export\n", TexData.GetObjectName(), *ExportExt);
+			}
+
 			if (bFail)
 			{
 				// Close and delete created file
@@ -467,7 +736,10 @@ struct CTextureExportWorker
 			else
 			{
 				// Do the export
-				Func(*Ar, TexData, pic, HasSlices ? Slice : -1);
+				if (bNeedDecompressedData)
+					Func(*Ar, TexData, pic, HasSlices ? Slice : -1);
+				else
+					Func(*Ar, TexData, NULL, NumPassthroughSlices);
 			}
 
 			// Cleanup
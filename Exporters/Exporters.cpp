@@ -11,6 +11,7 @@
 // configuration variables
 bool GExportScripts      = false;
 bool GExportLods         = false;
+bool GExportGLB          = false;
 bool GDontOverwriteFiles = false;
 
 bool GExportInProgress   = false;
@@ -34,6 +35,27 @@ struct CExporterInfo
 static CExporterInfo exporters[MAX_EXPORTERS];
 static int numExporters = 0;
 
+// Cache of exporter index for object class, so IsA() is not called for every exporter and
+// every exported object.
+#define EXPORTER_CACHE_SIZE		512
+#define EXPORTER_CACHE_MASK		(EXPORTER_CACHE_SIZE - 1)
+
+struct CExporterCacheEntry
+{
+	const CTypeInfo* Type;
+	int				ExporterIndex;		// INDEX_NONE when object has no exporter
+};
+
+static CExporterCacheEntry exporterCache[EXPORTER_CACHE_SIZE];
+static int exporterCacheCount = 0;
+
+#if THREADING
+static CMutex ExporterCacheMutex;
+#define LOCK_EXPORTER_CACHE()	CMutex::ScopedLock ExporterCacheLock(ExporterCacheMutex)
+#else
+#define LOCK_EXPORTER_CACHE()
+#endif
+
 void RegisterExporter(const char* ClassName, ExporterFunc_t Func)
 {
 	guard(RegisterExporter);
@@ -42,9 +64,49 @@ void RegisterExporter(const char* ClassName, ExporterFunc_t Func)
 	Info.ClassName = ClassName;
 	Info.Func = Func;
 	numExporters++;
+
+	// Reset cached exporters
+	LOCK_EXPORTER_CACHE();
+	memset(exporterCache, 0, sizeof(exporterCache));
+	exporterCacheCount = 0;
 	unguard;
 }
 
+static int FindExporter(const UObject* Obj)
+{
+	const CTypeInfo* Type = Obj->GetTypeinfo();
+
+	LOCK_EXPORTER_CACHE();
+
+	uint32 Hash = (uint32)((size_t)Type >> 4) * 0x9E3779B1;
+	for (uint32 i = Hash >> 20; ; i++)
+	{
+		CExporterCacheEntry& Entry = exporterCache[i & EXPORTER_CACHE_MASK];
+		if (Entry.Type == Type)
+			return Entry.ExporterIndex;
+		if (Entry.Type) continue;
+
+		// Not cached yet, find the first matching exporter
+		int ExporterIndex = INDEX_NONE;
+		for (int j = 0; j < numExporters; j++)
+		{
+			if (Type->IsA(exporters[j].ClassName))
+			{
+				ExporterIndex = j;
+				break;
+			}
+		}
+		// Keep the cache sparse, so the search will be fast
+		if (exporterCacheCount < EXPORTER_CACHE_SIZE / 2)
+		{
+			Entry.Type = Type;
+			Entry.ExporterIndex = ExporterIndex;
+			exporterCacheCount++;
+		}
+		return ExporterIndex;
+	}
+}
+
 
 // List of already exported objects
 
@@ -73,7 +135,6 @@ struct ExportedObjectEntry
 
 struct ExportContext
 {
-	const UObject* LastExported;
 	TArray<ExportedObjectEntry> Objects;
 	int ObjectHash[EXPORTED_LIST_HASH_SIZE];
 	unsigned long startTime;
@@ -91,7 +152,6 @@ struct ExportContext
 
 	void Reset()
 	{
-		LastExported = NULL;
 		NumSkippedObjects = 0;
 		Objects.Empty();
 		memset(ObjectHash, -1, sizeof(ObjectHash));
@@ -147,6 +207,18 @@ struct ExportContext
 
 static ExportContext ctx;
 
+// Object which is currently exported by this thread. It is tracked per thread, because packages
+// could be exported in parallel (see ExportPackages).
+static thread_local const UObject* LastExported = NULL;
+
+#if THREADING
+// Protects 'ctx' and 'ExportedNames' when objects are exported from multiple threads
+static CMutex ExportMutex;
+#define LOCK_EXPORT_CONTEXT()	CMutex::ScopedLock ExportLock(ExportMutex)
+#else
+#define LOCK_EXPORT_CONTEXT()
+#endif
+
 static bool OnObjectLoad(UObject* Obj)
 {
 	guard(OnObjectLoad);
@@ -197,6 +269,7 @@ void EndExport(bool profile)
 	ctx.startTime = 0;
 
 	ctx.Reset();
+	LastExported = NULL;
 }
 
 // return 'false' if object already registered
@@ -210,11 +283,13 @@ static bool RegisterProcessedObject(const UObject* Obj)
 		return true;
 	}
 
+	LOCK_EXPORT_CONTEXT();
 	return ctx.AddItem(Obj);
 }
 
 bool IsObjectExported(const UObject* Obj)
 {
+	LOCK_EXPORT_CONTEXT();
 	return ctx.ItemExists(Obj);
 }
 
@@ -336,62 +411,63 @@ bool ExportObject(const UObject *Obj)
 		bAddUniqueSuffix = true;
 	}
 
-	for (int i = 0; i < numExporters; i++)
-	{
-		const CExporterInfo &Info = exporters[i];
-		if (Obj->IsA(Info.ClassName))
-		{
-			char ExportPath[1024];
-			strcpy(ExportPath, GetExportPath(Obj));
-			const char* ClassName = Obj->GetClassName();
+	int ExporterIndex = FindExporter(Obj);
+	if (ExporterIndex == INDEX_NONE)
+		return false;
+	const CExporterInfo &Info = exporters[ExporterIndex];
 
-			// Check for duplicate name
-			const char* OriginalName = NULL;
-			if (bAddUniqueSuffix)
-			{
-				// Get object's unique key from its name
-				char uniqueName[1024];
-				appSprintf(ARRAY_ARG(uniqueName), "%s/%s.%s", ExportPath, Obj->Name, ClassName);
+	char ExportPath[1024];
+	strcpy(ExportPath, GetExportPath(Obj));
+	const char* ClassName = Obj->GetClassName();
+
+	// Check for duplicate name
+	const char* OriginalName = NULL;
+	if (bAddUniqueSuffix)
+	{
+		// Get object's unique key from its name
+		char uniqueName[1024];
+		appSprintf(ARRAY_ARG(uniqueName), "%s/%s.%s", ExportPath, Obj->Name, ClassName);
 
-				// Get object metadata for better detection of duplicates
-				FMemWriter MetaCollector;
-				Obj->GetMetadata(MetaCollector);
+		// Get object metadata for better detection of duplicates
+		FMemWriter MetaCollector;
+		Obj->GetMetadata(MetaCollector);
 
-				// Add unique numeric suffix when needed
-				const TArray<byte>& Meta = MetaCollector.GetData();
-				int uniqueIdx = ExportedNames.RegisterName(uniqueName, Meta);
+		// Add unique numeric suffix when needed
+		const TArray<byte>& Meta = MetaCollector.GetData();
+		int uniqueIdx;
+		{
+			LOCK_EXPORT_CONTEXT();
+			uniqueIdx = ExportedNames.RegisterName(uniqueName, Meta);
+		}
 #if DEBUG_DUP_FINDER
-				char buf[512];
-				appSprintf(ARRAY_ARG(buf), "%s -> %d", uniqueName, uniqueIdx);
-				if (Meta.Num())
-				{
-					DUMP_MEM_BYTES(&Meta[0], Meta.Num(), buf);
-				}
+		char buf[512];
+		appSprintf(ARRAY_ARG(buf), "%s -> %d", uniqueName, uniqueIdx);
+		if (Meta.Num())
+		{
+			DUMP_MEM_BYTES(&Meta[0], Meta.Num(), buf);
+		}
 #endif // DEBUG_DUP_FINDER
-				if (uniqueIdx >= 2)
-				{
-					// Find existing object name with same metadata, or register a new name
-					appSprintf(ARRAY_ARG(uniqueName), "%s_%d", Obj->Name, uniqueIdx);
-					appPrintf("Duplicate name %s found for class %s, renaming to %s\n", Obj->Name, ClassName, uniqueName);
-					//?? HACK: temporary replace object name with unique one
-					OriginalName = Obj->Name;
-					const_cast<UObject*>(Obj)->Name = uniqueName;
-				}
-			}
-
-			// Do the export with saving current "LastExported" value. This will fix an issue when object exporter
-			// will call another ExportObject function then continue exporting - without the fix, calling CreateExportArchive()
-			// will always fail because code will recognize object as exported for 2nd time.
-			const UObject* saveLastExported = ctx.LastExported;
-			Info.Func(Obj);
-			ctx.LastExported = saveLastExported;
-
-			//?? restore object name
-			if (OriginalName) const_cast<UObject*>(Obj)->Name = OriginalName;
-			return true;
+		if (uniqueIdx >= 2)
+		{
+			// Find existing object name with same metadata, or register a new name
+			appSprintf(ARRAY_ARG(uniqueName), "%s_%d", Obj->Name, uniqueIdx);
+			appPrintf("Duplicate name %s found for class %s, renaming to %s\n", Obj->Name, ClassName, uniqueName);
+			//?? HACK: temporary replace object name with unique one
+			OriginalName = Obj->Name;
+			const_cast<UObject*>(Obj)->Name = uniqueName;
 		}
 	}
-	return false;
+
+	// Do the export with saving current "LastExported" value. This will fix an issue when object exporter
+	// will call another ExportObject function then continue exporting - without the fix, calling CreateExportArchive()
+	// will always fail because code will recognize object as exported for 2nd time.
+	const UObject* saveLastExported = LastExported;
+	Info.Func(Obj);
+	LastExported = saveLastExported;
+
+	//?? restore object name
+	if (OriginalName) const_cast<UObject*>(Obj)->Name = OriginalName;
+	return true;
 
 	unguardf("%s'%s'", Obj->GetClassName(), Obj->Name);
 }
@@ -416,7 +492,7 @@ const char* GetExportPath(const UObject* Obj)
 {
 	guard(GetExportPath);
 
-	static char buf[1024]; // will be returned outside
+	static thread_local char buf[1024]; // will be returned outside
 
 	if (!BaseExportDir[0])
 		appSetBaseExportDirectory(".");	// to simplify code
@@ -473,7 +549,7 @@ const char* GetExportPath(const UObject* Obj)
 		PackageName = (GUncook) ? Obj->GetUncookedPackageName() : Obj->Package->Name;
 	}
 
-	static char group[512];
+	char group[512];
 	if (GUseGroups)
 	{
 		// get group name
@@ -504,7 +580,7 @@ const char* GetExportFileName(const UObject* Obj, const char* fmt, va_list args)
 	int len = vsnprintf(ARRAY_ARG(fmtBuf), fmt, args);
 	if (len < 0 || len >= sizeof(fmtBuf) - 1) return NULL;
 
-	static char buffer[1024];
+	static thread_local char buffer[1024];
 	appSprintf(ARRAY_ARG(buffer), "%s/%s", GetExportPath(Obj), fmtBuf);
 	return buffer;
 
@@ -541,13 +617,13 @@ FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const ch
 	guard(CreateExportArchive);
 
 	bool bNewObject = false;
-	if (ctx.LastExported != Obj)
+	if (LastExported != Obj)
 	{
 		// Exporting a new object, should perform some actions
 		if (!RegisterProcessedObject(Obj))
 			return NULL; // already exported
 		bNewObject = true;
-		ctx.LastExported = Obj;
+		LastExported = Obj;
 	}
 
 	va_list	argptr;
@@ -569,7 +645,7 @@ FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const ch
 		else
 		{
 			appPrintf("Export: file already exists %s\n", filename);
-			ctx.NumSkippedObjects++;
+			InterlockedIncrement(&ctx.NumSkippedObjects);
 			return NULL;
 		}
 	}
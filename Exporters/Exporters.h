@@ -39,9 +39,11 @@ FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const ch
 // Configuration
 extern bool GExportScripts;
 extern bool GExportLods;
+extern bool GExportGLB;
 extern bool GNoTgaCompress;
 extern bool GExportPNG;
 extern bool GExportDDS;
+extern bool GExportKTX2;
 extern bool GUncook;
 extern bool GUseGroups;
 extern bool GDontOverwriteFiles;
@@ -16,6 +16,12 @@ struct VChunkHeader
 	int32			DataSize;				// sizeof(type)
 	int32			DataCount;				// number of array elements
 
+	VChunkHeader()
+	{
+		// zero-fill unused ChunkID bytes and fields, so output files doesn't contain garbage
+		memset(this, 0, sizeof(*this));
+	}
+
 	friend FArchive& operator<<(FArchive &Ar, VChunkHeader &H)
 	{
 		Ar.Serialize(ARRAY_ARG(H.ChunkID));
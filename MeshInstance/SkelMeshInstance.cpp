@@ -468,6 +468,9 @@ void CSkelMeshInstance::UpdateSkeleton()
 				Frame2 = Chn->CurrentFrame / AnimSeq1->NumFrames * AnimSeq2->NumFrames;
 			}
 		}
+		// decode animation tracks when needed, and keep them while sampling
+		CAnimTracksLock TracksLock1(AnimSeq1);
+		CAnimTracksLock TracksLock2(AnimSeq2);
 
 		// compute bone range, affected by specified animation bone
 		int firstBone = Chn->RootBone;
@@ -0,0 +1,8 @@
+#define DO_GUARD		1
+#define THREADING		1
+
+#include "GameDefines.h"
+
+#ifdef __APPLE__
+#undef THREADING
+#endif
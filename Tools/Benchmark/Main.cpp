@@ -0,0 +1,761 @@
+#include "Core.h"
+#include "UnCore.h"
+#include "UnObject.h"
+#include "UnrealMaterial/UnMaterial.h"
+#include "Mesh/MeshCommon.h"
+#include "UnrealMesh/UnMathTools.h"
+#include "Mesh/SkeletalMesh.h"
+#include "Mesh/StaticMesh.h"
+#include "Exporters/Exporters.h"
+#include "Parallel.h"
+
+// Micro-benchmarks for performance-critical code paths. Every benchmark also verifies that
+// optimized code produces exactly the same results as the reference one.
+
+static int GBenchScale = 1;			// multiplier for amount of processed data, set with -scale=N
+static bool GBenchFailed = false;
+
+static void BenchError(const char* Fmt, ...)
+{
+	va_list argptr;
+	va_start(argptr, Fmt);
+	char buf[1024];
+	vsnprintf(ARRAY_ARG(buf), Fmt, argptr);
+	va_end(argptr);
+	appPrintf("ERROR: %s\n", buf);
+	GBenchFailed = true;
+}
+
+static uint32 GRandSeed = 1;
+
+static float RandFloat()
+{
+	GRandSeed = GRandSeed * 1664525 + 1013904223;
+	return (GRandSeed >> 8) / float(1 << 24);
+}
+
+// Fill buffer with reproducible pseudo-random data
+static void FillRandom(void* Data, int Size, uint32 Seed)
+{
+	byte* p = (byte*)Data;
+	for (int i = 0; i < Size; i++)
+	{
+		Seed = Seed * 1664525 + 1013904223;
+		p[i] = Seed >> 24;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	Pixel format conversion
+-----------------------------------------------------------------------------*/
+
+static const char* PixelConvertLevelNames[] = { "scalar", "sse2", "ssse3", "avx2" };
+
+static void BenchPixelConvert()
+{
+	guard(BenchPixelConvert);
+
+	// Odd pixel count to exercise the tail processing
+	const int NumPixels = 4096 * 1024 * GBenchScale + 7;
+	const int NumRuns = 8;
+
+	byte* Src = (byte*)appMalloc(NumPixels * 4);
+	byte* Opaque = (byte*)appMalloc(NumPixels * 4);		// for alpha check, which stops on the first translucent pixel
+	byte* Dst = (byte*)appMalloc(NumPixels * 4 * 2);		// ConvertHalfToFloat writes 2x more data
+	byte* Ref = (byte*)appMalloc(NumPixels * 4 * 2);
+	FillRandom(Src, NumPixels * 4, 1);
+	memcpy(Opaque, Src, NumPixels * 4);
+	for (int i = 0; i < NumPixels; i++)
+		Opaque[i * 4 + 3] = 255;
+
+	// Find the best supported level
+	EPixelConvertLevel BestLevel = SetPixelConvertLevel(PIXEL_CONVERT_AVX2);
+
+#define KERNEL(Name, DstSize, Call) { Name, DstSize, [](const byte* s, byte* d, int n) { Call; } }
+	static const struct
+	{
+		const char* Name;
+		int DstSize;		// bytes per pixel written to destination, 0 for opaque source and 1-byte result
+		void (*Func)(const byte* s, byte* d, int n);
+	} Kernels[] =
+	{
+		KERNEL("BGR8->RGBA8",  4, ConvertBGR8ToRGBA8(s, d, n)),
+		KERNEL("BGRA8->RGBA8", 4, ConvertBGRA8ToRGBA8(s, d, n)),
+		KERNEL("RGBA4->RGBA8", 4, ConvertRGBA4ToRGBA8(s, d, n)),
+		KERNEL("G8->RGBA8",    4, ConvertG8ToRGBA8(s, d, n)),
+		KERNEL("V8U8->RGBA8",  4, ConvertV8U8ToRGBA8(s, d, n, 128)),
+		KERNEL("Half->Float",  8, ConvertHalfToFloat((const uint16*)s, (float*)d, n * 2)),
+		KERNEL("AlphaCheck",   0, d[0] = IsAlphaChannelUsed(s, n)),
+	};
+#undef KERNEL
+
+	appPrintf("Pixel conversion: %d pixels, best level: %s\n", NumPixels, PixelConvertLevelNames[BestLevel]);
+	for (const auto& K : Kernels)
+	{
+		int DstBytes = K.DstSize ? NumPixels * K.DstSize : 1;
+		appPrintf("  %-14s", K.Name);
+		for (int Level = PIXEL_CONVERT_SCALAR; Level <= BestLevel; Level++)
+		{
+			SetPixelConvertLevel((EPixelConvertLevel)Level);
+			memset(Dst, 0xCD, DstBytes);
+			uint64 BestTime = ~(uint64)0;
+			for (int Run = 0; Run < NumRuns; Run++)
+			{
+				uint64 Time = appMicroseconds();
+				K.Func(K.DstSize ? Src : Opaque, Dst, NumPixels);
+				Time = appMicroseconds() - Time;
+				if (Time < BestTime) BestTime = Time;
+			}
+			if (Level == PIXEL_CONVERT_SCALAR)
+				memcpy(Ref, Dst, DstBytes);
+			else if (memcmp(Ref, Dst, DstBytes) != 0)
+				BenchError("%s: %s result differs from scalar", K.Name, PixelConvertLevelNames[Level]);
+			appPrintf("  %s %7.1f MPix/s", PixelConvertLevelNames[Level], BestTime ? NumPixels / (float)BestTime : 0.0f);
+		}
+		appPrintf("\n");
+	}
+	SetPixelConvertLevel(PIXEL_CONVERT_AVX2);
+
+	appFree(Src);
+	appFree(Opaque);
+	appFree(Dst);
+	appFree(Ref);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Vertex welding
+-----------------------------------------------------------------------------*/
+
+static void CompareVertexShare(const CVertexShare& A, const CVertexShare& B)
+{
+	if (A.Points.Num() != B.Points.Num() || A.WedgeToVert.Num() != B.WedgeToVert.Num())
+	{
+		BenchError("Weld: %d points, %d wedges, expected %d points, %d wedges",
+			A.Points.Num(), A.WedgeToVert.Num(), B.Points.Num(), B.WedgeToVert.Num());
+		return;
+	}
+	if (memcmp(A.Points.GetData(), B.Points.GetData(), A.Points.Num() * sizeof(CVec3)) != 0 ||
+		memcmp(A.Normals.GetData(), B.Normals.GetData(), A.Normals.Num() * sizeof(CPackedNormal)) != 0 ||
+		memcmp(A.ExtraInfos.GetData(), B.ExtraInfos.GetData(), A.ExtraInfos.Num() * sizeof(uint32)) != 0 ||
+		memcmp(A.WedgeToVert.GetData(), B.WedgeToVert.GetData(), A.WedgeToVert.Num() * sizeof(int)) != 0 ||
+		memcmp(A.VertToWedge.GetData(), B.VertToWedge.GetData(), A.Points.Num() * sizeof(int)) != 0)
+	{
+		BenchError("Weld: result differs from AddVertex()");
+	}
+}
+
+static void BenchWeld()
+{
+	guard(BenchWeld);
+
+	// Grid of quads with unshared wedges (6 per quad), as produced for a triangle list. The grid lies
+	// on the X+Y+Z=0 plane, which was the worst case for the old position hash. Every 4th row uses
+	// a different normal, and ExtraInfo splits vertices by a fake material index.
+	int Side = 2;
+	while (Side * Side * 6 < 1000000 * GBenchScale)
+		Side++;
+	const int NumVerts = Side * Side * 6;
+
+	TArray<CMeshVertex> Verts;
+	TArray<uint32> ExtraInfo;
+	Verts.AddZeroed(NumVerts);
+	ExtraInfo.AddUninitialized(NumVerts);
+	static const int QuadCorners[6][2] = { {0,0}, {1,0}, {1,1}, {0,0}, {1,1}, {0,1} };
+	int n = 0;
+	for (int y = 0; y < Side; y++)
+	{
+		for (int x = 0; x < Side; x++)
+		{
+			for (int c = 0; c < 6; c++, n++)
+			{
+				float u = (x + QuadCorners[c][0]) * 0.5f;
+				float v = (y + QuadCorners[c][1]) * 0.5f;
+				CMeshVertex& V = Verts[n];
+				CVec3 Pos;
+				Pos.Set(u, v, -(u + v));
+				V.Position.Set(Pos);
+				V.Normal.Data = (y & 3) ? 0x80FF8080 : 0x8080FF80;
+				ExtraInfo[n] = x / 64;
+			}
+		}
+	}
+
+	appPrintf("Vertex welding: %d vertices\n", NumVerts);
+
+	// Reference: sequential AddVertex() calls
+	CVertexShare Ref;
+	uint64 Time = appMicroseconds();
+	Ref.Prepare(Verts.GetData(), NumVerts, sizeof(CMeshVertex));
+	for (int i = 0; i < NumVerts; i++)
+	{
+		CPackedNormal Normal = Verts[i].Normal;
+		Ref.AddVertex(Verts[i].Position, Normal, ExtraInfo[i]);
+	}
+	Time = appMicroseconds() - Time;
+	appPrintf("  AddVertex:    %d points, %.3f sec\n", Ref.Points.Num(), Time / 1000000.0f);
+
+	CVertexShare Share;
+	Time = appMicroseconds();
+	Share.WeldVertices(Verts.GetData(), NumVerts, sizeof(CMeshVertex), ExtraInfo.GetData());
+	Time = appMicroseconds() - Time;
+	appPrintf("  WeldVertices: %d points, %.3f sec\n", Share.Points.Num(), Time / 1000000.0f);
+	CompareVertexShare(Share, Ref);
+
+	// Without normals, as used by BuildNormalsCommon()
+	Ref.Prepare(Verts.GetData(), NumVerts, sizeof(CMeshVertex));
+	for (int i = 0; i < NumVerts; i++)
+		Ref.AddVertex(Verts[i].Position, CPackedNormal());
+	Time = appMicroseconds();
+	Share.WeldVertices(Verts.GetData(), NumVerts, sizeof(CMeshVertex), NULL, false);
+	Time = appMicroseconds() - Time;
+	appPrintf("  WeldVertices: %d points, %.3f sec (positions only)\n", Share.Points.Num(), Time / 1000000.0f);
+	CompareVertexShare(Share, Ref);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Animation sampling
+-----------------------------------------------------------------------------*/
+
+static void MakeKeyTimes(TStaticArray<float, 1>& KeyTime, int NumKeys, int NumFrames)
+{
+	KeyTime.AddUninitialized(NumKeys);
+	for (int i = 0; i < NumKeys; i++)
+		KeyTime[i] = (float)i * NumFrames / NumKeys;
+}
+
+static void MakeKeys(CAnimTrack& T, int NumPosKeys, int NumRotKeys)
+{
+	T.KeyPos.AddUninitialized(NumPosKeys);
+	for (int i = 0; i < NumPosKeys; i++)
+		T.KeyPos[i].Set(RandFloat() * 100, RandFloat() * 100, RandFloat() * 100);
+	T.KeyQuat.AddUninitialized(NumRotKeys);
+	for (int i = 0; i < NumRotKeys; i++)
+	{
+		CQuat& Q = T.KeyQuat[i];
+		Q.Set(RandFloat() - 0.5f, RandFloat() - 0.5f, RandFloat() - 0.5f, RandFloat() - 0.5f);
+		Q.Normalize();
+	}
+}
+
+static void BenchAnimSampling()
+{
+	guard(BenchAnimSampling);
+
+	const int NumBones = 3072;
+	const int NumFrames = 10000 * GBenchScale;
+	const int KeyStep = 8;					// frames per key for keyframed tracks
+
+	// Track layouts which are produced by different animation decoders
+	TArray<CAnimTrack> Tracks;
+	Tracks.AddDefaulted(NumBones);
+	GRandSeed = 1;
+	for (int b = 0; b < NumBones; b++)
+	{
+		CAnimTrack& T = Tracks[b];
+		int NumKeys = NumFrames / KeyStep + (b & 7);
+		switch (b % 5)
+		{
+		case 0:
+			// shared KeyTime
+			MakeKeyTimes(T.KeyTime, NumKeys, NumFrames);
+			MakeKeys(T, NumKeys, NumKeys);
+			break;
+		case 1:
+			// separate position and rotation times
+			MakeKeyTimes(T.KeyPosTime, NumKeys / 2, NumFrames);
+			MakeKeyTimes(T.KeyQuatTime, NumKeys, NumFrames);
+			MakeKeys(T, NumKeys / 2, NumKeys);
+			break;
+		case 2:
+			// duplicate keys, time array is not strictly increasing
+			MakeKeyTimes(T.KeyTime, NumKeys, NumFrames);
+			for (int i = 1; i < NumKeys; i += 16)
+				T.KeyTime[i] = T.KeyTime[i - 1];
+			MakeKeys(T, NumKeys, NumKeys);
+			break;
+		case 3:
+			// unsorted keys
+			MakeKeyTimes(T.KeyTime, NumKeys, NumFrames);
+			for (int i = 1; i < NumKeys; i += 32)
+				Exchange(T.KeyTime[i], T.KeyTime[i - 1]);
+			MakeKeys(T, NumKeys, NumKeys);
+			break;
+		default:
+			// constant track
+			MakeKeys(T, 1, 1);
+		}
+	}
+
+	appPrintf("Animation sampling: %d bones, %d frames\n", NumBones, NumFrames);
+
+	// Sample frames sequentially like PSA export does, with and without cursors
+	TArray<CAnimTrackCursor> Cursors;
+	Cursors.AddDefaulted(NumBones);
+	TArray<CSkeletonBonePosition> Ref, Res;
+	Ref.AddZeroed(NumBones);
+	Res.AddZeroed(NumBones);
+	uint64 RefTime = 0, CursorTime = 0;
+	int NumMismatches = 0;
+	for (int t = 0; t < NumFrames; t++)
+	{
+		uint64 Time = appMicroseconds();
+		for (int b = 0; b < NumBones; b++)
+			Tracks[b].GetBonePosition(t, NumFrames, false, Ref[b].Position, Ref[b].Orientation);
+		uint64 Time2 = appMicroseconds();
+		for (int b = 0; b < NumBones; b++)
+			Tracks[b].GetBonePosition(t, NumFrames, false, Res[b].Position, Res[b].Orientation, &Cursors[b]);
+		uint64 Time3 = appMicroseconds();
+		RefTime += Time2 - Time;
+		CursorTime += Time3 - Time2;
+		if (memcmp(Ref.GetData(), Res.GetData(), NumBones * sizeof(CSkeletonBonePosition)) != 0)
+			NumMismatches++;
+	}
+	appPrintf("  without cursor: %.3f sec\n", RefTime / 1000000.0f);
+	appPrintf("  with cursor:    %.3f sec\n", CursorTime / 1000000.0f);
+	if (NumMismatches)
+		BenchError("AnimSampling: %d frames differ when sampled with cursor", NumMismatches);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Concurrent PSK/PSA export
+-----------------------------------------------------------------------------*/
+
+// Synthetic objects are exported with a single thread, then from several threads at once, and
+// results are compared byte by byte.
+
+#define PSK_NUM_BONES		40
+
+struct CPskTestItem
+{
+	UObject*		Object;
+	CSkeletalMesh*	SkelMesh;
+	CStaticMesh*	StaticMesh;
+	CAnimSet*		Anim;
+	const char*		Exts[2];				// extensions of exported files
+};
+
+static TArray<CPskTestItem> PskItems;
+static volatile int PskNextItem;
+
+static UObject* CreateDummyObject(const char* Fmt, int Index)
+{
+	char Name[64];
+	appSprintf(ARRAY_ARG(Name), Fmt, Index);
+	UObject* Obj = new UObject;
+	Obj->Package = NULL;					// non-packaged object, always exported
+	Obj->Name = appStrdupPool(Name);
+	return Obj;
+}
+
+// Grid of quads with unshared wedges, some of them are welded by exporter
+template<class LodType>
+static void FillMeshLod(LodType& Lod, int Index)
+{
+	int Side = (Index % 8 == 7) ? 110 : 20 + (Index * 7) % 60;	// some meshes have more than 64K wedges
+	int NumVerts = Side * Side * 6;
+	Lod.NumTexCoords = 1 + (Index & 1);
+	Lod.HasNormals = Lod.HasTangents = true;
+	Lod.AllocateVerts(NumVerts);
+	if (Index % 3 == 0)
+		Lod.AllocateVertexColorBuffer();
+
+	static const int QuadCorners[6][2] = { {0,0}, {1,0}, {1,1}, {0,0}, {1,1}, {0,1} };
+	int n = 0;
+	for (int y = 0; y < Side; y++)
+	{
+		for (int x = 0; x < Side; x++)
+		{
+			for (int c = 0; c < 6; c++, n++)
+			{
+				int gx = x + QuadCorners[c][0], gy = y + QuadCorners[c][1];
+				CMeshVertex& V = Lod.Verts[n];
+				CVec3 Pos;
+				Pos.Set(gx * 4.0f, gy * 4.0f, ((gx * 31 + gy * 17 + Index) & 15) * 0.5f);
+				V.Position.Set(Pos);
+				V.Normal.Data = 0x80FF8080 ^ ((gx ^ gy) & 3);
+				V.Tangent.Data = 0x808080FF;
+				V.UV.U = gx / (float)Side;
+				V.UV.V = gy / (float)Side;
+				for (int i = 0; i < Lod.NumTexCoords - 1; i++)
+				{
+					Lod.ExtraUV[i][n].U = V.UV.V;
+					Lod.ExtraUV[i][n].V = V.UV.U;
+				}
+				if (Lod.VertexColors)
+					Lod.VertexColors[n] = FColor(gx, gy, Index, 255);
+			}
+		}
+	}
+
+	// two sections with triangle list
+	TArray<uint32> Indices;
+	Indices.AddUninitialized(NumVerts);
+	for (int i = 0; i < NumVerts; i++)
+		Indices[i] = i;
+	if (NumVerts > 65536)
+	{
+		CopyArray(Lod.Indices.Indices32, Indices);
+	}
+	else
+	{
+		Lod.Indices.Indices16.AddUninitialized(NumVerts);
+		for (int i = 0; i < NumVerts; i++)
+			Lod.Indices.Indices16[i] = i;
+	}
+	int NumFaces = NumVerts / 3;
+	CMeshSection* Sec = new (Lod.Sections) CMeshSection;
+	Sec->Material = NULL;
+	Sec->FirstIndex = 0;
+	Sec->NumFaces = NumFaces / 2;
+	Sec = new (Lod.Sections) CMeshSection;
+	Sec->Material = NULL;
+	Sec->FirstIndex = (NumFaces / 2) * 3;
+	Sec->NumFaces = NumFaces - NumFaces / 2;
+}
+
+// Decoder for synthetic animation, keys depend on sequence name only
+static void DecodePskTestSequence(const UObject* Owner, CAnimSequence& Dst)
+{
+	uint32 Seed = 0;
+	for (const char* s = *Dst.Name; *s; s++)
+		Seed = Seed * 33 + *s;
+	int NumKeys = Dst.NumFrames / 2;
+	for (int b = 0; b < PSK_NUM_BONES; b++)
+	{
+		CAnimTrack* T = new CAnimTrack;
+		Dst.Tracks.Add(T);
+		T->KeyTime.AddUninitialized(NumKeys);
+		T->KeyPos.AddUninitialized(NumKeys);
+		T->KeyQuat.AddUninitialized(NumKeys);
+		for (int k = 0; k < NumKeys; k++)
+		{
+			Seed = Seed * 1664525 + 1013904223;
+			T->KeyTime[k] = k * 2.0f;
+			T->KeyPos[k].Set(b, k, (Seed >> 20) * 0.01f);
+			T->KeyQuat[k].Set(0, (Seed >> 24) / 256.0f, 0, 1);
+			T->KeyQuat[k].Normalize();
+		}
+	}
+}
+
+static void CreatePskTestItems(int Count)
+{
+	guard(CreatePskTestItems);
+
+	for (int i = 0; i < Count; i++)
+	{
+		CPskTestItem* Item = new (PskItems) CPskTestItem;
+		memset(Item, 0, sizeof(*Item));
+		switch (i % 3)
+		{
+		case 0:
+			{
+				Item->Object = CreateDummyObject("SkelMesh_%d", i);
+				CSkeletalMesh* Mesh = new CSkeletalMesh(Item->Object);
+				Item->SkelMesh = Mesh;
+				Mesh->MeshScale.Set(1, 1, 1);
+				for (int b = 0; b < PSK_NUM_BONES; b++)
+				{
+					char BoneName[32];
+					appSprintf(ARRAY_ARG(BoneName), "Bone_%d", b);
+					CSkelMeshBone* B = new (Mesh->RefSkeleton) CSkelMeshBone;
+					B->Name = BoneName;
+					B->ParentIndex = b ? (b - 1) / 2 : 0;
+					B->Position.Set(b, 0, 1);
+					B->Orientation.Set(0, 0, 0, 1);
+				}
+				CSkelMeshLod* Lod = new (Mesh->Lods) CSkelMeshLod;
+				FillMeshLod(*Lod, i);
+				for (int v = 0; v < Lod->NumVerts; v++)
+				{
+					// 1 or 2 influences, welded wedges should have the same weights
+					CSkelMeshVertex& V = Lod->Verts[v];
+					int Pos = appRound(V.Position[0] + V.Position[1]);
+					int w = Pos & 255;
+					V.PackedWeights = w | ((255 - w) << 8);
+					V.Bone[0] = Pos % PSK_NUM_BONES;
+					V.Bone[1] = w ? (Pos + 1) % PSK_NUM_BONES : -1;
+					V.Bone[2] = V.Bone[3] = -1;
+				}
+				Item->Exts[0] = Lod->NumVerts > 65536 ? "pskx" : "psk";
+			}
+			break;
+		case 1:
+			{
+				Item->Object = CreateDummyObject("StaticMesh_%d", i);
+				CStaticMesh* Mesh = new CStaticMesh(Item->Object);
+				Item->StaticMesh = Mesh;
+				CStaticMeshLod* Lod = new (Mesh->Lods) CStaticMeshLod;
+				FillMeshLod(*Lod, i);
+				Item->Exts[0] = "pskx";
+			}
+			break;
+		default:
+			{
+				Item->Object = CreateDummyObject("Anim_%d", i);
+				CAnimSet* Anim = new CAnimSet(Item->Object);
+				Item->Anim = Anim;
+				for (int b = 0; b < PSK_NUM_BONES; b++)
+				{
+					char BoneName[32];
+					appSprintf(ARRAY_ARG(BoneName), "Bone_%d", b);
+					FName* Name = new (Anim->TrackBoneNames) FName;
+					*Name = BoneName;
+					Anim->BoneModes.Add(EBoneRetargetingMode::Animation);		// this will write a config file
+				}
+				for (int s = 0; s < 3; s++)
+				{
+					char SeqName[64];
+					appSprintf(ARRAY_ARG(SeqName), "Seq_%d_%d", i, s);
+					CAnimSequence* Seq = new CAnimSequence;
+					Seq->Name = SeqName;
+					Seq->NumFrames = 60 + (i * 13 + s * 7) % 80;
+					Seq->Rate = 30;
+					Seq->SetDecoder(DecodePskTestSequence, Item->Object);
+					Anim->Sequences.Add(Seq);
+				}
+				Item->Exts[0] = "psa";
+				Item->Exts[1] = "config";
+			}
+		}
+	}
+
+	unguard;
+}
+
+static void ExportPskTestItem(const CPskTestItem& Item)
+{
+	if (Item.SkelMesh)
+		ExportPsk(Item.SkelMesh);
+	else if (Item.StaticMesh)
+		ExportStaticMesh(Item.StaticMesh);
+	else
+		ExportPsa(Item.Anim);
+}
+
+class CPskExportThread : public CThread
+{
+public:
+	CSemaphore Done;
+
+	virtual void Run()
+	{
+		while (true)
+		{
+			int Index = InterlockedIncrement(&PskNextItem) - 1;
+			if (Index >= PskItems.Num()) break;
+			ExportPskTestItem(PskItems[Index]);
+		}
+		// Don't access 'this' after signaling: the object is deleted by the waiting thread
+		Done.Signal();
+	}
+};
+
+static bool LoadTestFile(const char* Filename, TArray<byte>& Data)
+{
+	Data.Empty();
+	FILE* f = fopen(Filename, "rb");
+	if (!f) return false;
+	fseek(f, 0, SEEK_END);
+	int Size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	Data.AddUninitialized(Size);
+	bool ok = fread(Data.GetData(), Size, 1, f) == 1 || Size == 0;
+	fclose(f);
+	return ok;
+}
+
+static void BenchPskExport()
+{
+	guard(BenchPskExport);
+
+	const int NumItems = 48 * GBenchScale;
+	const int NumThreads = 8;
+	static const char BaseDir[] = "BenchmarkExport";
+
+	GAnimTracksBudget = 1;				// make sequences decoded again by export threads
+	CreatePskTestItems(NumItems);
+	appPrintf("PSK export: %d objects, %d threads\n", NumItems, NumThreads);
+
+	// Reference: serial export
+	char Dir[256];
+	appSprintf(ARRAY_ARG(Dir), "%s/serial", BaseDir);
+	appSetBaseExportDirectory(Dir);
+	uint64 Time = appMicroseconds();
+	for (const CPskTestItem& Item : PskItems)
+		ExportPskTestItem(Item);
+	Time = appMicroseconds() - Time;
+	float SerialTime = Time / 1000000.0f;
+
+	// Export from multiple threads
+	appSprintf(ARRAY_ARG(Dir), "%s/parallel", BaseDir);
+	appSetBaseExportDirectory(Dir);
+	PskNextItem = 0;
+	CPskExportThread* Threads[NumThreads];
+	Time = appMicroseconds();
+	for (int i = 0; i < NumThreads; i++)
+	{
+		Threads[i] = new CPskExportThread;
+		Threads[i]->Start();
+	}
+	for (int i = 0; i < NumThreads; i++)
+	{
+		Threads[i]->Done.Wait();
+		delete Threads[i];
+	}
+	Time = appMicroseconds() - Time;
+	appPrintf("  serial:   %.3f sec\n", SerialTime);
+	appPrintf("  parallel: %.3f sec\n", Time / 1000000.0f);
+
+	// Compare results
+	int NumFiles = 0;
+	TArray<byte> Serial, Parallel;
+	for (const CPskTestItem& Item : PskItems)
+	{
+		for (int i = 0; i < ARRAY_COUNT(Item.Exts) && Item.Exts[i]; i++)
+		{
+			char SerialName[1024];
+			appSetBaseExportDirectory(va("%s/serial", BaseDir));
+			appStrncpyz(SerialName, GetExportFileName(Item.Object, "%s.%s", Item.Object->Name, Item.Exts[i]), ARRAY_COUNT(SerialName));
+			appSetBaseExportDirectory(va("%s/parallel", BaseDir));
+			const char* ParallelName = GetExportFileName(Item.Object, "%s.%s", Item.Object->Name, Item.Exts[i]);
+			if (!LoadTestFile(SerialName, Serial))
+			{
+				BenchError("PskExport: missing file %s", SerialName);
+				continue;
+			}
+			if (!LoadTestFile(ParallelName, Parallel) || Serial.Num() != Parallel.Num() ||
+				memcmp(Serial.GetData(), Parallel.GetData(), Serial.Num()) != 0)
+			{
+				BenchError("PskExport: %s differs from serial export", ParallelName);
+			}
+			NumFiles++;
+		}
+	}
+	appPrintf("  compared %d files\n", NumFiles);
+
+	for (CPskTestItem& Item : PskItems)
+	{
+		delete Item.SkelMesh;
+		delete Item.StaticMesh;
+		delete Item.Anim;
+		delete Item.Object;
+	}
+	PskItems.Empty();
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Main function
+-----------------------------------------------------------------------------*/
+
+#if UNREAL4
+
+int UE4UnversionedPackage(int verMin, int verMax)
+{
+	appErrorNoLog("Unversioned UE4 packages are not supported.");
+	return -1;
+}
+
+bool UE4EncryptedPak()
+{
+	return false;
+}
+
+#endif // UNREAL4
+
+static const struct
+{
+	const char* Name;
+	void (*Func)();
+	const char* Description;
+} Benchmarks[] =
+{
+	{ "pixel", BenchPixelConvert, "pixel format conversion kernels, SIMD vs scalar" },
+	{ "weld",  BenchWeld,         "vertex welding of 1M vertex mesh, parallel vs AddVertex()" },
+	{ "anim",  BenchAnimSampling, "sampling of 3072 bone 10k frame animation, with and without cursors" },
+	{ "psk",   BenchPskExport,    "export of synthetic meshes and animations from 8 threads, compared with serial export" },
+};
+
+int main(int argc, char **argv)
+{
+#if DO_GUARD
+	TRY {
+#endif
+
+	guard(Main);
+
+	appInitPlatform();
+
+	// parse command line
+	int arg;
+	for (arg = 1; arg < argc; arg++)
+	{
+		const char* opt = argv[arg];
+		if (opt[0] != '-') break;
+		opt++;
+		if (!strnicmp(opt, "scale=", 6))
+			GBenchScale = max(atoi(opt + 6), 1);
+		else
+			goto help;
+	}
+
+	if (arg >= argc)
+	{
+	help:
+		appPrintf("Umodel benchmarks\n"
+				  "Usage: benchmark [options] <test> [<test> ...]\n"
+				  "\n"
+				  "Options:\n"
+				  "    -scale=N           multiply amount of processed data by N\n"
+				  "\n"
+				  "Tests:\n"
+				  "    all                run all tests\n"
+		);
+		for (const auto& B : Benchmarks)
+			appPrintf("    %-18s %s\n", B.Name, B.Description);
+		exit(0);
+	}
+
+	for ( ; arg < argc; arg++)
+	{
+		bool found = false;
+		for (const auto& B : Benchmarks)
+		{
+			if (!stricmp(argv[arg], "all") || !stricmp(argv[arg], B.Name))
+			{
+				B.Func();
+				found = true;
+			}
+		}
+		if (!found) goto help;
+	}
+
+	unguard;
+
+#if DO_GUARD
+	} CATCH {
+		GError.StandardHandler();
+		exit(1);
+	}
+#endif
+
+	if (GBenchFailed)
+	{
+		appPrintf("FAILED\n");
+		return 1;
+	}
+	return 0;
+}
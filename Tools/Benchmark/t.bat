@@ -0,0 +1,6 @@
+@echo off
+
+rm benchmark.exe
+bash build.sh
+
+benchmark.exe all
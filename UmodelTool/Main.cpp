@@ -23,6 +23,7 @@
 #include "UnThirdParty.h"
 
 #include "Exporters/Exporters.h"
+#include "Wrappers/TexturePNG.h"
 
 #if DECLARE_VIEWER_PROPS
 #include "Mesh/SkeletalMesh.h"
@@ -34,6 +35,8 @@
 
 #include "UmodelApp.h"
 #include "UmodelCommands.h"
+#include "FileSystem/BlockCache.h"
+#include "FileSystem/IndexCache.h"
 #include "Version.h"
 #include "MiscStrings.h"
 
@@ -335,6 +338,7 @@ void InitClassAndExportSystems(int Game)
 		CTypeInfo::RemapProp("UShader", "Opacity", "Opacity_Bio"); //!!
 	}
 #endif // BIOSHOCK
+	BuildClassRegistry();
 }
 
 /*-----------------------------------------------------------------------------
@@ -366,6 +370,9 @@ static void PrintUsage()
 			"    -list           list contents of package\n"
 			"    -export         export specified object or whole package\n"
 			"    -save           save specified packages\n"
+			"    -scan           scan headers of specified packages and display number of\n"
+			"                    meshes, animations and textures; use wildcards for scanning\n"
+			"                    many packages, e.g. \"-scan *\"\n"
 			"\n"
 			"Help information:\n"
 			"    -help           display this help page\n"
@@ -402,6 +409,11 @@ static void PrintUsage()
 			"                    key is ASCII or hex string (hex format is 0xAABBCCDD),\n"
 			"                    multiple options could be provided for multi-key games\n"
 			"    -aes=@file.txt  read AES decryption key(s) from a text file\n"
+#if UNREAL4
+			"    -blockcache=N   memory used for caching decompressed pak file blocks,\n"
+			"                    in MBytes (default is 64), 0 disables the cache\n"
+			"    -indexcache=FILE store parsed pak file indices in a file for faster startup\n"
+#endif
 			"\n"
 			"Compatibility options:\n"
 			"    -nomesh         disable loading of SkeletalMesh classes in a case of\n"
@@ -439,19 +451,26 @@ static void PrintUsage()
 			"    -psk            use ActorX format for meshes (default)\n"
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
 			"    -gltf           use glTF 2.0 format for mesh\n"
+			"    -glb            same as -gltf, but save a single binary glb file\n"
 			"    -lods           export all available mesh LOD levels\n"
 			"    -dds            export textures in DDS format whenever possible\n"
+			"    -ktx2           export compressed textures in KTX2 format (BC, ETC, ASTC)\n"
 			"    -png            export textures in PNG format instead of TGA\n"
+			"    -pngcomp=<mode> PNG compression: fast, normal (default), best or level 0-9\n"
 			"    -notgacomp      disable TGA compression\n"
+			"    -animmem=N      keep at most N megabytes of decompressed animations\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
+#if THREADING
+			"    -jobs=N         export up to N packages simultaneously\n"
+#endif
 			"\n"
 			"Supported resources for export:\n"
 			"    SkeletalMesh    exported as ActorX psk file, MD5Mesh or glTF\n"
 			"    MeshAnimation   exported as ActorX psa file or MD5Anim\n"
 			"    VertMesh        exported as Unreal 3d file\n"
 			"    StaticMesh      exported as psk file with no skeleton (pskx) or glTF\n"
-			"    Texture         exported in tga or dds format\n"
+			"    Texture         exported in tga, png, dds or ktx2 format\n"
 			"    Sounds          file extension depends on object contents\n"
 			"    ScaleForm       gfx\n"
 			"    FaceFX          fxa\n"
@@ -790,6 +809,7 @@ int main(int argc, const char **argv)
 		CMD_List,
 		CMD_Export,
 		CMD_Save,
+		CMD_Scan,
 	};
 
 	static byte mainCmd = CMD_View;
@@ -817,6 +837,7 @@ int main(int argc, const char **argv)
 			OPT_VALUE("save",    mainCmd, CMD_Save)
 			OPT_VALUE("pkginfo", mainCmd, CMD_PkgInfo)
 			OPT_VALUE("list",    mainCmd, CMD_List)
+			OPT_VALUE("scan",    mainCmd, CMD_Scan)
 #if VSTUDIO_INTEGRATION
 			OPT_BOOL ("debug",   GUseDebugger)
 #endif
@@ -838,6 +859,7 @@ int main(int argc, const char **argv)
 			OPT_NBOOL("nolightmap", GSettings.Startup.UseLightmapTexture)
 			OPT_BOOL ("sounds",  GSettings.Startup.UseSound)
 			OPT_BOOL ("dds",     GSettings.Export.ExportDdsTexture)
+			OPT_BOOL ("ktx2",    GSettings.Export.ExportKtx2Texture)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
 #if HAS_UI
@@ -873,6 +895,11 @@ int main(int argc, const char **argv)
 		{
 			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::gltf;
 		}
+		else if (!stricmp(opt, "glb"))
+		{
+			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::gltf;
+			GSettings.Export.ExportGlb = true;
+		}
 		else if (!stricmp(opt, "all") && mainCmd == CMD_Dump)
 		{
 			// -all should be used only with -dump
@@ -902,6 +929,24 @@ int main(int argc, const char **argv)
 			}
 			GSettings.Startup.GameOverride = tag;
 		}
+		else if (!strnicmp(opt, "pngcomp=", 8))
+		{
+			if (!SetPngCompression(opt+8))
+			{
+				appPrintf("ERROR: unknown PNG compression mode \"%s\"\n", opt+8);
+				exit(0);
+			}
+		}
+		else if (!strnicmp(opt, "animmem=", 8))
+		{
+			int mem = atoi(opt+8);
+			if (mem < 1)
+			{
+				appPrintf("ERROR: animmem value is not valid: %s\n", opt+8);
+				exit(0);
+			}
+			GAnimTracksBudget = mem;
+		}
 		else if (!strnicmp(opt, "pkgver=", 7))
 		{
 			int ver = atoi(opt+7);
@@ -936,6 +981,22 @@ int main(int argc, const char **argv)
 		{
 			HandleAesKeyOption(opt+4);
 		}
+#if UNREAL4
+		else if (!strnicmp(opt, "blockcache=", 11))
+		{
+			int size = atoi(opt+11);
+			if (size < 0)
+			{
+				appPrintf("ERROR: block cache size is not valid: %s\n", opt+11);
+				exit(0);
+			}
+			BlockCache::SetMemoryBudget((int64)size << 20);
+		}
+		else if (!strnicmp(opt, "indexcache=", 11))
+		{
+			IndexCache::SetFilename(opt+11);
+		}
+#endif
 		// information commands
 		else if (!stricmp(opt, "taglist"))
 		{
@@ -963,6 +1024,16 @@ int main(int argc, const char **argv)
 		{
 			GEnableThreads = false;
 		}
+		else if (!strnicmp(opt, "jobs=", 5))
+		{
+			int jobs = atoi(opt+5);
+			if (jobs < 1)
+			{
+				appPrintf("ERROR: jobs number is not valid: %s\n", opt+5);
+				exit(0);
+			}
+			GExportJobs = jobs;
+		}
 #endif
 		else if (!stricmp(opt, "testexport"))
 		{
@@ -1066,7 +1137,7 @@ int main(int argc, const char **argv)
 		appSetRootDirectory(".");			// scan for packages
 	}
 
-	bool bShouldLoadPackages = (mainCmd != CMD_Save);
+	bool bShouldLoadPackages = (mainCmd != CMD_Save && mainCmd != CMD_Scan);
 	TArray<const CGameFileInfo*> GameFiles;
 
 	// Try to load all packages first.
@@ -1166,6 +1237,12 @@ int main(int argc, const char **argv)
 		return 0;
 	}
 
+	if (mainCmd == CMD_Scan)
+	{
+		DisplayPackageContent(GameFiles);
+		return 0;
+	}
+
 	// register exporters and classes
 	InitClassAndExportSystems(Packages[0]->Game);
 
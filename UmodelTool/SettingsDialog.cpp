@@ -147,6 +147,7 @@ UIElement& UISettingsDialog::MakeExportOptions()
 					.AddItem("glTF 2.0", EExportMeshFormat::gltf)
 			]
 			+ NewControl(UICheckbox, "Export LODs", &Opt.Export.ExportMeshLods)
+			+ NewControl(UICheckbox, "Save glTF as a single binary file (glb)", &Opt.Export.ExportGlb)
 		]
 		+ NewControl(UIGroup, "Texture Export")
 		[
@@ -160,6 +161,7 @@ UIElement& UISettingsDialog::MakeExportOptions()
 					.AddItem("PNG", ETextureExportFormat::png)
 			]
 			+ NewControl(UICheckbox, "Export compressed textures to dds format", &Opt.Export.ExportDdsTexture)
+			+ NewControl(UICheckbox, "Export compressed textures to ktx2 format", &Opt.Export.ExportKtx2Texture)
 		]
 		+ NewControl(UICheckbox, "Don't overwrite already exported files", &Opt.Export.DontOverwriteFiles)
 		;
@@ -7,7 +7,15 @@
 #include "UnrealPackage/PackageUtils.h"
 #include "Exporters/Exporters.h"
 #include "UmodelApp.h"
+#include "UmodelCommands.h"
+#include "FileSystem/BlockCache.h"
 
+#include "Parallel.h"
+
+#if THREADING
+// Number of packages exported simultaneously, changed with "-jobs=N" command line option
+int GExportJobs = 1;
+#endif
 
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 {
@@ -51,6 +59,68 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 }
 
 
+#if THREADING
+
+// Objects loaded from a single package. Objects are detached from loader, so they're exported
+// in a worker thread while the main thread is loading next packages.
+struct CExportBatch
+{
+	TArray<UObject*> Objects;
+	CSemaphore Done;
+};
+
+static void ExportBatch(CExportBatch* Batch)
+{
+	guard(ExportBatch);
+
+	appPrintf("Exporting objects ...\n");
+	UnPackage* notifyPackage = NULL;
+	for (UObject* ExpObj : Batch->Objects)
+	{
+		if (notifyPackage != ExpObj->Package)
+		{
+			notifyPackage = ExpObj->Package;
+			appSetNotifyHeader(*notifyPackage->GetFilename());
+		}
+		ExportObject(ExpObj);
+	}
+	appSetNotifyHeader(NULL);
+
+	unguard;
+}
+
+// Wait for the oldest batch and release its objects. Batches never share objects, because
+// DetachAllObjects() unlinks them from export tables; waiting for the oldest batch just keeps
+// at most NumJobs packages in memory.
+static void ReleaseOldestBatch(TArray<CExportBatch*>& Batches)
+{
+	guard(ReleaseOldestBatch);
+
+	CExportBatch* Batch = Batches[0];
+	Batches.RemoveAt(0);
+	Batch->Done.Wait();
+	ReleaseObjects(Batch->Objects);
+	delete Batch;
+
+	unguard;
+}
+
+static int GetExportJobCount(const TArray<UnPackage*>& Packages)
+{
+	int NumJobs = min(GExportJobs, CThread::GetLogicalCPUCount());
+	if (NumJobs <= 1 || Packages.Num() < 2)
+		return 1;
+	// Unique names of uncooked UE3 objects depends on export order, so export packages sequentially
+	// to get the same file names on every run
+	int Game = Packages[0]->Game;
+	if (GUncook && Game >= GAME_UE3 && Game < GAME_UE4_BASE)
+		return 1;
+	return NumJobs;
+}
+
+#endif // THREADING
+
+
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress)
 {
 	guard(ExportPackages);
@@ -71,6 +141,13 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 //	appResetProfiler(); -- there's nested appResetProfiler/appPrintProfiler calls, which are not supported
 #endif
 
+#if THREADING
+	// When multiple jobs are allowed, the main thread only loads packages, and loaded objects
+	// are exported by pool threads. At most NumJobs packages are exported simultaneously.
+	int NumJobs = GetExportJobCount(Packages);
+	TArray<CExportBatch*> Batches;
+#endif
+
 	BeginExport(true);
 
 	// For each package: load a package, export, then release
@@ -90,6 +167,26 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 			cancelled = true;
 			break;
 		}
+#if THREADING
+		if (NumJobs > 1)
+		{
+			if (!UObject::GObjObjects.Num())
+			{
+				// Nothing to export
+				ReleaseAllObjects();
+				continue;
+			}
+			// Export in a pool thread
+			CExportBatch* Batch = new CExportBatch;
+			DetachAllObjects(Batch->Objects);
+			Batches.Add(Batch);
+			ThreadPool::TryExecuteInThread([Batch]() { ExportBatch(Batch); }, &Batch->Done);
+			// Limit number of packages kept in memory
+			if (Batches.Num() >= NumJobs)
+				ReleaseOldestBatch(Batches);
+			continue;
+		}
+#endif // THREADING
 		// Export
 		if (!ExportObjects(NULL, Progress))
 		{
@@ -100,12 +197,26 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 		ReleaseAllObjects();
 	}
 
+#if THREADING
+	// Finish remaining jobs
+	while (Batches.Num())
+		ReleaseOldestBatch(Batches);
+#endif
+
 	// Cleanup
 	EndExport(true);
 
 #if PROFILE
 //	appPrintProfiler();
+#if UNREAL4
+	BlockCache::PrintStats();
+#endif
+	CDecompressor::PrintStats();
+	appPrintStringPoolStats();
+#if THREADING
+	ThreadPool::PrintStats();
 #endif
+#endif // PROFILE
 
 	if (cancelled)
 	{
@@ -136,6 +247,33 @@ void DisplayPackageStats(const TArray<UnPackage*> &Packages)
 }
 
 
+void DisplayPackageContent(const TArray<const CGameFileInfo*>& Packages)
+{
+	guard(DisplayPackageContent);
+
+	ScanContent(Packages);
+
+	int NumSkeletalMeshes = 0, NumStaticMeshes = 0, NumAnimations = 0, NumTextures = 0;
+	appPrintf("  Skel  Static    Anim     Tex Package\n");
+	for (const CGameFileInfo* file : Packages)
+	{
+		NumSkeletalMeshes += file->NumSkeletalMeshes;
+		NumStaticMeshes   += file->NumStaticMeshes;
+		NumAnimations     += file->NumAnimations;
+		NumTextures       += file->NumTextures;
+		// Don't list packages without any interesting content
+		if (file->NumSkeletalMeshes + file->NumStaticMeshes + file->NumAnimations + file->NumTextures == 0)
+			continue;
+		appPrintf("%6d %7d %7d %7d %s\n", file->NumSkeletalMeshes, file->NumStaticMeshes, file->NumAnimations, file->NumTextures,
+			*file->GetRelativeName());
+	}
+	appPrintf("Total: %d packages, %d skeletal meshes, %d static meshes, %d animations, %d textures\n",
+		Packages.Num(), NumSkeletalMeshes, NumStaticMeshes, NumAnimations, NumTextures);
+
+	unguard;
+}
+
+
 static void CopyStream(FArchive *Src, FILE *Dst, int Count)
 {
 	guard(CopyStream);
@@ -8,10 +8,18 @@ class IProgressCallback;
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress = NULL);
 
 // Export everything from provided package list.
+// With THREADING, up to GExportJobs packages are exported in parallel.
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress = NULL);
 
 void DisplayPackageStats(const TArray<UnPackage*> &Packages);
 
+// Scan package headers and display number of meshes, animations and textures in each package.
+void DisplayPackageContent(const TArray<const CGameFileInfo*>& Packages);
+
 void SavePackages(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL);
 
+#if THREADING
+extern int GExportJobs;
+#endif
+
 #endif // __UMODEL_COMMANDS_H__
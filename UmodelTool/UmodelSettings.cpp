@@ -124,10 +124,12 @@ void CExportSettings::Reset()
 	SetPath(EXPORT_DIRECTORY);
 
 	ExportDdsTexture = false;
+	ExportKtx2Texture = false;
 	SkeletalMeshFormat = EExportMeshFormat::psk;
 	StaticMeshFormat = EExportMeshFormat::psk;
 	TextureFormat = ETextureExportFormat::tga;
 	ExportMeshLods = false;
+	ExportGlb = false;
 	SaveUncooked = false;
 	SaveGroups = false;
 	DontOverwriteFiles = false;
@@ -144,8 +146,10 @@ void CExportSettings::Apply()
 	GNoTgaCompress = (TextureFormat == ETextureExportFormat::tga_uncomp);
 	GExportPNG = (TextureFormat == ETextureExportFormat::png);
 	GExportDDS = ExportDdsTexture;
+	GExportKTX2 = ExportKtx2Texture;
 
 	GExportLods = ExportMeshLods;
+	GExportGLB = ExportGlb;
 	GUncook = SaveUncooked;
 	GUseGroups = SaveGroups;
 	GDontOverwriteFiles = DontOverwriteFiles;
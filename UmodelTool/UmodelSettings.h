@@ -73,10 +73,12 @@ struct CExportSettings
 
 	FString			ExportPath;
 	bool			ExportDdsTexture;
+	bool			ExportKtx2Texture;
 	EExportMeshFormat SkeletalMeshFormat;
 	EExportMeshFormat StaticMeshFormat;
 	ETextureExportFormat TextureFormat;
 	bool			ExportMeshLods;
+	bool			ExportGlb;
 	bool			SaveUncooked;
 	bool			SaveGroups;
 	bool			DontOverwriteFiles;
@@ -84,10 +86,12 @@ struct CExportSettings
 	BEGIN_PROP_TABLE
 		PROP_STRING(ExportPath)
 		PROP_BOOL(ExportDdsTexture)
+		PROP_BOOL(ExportKtx2Texture)
 		PROP_INT(SkeletalMeshFormat)
 		PROP_INT(StaticMeshFormat)
 		PROP_INT(TextureFormat)
 		PROP_BOOL(ExportMeshLods)
+		PROP_BOOL(ExportGlb)
 		PROP_BOOL(SaveUncooked)
 		PROP_BOOL(SaveGroups)
 		PROP_BOOL(DontOverwriteFiles)
@@ -0,0 +1,227 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "BlockCache.h"
+
+#include "Parallel.h"
+
+#if UNREAL4
+
+// Default size of the cache
+#define DEFAULT_BLOCK_CACHE_SIZE	(64 << 20)
+
+#define BLOCK_HASH_SIZE				4096
+#define BLOCK_HASH_MASK				(BLOCK_HASH_SIZE - 1)
+
+namespace BlockCache
+{
+
+static int64 MemoryBudget = DEFAULT_BLOCK_CACHE_SIZE;
+static int64 MemoryUsed = 0;
+static int64 MaxMemoryUsed = 0;
+static int NumCachedBlocks = 0;
+
+// Statistics
+static int NumHits = 0;
+static int NumMisses = 0;
+static int NumEvictions = 0;
+
+static CCachedBlock* HashTable[BLOCK_HASH_SIZE];
+// LRU list: recently used blocks are at head
+static CCachedBlock* LruHead = NULL;
+static CCachedBlock* LruTail = NULL;
+
+#if THREADING
+static CMutex CacheMutex;
+#define LOCK_CACHE()	CMutex::ScopedLock _Lock(CacheMutex)
+#else
+#define LOCK_CACHE()
+#endif
+
+static FORCEINLINE int GetHash(const void* Container, int64 Key)
+{
+	uint32 h = (uint32)(size_t)Container ^ (uint32)Key ^ (uint32)(Key >> 32);
+	h ^= h >> 16;
+	return (h * 0x9E3779B1) >> 20 & BLOCK_HASH_MASK;
+}
+
+static void LinkLru(CCachedBlock* Block)
+{
+	Block->LruPrev = NULL;
+	Block->LruNext = LruHead;
+	if (LruHead)
+		LruHead->LruPrev = Block;
+	else
+		LruTail = Block;
+	LruHead = Block;
+}
+
+static void UnlinkLru(CCachedBlock* Block)
+{
+	if (Block->LruPrev)
+		Block->LruPrev->LruNext = Block->LruNext;
+	else
+		LruHead = Block->LruNext;
+	if (Block->LruNext)
+		Block->LruNext->LruPrev = Block->LruPrev;
+	else
+		LruTail = Block->LruPrev;
+	Block->LruPrev = Block->LruNext = NULL;
+}
+
+// Exclude block from the cache. The block is freed immediately if it is not used.
+static void RemoveBlock(CCachedBlock* Block)
+{
+	CCachedBlock** Link = &HashTable[GetHash(Block->Container, Block->Key)];
+	while (*Link != Block)
+	{
+		assert(*Link);
+		Link = &(*Link)->HashNext;
+	}
+	*Link = Block->HashNext;
+	UnlinkLru(Block);
+
+	Block->bInCache = false;
+	MemoryUsed -= Block->Size;
+	NumCachedBlocks--;
+
+	if (Block->RefCount == 0)
+		appFree(Block);
+}
+
+// Drop least recently used blocks until the cache fits the memory budget. Blocks which are used
+// at the moment are kept.
+static void Trim()
+{
+	CCachedBlock* Block = LruTail;
+	while (Block && MemoryUsed > MemoryBudget)
+	{
+		CCachedBlock* Prev = Block->LruPrev;
+		if (Block->RefCount == 0)
+		{
+			RemoveBlock(Block);
+			NumEvictions++;
+		}
+		Block = Prev;
+	}
+}
+
+CCachedBlock* Find(const void* Container, int64 Key)
+{
+	LOCK_CACHE();
+
+	for (CCachedBlock* Block = HashTable[GetHash(Container, Key)]; Block; Block = Block->HashNext)
+	{
+		if (Block->Container == Container && Block->Key == Key)
+		{
+			NumHits++;
+			Block->RefCount++;
+			// Move to the head of the list
+			UnlinkLru(Block);
+			LinkLru(Block);
+			return Block;
+		}
+	}
+
+	NumMisses++;
+	return NULL;
+}
+
+CCachedBlock* Allocate(int Size)
+{
+	// Allocate block header and data with a single allocation
+	CCachedBlock* Block = (CCachedBlock*)appMallocNoInit(sizeof(CCachedBlock) + Size);
+	memset(Block, 0, sizeof(CCachedBlock));
+	Block->Data = (byte*)(Block + 1);
+	Block->Size = Size;
+	Block->RefCount = 1;
+	return Block;
+}
+
+CCachedBlock* Add(const void* Container, int64 Key, CCachedBlock* Block)
+{
+	guard(BlockCache::Add);
+	LOCK_CACHE();
+
+	assert(!Block->bInCache && Block->RefCount == 1);
+	Block->Container = Container;
+	Block->Key = Key;
+
+	if (Block->Size > MemoryBudget)
+	{
+		// Caching is disabled, or the block is too large: return block as is, it will be freed on release
+		return Block;
+	}
+
+	int Hash = GetHash(Container, Key);
+	for (CCachedBlock* Other = HashTable[Hash]; Other; Other = Other->HashNext)
+	{
+		if (Other->Container == Container && Other->Key == Key)
+		{
+			// The same block was decompressed in another thread
+			appFree(Block);
+			Other->RefCount++;
+			return Other;
+		}
+	}
+
+	Block->HashNext = HashTable[Hash];
+	HashTable[Hash] = Block;
+	LinkLru(Block);
+	Block->bInCache = true;
+	MemoryUsed += Block->Size;
+	NumCachedBlocks++;
+	if (MemoryUsed > MaxMemoryUsed)
+		MaxMemoryUsed = MemoryUsed;
+
+	Trim();
+
+	return Block;
+
+	unguard;
+}
+
+void Release(CCachedBlock* Block)
+{
+	LOCK_CACHE();
+
+	assert(Block->RefCount > 0);
+	if (--Block->RefCount == 0 && !Block->bInCache)
+		appFree(Block);
+}
+
+void RemoveContainer(const void* Container)
+{
+	LOCK_CACHE();
+
+	CCachedBlock* Block = LruHead;
+	while (Block)
+	{
+		CCachedBlock* Next = Block->LruNext;
+		if (Block->Container == Container)
+			RemoveBlock(Block);
+		Block = Next;
+	}
+}
+
+void SetMemoryBudget(int64 Size)
+{
+	LOCK_CACHE();
+
+	MemoryBudget = Size;
+	Trim();
+}
+
+void PrintStats()
+{
+	LOCK_CACHE();
+
+	if (!NumHits && !NumMisses) return;
+	appPrintf("Block cache: %d hits, %d misses (%.1f%% hit rate), %d evictions, %d blocks (%.1f MBytes) cached, peak %.1f MBytes\n",
+		NumHits, NumMisses, NumHits * 100.0f / (NumHits + NumMisses), NumEvictions,
+		NumCachedBlocks, MemoryUsed / (1024.0f * 1024.0f), MaxMemoryUsed / (1024.0f * 1024.0f));
+}
+
+} // namespace BlockCache
+
+#endif // UNREAL4
@@ -0,0 +1,55 @@
+#ifndef __BLOCK_CACHE_H__
+#define __BLOCK_CACHE_H__
+
+#if UNREAL4
+
+// Process-wide cache of decompressed data blocks, shared by all pak and IOStore containers.
+// The same block may be requested many times: by .uasset/.uexp/.ubulk readers sharing a block,
+// or when a file is reopened after UnPackage::CloseAllReaders(). Blocks are identified by the
+// container object and a block key which is unique inside the container.
+
+struct CCachedBlock
+{
+	byte*			Data;
+	int				Size;
+
+	// Internal data
+	const void*		Container;
+	int64			Key;
+	int				RefCount;
+	bool			bInCache;
+	CCachedBlock*	HashNext;
+	CCachedBlock*	LruPrev;
+	CCachedBlock*	LruNext;
+};
+
+namespace BlockCache
+{
+
+// Find a block in cache. Returns NULL if block is not cached. Found block is locked,
+// and should be released with Release() call.
+CCachedBlock* Find(const void* Container, int64 Key);
+
+// Allocate a new block which could be filled with data and passed to Add() function.
+CCachedBlock* Allocate(int Size);
+
+// Put a filled block into the cache. If another thread has already cached the same block,
+// the passed block is released, and the cached one is returned. Returned block is locked.
+CCachedBlock* Add(const void* Container, int64 Key, CCachedBlock* Block);
+
+// Unlock the block. Blocks which are not in cache anymore are freed.
+void Release(CCachedBlock* Block);
+
+// Drop all blocks of the container, should be called when container is destroyed.
+void RemoveContainer(const void* Container);
+
+// Set size of memory used by cache, in bytes. Zero value disables caching.
+void SetMemoryBudget(int64 Size);
+
+void PrintStats();
+
+}
+
+#endif // UNREAL4
+
+#endif // __BLOCK_CACHE_H__
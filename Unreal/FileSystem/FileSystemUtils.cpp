@@ -1,6 +1,10 @@
 #include "Core.h"
 #include "UnCore.h"
 
+#include "FileSystemUtils.h"
+
+#include "Parallel.h"
+
 
 void ValidateMountPoint(FString& MountPoint, const FString& ContextFilename)
 {
@@ -77,9 +81,53 @@ int32 StringToCompressionMethod(const char* Name)
 
 #if UNREAL4
 
+#if THREADING
+static CMutex AesKeyMutex;
+#endif
+
+static bool bDeferAesKeyRequests = false;
+static volatile int32 NumDeferredAesKeyRequests = 0;
+// Set when FileRequiresAesKey() has deferred a request in the current thread
+static thread_local bool bAesKeyRequestDeferredInThread = false;
+
+void DeferAesKeyRequests()
+{
+	NumDeferredAesKeyRequests = 0;
+	bDeferAesKeyRequests = true;
+}
+
+bool ResolveDeferredAesKey()
+{
+	bDeferAesKeyRequests = false;
+	if (!NumDeferredAesKeyRequests) return false;
+	return FileRequiresAesKey(false);
+}
+
+bool CheckDeferredAesKeyRequest()
+{
+	bool Result = bAesKeyRequestDeferredInThread;
+	bAesKeyRequestDeferredInThread = false;
+	return Result;
+}
+
 bool FileRequiresAesKey(bool fatal)
 {
-	if ((GAesKeys.Num() == 0) && !UE4EncryptedPak())
+#if THREADING
+	// Encrypted files could be read from multiple threads, ask for the key only once. GAesKeys could
+	// be modified by other thread, so check it under the lock too.
+	CMutex::ScopedLock Lock(AesKeyMutex);
+#endif
+	if (GAesKeys.Num()) return true;
+	if (bDeferAesKeyRequests)
+	{
+		// Called from a worker thread, the key will be requested by ResolveDeferredAesKey()
+		InterlockedIncrement(&NumDeferredAesKeyRequests);
+		bAesKeyRequestDeferredInThread = true;
+		if (fatal)
+			appErrorNoLog("AES key is required");
+		return false;
+	}
+	if (!UE4EncryptedPak())
 	{
 		if (fatal)
 			appErrorNoLog("AES key is required");
@@ -89,3 +137,35 @@ bool FileRequiresAesKey(bool fatal)
 }
 
 #endif // UNREAL4
+
+static void DecompressBlock(const CDecompressBlock& Block)
+{
+	if (Block.CompressionMethod)
+	{
+		appDecompress(Block.CompressedData, Block.CompressedSize, Block.UncompressedData, Block.UncompressedSize, Block.CompressionMethod, Block.DecompressCache);
+	}
+	else
+	{
+		assert(Block.CompressedSize == Block.UncompressedSize);
+		memcpy(Block.UncompressedData, Block.CompressedData, Block.UncompressedSize);
+	}
+}
+
+void DecompressBlocks(const CDecompressBlock* Blocks, int NumBlocks)
+{
+	guard(DecompressBlocks);
+
+	if (NumBlocks <= 0) return;
+
+	// Decompress the first block in the calling thread. This initializes decompressor's state (compression
+	// method detection) before other threads will access it.
+	DecompressBlock(Blocks[0]);
+
+	// Every thread grabs blocks one by one until all blocks are processed
+	ParallelForSlow(NumBlocks - 1, [Blocks](int Index)
+		{
+			DecompressBlock(Blocks[Index + 1]);
+		});
+
+	unguardf("%d blocks", NumBlocks);
+}
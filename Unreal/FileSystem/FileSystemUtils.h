@@ -9,4 +9,27 @@ int32 StringToCompressionMethod(const char* Name);
 
 bool FileRequiresAesKey(bool fatal = true);
 
+// Worker threads can't ask user for the AES key. Between these calls FileRequiresAesKey() fails instead
+// of displaying UI, and remembers the request. ResolveDeferredAesKey() should be called on the main thread,
+// it asks for the key when it was requested, and returns true when the key became available.
+void DeferAesKeyRequests();
+bool ResolveDeferredAesKey();
+// Returns true when FileRequiresAesKey() has deferred a request in the current thread since the
+// previous call, i.e. when the operation failed because of the missing AES key.
+bool CheckDeferredAesKeyRequest();
+
+// Description of a block for DecompressBlocks()
+struct CDecompressBlock
+{
+	byte*		CompressedData;
+	int			CompressedSize;
+	byte*		UncompressedData;
+	int			UncompressedSize;
+	int			CompressionMethod;		// 0 for uncompressed data
+	CDecompressCache* DecompressCache;	// container's storage for appDecompress()
+};
+
+// Decompress a set of independent blocks, using pool threads when possible
+void DecompressBlocks(const CDecompressBlock* Blocks, int NumBlocks);
+
 #endif // __FILE_SYSTEM_UTILS_H__
@@ -5,6 +5,8 @@
 #include "UnArchiveObb.h"
 #include "UnArchivePak.h"
 #include "IOStoreFileSystem.h"
+#include "IndexCache.h"
+#include "FileSystemUtils.h"
 
 #include "Parallel.h"
 
@@ -122,7 +124,7 @@ static const char *KnownExtensions[] =
 static const char *SkipExtensions[] =
 {
 	"tga", "png", "dds", "bmp", "mat", "txt",	// textures, materials
-	"psk", "pskx", "psa", "config", "gltf",		// meshes, animations
+	"psk", "pskx", "psa", "config", "gltf", "glb", // meshes, animations
 	"ogg", "wav", "fsb", "xma", "unk",			// sounds
 	"gfx", "fxa",								// 3rd party
 	"md5mesh", "md5anim",						// md5 mesh
@@ -186,13 +188,122 @@ static int            GStartupPackageInfoWeight = 0;
 #endif
 
 
+/*-----------------------------------------------------------------------------
+	Virtual file system registration
+-----------------------------------------------------------------------------*/
+
+// Recorded registration calls of FVirtualFileSystem
+struct CDeferredRegistration
+{
+	TArray<CRegisterFileInfo> Items;		// folders are stored with Filename == NULL and name in Path
+	CMemoryChain*	Strings;				// storage for copies of file and folder names
+	int				NumFolders;
+	int				ReserveCount;
+
+	CDeferredRegistration()
+	: Strings(new CMemoryChain())
+	, NumFolders(0)
+	, ReserveCount(0)
+	{}
+
+	~CDeferredRegistration()
+	{
+		delete Strings;
+	}
+
+	const char* CopyString(const char* Str)
+	{
+		int Len = strlen(Str) + 1;
+		char* Copy = (char*)Strings->Alloc(Len, 1);
+		memcpy(Copy, Str, Len);
+		return Copy;
+	}
+};
+
+FVirtualFileSystem::~FVirtualFileSystem()
+{
+	delete Deferred;
+}
+
 void FVirtualFileSystem::Reserve(int count)
 {
 	guard(FVirtualFileSystem::Reserve);
+	if (Deferred)
+	{
+		Deferred->ReserveCount += count;
+		Deferred->Items.Reserve(Deferred->Items.Num() + count);
+		return;
+	}
 	GameFiles.Reserve(GameFiles.Num() + count);
 	unguard;
 }
 
+void FVirtualFileSystem::RegisterFile(CRegisterFileInfo& info)
+{
+	assert(info.IndexInArchive >= 0);
+	if (Deferred)
+	{
+		CRegisterFileInfo& Item = Deferred->Items[Deferred->Items.Add(info)];
+		Item.Filename = Deferred->CopyString(info.Filename);
+		if (info.Path)
+			Item.Path = Deferred->CopyString(info.Path);
+		return;
+	}
+	OnFileRegistered(info.IndexInArchive, CGameFileInfo::Register(this, info));
+}
+
+int FVirtualFileSystem::RegisterFolder(const char* FolderName)
+{
+	if (Deferred)
+	{
+		// Return a local folder index, it will be remapped in FinishRegistration()
+		CRegisterFileInfo& Item = Deferred->Items[Deferred->Items.AddDefaulted()];
+		Item.Path = Deferred->CopyString(FolderName);
+		return ++Deferred->NumFolders;
+	}
+	return RegisterGameFolder(FolderName);
+}
+
+void FVirtualFileSystem::DeferRegistration()
+{
+	assert(!Deferred);
+	Deferred = new CDeferredRegistration;
+}
+
+void FVirtualFileSystem::FinishRegistration()
+{
+	guard(FVirtualFileSystem::FinishRegistration);
+
+	if (Deferred)
+	{
+		// Prevent recursion into deferred code
+		CDeferredRegistration* Data = Deferred;
+		Deferred = NULL;
+
+		GameFiles.Reserve(GameFiles.Num() + Data->ReserveCount);
+
+		TArray<int> FolderIndices;
+		FolderIndices.Empty(Data->NumFolders);
+		for (CRegisterFileInfo& Item : Data->Items)
+		{
+			if (!Item.Filename)
+			{
+				FolderIndices.Add(RegisterGameFolder(Item.Path));
+				continue;
+			}
+			if (Item.FolderIndex)
+				Item.FolderIndex = FolderIndices[Item.FolderIndex - 1];
+			RegisterFile(Item);
+		}
+
+		delete Data;
+	}
+
+	OnRegistrationFinished();
+
+	unguard;
+}
+
 FORCEINLINE uint32 GetHashInternal(const char* s, int len)
 {
 	uint16 hash = 0;
@@ -351,164 +462,234 @@ int RegisterGameFolder(const char* FolderName)
 
 //!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
 
-static void RegisterGameFile(const char* FullName, int64 FileSize = -1)
+// Information about a file found during game directory scan
+struct CScannedFile
 {
-	guard(RegisterGameFile);
+	FString FullName;
+	int64 Size;
+	struct CScannedContainer* Container;	// not NULL for files with VFS inside
+};
 
-//	printf("..file %s\n", FullName);
+enum EContainerType
+{
+	CT_Obb,
+	CT_Pak,
+};
 
-	const char* ext = strrchr(FullName, '.');
-	if (ext == NULL) return;
+// VFS data prepared in worker thread
+struct CScannedContainer
+{
+	EContainerType Type;
+	FVirtualFileSystem* Vfs;
+	FString Error;
+#if UNREAL4
+	bool bHasIoStore;
+	FIOStoreFileSystem* IoVfs;
+	FString IoError;
+	bool bHasEncryptedFiles;
+	bool bNeedsAesKey;						// attach has failed because of the missing AES key
+#endif
 
+	CScannedContainer(EContainerType InType)
+	: Type(InType)
+	, Vfs(NULL)
+#if UNREAL4
+	, bHasIoStore(false)
+	, IoVfs(NULL)
+	, bHasEncryptedFiles(false)
+	, bNeedsAesKey(false)
+#endif
+	{}
+};
+
+// Find if this file is an archive with VFS inside
+static CScannedContainer* CheckContainerFile(const char* FullName)
+{
+	const char* ext = strrchr(FullName, '.');
+	if (ext == NULL) return NULL;
 	ext++;
 
-	// Find if this file in an archive with VFS inside
+#if SUPPORT_ANDROID
+	if (!stricmp(ext, "obb"))
+	{
+		GForcePlatform = PLATFORM_ANDROID;
+		return new CScannedContainer(CT_Obb);
+	}
+#endif // SUPPORT_ANDROID
+#if UNREAL4
+	if (!stricmp(ext, "pak"))
+	{
+		return new CScannedContainer(CT_Pak);
+	}
+#endif // UNREAL4
+	return NULL;
+}
+
+// Read VFS directory. This function is executed in a worker thread, so all file registrations are deferred.
+static void AttachContainer(const char* FullName, CScannedContainer& Container)
+{
+	guard(AttachContainer);
+
 	FVirtualFileSystem* vfs = NULL;
 	FArchive* reader = NULL;
 
 #if SUPPORT_ANDROID
-	if (!stricmp(ext, "obb"))
+	if (Container.Type == CT_Obb)
 	{
-		GForcePlatform = PLATFORM_ANDROID;
 		reader = new FFileReader(FullName);
-		if (!reader) return;
 		reader->Game = GAME_UE3;
 		vfs = new FObbVFS(FullName);
 	}
 #endif // SUPPORT_ANDROID
 #if UNREAL4
 	FPakVFS* PakVfs = NULL;
-	if (!stricmp(ext, "pak"))
+	if (Container.Type == CT_Pak)
 	{
 		reader = new FFileReader(FullName);
-		if (!reader) return;
 		reader->Game = GAME_UE4_BASE;
 		PakVfs = new FPakVFS(FullName);
 		vfs = PakVfs;
-		GIsUE4Pak = true; // ignore non-UE4 extensions for speedup file registration
-	}
-	else if (!stricmp(ext, "utok") || !stricmp(ext, "ucas"))
-	{
-		// Processed with .pak file, so ignore these files
 	}
 #endif // UNREAL4
 
 	// Note: VFS pointer is not stored in any global list, and not released at program exit
-	if (vfs)
+	assert(vfs && reader);
+	vfs->DeferRegistration();
+#if UNREAL4
+	CheckDeferredAesKeyRequest();
+#endif
+	if (!vfs->AttachReader(reader, Container.Error))
 	{
-		assert(reader);
-		// read VFS directory
-		FString error;
-		if (!vfs->AttachReader(reader, error))
-		{
 #if UNREAL4
-			// Reset GIsUE4Pak back in a case if .pak file appeared in directory
-			// by accident.
-			GIsUE4Pak = false;
+		Container.bNeedsAesKey = CheckDeferredAesKeyRequest();
 #endif
-			// something goes wrong
-			if (error.Len())
+		// something goes wrong
+		if (!Container.Error.Len())
+		{
+			char buf[1024];
+			appSprintf(ARRAY_ARG(buf), "File %s has an unknown format", FullName);
+			Container.Error = buf;
+		}
+		delete vfs;
+		delete reader;
+		return;
+	}
+	Container.Vfs = vfs;
+
+#if UNREAL4
+	if (PakVfs)
+	{
+		Container.bHasEncryptedFiles = PakVfs->HasEncryptedFiles();
+
+		// Get the pak's encryption key, which is only assigned after vfs->AttachReader()
+		FString PakEncryptionKey = PakVfs->GetPakEncryptionKey();
+
+		// Check for presense of IOStore file system for this pak
+		guard(TokArchive);
+		char Path[MAX_PACKAGE_PATH];
+		appStrncpyz(Path, FullName, ARRAY_COUNT(Path));
+		char* PathExt = strrchr(Path, '.') + 1;
+		strcpy(PathExt, "utoc");
+		FILE* tocFile = fopen(Path, "rb");
+		if (tocFile)
+		{
+			fclose(tocFile);
+			Container.bHasIoStore = true;
+
+			FIOStoreFileSystem* iosVfs = new FIOStoreFileSystem(Path);
+			iosVfs->PakEncryptionKey = PakEncryptionKey;
+			FArchive* tocReader = new FFileReader(Path);
+			tocReader->Game = GAME_UE4_BASE;
+
+			// Scan contents of IOStore container
+			iosVfs->DeferRegistration();
+			if (iosVfs->AttachReader(tocReader, Container.IoError))
 			{
-				appPrintf("%s\n", *error);
+				Container.IoVfs = iosVfs;
+				if (iosVfs->IsEncrypted())
+					Container.bHasEncryptedFiles = true;
 			}
 			else
 			{
-				appPrintf("File %s has an unknown format\n", FullName);
+				delete iosVfs;
+				delete tocReader;
 			}
-			delete vfs;
-			delete reader;
-			return;
 		}
-#if UNREAL4
-		if (GIsUE4Pak)
-		{
-			// Get the pak's encryption key, which is only assigned after vfs->AttachReader()
-			assert(PakVfs);
-			FString PakEncryptionKey = PakVfs->GetPakEncryptionKey();
-
-			// Check for presense of IOStore file system for this pak
-			guard(TokArchive);
-			char Path[MAX_PACKAGE_PATH];
-			appStrncpyz(Path, FullName, ARRAY_COUNT(Path));
-			char* PathExt = Path + (ext - FullName);
-			strcpy(PathExt, "utoc");
-			FILE* tocFile = fopen(Path, "rb");
-			if (tocFile)
-			{
-				fclose(tocFile);
+		unguard;
+	}
+#endif // UNREAL4
 
-				static bool bGlobalChecked = false;
-				if (!bGlobalChecked)
-				{
-					bGlobalChecked = true;
-					char GlobalPath[MAX_PACKAGE_PATH];
-					strcpy(GlobalPath, Path);
-					char* s = strrchr(GlobalPath, '/');
-					if (s)
-						s++;
-					else
-						s = GlobalPath;
-					strcpy(s, "global.utoc");
-					FIOStoreFileSystem::LoadGlobalContainer(GlobalPath);
-				}
+	unguardf("%s", FullName);
+}
 
-				FIOStoreFileSystem* iosVfs = new FIOStoreFileSystem(Path);
-				iosVfs->PakEncryptionKey = PakEncryptionKey;
-				FArchive* tocReader = new FFileReader(Path);
-				tocReader->Game = GAME_UE4_BASE;
+// Add VFS content to the global file list. Executed in the main thread, in the same order as files
+// were found.
+static void RegisterContainer(const char* FullName, CScannedContainer& Container)
+{
+	guard(RegisterContainer);
 
-				// Scan contents of IOStore container
-				FString error;
-				if (!iosVfs->AttachReader(tocReader, error))
-				{
-					if (error.Len())
-					{
-						appPrintf("%s\n", *error);
-					}
-					delete iosVfs;
-					delete tocReader;
-				}
-			}
-			unguard;
+	if (!Container.Vfs)
+	{
+		appPrintf("%s\n", *Container.Error);
+		return;
+	}
 
-			// Reset GIsUE4Pak
-			GIsUE4Pak = false;
-		}
+#if UNREAL4
+	// ignore non-UE4 extensions for speedup file registration
+	GIsUE4Pak = (Container.Type == CT_Pak);
 #endif
-	}
-	else
-	{
-		// Register OS file
-		CRegisterFileInfo info;
 
-		if (FileSize < 0)
+	Container.Vfs->FinishRegistration();
+
+#if UNREAL4
+	if (Container.bHasIoStore)
+	{
+		static bool bGlobalChecked = false;
+		if (!bGlobalChecked)
 		{
-			// Get file size
-			FILE* f = fopen(FullName, "rb");
-			if (f)
-			{
-				fseek(f, 0, SEEK_END);
-				info.Size = ftell(f);
-				fclose(f);
-			}
+			bGlobalChecked = true;
+			char GlobalPath[MAX_PACKAGE_PATH];
+			appStrncpyz(GlobalPath, FullName, ARRAY_COUNT(GlobalPath));
+			char* s = strrchr(GlobalPath, '/');
+			if (s)
+				s++;
 			else
-			{
-				// File is not accessible
-				return;
-			}
+				s = GlobalPath;
+			strcpy(s, "global.utoc");
+			FIOStoreFileSystem::LoadGlobalContainer(GlobalPath);
 		}
-		else
+
+		if (Container.IoVfs)
+		{
+			Container.IoVfs->FinishRegistration();
+		}
+		else if (Container.IoError.Len())
 		{
-			info.Size = FileSize;
+			appPrintf("%s\n", *Container.IoError);
 		}
+	}
 
-		// Cut GRootDirectory from filename
-		const char *s = FullName + strlen(GRootDirectory) + 1;
-		assert(s[-1] == '/');
-		info.Filename = s;
+	// Reset GIsUE4Pak
+	GIsUE4Pak = false;
+#endif // UNREAL4
 
-		CGameFileInfo::Register(NULL, info);
-	}
+	unguardf("%s", FullName);
+}
+
+// Register OS file
+static void RegisterGameFile(const char* FullName, int64 FileSize)
+{
+	guard(RegisterGameFile);
+
+	CRegisterFileInfo info;
+	info.Size = FileSize;
+
+	// Cut GRootDirectory from filename
+	const char *s = FullName + strlen(GRootDirectory) + 1;
+	assert(s[-1] == '/');
+	info.Filename = s;
+
+	CGameFileInfo::Register(NULL, info);
 
 	unguardf("%s", FullName);
 }
@@ -698,31 +879,39 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 	unguardf("%s", RegisterInfo.Filename);
 }
 
-static bool ScanGameDirectory(const char *dir, bool recurse)
+struct CScannedDirectory
 {
-	guard(ScanGameDirectory);
-
-	char Path[MAX_PACKAGE_PATH];
-	bool res = true;
-//	printf("Scan %s\n", dir);
-
 	struct FileInfo
 	{
-		FStaticString<256> Filename;	// short file name
+		FString Filename;				// short file name
 		int64 Size;						// file size
 	};
 
-	//todo: check - there's TArray<FStaticString> what's unsafe
-	TArray<FileInfo> Files;
-	Files.Empty(1024);
+	FString Path;
+	TArray<FileInfo> Files;					// sorted by name
+	TArray<CScannedDirectory*> SubDirs;		// in enumeration order
 
-	guard(ReadDir);
+	~CScannedDirectory()
+	{
+		for (CScannedDirectory* Dir : SubDirs)
+			delete Dir;
+	}
+};
+
+// Read the directory content, without recursing into subdirectories. Executed in a worker thread.
+static void ReadGameDirectory(CScannedDirectory& Dir, bool recurse)
+{
+	guard(ReadGameDirectory);
+
+	const char* dir = *Dir.Path;
+	char Path[MAX_PACKAGE_PATH];
+//	printf("Scan %s\n", dir);
 
 #if _WIN32
 	appSprintf(ARRAY_ARG(Path), "%s/*.*", dir);
 	_finddatai64_t found;
 	intptr_t hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
+	if (hFind == -1) return;
 	do
 	{
 		if (found.name[0] == '.') continue;			// "." or ".."
@@ -732,20 +921,22 @@ static bool ScanGameDirectory(const char *dir, bool recurse)
 			if (recurse)
 			{
 				appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
-				res = ScanGameDirectory(Path, recurse);
+				CScannedDirectory* SubDir = new CScannedDirectory;
+				SubDir->Path = Path;
+				Dir.SubDirs.Add(SubDir);
 			}
 		}
 		else
 		{
-			Files.Add( { found.name, found.size } );
+			Dir.Files.Add( { found.name, found.size } );
 		}
-	} while (res && _findnexti64(hFind, &found) != -1);
+	} while (_findnexti64(hFind, &found) != -1);
 	_findclose(hFind);
 #else
 	DIR *find = opendir(dir);
-	if (!find) return true;
+	if (!find) return;
 	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
+	while ((ent = readdir(find)))
 	{
 		if (ent->d_name[0] == '.') continue;			// "." or ".."
 		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
@@ -756,31 +947,140 @@ static bool ScanGameDirectory(const char *dir, bool recurse)
 		if (S_ISDIR(buf.st_mode))
 		{
 			if (recurse)
-				res = ScanGameDirectory(Path, recurse);
+			{
+				CScannedDirectory* SubDir = new CScannedDirectory;
+				SubDir->Path = Path;
+				Dir.SubDirs.Add(SubDir);
+			}
 		}
 		else
 		{
-			Files.Add( { ent->d_name, buf.st_size } );
+			Dir.Files.Add( { ent->d_name, buf.st_size } );
 		}
 	}
 	closedir(find);
 #endif
 
-	unguard;
-
 	// Register files in sorted order - should be done for pak files, so patches will work.
-	Files.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
+	Dir.Files.Sort([](const CScannedDirectory::FileInfo& p1, const CScannedDirectory::FileInfo& p2) -> int
 		{
 			return stricmp(*p1.Filename, *p2.Filename);
 		});
 
-	for (const FileInfo& File : Files)
+	unguardf("%s", *Dir.Path);
+}
+
+// Build the list of files in registration order: files of subdirectories go first (in order of
+// directory enumeration), then files of the directory itself.
+static void CollectScannedFiles(const CScannedDirectory& Dir, TArray<CScannedFile>& OutFiles)
+{
+	for (const CScannedDirectory* SubDir : Dir.SubDirs)
+	{
+		CollectScannedFiles(*SubDir, OutFiles);
+	}
+	char Path[MAX_PACKAGE_PATH];
+	for (const CScannedDirectory::FileInfo& File : Dir.Files)
+	{
+		appSprintf(ARRAY_ARG(Path), "%s/%s", *Dir.Path, *File.Filename);
+		CScannedFile& Scanned = OutFiles[OutFiles.AddDefaulted()];
+		Scanned.FullName = Path;
+		Scanned.Size = File.Size;
+		Scanned.Container = NULL;
+	}
+}
+
+static void ScanGameDirectory(const char *dir, bool recurse)
+{
+	guard(ScanGameDirectory);
+
+	// Walk the directory tree in parallel, one tree level at time
+	CScannedDirectory Root;
+	Root.Path = dir;
+
+	TArray<CScannedDirectory*> Level;
+	Level.Add(&Root);
+	while (Level.Num())
+	{
+		ParallelForSlow(Level.Num(), [&Level, recurse](int Index)
+			{
+				ReadGameDirectory(*Level[Index], recurse);
+			});
+		TArray<CScannedDirectory*> NextLevel;
+		for (CScannedDirectory* Dir : Level)
+		{
+			for (CScannedDirectory* SubDir : Dir->SubDirs)
+				NextLevel.Add(SubDir);
+		}
+		Exchange(Level, NextLevel);
+	}
+
+	TArray<CScannedFile> Files;
+	CollectScannedFiles(Root, Files);
+
+	// Read directories of all containers in parallel
+	TArray<CScannedFile*> Containers;
+	for (CScannedFile& File : Files)
+	{
+		File.Container = CheckContainerFile(*File.FullName);
+		if (File.Container)
+			Containers.Add(&File);
+	}
+#if UNREAL4
+	// Worker threads can't ask for the AES key, this will be done on the main thread after attaching
+	DeferAesKeyRequests();
+#endif
+	ParallelForSlow(Containers.Num(), [&Containers](int Index)
+		{
+			CScannedFile& File = *Containers[Index];
+			AttachContainer(*File.FullName, *File.Container);
+		});
+#if UNREAL4
+	if (ResolveDeferredAesKey())
 	{
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *File.Filename);
-		RegisterGameFile(Path, File.Size);
+		// The key has been provided, retry containers which failed because of the missing key
+		TArray<CScannedFile*> FailedContainers;
+		for (CScannedFile* File : Containers)
+		{
+			if (!File->Container->Vfs && File->Container->bNeedsAesKey)
+			{
+				File->Container->Error.Empty();
+				File->Container->bNeedsAesKey = false;
+				FailedContainers.Add(File);
+			}
+		}
+		ParallelForSlow(FailedContainers.Num(), [&FailedContainers](int Index)
+			{
+				CScannedFile& File = *FailedContainers[Index];
+				AttachContainer(*File.FullName, *File.Container);
+			});
+	}
+	bool bHasEncryptedFiles = false;
+#endif // UNREAL4
+
+	// Register everything in the original order, so patches will override older files
+	for (CScannedFile& File : Files)
+	{
+		if (File.Container)
+		{
+#if UNREAL4
+			if (File.Container->Vfs && File.Container->bHasEncryptedFiles)
+				bHasEncryptedFiles = true;
+#endif
+			RegisterContainer(*File.FullName, *File.Container);
+			delete File.Container;
+		}
+		else
+		{
+			RegisterGameFile(*File.FullName, File.Size);
+		}
 	}
 
-	return res;
+#if UNREAL4
+	// Encrypted files could be read from worker threads later (e.g. when exporting packages in parallel),
+	// so ask for the key now, in the main thread
+	if (bHasEncryptedFiles)
+		FileRequiresAesKey(false);
+#endif
 
 	unguard;
 }
@@ -798,7 +1098,13 @@ void appSetRootDirectory(const char *dir, bool recurse)
 
 	if (dir[0] == 0) dir = ".";	// using dir="" will cause scanning of "/dir1", "/dir2" etc (i.e. drive root)
 	appStrncpyz(GRootDirectory, dir, ARRAY_COUNT(GRootDirectory));
+#if UNREAL4
+	IndexCache::Load();
+#endif
 	ScanGameDirectory(GRootDirectory, recurse);
+#if UNREAL4
+	IndexCache::Save();
+#endif
 
 #if GEARS4
 	if (GForceGame == GAME_Gears4)
@@ -816,6 +1122,9 @@ void appSetRootDirectory(const char *dir, bool recurse)
 #endif // GEARS4
 
 	appPrintf("Found %d game files (%d skipped) in %d folders at path \"%s\"\n", GameFiles.Num(), GNumForeignFiles, GameFolders.Num() ? GameFolders.Num()-1 : 0, dir);
+#if UNREAL4
+	IndexCache::PrintStats();
+#endif
 
 #if UNREAL4
 	// Count sizes of additional files. Should process .uexp and .ubulk files, register their information for .uasset.
@@ -23,9 +23,12 @@ struct CRegisterFileInfo
 class FVirtualFileSystem
 {
 public:
-	virtual ~FVirtualFileSystem()
+	FVirtualFileSystem()
+	: Deferred(NULL)
 	{}
 
+	virtual ~FVirtualFileSystem();
+
 	// Attach FArchive which will be used for reading VFS content. This function should scan
 	// VFS directory. If function failed, it should return false and optionally fill error string.
 	virtual bool AttachReader(FArchive* reader, FString& error) = 0;
@@ -35,11 +38,26 @@ public:
 	// Reserve space for 'count' files
 	void Reserve(int count);
 
-	FORCEINLINE CGameFileInfo* RegisterFile(CRegisterFileInfo& info)
-	{
-		assert(info.IndexInArchive >= 0);
-		return CGameFileInfo::Register(this, info);
-	}
+	// Register a file in global file list. OnFileRegistered() is called when the file is actually
+	// added to the list, what could happen later when registration is deferred.
+	void RegisterFile(CRegisterFileInfo& info);
+	// Register a folder, returns value for CRegisterFileInfo::FolderIndex.
+	int RegisterFolder(const char* FolderName);
+
+	// Deferred registration allows calling AttachReader() from a worker thread: registered files and
+	// folders are recorded, and added to the global file list with FinishRegistration(), which should
+	// be called from the main thread. Registration order is preserved.
+	void DeferRegistration();
+	void FinishRegistration();
+
+protected:
+	virtual void OnFileRegistered(int IndexInArchive, CGameFileInfo* info)
+	{}
+	// Called from FinishRegistration() when all files are added to the global list.
+	virtual void OnRegistrationFinished()
+	{}
+
+	struct CDeferredRegistration* Deferred;
 };
 
 int RegisterGameFolder(const char* FolderName);
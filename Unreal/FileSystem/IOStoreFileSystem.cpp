@@ -5,6 +5,7 @@
 #include "UnrealPackage/UnPackage.h"
 
 #include "IOStoreFileSystem.h"
+#include "BlockCache.h"
 
 #if UNREAL4
 
@@ -301,6 +302,7 @@ FIOStoreFile::FIOStoreFile(int InFileIndex, FIOStoreFileSystem* InParent)
 :	Parent(InParent)
 ,	FileIndex(InFileIndex)
 ,	UncompressedBuffer(NULL)
+,	CachedBlock(NULL)
 ,	IsFileOpen(true)
 {
 	const FIoOffsetAndLength& OffsetAndLength = Parent->ChunkLocations[FileIndex];
@@ -316,9 +318,10 @@ FIOStoreFile::~FIOStoreFile()
 
 void FIOStoreFile::Close()
 {
-	if (UncompressedBuffer)
+	if (CachedBlock)
 	{
-		appFree(UncompressedBuffer);
+		BlockCache::Release(CachedBlock);
+		CachedBlock = NULL;
 		UncompressedBuffer = NULL;
 	}
 	if (IsFileOpen)
@@ -353,64 +356,133 @@ void FIOStoreFile::Serialize(void *data, int size)
 		IsFileOpen = true;
 	}
 
-	FArchive* Reader = Parent->Reader;
+	// All FIOStoreFile objects of the container are sharing the same Reader, possibly from different
+	// threads, so use positional reads
+	FFileReader* Reader = Parent->Reader;
 
 	// References:
 	// - FIoStoreReaderImpl::Read() - simpler implementation
 	// - FFileIoStore::ReadBlocks() - more complex asynchronous reading, doing the same
 	while (size > 0)
 	{
-		if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Parent->CompressionBlockSize))
+		int BlockSize = Parent->CompressionBlockSize;
+		if (((UncompressedOffset + ArPos) % BlockSize) == 0 && size >= BlockSize * 2)
 		{
-			// buffer is not ready
-			if (UncompressedBuffer == NULL)
+			// Large request which covers several whole blocks
+			int BlockIndex = int((UncompressedOffset + ArPos) / BlockSize);
+			const FIoStoreTocCompressedBlockEntry& Block = Parent->CompressionBlocks[BlockIndex];
+			if (Block.GetCompressionMethodIndex() || (Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)))
 			{
-				UncompressedBuffer = (byte*)appMallocNoInit(Parent->CompressionBlockSize); // size of uncompressed block
+				// Decompress blocks in parallel directly to the destination
+				int NumBlocks = size / BlockSize;
+				if (ArPos + size >= (int)UncompressedSize)
+				{
+					// Include the last (possibly incomplete) block of the chunk
+					NumBlocks = (UncompressedSize - ArPos + BlockSize - 1) / BlockSize;
+				}
+				if (NumBlocks > MaxBlocksPerRead) NumBlocks = MaxBlocksPerRead;
+				int BytesRead = DecompressBlocksTo(BlockIndex, NumBlocks, (byte*)data, size);
+				if (BytesRead)
+				{
+					// advance pointers
+					ArPos += BytesRead;
+					size  -= BytesRead;
+					data  = OffsetPointer(data, BytesRead);
+					continue;
+				}
 			}
-			// prepare buffer
+		}
+
+		if ((CachedBlock == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + CachedBlock->Size))
+		{
+			// buffer is not ready
 			int BlockIndex = int((UncompressedOffset + ArPos) / Parent->CompressionBlockSize);
-			UncompressedBufferPos = int(int64(Parent->CompressionBlockSize) * BlockIndex - UncompressedOffset);
+			int BlockPos = int(int64(Parent->CompressionBlockSize) * BlockIndex - UncompressedOffset);
 
 			const FIoStoreTocCompressedBlockEntry& Block = Parent->CompressionBlocks[BlockIndex];
 			int CompressedBlockSize = Block.GetCompressedSize();
 			int UncompressedBlockSize = Block.GetUncompressedSize();
-			byte* CompressedData;
-			if (!(Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)))
+			uint32 CompressionMethodIndex = Block.GetCompressionMethodIndex();
+			bool bEncrypted = (Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)) != 0;
+
+			if (!CompressionMethodIndex && !bEncrypted)
 			{
-				CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, CompressedBlockSize);
+				// Uncompressed data. When the container is memory-mapped, copy it directly from the mapping.
+				const byte* MappedData = Reader->GetMappedData(Block.GetOffset(), UncompressedBlockSize);
+				if (MappedData)
+				{
+					int OffsetInBlock = ArPos - BlockPos;
+					int BytesToCopy = UncompressedBlockSize - OffsetInBlock;
+					if (BytesToCopy > size) BytesToCopy = size;
+					assert(BytesToCopy > 0);
+					memcpy(data, MappedData + OffsetInBlock, BytesToCopy);
+
+					// advance pointers
+					ArPos += BytesToCopy;
+					size  -= BytesToCopy;
+					data  = OffsetPointer(data, BytesToCopy);
+					continue;
+				}
 			}
-			else
+
+			if (CachedBlock)
 			{
-				int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
-				CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, EncryptedSize);
-				FileRequiresAesKey();
-				Parent->DecryptDataBlock(CompressedData, EncryptedSize);
+				BlockCache::Release(CachedBlock);
+				CachedBlock = NULL;
 			}
-			uint32 CompressionMethodIndex = Block.GetCompressionMethodIndex();
-			if (CompressionMethodIndex)
+			// prepare buffer
+			UncompressedBufferPos = BlockPos;
+			CachedBlock = BlockCache::Find(Parent, BlockIndex);
+			if (CachedBlock)
 			{
-				// Compressed data
-				assert(CompressionMethodIndex <= Parent->NumCompressionMethods); // 0 = None is not counted, so "<=" is used here
-				int CompressionFlags = Parent->CompressionMethods[CompressionMethodIndex];
-				appDecompress(CompressedData, CompressedBlockSize, UncompressedBuffer, UncompressedBlockSize, CompressionFlags);
-				appFree(CompressedData);
+				// The block is already decompressed
 			}
-			else
+			else if (!CompressionMethodIndex && !bEncrypted)
 			{
-				// Uncompressed data
-				//todo: don't allocate 'CompressedData' and don't 'memcpy', read directly to 'UncompressedBuffer'
+				// Uncompressed data, read it directly to the buffer
 				assert(CompressedBlockSize == UncompressedBlockSize);
-				memcpy(UncompressedBuffer, CompressedData, UncompressedBlockSize);
+				CCachedBlock* NewBlock = BlockCache::Allocate(UncompressedBlockSize);
+				Reader->ReadAt(Block.GetOffset(), NewBlock->Data, UncompressedBlockSize);
+				CachedBlock = BlockCache::Add(Parent, BlockIndex, NewBlock);
+			}
+			else
+			{
+				byte* CompressedData;
+				if (!bEncrypted)
+				{
+					CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
+					Reader->ReadAt(Block.GetOffset(), CompressedData, CompressedBlockSize);
+				}
+				else
+				{
+					int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
+					CompressedData = (byte*)appMallocNoInit(EncryptedSize);
+					Reader->ReadAt(Block.GetOffset(), CompressedData, EncryptedSize);
+					FileRequiresAesKey();
+					Parent->DecryptDataBlock(CompressedData, EncryptedSize);
+				}
+				CCachedBlock* NewBlock = BlockCache::Allocate(UncompressedBlockSize);
+				if (CompressionMethodIndex)
+				{
+					// Compressed data
+					assert(CompressionMethodIndex <= Parent->NumCompressionMethods); // 0 = None is not counted, so "<=" is used here
+					int CompressionFlags = Parent->CompressionMethods[CompressionMethodIndex];
+					appDecompress(CompressedData, CompressedBlockSize, NewBlock->Data, UncompressedBlockSize, CompressionFlags, &Parent->DecompressCache);
+				}
+				else
+				{
+					// Uncompressed encrypted data
+					assert(CompressedBlockSize == UncompressedBlockSize);
+					memcpy(NewBlock->Data, CompressedData, UncompressedBlockSize);
+				}
 				appFree(CompressedData);
+				CachedBlock = BlockCache::Add(Parent, BlockIndex, NewBlock);
 			}
+			UncompressedBuffer = CachedBlock->Data;
 		}
 
 		// data is in buffer, copy it
-		int BytesToCopy = UncompressedBufferPos + Parent->CompressionBlockSize - ArPos; // number of bytes until end of the buffer
+		int BytesToCopy = UncompressedBufferPos + CachedBlock->Size - ArPos; // number of bytes until end of the buffer
 		if (BytesToCopy > size) BytesToCopy = size;
 		assert(BytesToCopy > 0);
 
@@ -427,6 +499,75 @@ void FIOStoreFile::Serialize(void *data, int size)
 	unguard;
 }
 
+int FIOStoreFile::DecompressBlocksTo(int FirstBlock, int NumBlocks, byte* Dest, int MaxSize)
+{
+	guard(FIOStoreFile::DecompressBlocksTo);
+
+	const FIoStoreTocCompressedBlockEntry* Blocks = &Parent->CompressionBlocks[FirstBlock];
+	bool bEncrypted = (Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)) != 0;
+	int DataAlign = bEncrypted ? EncryptionAlign : 1;
+
+	// Compressed blocks are stored sequentially, so we can fetch all of them with a single read
+	int64 ReadStart = Blocks[0].GetOffset();
+	int64 ReadEnd = ReadStart;
+	int TotalSize = 0;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		const FIoStoreTocCompressedBlockEntry& Block = Blocks[i];
+		if ((int64)Block.GetOffset() < ReadEnd || (int64)Block.GetOffset() - ReadEnd > 4096 ||
+			TotalSize + (int)Block.GetUncompressedSize() > MaxSize)
+		{
+			// Not a sequence, or the block is only partially requested: process only preceding blocks
+			NumBlocks = i;
+			break;
+		}
+		ReadEnd = Block.GetOffset() + Align(Block.GetCompressedSize(), DataAlign);
+		TotalSize += Block.GetUncompressedSize();
+	}
+	if (NumBlocks < 2)
+	{
+		// Let the caller to process the data block by block
+		return 0;
+	}
+
+	int ReadSize = int(ReadEnd - ReadStart);
+	byte* CompressedData = (byte*)appMallocNoInit(ReadSize);
+	Parent->Reader->ReadAt(ReadStart, CompressedData, ReadSize);
+	if (bEncrypted)
+	{
+		FileRequiresAesKey();
+	}
+
+	TStaticArray<CDecompressBlock, MaxBlocksPerRead> Tasks;
+	Tasks.AddUninitialized(NumBlocks);
+	int BytesDecompressed = 0;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		const FIoStoreTocCompressedBlockEntry& Block = Blocks[i];
+		CDecompressBlock& Task = Tasks[i];
+		Task.CompressedData = CompressedData + (Block.GetOffset() - ReadStart);
+		Task.CompressedSize = Block.GetCompressedSize();
+		Task.UncompressedData = Dest + BytesDecompressed;
+		Task.UncompressedSize = Block.GetUncompressedSize();
+		uint32 CompressionMethodIndex = Block.GetCompressionMethodIndex();
+		assert(CompressionMethodIndex <= Parent->NumCompressionMethods);
+		Task.CompressionMethod = CompressionMethodIndex ? Parent->CompressionMethods[CompressionMethodIndex] : 0;
+		Task.DecompressCache = &Parent->DecompressCache;
+		if (bEncrypted)
+		{
+			Parent->DecryptDataBlock(Task.CompressedData, Align(Task.CompressedSize, EncryptionAlign));
+		}
+		BytesDecompressed += Task.UncompressedSize;
+	}
+
+	DecompressBlocks(Tasks.GetData(), NumBlocks);
+	appFree(CompressedData);
+
+	return BytesDecompressed;
+
+	unguardf("blocks=%d+%d", FirstBlock, NumBlocks);
+}
+
 /*-----------------------------------------------------------------------------
 	FPackageId to CGameFileInfo map
 -----------------------------------------------------------------------------*/
@@ -498,6 +639,7 @@ FIOStoreFileSystem::FIOStoreFileSystem(const char* InFilename, bool InIsGlobalCo
 
 FIOStoreFileSystem::~FIOStoreFileSystem()
 {
+	BlockCache::RemoveContainer(this);
 	delete Reader;
 }
 
@@ -505,6 +647,11 @@ FIOStoreFileSystem::~FIOStoreFileSystem()
 static TArray<CGameFileInfo*> ChunkInfos;
 #endif
 
+bool FIOStoreFileSystem::IsEncrypted() const
+{
+	return (ContainerFlags & int(EIoContainerFlags::Encrypted)) != 0;
+}
+
 const FString& FIOStoreFileSystem::GetPakEncryptionKey() const
 {
 	if (!PakEncryptionKey.IsEmpty())
@@ -522,8 +669,12 @@ void FIOStoreFileSystem::DecryptDataBlock(byte* Data, int DataSize)
 {
 	guard(FIOStoreFileSystem::DecryptDataBlock);
 
-	const FString& Key = GetPakEncryptionKey();
-	appDecryptAES(Data, DataSize, &Key[0], Key.Len());
+	if (!AesKey.IsReady())
+	{
+		const FString& Key = GetPakEncryptionKey();
+		AesKey.Setup(&Key[0], Key.Len());
+	}
+	AesKey.Decrypt(Data, DataSize);
 
 	unguard;
 }
@@ -537,7 +688,7 @@ bool FIOStoreFileSystem::AttachReader(FArchive* reader, FString& error)
 	appStrncpyz(ContainerFileName, *Filename, ARRAY_COUNT(ContainerFileName));
 	char* ext = strrchr(ContainerFileName, '.') + 1;
 	strcpy(ext, "ucas");
-	FArchive* ContainerFile = new FFileReader(ContainerFileName, FAO_NoOpenError);
+	FFileReader* ContainerFile = new FFileReader(ContainerFileName, FAO_NoOpenError);
 	if (!ContainerFile->IsOpen())
 	{
 		delete ContainerFile;
@@ -589,6 +740,26 @@ bool FIOStoreFileSystem::AttachReader(FArchive* reader, FString& error)
 		unguard;
 	}
 
+	delete reader;
+	Reader = ContainerFile;
+	return true;
+
+	unguard;
+}
+
+void FIOStoreFileSystem::OnFileRegistered(int IndexInArchive, CGameFileInfo* info)
+{
+#if PRINT_CHUNKS
+	ChunkInfos[IndexInArchive] = info;
+#endif
+	if (info && info->IsPackage())
+	{
+		RegisterPackageId(ChunkIds[IndexInArchive].GetPackageId(), info);
+	}
+}
+
+void FIOStoreFileSystem::OnRegistrationFinished()
+{
 #if PRINT_CHUNKS
 	appPrintf("\n%d chunks\n\n", ChunkIds.Num());
 	for (int i = 0; i < ChunkIds.Num(); i++)
@@ -606,12 +777,6 @@ bool FIOStoreFileSystem::AttachReader(FArchive* reader, FString& error)
 		// We don't need ChunkIds here
 		ChunkIds.Empty();
 	}
-
-	delete reader;
-	Reader = ContainerFile;
-	return true;
-
-	unguard;
 }
 
 #define FLATTEN_RECURSE 1
@@ -651,7 +816,7 @@ void FIOStoreFileSystem::WalkDirectoryTreeRecursive(struct FIoDirectoryIndexReso
 		if (FileIndex != -1)
 		{
 			// Register the content folder
-			int FolderIndex = RegisterGameFolder(*DirectoryPath);
+			int FolderIndex = RegisterFolder(*DirectoryPath);
 
 			while (FileIndex != -1)
 			{
@@ -663,16 +828,9 @@ void FIOStoreFileSystem::WalkDirectoryTreeRecursive(struct FIoDirectoryIndexReso
 				reg.Size = ChunkLocations[File.UserData].GetLength();
 				reg.Flags = CGameFileInfo::GFI_IOStoreFile;
 				reg.IndexInArchive = File.UserData;
-				CGameFileInfo* file = RegisterFile(reg);
-#if PRINT_CHUNKS
-				ChunkInfos[File.UserData] = file;
-#endif
+				RegisterFile(reg);
 
 				FileIndex = File.NextFileEntry;
-				if (file->IsPackage())
-				{
-					RegisterPackageId(ChunkIds[File.UserData].GetPackageId(), file);
-				}
 			}
 		}
 
@@ -8,6 +8,7 @@ enum class EIoChunkType : uint8;
 struct FIoChunkId;
 struct FIoOffsetAndLength;
 struct FIoStoreTocCompressedBlockEntry;
+struct CCachedBlock;
 
 typedef uint64 FPackageId;
 
@@ -44,8 +45,13 @@ public:
 
 	enum { EncryptionAlign = 16 }; // AES-specific constant
 	enum { EncryptedBufferSize = 256 }; //?? TODO: check - may be value 16 will be better for performance
+	enum { MaxBlocksPerRead = 256 };	// limit for memory used by DecompressBlocksTo()
 
 protected:
+	// Decompress a sequence of container blocks directly to the destination buffer, not exceeding
+	// MaxSize bytes. Returns number of decompressed bytes.
+	int DecompressBlocksTo(int FirstBlock, int NumBlocks, byte* Dest, int MaxSize);
+
 	// File (chunk) info
 	FIOStoreFileSystem* Parent;
 	int32		FileIndex;
@@ -55,8 +61,9 @@ protected:
 	uint32		UncompressedSize;		// uncompressed size of the chunk
 
 	// Data for decompression
-	byte*		UncompressedBuffer;
+	byte*		UncompressedBuffer;		// points to CachedBlock's data
 	int			UncompressedBufferPos;	// buffer's position inside the chunk
+	CCachedBlock* CachedBlock;
 
 	bool		IsFileOpen;
 };
@@ -80,6 +87,8 @@ public:
 
 	static bool LoadGlobalContainer(const char* Filename);
 
+	bool IsEncrypted() const;
+
 	FString PakEncryptionKey;
 
 protected:
@@ -87,10 +96,13 @@ protected:
 
 	void DecryptDataBlock(byte* Data, int DataSize);
 
+	virtual void OnFileRegistered(int IndexInArchive, CGameFileInfo* info);
+	virtual void OnRegistrationFinished();
+
 	void WalkDirectoryTreeRecursive(struct FIoDirectoryIndexResource& IndexResource, int DirectoryIndex, const FString& ParentDirectory);
 
 	FString Filename;
-	FArchive* Reader;
+	FFileReader* Reader;
 
 	// utoc/ucas information
 	bool bIsGlobalContainer;
@@ -103,6 +115,8 @@ protected:
 	int CompressionMethods[MAX_COMPRESSION_METHODS];
 	uint64 PartitionSize;
 	uint32 PartitionCount;
+	CDecompressCache DecompressCache;	// used by appDecompress()
+	CAesKey AesKey;				// expanded on first use of DecryptDataBlock()
 };
 
 const CGameFileInfo* FindPackageById(FPackageId PackageId);
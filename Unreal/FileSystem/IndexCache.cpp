@@ -0,0 +1,273 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "IndexCache.h"
+
+#include "Parallel.h"
+
+#if _WIN32
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#else
+#	include <sys/stat.h>
+#endif
+
+#if UNREAL4
+
+#define INDEX_CACHE_MAGIC		0x58444955		// 'UIDX'
+// Should be incremented when format of the cache, or format of any container data is changed
+#define INDEX_CACHE_VERSION		1
+
+#define INDEX_CACHE_HASH_SIZE	1024
+#define INDEX_CACHE_HASH_MASK	(INDEX_CACHE_HASH_SIZE - 1)
+
+namespace IndexCache
+{
+
+struct CCacheEntry
+{
+	FString			Filename;
+	int64			FileSize;
+	int64			FileTime;
+	uint64			ScanTime;			// time spent for scanning this container without cache
+	TArray<byte>	Data;
+	bool			bUsed;				// should be saved with the next Save() call
+	int				HashNext;			// index in Entries array + 1, 0 for the end of list
+
+	friend FArchive& operator<<(FArchive& Ar, CCacheEntry& E)
+	{
+		return Ar << E.Filename << E.FileSize << E.FileTime << E.ScanTime << E.Data;
+	}
+};
+
+static FString CacheFilename;
+static TArray<CCacheEntry> Entries;
+static int EntriesHash[INDEX_CACHE_HASH_SIZE];	// index of the first entry + 1, or 0
+static bool bModified = false;
+
+// Statistics
+static int NumRestored = 0;
+static int NumScanned = 0;
+static uint64 TimeSaved = 0;
+static uint64 RestoreTime = 0;
+
+#if THREADING
+static CMutex CacheMutex;
+#define LOCK_CACHE()	CMutex::ScopedLock _Lock(CacheMutex)
+#else
+#define LOCK_CACHE()
+#endif
+
+static bool GetFileSizeAndTime(const char* Filename, int64& Size, int64& Time)
+{
+#if _WIN32
+	struct _stati64 buf;
+	if (_stati64(Filename, &buf) < 0) return false;
+#else
+	struct stat64 buf;
+	if (stat64(Filename, &buf) < 0) return false;
+#endif
+	Size = buf.st_size;
+	Time = buf.st_mtime;
+	return true;
+}
+
+static int GetHashForFilename(const char* Filename)
+{
+	uint32 hash = 0;
+	while (char c = *Filename++)
+	{
+		hash = hash * 33 + (byte)c;
+	}
+	return (hash ^ (hash >> 16)) & INDEX_CACHE_HASH_MASK;
+}
+
+static void ClearHash()
+{
+	memset(EntriesHash, 0, sizeof(EntriesHash));
+}
+
+static void AddEntryToHash(int Index)
+{
+	int hash = GetHashForFilename(*Entries[Index].Filename);
+	Entries[Index].HashNext = EntriesHash[hash];
+	EntriesHash[hash] = Index + 1;
+}
+
+static CCacheEntry* FindEntry(const char* Filename)
+{
+	for (int Next = EntriesHash[GetHashForFilename(Filename)]; Next; Next = Entries[Next - 1].HashNext)
+	{
+		CCacheEntry& E = Entries[Next - 1];
+		if (!strcmp(*E.Filename, Filename))
+			return &E;
+	}
+	return NULL;
+}
+
+void SetFilename(const char* Filename)
+{
+	CacheFilename = Filename ? Filename : "";
+}
+
+void Load()
+{
+	guard(IndexCache::Load);
+
+	Entries.Empty();
+	ClearHash();
+	bModified = false;
+	NumRestored = NumScanned = 0;
+	TimeSaved = RestoreTime = 0;
+
+	if (CacheFilename.IsEmpty()) return;
+
+	FFileReader Reader(*CacheFilename, FAO_NoOpenError);
+	if (!Reader.IsOpen()) return;
+
+	int64 FileSize = Reader.GetFileSize64();
+	int32 Magic = 0, Version = 0, PayloadSize = 0;
+	if (FileSize >= 12)
+		Reader << Magic << Version << PayloadSize;
+	if (Magic != INDEX_CACHE_MAGIC || Version != INDEX_CACHE_VERSION || PayloadSize != FileSize - 12)
+	{
+		// Different version, or the file was not completely written
+		appPrintf("Index cache %s is outdated, rebuilding\n", *CacheFilename);
+		bModified = true;
+		return;
+	}
+
+	TArray<byte> Payload;
+	Payload.SetNumUninitialized(PayloadSize);
+	Reader.Serialize(Payload.GetData(), PayloadSize);
+
+	FMemReader Ar(Payload.GetData(), PayloadSize);
+	Ar.Game = GAME_UE4_BASE;
+	Ar << Entries;
+	for (int Index = 0; Index < Entries.Num(); Index++)
+	{
+		Entries[Index].bUsed = false;
+		AddEntryToHash(Index);
+	}
+
+	unguardf("%s", *CacheFilename);
+}
+
+void Save()
+{
+	guard(IndexCache::Save);
+
+	if (CacheFilename.IsEmpty()) return;
+
+	// Drop containers which weren't found during the scan
+	for (int i = Entries.Num() - 1; i >= 0; i--)
+	{
+		if (!Entries[i].bUsed)
+		{
+			Entries.RemoveAt(i);
+			bModified = true;
+		}
+	}
+
+	if (bModified)
+	{
+		FMemWriter Writer;
+		Writer.Game = GAME_UE4_BASE;
+		Writer << Entries;
+
+		FFileWriter Ar(*CacheFilename, FAO_NoOpenError);
+		if (Ar.IsOpen())
+		{
+			int32 Magic = INDEX_CACHE_MAGIC, Version = INDEX_CACHE_VERSION;
+			int32 PayloadSize = Writer.GetData().Num();
+			Ar << Magic << Version << PayloadSize;
+			Ar.Serialize(const_cast<byte*>(Writer.GetData().GetData()), PayloadSize);
+		}
+		else
+		{
+			appPrintf("WARNING: unable to write index cache %s\n", *CacheFilename);
+		}
+	}
+
+	Entries.Empty();
+	ClearHash();
+	bModified = false;
+
+	unguardf("%s", *CacheFilename);
+}
+
+bool Find(const char* Filename, const byte*& Data, int& DataSize)
+{
+	LOCK_CACHE();
+
+	CCacheEntry* E = FindEntry(Filename);
+	if (!E) return false;
+
+	int64 FileSize, FileTime;
+	if (!GetFileSizeAndTime(Filename, FileSize, FileTime) || FileSize != E->FileSize || FileTime != E->FileTime)
+	{
+		// The file was changed
+		return false;
+	}
+
+	Data = E->Data.GetData();
+	DataSize = E->Data.Num();
+	return true;
+}
+
+void Restored(const char* Filename, uint64 Time)
+{
+	LOCK_CACHE();
+
+	CCacheEntry* E = FindEntry(Filename);
+	assert(E);
+	E->bUsed = true;
+
+	NumRestored++;
+	TimeSaved += E->ScanTime;
+	RestoreTime += Time;
+}
+
+void Add(const char* Filename, const TArray<byte>& Data, uint64 ScanTime)
+{
+	guard(IndexCache::Add);
+
+	if (CacheFilename.IsEmpty()) return;
+
+	LOCK_CACHE();
+
+	NumScanned++;
+
+	int64 FileSize, FileTime;
+	if (!GetFileSizeAndTime(Filename, FileSize, FileTime)) return;
+
+	CCacheEntry* E = FindEntry(Filename);
+	if (!E)
+	{
+		int Index = Entries.AddDefaulted();
+		E = &Entries[Index];
+		E->Filename = Filename;
+		AddEntryToHash(Index);
+	}
+	E->FileSize = FileSize;
+	E->FileTime = FileTime;
+	E->ScanTime = ScanTime;
+	CopyArrayView(E->Data, Data.GetData(), Data.Num());
+	E->bUsed = true;
+	bModified = true;
+
+	unguardf("%s", Filename);
+}
+
+void PrintStats()
+{
+	LOCK_CACHE();
+
+	if (!NumRestored) return;
+	float Saved = TimeSaved > RestoreTime ? (TimeSaved - RestoreTime) / 1000000.0f : 0.0f;
+	appPrintf("Index cache: %d containers restored, %d scanned, %.2f sec saved\n", NumRestored, NumScanned, Saved);
+}
+
+} // namespace IndexCache
+
+#endif // UNREAL4
@@ -0,0 +1,43 @@
+#ifndef __INDEX_CACHE_H__
+#define __INDEX_CACHE_H__
+
+#if UNREAL4
+
+// Persistent cache of pak file indices. Loading of a pak index requires reading, decrypting and
+// parsing of a large amount of data, what could take tens of seconds for large games. The cache
+// stores already parsed information, so it could be restored quickly on the next startup.
+// Each container is identified by its file name, size and modification time, so changed files
+// are always scanned again.
+
+namespace IndexCache
+{
+
+// Set name of the cache file. Empty or NULL name disables caching. Should be called before
+// appSetRootDirectory().
+void SetFilename(const char* Filename);
+
+// Load the cache file, called before scanning of game directory.
+void Load();
+
+// Save the cache file if it was changed, called after scanning of game directory.
+void Save();
+
+// Find data for the container. Returns false if there's no data, or when the file was changed.
+// Returned data is valid until Save() call.
+bool Find(const char* Filename, const byte*& Data, int& DataSize);
+
+// Notify that the container was successfully restored from the data returned by Find(). Time is
+// spent for restoring, in microseconds.
+void Restored(const char* Filename, uint64 Time);
+
+// Store data for the container. ScanTime is time spent for scanning the container without
+// cache, in microseconds.
+void Add(const char* Filename, const TArray<byte>& Data, uint64 ScanTime);
+
+void PrintStats();
+
+}
+
+#endif // UNREAL4
+
+#endif // __INDEX_CACHE_H__
@@ -4,6 +4,10 @@
 #include "FileSystemUtils.h"
 
 #include "UnArchivePak.h"
+#include "BlockCache.h"
+#include "IndexCache.h"
+
+#include "Parallel.h"
 
 #if UNREAL4
 
@@ -14,6 +18,15 @@
 // of pak files exceeding C library limitations (2048 files in msvcrt.dll).
 #define MAX_OPEN_PAKS		32
 
+#if THREADING
+// Pak files could be opened and closed from different threads, protect the list of open pak files.
+// Reading itself is done with positional reads and doesn't require locking.
+static CMutex OpenPaksMutex;
+#define LOCK_OPEN_PAKS()	CMutex::ScopedLock OpenPaksLock(OpenPaksMutex)
+#else
+#define LOCK_OPEN_PAKS()
+#endif
+
 FArchive& operator<<(FArchive& Ar, FPakInfo& P)
 {
 	// New FPakInfo fields.
@@ -275,6 +288,12 @@ FPakFile::~FPakFile()
 
 void FPakFile::Close()
 {
+	if (CachedBlock)
+	{
+		BlockCache::Release(CachedBlock);
+		CachedBlock = NULL;
+		UncompressedBuffer = NULL;
+	}
 	if (UncompressedBuffer)
 	{
 		appFree(UncompressedBuffer);
@@ -301,7 +320,7 @@ void FPakFile::Serialize(void *data, int size)
 		IsFileOpen = true;
 	}
 
-	FArchive* Reader = Parent->Reader;
+	FFileReader* Reader = Parent->Reader;
 
 	if (Info->CompressionMethod)
 	{
@@ -309,42 +328,70 @@ void FPakFile::Serialize(void *data, int size)
 
 		while (size > 0)
 		{
-			if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Info->CompressionBlockSize))
+			int BlockSize = Info->CompressionBlockSize;
+			if ((ArPos % BlockSize) == 0 && size >= BlockSize * 2)
+			{
+				// Large request which covers several whole blocks: decompress these blocks in parallel
+				// directly to the destination
+				int NumBlocks = size / BlockSize;
+				if (ArPos + size >= Info->UncompressedSize)
+				{
+					// Include the last (possibly incomplete) block of the file
+					NumBlocks = int((Info->UncompressedSize - ArPos + BlockSize - 1) / BlockSize);
+				}
+				if (NumBlocks > MaxBlocksPerRead) NumBlocks = MaxBlocksPerRead;
+				int BytesRead = DecompressBlocksTo(ArPos / BlockSize, NumBlocks, (byte*)data);
+
+				// advance pointers
+				ArPos += BytesRead;
+				size  -= BytesRead;
+				data  = OffsetPointer(data, BytesRead);
+				continue;
+			}
+
+			if ((CachedBlock == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + CachedBlock->Size))
 			{
 				// buffer is not ready
-				if (UncompressedBuffer == NULL)
+				if (CachedBlock)
 				{
-					UncompressedBuffer = (byte*)appMallocNoInit((int)Info->CompressionBlockSize); // size of uncompressed block
+					BlockCache::Release(CachedBlock);
+					CachedBlock = NULL;
 				}
 				// prepare buffer
 				int BlockIndex = ArPos / Info->CompressionBlockSize;
 				UncompressedBufferPos = Info->CompressionBlockSize * BlockIndex;
 
 				const FPakCompressedBlock& Block = Info->CompressionBlocks[BlockIndex];
-				int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
-				int UncompressedBlockSize = min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - UncompressedBufferPos); // don't pass file end
-				byte* CompressedData;
-				if (!Info->bEncrypted)
-				{
-					CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, CompressedBlockSize);
-				}
-				else
+				// Block position is unique inside the pak, use it as a cache key
+				CachedBlock = BlockCache::Find(Parent, Block.CompressedStart);
+				if (!CachedBlock)
 				{
-					int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
-					CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, EncryptedSize);
-					FileRequiresAesKey();
-					Parent->DecryptDataBlock(CompressedData, EncryptedSize);
+					int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
+					int UncompressedBlockSize = min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - UncompressedBufferPos); // don't pass file end
+					byte* CompressedData;
+					if (!Info->bEncrypted)
+					{
+						CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
+						Reader->ReadAt(Block.CompressedStart, CompressedData, CompressedBlockSize);
+					}
+					else
+					{
+						int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
+						CompressedData = (byte*)appMallocNoInit(EncryptedSize);
+						Reader->ReadAt(Block.CompressedStart, CompressedData, EncryptedSize);
+						FileRequiresAesKey();
+						Parent->DecryptDataBlock(CompressedData, EncryptedSize);
+					}
+					CCachedBlock* NewBlock = BlockCache::Allocate(UncompressedBlockSize);
+					appDecompress(CompressedData, CompressedBlockSize, NewBlock->Data, UncompressedBlockSize, Info->CompressionMethod, &Parent->DecompressCache);
+					appFree(CompressedData);
+					CachedBlock = BlockCache::Add(Parent, Block.CompressedStart, NewBlock);
 				}
-				appDecompress(CompressedData, CompressedBlockSize, UncompressedBuffer, UncompressedBlockSize, Info->CompressionMethod);
-				appFree(CompressedData);
+				UncompressedBuffer = CachedBlock->Data;
 			}
 
 			// data is in buffer, copy it
-			int BytesToCopy = UncompressedBufferPos + Info->CompressionBlockSize - ArPos; // number of bytes until end of the buffer
+			int BytesToCopy = UncompressedBufferPos + CachedBlock->Size - ArPos; // number of bytes until end of the buffer
 			if (BytesToCopy > size) BytesToCopy = size;
 			assert(BytesToCopy > 0);
 
@@ -372,17 +419,29 @@ void FPakFile::Serialize(void *data, int size)
 		}
 		while (size > 0)
 		{
+			if ((ArPos & (EncryptionAlign - 1)) == 0 && size >= EncryptedBufferSize)
+			{
+				// Large aligned request: read and decrypt the whole aligned part directly into destination
+				// buffer, and leave only the unaligned tail for buffered code below
+				int DirectSize = size & ~(EncryptionAlign - 1);
+				Reader->ReadAt(Info->Pos + Info->StructSize + ArPos, data, DirectSize);
+				FileRequiresAesKey();
+				Parent->DecryptDataBlock((byte*)data, DirectSize);
+				ArPos += DirectSize;
+				size  -= DirectSize;
+				data  = OffsetPointer(data, DirectSize);
+				continue;
+			}
 			if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + EncryptedBufferSize))
 			{
 				// Should fetch block and decrypt it.
 				// Note: AES is block encryption, so we should always align read requests for correct decryption.
 				UncompressedBufferPos = ArPos & ~(EncryptionAlign - 1);
-				Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
 				int RemainingSize = Info->Size - UncompressedBufferPos;
 				if (RemainingSize > EncryptedBufferSize)
 					RemainingSize = EncryptedBufferSize;
 				RemainingSize = Align(RemainingSize, EncryptionAlign); // align for AES, pak contains aligned data
-				Reader->Serialize(UncompressedBuffer, RemainingSize);
+				Reader->ReadAt(Info->Pos + Info->StructSize + UncompressedBufferPos, UncompressedBuffer, RemainingSize);
 				FileRequiresAesKey();
 				Parent->DecryptDataBlock(UncompressedBuffer, RemainingSize);
 			}
@@ -409,17 +468,116 @@ void FPakFile::Serialize(void *data, int size)
 		guard(SerializeUncompressed);
 
 		// Pure data
-		// seek every time in a case if the same 'Reader' was used by different FPakFile
-		// (this is a lightweight operation for buffered FArchive)
-		Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
-		Reader->Serialize(data, size);
-		ArPos += size;
+		// Use positional reads, because the same 'Reader' could be used by different FPakFile objects
+		// from different threads. Large blocks are read directly, small reads are buffered.
+		int64 DataPos = Info->Pos + Info->StructSize;
+		const byte* MappedData = Reader->GetMappedData(DataPos + ArPos, size);
+		if (MappedData)
+		{
+			// The pak is memory-mapped, no buffering required
+			memcpy(data, MappedData, size);
+			ArPos += size;
+		}
+		else if (size >= ReadBufferSize / 2)
+		{
+			Reader->ReadAt(DataPos + ArPos, data, size);
+			ArPos += size;
+		}
+		else
+		{
+			if (UncompressedBuffer == NULL)
+			{
+				UncompressedBuffer = (byte*)appMallocNoInit(ReadBufferSize);
+				UncompressedBufferPos = 0x40000000; // some invalid value
+			}
+			while (size > 0)
+			{
+				if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + ReadBufferSize))
+				{
+					UncompressedBufferPos = ArPos;
+					int RemainingSize = (int)(Info->Size - UncompressedBufferPos);
+					if (RemainingSize > ReadBufferSize)
+						RemainingSize = ReadBufferSize;
+					Reader->ReadAt(DataPos + UncompressedBufferPos, UncompressedBuffer, RemainingSize);
+				}
+
+				int BytesToCopy = UncompressedBufferPos + ReadBufferSize - ArPos; // number of bytes until end of the buffer
+				if (BytesToCopy > size) BytesToCopy = size;
+				assert(BytesToCopy > 0);
+
+				// copy data
+				int OffsetInBuffer = ArPos - UncompressedBufferPos;
+				memcpy(data, UncompressedBuffer + OffsetInBuffer, BytesToCopy);
+
+				// advance pointers
+				ArPos += BytesToCopy;
+				size  -= BytesToCopy;
+				data  = OffsetPointer(data, BytesToCopy);
+			}
+		}
 
 		unguard;
 	}
 	unguardf("file=%s", *Info->FileInfo->GetRelativeName());
 }
 
+int FPakFile::DecompressBlocksTo(int FirstBlock, int NumBlocks, byte* Dest)
+{
+	guard(FPakFile::DecompressBlocksTo);
+
+	const FPakCompressedBlock* Blocks = &Info->CompressionBlocks[FirstBlock];
+	int DataAlign = Info->bEncrypted ? EncryptionAlign : 1;
+
+	// Compressed blocks are usually stored sequentially, so we can fetch all of them with a single read
+	int64 ReadStart = Blocks[0].CompressedStart;
+	int64 ReadEnd = ReadStart;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		if (Blocks[i].CompressedStart < ReadEnd || Blocks[i].CompressedStart - ReadEnd > 4096)
+		{
+			// Not a sequence, process only preceding blocks
+			NumBlocks = i;
+			break;
+		}
+		ReadEnd = Blocks[i].CompressedStart + Align(Blocks[i].CompressedEnd - Blocks[i].CompressedStart, DataAlign);
+	}
+	assert(NumBlocks > 0);
+
+	int ReadSize = int(ReadEnd - ReadStart);
+	byte* CompressedData = (byte*)appMallocNoInit(ReadSize);
+	FFileReader* Reader = Parent->Reader;
+	Reader->ReadAt(ReadStart, CompressedData, ReadSize);
+
+	TStaticArray<CDecompressBlock, MaxBlocksPerRead> Tasks;
+	Tasks.AddUninitialized(NumBlocks);
+	int UncompressedPos = FirstBlock * Info->CompressionBlockSize;
+	int BytesDecompressed = 0;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		CDecompressBlock& Task = Tasks[i];
+		Task.CompressedData = CompressedData + (Blocks[i].CompressedStart - ReadStart);
+		Task.CompressedSize = int(Blocks[i].CompressedEnd - Blocks[i].CompressedStart);
+		Task.UncompressedData = Dest + BytesDecompressed;
+		Task.UncompressedSize = min((int)Info->CompressionBlockSize, int(Info->UncompressedSize - UncompressedPos)); // don't pass file end
+		Task.CompressionMethod = Info->CompressionMethod;
+		Task.DecompressCache = &Parent->DecompressCache;
+		if (Info->bEncrypted)
+		{
+			FileRequiresAesKey();
+			Parent->DecryptDataBlock(Task.CompressedData, Align(Task.CompressedSize, EncryptionAlign));
+		}
+		UncompressedPos += Task.UncompressedSize;
+		BytesDecompressed += Task.UncompressedSize;
+	}
+
+	DecompressBlocks(Tasks.GetData(), NumBlocks);
+	appFree(CompressedData);
+
+	return BytesDecompressed;
+
+	unguardf("file=%s, blocks=%d+%d", *Info->FileInfo->GetRelativeName(), FirstBlock, NumBlocks);
+}
+
 bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 {
 	int mainVer = 0, subVer = 0;
@@ -427,6 +585,15 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 	guard(FPakVFS::ReadDirectory);
 	PROFILE_LABEL(*Filename);
 
+	uint64 StartTime = appMicroseconds();
+	if (LoadFromIndexCache(reader))
+	{
+		IndexCache::Restored(*Filename, appMicroseconds() - StartTime);
+		PrintInfo(reader->ArLicenseeVer >> 4);
+		Reader->Close();
+		return true;
+	}
+
 	// Pak file may have different header sizes, try them all
 	static const int OffsetsToTry[] = { FPakInfo::Size, FPakInfo::Size8, FPakInfo::Size8a, FPakInfo::Size9 };
 	FPakInfo info;
@@ -496,13 +663,9 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 
 	if (result)
 	{
-		// Print statistics
-		appPrintf("Pak %s: %d files", *Filename, FileInfos.Num());
-		if (NumEncryptedFiles)
-			appPrintf(" (%d encrypted)", NumEncryptedFiles);
-		if (strcmp(*MountPoint, "/") != 0)
-			appPrintf(", mount point: \"%s\"", *MountPoint);
-		appPrintf(", version %d\n", info.Version);
+		// The index will be stored in cache when all files are registered
+		IndexScanTime = appMicroseconds() - StartTime;
+		PrintInfo(info.Version);
 	}
 
 	// Close the file handle
@@ -516,6 +679,179 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 	unguardf("PakVer=%d.%d", mainVer, subVer);
 }
 
+void FPakVFS::OnFileRegistered(int IndexInArchive, CGameFileInfo* info)
+{
+	FileInfos[IndexInArchive].FileInfo = info;
+}
+
+void FPakVFS::OnRegistrationFinished()
+{
+	if (IndexScanTime)
+	{
+		SaveToIndexCache(IndexScanTime);
+		IndexScanTime = 0;
+	}
+}
+
+void FPakVFS::PrintInfo(int Version) const
+{
+	// Print statistics
+	appPrintf("Pak %s: %d files", *Filename, FileInfos.Num());
+	if (NumEncryptedFiles)
+		appPrintf(" (%d encrypted)", NumEncryptedFiles);
+	if (strcmp(*MountPoint, "/") != 0)
+		appPrintf(", mount point: \"%s\"", *MountPoint);
+	appPrintf(", version %d\n", Version);
+}
+
+// Identify the encryption key without storing it in the cache
+static int32 GetAesKeyHash(const FString& Key)
+{
+	uint32 Hash = 0x811C9DC5;
+	for (int i = 0; i < Key.Len(); i++)
+		Hash = (Hash ^ (byte)Key[i]) * 0x01000193;
+	return Hash | 1;				// zero value means "no key"
+}
+
+// Decoded FPakEntry data stored in the index cache
+static void SerializeCachedEntry(FArchive& Ar, FPakEntry& E)
+{
+	Ar << E.Pos << E.Size << E.UncompressedSize << E.CompressionMethod << E.CompressionBlockSize;
+	Ar << E.CompressionBlocks << E.bEncrypted << E.StructSize;
+}
+
+bool FPakVFS::LoadFromIndexCache(FArchive* reader)
+{
+	guard(FPakVFS::LoadFromIndexCache);
+
+	const byte* Data;
+	int DataSize;
+	if (!IndexCache::Find(*Filename, Data, DataSize))
+		return false;
+
+	FMemReader Ar(Data, DataSize);
+	Ar.Game = GAME_UE4_BASE;
+
+	int32 PakVersion, KeyHash;
+	Ar << PakVersion << KeyHash;
+	if (KeyHash)
+	{
+		// The pak has encrypted index, find a key which was used for it
+		for (const FString& Key : GAesKeys)
+		{
+			if (GetAesKeyHash(Key) == KeyHash)
+			{
+				PakEncryptionKey = Key;
+				break;
+			}
+		}
+		// Fall back to regular loading when the key is not available, it will report an error
+		if (PakEncryptionKey.IsEmpty())
+			return false;
+	}
+
+	TArray<FString> Folders;
+	int32 count;
+	Ar << MountPoint << NumEncryptedFiles << Folders << count;
+
+	assert(reader->IsA("FFileReader"));
+	Reader = static_cast<FFileReader*>(reader);
+	Reader->ArLicenseeVer = PakVersion;
+
+	// Folders are registered in order of their first use, like with regular index loading
+	TArray<int> FolderIndices;
+	FolderIndices.AddZeroed(Folders.Num());
+
+	FileInfos.AddZeroed(count);
+	Reserve(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		FPakEntry& E = FileInfos[i];
+		int32 Folder;
+		FStaticString<MAX_PACKAGE_PATH> ShortFilename;
+		Ar << Folder << ShortFilename;
+		SerializeCachedEntry(Ar, E);
+
+		if (Folder >= 0)
+		{
+			int& FolderIndex = FolderIndices[Folder];
+			if (!FolderIndex)
+				FolderIndex = RegisterFolder(*Folders[Folder]);
+
+			// Register the file
+			CRegisterFileInfo reg;
+			reg.Filename = *ShortFilename;
+			reg.FolderIndex = FolderIndex;
+			reg.Size = E.UncompressedSize;
+			reg.IndexInArchive = i;
+			RegisterFile(reg);
+		}
+	}
+
+	return true;
+
+	unguardf("%s", *Filename);
+}
+
+void FPakVFS::SaveToIndexCache(uint64 ScanTime)
+{
+	guard(FPakVFS::SaveToIndexCache);
+
+	// Build a list of used folders, map global folder index to index in this list
+	TArray<FString> Folders;
+	TArray<int> FolderMap;
+	FolderMap.Init(-1, appGetGameFolderCount());
+	TArray<int> FileFolders;
+	FileFolders.AddUninitialized(FileInfos.Num());
+
+	for (int i = 0; i < FileInfos.Num(); i++)
+	{
+		const CGameFileInfo* File = FileInfos[i].FileInfo;
+		// Files with unsupported types are not registered
+		int Folder = -1;
+		if (File)
+		{
+			Folder = FolderMap[File->FolderIndex];
+			if (Folder < 0)
+			{
+				Folder = FolderMap[File->FolderIndex] = Folders.Num();
+				Folders.Add(File->GetPath());
+			}
+		}
+		FileFolders[i] = Folder;
+	}
+
+	FMemWriter Ar;
+	Ar.Game = GAME_UE4_BASE;
+
+	int32 PakVersion = Reader->ArLicenseeVer;
+	int32 KeyHash = PakEncryptionKey.IsEmpty() ? 0 : GetAesKeyHash(PakEncryptionKey);
+	int32 count = FileInfos.Num();
+	Ar << PakVersion << KeyHash << MountPoint << NumEncryptedFiles << Folders << count;
+
+	for (int i = 0; i < count; i++)
+	{
+		FPakEntry& E = FileInfos[i];
+		FString ShortFilename;
+		if (E.FileInfo)
+			E.FileInfo->GetCleanName(ShortFilename);
+		Ar << FileFolders[i] << ShortFilename;
+		SerializeCachedEntry(Ar, E);
+	}
+
+	IndexCache::Add(*Filename, Ar.GetData(), ScanTime);
+
+	unguardf("%s", *Filename);
+}
+
+FPakVFS::~FPakVFS()
+{
+	BlockCache::RemoveContainer(this);
+	delete Reader;
+//	if (HashTable) delete[] HashTable;
+}
+
 // FPakVFS objects which has Reader open, but no active files (MRU)
 static TStaticArray<FPakVFS*, MAX_OPEN_PAKS>  VFSWithOpenReaders;
 
@@ -533,6 +869,7 @@ FArchive* FPakVFS::CreateReader(int index)
 void FPakVFS::FileOpened()
 {
 	guard(FPakVFS::FileOpened);
+	LOCK_OPEN_PAKS();
 
 	if (NumOpenFiles++ == 0)
 	{
@@ -558,6 +895,7 @@ void FPakVFS::FileOpened()
 void FPakVFS::FileClosed()
 {
 	guard(FPakVFS::FileClosed);
+	LOCK_OPEN_PAKS();
 
 	assert(NumOpenFiles > 0);
 	if (--NumOpenFiles == 0)
@@ -664,8 +1002,12 @@ void FPakVFS::DecryptDataBlock(byte* Data, int DataSize)
 {
 	guard(FPakVFS::DecryptDataBlock);
 
-	const FString& Key = GetPakEncryptionKey();
-	appDecryptAES(Data, DataSize, &Key[0], Key.Len());
+	if (!AesKey.IsReady())
+	{
+		const FString& Key = GetPakEncryptionKey();
+		AesKey.Setup(&Key[0], Key.Len());
+	}
+	AesKey.Decrypt(Data, DataSize);
 
 	unguard;
 }
@@ -687,7 +1029,8 @@ bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString
 	}
 
 	// this file looks correct, store 'reader'
-	Reader = reader;
+	assert(reader->IsA("FFileReader"));
+	Reader = static_cast<FFileReader*>(reader);
 
 	// Read pak index
 	FMemReader InfoReader(InfoBlock.GetData(), info.IndexSize);
@@ -761,7 +1104,7 @@ bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString
 		reg.Filename = *CombinedPath;
 		reg.Size = E.UncompressedSize;
 		reg.IndexInArchive = i;
-		E.FileInfo = RegisterFile(reg);
+		RegisterFile(reg);
 
 		unguardf("Index=%d/%d", i, count);
 	}
@@ -799,7 +1142,8 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 	}
 
 	// this file looks correct, store 'reader'
-	Reader = reader;
+	assert(reader->IsA("FFileReader"));
+	Reader = static_cast<FFileReader*>(reader);
 
 	// Read pak index
 	FMemReader InfoReader(InfoBlock.GetData(), info.IndexSize);
@@ -937,7 +1281,7 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 		int FolderIndex = -1;
 		if (NumFilesInDirectory)
 		{
-			FolderIndex = RegisterGameFolder(*DirectoryPath);
+			FolderIndex = RegisterFolder(*DirectoryPath);
 		}
 
 		for (int DirectoryFileIndex = 0; DirectoryFileIndex < NumFilesInDirectory; DirectoryFileIndex++)
@@ -983,7 +1327,7 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 			reg.FolderIndex = FolderIndex;
 			reg.Size = E.UncompressedSize;
 			reg.IndexInArchive = FileIndex;
-			E.FileInfo = RegisterFile(reg);
+			RegisterFile(reg);
 
 			FileIndex++;
 			unguard;
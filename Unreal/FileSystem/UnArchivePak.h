@@ -98,6 +98,7 @@ struct FPakEntry
 };
 
 class FPakVFS;
+struct CCachedBlock;
 
 class FPakFile : public FArchive
 {
@@ -107,6 +108,7 @@ public:
 	:	Info(info)
 	,	Parent(parent)
 	,	UncompressedBuffer(NULL)
+	,	CachedBlock(NULL)
 	,	IsFileOpen(true)
 	{}
 
@@ -136,12 +138,19 @@ public:
 
 	enum { EncryptionAlign = 16 }; // AES-specific constant
 	enum { EncryptedBufferSize = 256 }; //?? TODO: check - may be value 16 will be better for performance
+	enum { ReadBufferSize = 4096 };		// buffer for small reads of uncompressed data
+	enum { MaxBlocksPerRead = 256 };	// limit for memory used by DecompressBlocksTo()
 
 protected:
+	// Decompress a sequence of blocks directly to the destination buffer. Returns number of
+	// decompressed bytes.
+	int DecompressBlocksTo(int FirstBlock, int NumBlocks, byte* Dest);
+
 	FPakVFS*	Parent;
 	const FPakEntry* Info;
 	byte*		UncompressedBuffer;
 	int			UncompressedBufferPos;
+	CCachedBlock* CachedBlock;			// decompressed block, UncompressedBuffer points to its data
 	bool		IsFileOpen;
 };
 
@@ -157,13 +166,10 @@ public:
 //	,	HashTable(NULL)
 	,	NumEncryptedFiles(0)
 	,	NumOpenFiles(0)
+	,	IndexScanTime(0)
 	{}
 
-	virtual ~FPakVFS()
-	{
-		delete Reader;
-//		if (HashTable) delete[] HashTable;
-	}
+	virtual ~FPakVFS();
 
 	virtual bool AttachReader(FArchive* reader, FString& error);
 
@@ -171,14 +177,25 @@ public:
 
 	const FString& GetPakEncryptionKey() const;
 
+	bool HasEncryptedFiles() const
+	{
+		return NumEncryptedFiles > 0;
+	}
+
 protected:
 	FString				Filename;
-	FArchive*			Reader;
+	FFileReader*		Reader;
 	TArray<FPakEntry>	FileInfos;
 	FStaticString<MAX_PACKAGE_PATH> MountPoint;
 	int					NumEncryptedFiles;
 	int					NumOpenFiles;
 	FString				PakEncryptionKey;
+	CDecompressCache	DecompressCache;		// used by appDecompress()
+	CAesKey				AesKey;					// expanded on first use of DecryptDataBlock()
+	uint64				IndexScanTime;			// non-zero when the index should be stored in IndexCache
+
+	virtual void OnFileRegistered(int IndexInArchive, CGameFileInfo* info);
+	virtual void OnRegistrationFinished();
 
 	// Called when some FPakFile has been opened
 	void FileOpened();
@@ -193,6 +210,12 @@ protected:
 
 	bool DecryptPakIndex(TArray<byte>& IndexData, FString& ErrorString);
 
+	// Persistent index cache support, see IndexCache.h
+	bool LoadFromIndexCache(FArchive* reader);
+	void SaveToIndexCache(uint64 ScanTime);
+
+	void PrintInfo(int Version) const;
+
 	void DecryptDataBlock(byte* Data, int DataSize);
 
 #if 0
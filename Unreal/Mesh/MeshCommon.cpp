@@ -4,9 +4,168 @@
 #include "MeshCommon.h"
 #include "UnrealMesh/UnMathTools.h"		// CVertexShare
 #include "UnrealMaterial/UnMaterial.h"
+#include "Parallel.h"
 
 #define STRIP_BINORMAL		1
 
+/*-----------------------------------------------------------------------------
+	CVertexShare
+-----------------------------------------------------------------------------*/
+
+#define WELD_PARALLEL_MIN_VERTS		65536	// smaller meshes are welded in a single thread
+#define WELD_NUM_PARTITIONS			64		// number of hash table parts processed independently
+
+void CVertexShare::Prepare(const CMeshVertex *Verts, int NumVerts, int VertexSize)
+{
+	WedgeIndex = 0;
+	Points.Empty(NumVerts);
+	Normals.Empty(NumVerts);
+	ExtraInfos.Empty(NumVerts);
+	WedgeToVert.Empty(NumVerts);
+	VertToWedge.Empty(NumVerts);
+	VertToWedge.AddZeroed(NumVerts);
+	// hash table with approximately one vertex per bucket
+	int HashSize = WELD_NUM_PARTITIONS * 16;
+	while (HashSize < NumVerts)
+		HashSize <<= 1;
+	HashMask = HashSize - 1;
+	Hash.Init(-1, HashSize);
+	HashNext.Empty(NumVerts);
+}
+
+void CVertexShare::WeldVertices(const CMeshVertex *Verts, int NumVerts, int VertexSize, const uint32* ExtraInfo, bool UseNormals)
+{
+	guard(CVertexShare::WeldVertices);
+
+#define VERT(n)		OffsetPointer(Verts, (n) * VertexSize)
+
+	Prepare(Verts, NumVerts, VertexSize);
+
+	auto GetNormal = [Verts, VertexSize, UseNormals](int i) -> CPackedNormal
+	{
+		CPackedNormal Normal;
+		Normal.Data = UseNormals ? VERT(i)->Normal.Data & 0xFFFFFF : 0;
+		return Normal;
+	};
+
+	bool bParallel = NumVerts >= WELD_PARALLEL_MIN_VERTS;
+#if THREADING
+	// Parallel algorithm does more work, it is 2x slower than AddVertex() when executed in a single thread
+	if (CThread::GetLogicalCPUCount() < 2) bParallel = false;
+#else
+	bParallel = false;
+#endif
+	if (!bParallel)
+	{
+		for (int i = 0; i < NumVerts; i++)
+		{
+			AddVertex(VERT(i)->Position, GetNormal(i), ExtraInfo ? ExtraInfo[i] : 0);
+		}
+		return;
+	}
+
+	// Compute hashes of all vertices
+	TArray<uint32> VertHash;
+	VertHash.AddUninitialized(NumVerts);
+	ParallelFor(NumVerts, [&](int i)
+		{
+			VertHash[i] = GetHash(VERT(i)->Position, GetNormal(i), ExtraInfo ? ExtraInfo[i] : 0) & HashMask;
+		});
+
+	// Hash table is split into partitions by bucket index, so every partition has its own set of
+	// chains and could be processed in a separate thread. Sort vertices by partition, keeping the
+	// original order inside each partition.
+	int PartitionShift = 0;
+	while ((Hash.Num() >> PartitionShift) > WELD_NUM_PARTITIONS)
+		PartitionShift++;
+	int PartitionStart[WELD_NUM_PARTITIONS + 1];
+	memset(PartitionStart, 0, sizeof(PartitionStart));
+	for (int i = 0; i < NumVerts; i++)
+	{
+		PartitionStart[(VertHash[i] >> PartitionShift) + 1]++;
+	}
+	for (int i = 1; i <= WELD_NUM_PARTITIONS; i++)
+	{
+		PartitionStart[i] += PartitionStart[i - 1];
+	}
+	TArray<int> SortedVerts;
+	SortedVerts.AddUninitialized(NumVerts);
+	{
+		int PartitionPos[WELD_NUM_PARTITIONS];
+		memcpy(PartitionPos, PartitionStart, sizeof(PartitionPos));
+		for (int i = 0; i < NumVerts; i++)
+		{
+			SortedVerts[PartitionPos[VertHash[i] >> PartitionShift]++] = i;
+		}
+	}
+
+	// For every vertex find the first vertex with the same data. Chains are built from vertex
+	// indices here and contain only unique vertices.
+	TArray<int> FirstVert, VertNext;
+	FirstVert.AddUninitialized(NumVerts);
+	VertNext.AddUninitialized(NumVerts);
+	ParallelForSlow(WELD_NUM_PARTITIONS, [&](int Partition)
+		{
+			for (int n = PartitionStart[Partition]; n < PartitionStart[Partition + 1]; n++)
+			{
+				int i = SortedVerts[n];
+				int h = VertHash[i];
+				const CMeshVertex* V = VERT(i);
+				CPackedNormal Normal = GetNormal(i);
+				uint32 Extra = ExtraInfo ? ExtraInfo[i] : 0;
+				int Index;
+				for (Index = Hash[h]; Index >= 0; Index = VertNext[Index])
+				{
+					if (VERT(Index)->Position == V->Position && GetNormal(Index) == Normal && (ExtraInfo ? ExtraInfo[Index] : 0) == Extra)
+						break;
+				}
+				if (Index < 0)
+				{
+					// new unique vertex
+					VertNext[i] = Hash[h];
+					Hash[h] = i;
+					Index = i;
+				}
+				FirstVert[i] = Index;
+			}
+		});
+
+	// Create points in the same order as AddVertex() does. VertHash is reused for vertex to point mapping.
+	TArray<uint32>& VertToPoint = VertHash;
+	for (int i = 0; i < NumVerts; i++)
+	{
+		int PointIndex;
+		int First = FirstVert[i];
+		if (First == i)
+		{
+			PointIndex = Points.Add(VERT(i)->Position);
+			Normals.Add(GetNormal(i));
+			ExtraInfos.Add(ExtraInfo ? ExtraInfo[i] : 0);
+			// earlier vertex in the chain already has a point
+			HashNext.Add(VertNext[i] >= 0 ? VertToPoint[VertNext[i]] : -1);
+		}
+		else
+		{
+			PointIndex = VertToPoint[First];
+		}
+		VertToPoint[i] = PointIndex;
+		WedgeToVert.Add(PointIndex);
+		VertToWedge[PointIndex] = i;
+	}
+	WedgeIndex = NumVerts;
+
+	// Convert hash table to point indices, so AddVertex() could still be used
+	for (int& Index : Hash)
+	{
+		if (Index >= 0) Index = VertToPoint[Index];
+	}
+
+#undef VERT
+
+	unguard;
+}
+
+
 // WARNING for BuildNnnCommon functions: do not access Verts[i] directly, use VERT macro only!
 #define VERT(n)		OffsetPointer(Verts, (n) * VertexSize)
 
@@ -22,13 +181,7 @@ void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const
 	TArray<CVec3> tmpNorm;
 	tmpNorm.AddZeroed(NumVerts);					// really will use Points.Num() items, which value is smaller than NumVerts
 	CVertexShare Share;
-	Share.Prepare(Verts, NumVerts, VertexSize);
-	for (i = 0; i < NumVerts; i++)
-	{
-		CPackedNormal NullVec;
-		NullVec.Data = 0;
-		Share.AddVertex(VERT(i)->Position, NullVec);
-	}
+	Share.WeldVertices(Verts, NumVerts, VertexSize, NULL, false);
 
 	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
 	for (i = 0; i < Indices.Num() / 3; i++)
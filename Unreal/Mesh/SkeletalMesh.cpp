@@ -2,6 +2,7 @@
 #include "UnCore.h"
 #include "UnObject.h"		// for typeinfo
 #include "SkeletalMesh.h"
+#include "Parallel.h"
 
 
 /*-----------------------------------------------------------------------------
@@ -320,12 +321,46 @@ static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
 }
 
 
+// Key search continuing from the previous result. Used only for strictly increasing time arrays: for them
+// FindTimeKey() always returns the last key with KeyTime[Key] <= Frame (or 0), so the result doesn't depend
+// on the search method. Other arrays, and moving backwards in time, are handled with FindTimeKey().
+static int FindTimeKey(const TArray<float> &KeyTime, float Frame, int &LastKey, int8 &IsSorted)
+{
+	int NumKeys = KeyTime.Num();
+	if (IsSorted < 0)
+	{
+		IsSorted = 1;
+		for (int i = 1; i < NumKeys; i++)
+		{
+			if (!(KeyTime[i - 1] < KeyTime[i]))
+			{
+				IsSorted = 0;
+				break;
+			}
+		}
+	}
+
+	if (!IsSorted || LastKey < 0 || LastKey >= NumKeys || Frame != Frame || (LastKey > 0 && Frame < KeyTime[LastKey]))
+	{
+		LastKey = FindTimeKey(KeyTime, Frame);
+		return LastKey;
+	}
+
+	int Key = LastKey;
+	while (Key + 1 < NumKeys && KeyTime[Key + 1] <= Frame)
+		Key++;
+	LastKey = Key;
+	return Key;
+}
+
+
 // In:  KeyTime, Frame, NumFrames, Loop
 // Out: X - previous key index, Y - next key index, F - fraction between keys
-static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
+static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F,
+	CAnimTrackCursor* Cursor, int CursorKey)
 {
 	guard(GetKeyParams);
-	X = FindTimeKey(KeyTime, Frame);
+	X = Cursor ? FindTimeKey(KeyTime, Frame, Cursor->LastKey[CursorKey], Cursor->IsSorted[CursorKey]) : FindTimeKey(KeyTime, Frame);
 	Y = X + 1;
 	int NumTimeKeys = KeyTime.Num();
 	if (Y >= NumTimeKeys)
@@ -353,7 +388,7 @@ static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFra
 
 
 // not 'static', because used in ExportPsa()
-void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat, CAnimTrackCursor* Cursor) const
 {
 	guard(CAnimTrack::GetBonePosition);
 
@@ -380,7 +415,7 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 		assert(NumPosKeys <= 1 || NumPosKeys == NumTimeKeys);
 		assert(NumRotKeys == 1 || NumRotKeys == NumTimeKeys);
 
-		GetKeyParams(KeyTime, Frame, NumFrames, Loop, posX, posY, posF);
+		GetKeyParams(KeyTime, Frame, NumFrames, Loop, posX, posY, posF, Cursor, CAnimTrackCursor::KEY_Time);
 		rotX = posX;
 		rotY = posY;
 		rotF = posF;
@@ -402,7 +437,7 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 		// note: KeyPos and KeyQuat sizes can be different
 		if (KeyPosTime.Num())
 		{
-			GetKeyParams(KeyPosTime, Frame, NumFrames, Loop, posX, posY, posF);
+			GetKeyParams(KeyPosTime, Frame, NumFrames, Loop, posX, posY, posF, Cursor, CAnimTrackCursor::KEY_PosTime);
 		}
 		else if (NumPosKeys > 1)
 		{
@@ -429,7 +464,7 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 
 		if (KeyQuatTime.Num())
 		{
-			GetKeyParams(KeyQuatTime, Frame, NumFrames, Loop, rotX, rotY, rotF);
+			GetKeyParams(KeyQuatTime, Frame, NumFrames, Loop, rotX, rotY, rotF, Cursor, CAnimTrackCursor::KEY_QuatTime);
 		}
 		else if (NumRotKeys > 1)
 		{
@@ -482,3 +517,160 @@ void CAnimTrack::CopyFrom(const CAnimTrack &Src)
 	CopyArray(KeyScaleTime, Src.KeyScaleTime);
 #endif
 }
+
+
+/*-----------------------------------------------------------------------------
+	CAnimSequence
+-----------------------------------------------------------------------------*/
+
+int GAnimTracksBudget = 0;
+
+// AnimTracksMutex protects LRU list and lock counts only. Decoding is done without it, under a
+// per-sequence lock, so different sequences are decoded in parallel.
+#if THREADING
+static CMutex AnimTracksMutex;
+#define LOCK_ANIM_TRACKS()		CMutex::ScopedLock AnimLock(AnimTracksMutex)
+#define NUM_DECODE_MUTEXES		64
+static CMutex AnimDecodeMutexes[NUM_DECODE_MUTEXES];
+#define LOCK_ANIM_DECODE(Seq)	CMutex::ScopedLock DecodeLock(AnimDecodeMutexes[((size_t)(Seq) >> 4) % NUM_DECODE_MUTEXES])
+#else
+#define LOCK_ANIM_TRACKS()
+#define LOCK_ANIM_DECODE(Seq)
+#endif
+
+// Sequences with decoded tracks which could be released, the most recently used one is the last
+static TArray<const CAnimSequence*> DecodedSequences;
+static size_t DecodedTracksMemory = 0;
+
+static size_t GetTracksMemory(const TArray<CAnimTrack*>& Tracks)
+{
+	size_t Size = Tracks.Num() * (sizeof(CAnimTrack*) + sizeof(CAnimTrack));
+	for (const CAnimTrack* Track : Tracks)
+	{
+		Size += Track->KeyQuat.Num() * sizeof(CQuat) + Track->KeyPos.Num() * sizeof(CVec3)
+			+ (Track->KeyTime.Num() + Track->KeyQuatTime.Num() + Track->KeyPosTime.Num()) * sizeof(float);
+#if SUPPORT_SCALE_KEYS
+		Size += Track->KeyScale.Num() * sizeof(CVec3) + Track->KeyScaleTime.Num() * sizeof(float);
+#endif
+	}
+	return Size;
+}
+
+CAnimSequence::~CAnimSequence()
+{
+	if (Decoder)
+	{
+		LOCK_ANIM_TRACKS();
+		ReleaseTracks();
+	}
+	for (int i = 0; i < Tracks.Num(); i++)
+	{
+		delete Tracks[i];
+	}
+}
+
+// Call decoder, and don't leave partially decoded tracks if it fails
+static void DecodeTracks(AnimTrackDecoder Decoder, const UObject* Owner, CAnimSequence& Seq)
+{
+	TRY {
+		Decoder(Owner, Seq);
+	} CATCH {
+		for (int i = 0; i < Seq.Tracks.Num(); i++)
+		{
+			delete Seq.Tracks[i];
+		}
+		Seq.Tracks.Empty();
+		THROW_AGAIN;
+	}
+}
+
+// Should be called with locked AnimTracksMutex
+bool CAnimSequence::LockDecodedTracks() const
+{
+	if (!bTracksDecoded) return false;
+
+	TracksLockCount++;
+	// Mark as the most recently used sequence
+	if (DecodedSequences[DecodedSequences.Num() - 1] != this)
+	{
+		DecodedSequences.RemoveSingle(this);
+		DecodedSequences.Add(this);
+	}
+	return true;
+}
+
+void CAnimSequence::LockTracks() const
+{
+	// Sequences without decoder has tracks filled at load time
+	if (!Decoder) return;
+
+	guard(CAnimSequence::LockTracks);
+
+	{
+		LOCK_ANIM_TRACKS();
+		if (LockDecodedTracks()) return;
+	}
+
+	// Only one thread decodes the sequence, others are waiting here. Tracks which aren't decoded
+	// are not in DecodedSequences list, so they couldn't be released by other threads.
+	LOCK_ANIM_DECODE(this);
+	{
+		LOCK_ANIM_TRACKS();
+		if (LockDecodedTracks()) return;		// decoded while we were waiting
+	}
+
+	CAnimSequence* Self = const_cast<CAnimSequence*>(this);
+	DecodeTracks(Decoder, DecoderOwner, *Self);
+
+	LOCK_ANIM_TRACKS();
+	TracksLockCount++;
+	bTracksDecoded = true;
+	TracksMemory = GetTracksMemory(Tracks);
+	DecodedTracksMemory += TracksMemory;
+	DecodedSequences.Add(this);
+
+	if (GAnimTracksBudget > 0)
+	{
+		// Release least recently used sequences which are not locked
+		size_t Budget = (size_t)GAnimTracksBudget << 20;
+		for (int i = 0; i < DecodedSequences.Num() && DecodedTracksMemory > Budget; /* empty */)
+		{
+			const CAnimSequence* Seq = DecodedSequences[i];
+			if (Seq->TracksLockCount)
+			{
+				i++;
+				continue;
+			}
+			Seq->ReleaseTracks();		// this will remove DecodedSequences[i]
+		}
+	}
+
+	unguardf("%s", *Name);
+}
+
+void CAnimSequence::UnlockTracks() const
+{
+	if (!Decoder) return;
+
+	LOCK_ANIM_TRACKS();
+	assert(TracksLockCount > 0);
+	TracksLockCount--;
+}
+
+// Should be called with locked AnimTracksMutex
+void CAnimSequence::ReleaseTracks() const
+{
+	if (!bTracksDecoded) return;
+
+	CAnimSequence* Self = const_cast<CAnimSequence*>(this);
+	for (int i = 0; i < Tracks.Num(); i++)
+	{
+		delete Tracks[i];
+	}
+	Self->Tracks.Empty();
+
+	DecodedTracksMemory -= TracksMemory;
+	TracksMemory = 0;
+	bTracksDecoded = false;
+	DecodedSequences.RemoveSingle(this);
+}
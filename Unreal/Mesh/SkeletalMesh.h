@@ -232,6 +232,32 @@ private:
 */
 
 
+// Sampling position inside CAnimTrack. Makes key search amortized O(1) when frames are sampled
+// in increasing order (e.g. during export), results are the same as without the cursor.
+struct CAnimTrackCursor
+{
+	enum
+	{
+		KEY_Time,
+		KEY_PosTime,
+		KEY_QuatTime,
+		KEY_Count
+	};
+
+	int						LastKey[KEY_Count];		// key found with previous call, -1 when unknown
+	int8					IsSorted[KEY_Count];	// -1 when not checked yet
+
+	CAnimTrackCursor()
+	{
+		Reset();
+	}
+	void Reset()
+	{
+		memset(LastKey, -1, sizeof(LastKey));
+		memset(IsSorted, -1, sizeof(IsSorted));
+	}
+};
+
 struct CAnimTrack
 {
 	TStaticArray<CQuat, 1>	KeyQuat;
@@ -249,7 +275,8 @@ struct CAnimTrack
 #endif
 
 	// DstPos and/or DstQuat will not be changed when KeyPos and/or KeyQuat are empty.
-	void GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const;
+	// Cursor is optional, it should be used with a single track only.
+	void GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat, CAnimTrackCursor* Cursor = NULL) const;
 
 	inline bool HasKeys() const
 	{
@@ -270,6 +297,12 @@ struct CSkeletonBonePosition
 	CQuat Orientation;
 };
 
+class CAnimSequence;
+
+// Function which fills CAnimSequence::Tracks from the compressed data of the original object.
+// 'Owner' is an object which has created the sequence (UAnimSet, USkeleton).
+typedef void (*AnimTrackDecoder)(const UObject* Owner, CAnimSequence& Dst);
+
 class CAnimSequence
 {
 public:
@@ -287,17 +320,59 @@ public:
 	CAnimSequence(const UObject* Original = NULL)
 	: bAdditive(false)
 	, OriginalSequence(Original)
+	, Decoder(NULL)
+	, DecoderOwner(NULL)
+	, bTracksDecoded(false)
+	, TracksLockCount(0)
+	, TracksMemory(0)
 	{}
 
-	~CAnimSequence()
+	~CAnimSequence();
+
+	// Defer decompression of Tracks until the sequence is sampled or exported. Decoded tracks
+	// could be released later when the animation memory budget is exceeded.
+	void SetDecoder(AnimTrackDecoder InDecoder, const UObject* Owner)
 	{
-		for (int i = 0; i < Tracks.Num(); i++)
-		{
-			delete Tracks[i];
-		}
+		Decoder = InDecoder;
+		DecoderOwner = Owner;
 	}
+
+	// Decode Tracks when needed and protect them from being released until UnlockTracks() call.
+	// Tracks array should not be accessed without the lock when the sequence has a decoder.
+	void LockTracks() const;
+	void UnlockTracks() const;
+
+protected:
+	bool LockDecodedTracks() const;
+	void ReleaseTracks() const;
+
+	AnimTrackDecoder		Decoder;
+	const UObject*			DecoderOwner;
+	mutable bool			bTracksDecoded;
+	mutable int				TracksLockCount;
+	mutable size_t			TracksMemory;
 };
 
+// Scoped CAnimSequence::LockTracks(), accepts NULL sequence
+class CAnimTracksLock
+{
+public:
+	CAnimTracksLock(const CAnimSequence* InSeq)
+	: Seq(InSeq)
+	{
+		if (Seq) Seq->LockTracks();
+	}
+	~CAnimTracksLock()
+	{
+		if (Seq) Seq->UnlockTracks();
+	}
+protected:
+	const CAnimSequence* Seq;
+};
+
+// Maximal amount of memory used by decoded animation tracks, in megabytes. 0 means no limit.
+extern int GAnimTracksBudget;
+
 
 enum class EAnimRetargetingMode
 {
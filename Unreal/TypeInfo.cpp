@@ -4,6 +4,8 @@
 
 #include "UnObject.h"		// dumping UObject in a few places
 
+#include "Parallel.h"
+
 #define MAX_CLASSES		256
 #define MAX_ENUMS		32
 #define MAX_SUPPRESSED_CLASSES 32
@@ -20,9 +22,12 @@ static int GClassCount = 0;
 static const char* GSuppressedClasses[MAX_SUPPRESSED_CLASSES];
 static int GSuppressedClassCount = 0;
 
+static void InvalidateClassRegistry();
+
 void RegisterClasses(const CClassInfo* Table, int Count)
 {
 	if (Count <= 0) return;
+	InvalidateClassRegistry();
 	assert(GClassCount + Count < ARRAY_COUNT(GClasses));
 	for (int i = 0; i < Count; i++)
 	{
@@ -53,6 +58,7 @@ void RegisterClasses(const CClassInfo* Table, int Count)
 
 void UnregisterClass(const char* Name, bool WholeTree)
 {
+	InvalidateClassRegistry();
 	for (int i = 0; i < GClassCount; i++)
 		if (!strcmp(GClasses[i].Name + 1, Name) ||
 			(WholeTree && (GClasses[i].TypeInfo()->IsA(Name))))
@@ -84,6 +90,134 @@ void SuppressUnknownClass(const char* ClassNameWildcard)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Class registry
+-----------------------------------------------------------------------------*/
+
+// The registry is an immutable snapshot of the class table with hashes for quick lookup by name.
+// It is rebuilt when class table is changed, normally only once after all classes are registered
+// (see BuildClassRegistry). The class table is changed only at startup or between loading sessions,
+// when no other thread is looking for classes, so the replaced snapshot is freed on rebuild.
+
+#define CLASS_HASH_SIZE			1024		// should be larger than MAX_CLASSES
+#define CLASS_HASH_MASK			(CLASS_HASH_SIZE - 1)
+
+struct CClassRegistry
+{
+	struct CClassEntry
+	{
+		const char*		Name;
+		const CTypeInfo* Type;
+	};
+
+	TArray<CClassEntry>	Classes;
+	// Indices in Classes array, -1 for empty slot
+	int16				ClassNameHash[CLASS_HASH_SIZE];		// for 'Name + 1', case-insensitive
+	int16				StructNameHash[CLASS_HASH_SIZE];	// for full 'Name', case-insensitive
+
+	static FORCEINLINE uint32 GetNameHash(const char* Name)
+	{
+		// Case-insensitive FNV-1a
+		uint32 Hash = 0x811C9DC5;
+		while (char c = *Name++)
+		{
+			if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+			Hash = (Hash ^ (byte)c) * 0x01000193;
+		}
+		return Hash;
+	}
+
+	const CClassEntry* FindClass(const char* Name, bool ClassType) const
+	{
+		const int16* Table = ClassType ? ClassNameHash : StructNameHash;
+		for (uint32 i = GetNameHash(Name); ; i++)
+		{
+			int Index = Table[i & CLASS_HASH_MASK];
+			if (Index < 0) return NULL;
+			const CClassEntry& Entry = Classes[Index];
+			if (stricmp(ClassType ? Entry.Name + 1 : Entry.Name, Name) == 0)
+				return &Entry;
+		}
+	}
+
+	void Build()
+	{
+		memset(ClassNameHash, 0xFF, sizeof(ClassNameHash));
+		memset(StructNameHash, 0xFF, sizeof(StructNameHash));
+
+		// Class table. When there're several classes with the same name, the first one is used, as
+		// it was with linear search.
+		Classes.Empty(GClassCount);
+		for (int i = 0; i < GClassCount; i++)
+		{
+			if (!GClasses[i].TypeInfo) appError("No typeinfo for class");
+			CClassEntry& Entry = Classes[Classes.AddUninitialized()];
+			Entry.Name = GClasses[i].Name;
+			Entry.Type = GClasses[i].TypeInfo();
+			for (int pass = 0; pass < 2; pass++)
+			{
+				int16* Table = pass == 0 ? ClassNameHash : StructNameHash;
+				const char* Name = pass == 0 ? Entry.Name + 1 : Entry.Name;
+				for (uint32 h = GetNameHash(Name); ; h++)
+				{
+					int16& Slot = Table[h & CLASS_HASH_MASK];
+					if (Slot < 0)
+					{
+						Slot = i;
+						break;
+					}
+					const CClassEntry& Other = Classes[Slot];
+					if (!stricmp(pass == 0 ? Other.Name + 1 : Other.Name, Name))
+						break;
+				}
+			}
+		}
+	}
+};
+
+static CClassRegistry* volatile GClassRegistry = NULL;
+static volatile bool GClassRegistryValid = false;
+#if THREADING
+static CMutex GClassRegistryMutex;
+#endif
+
+static void InvalidateClassRegistry()
+{
+	GClassRegistryValid = false;
+}
+
+void BuildClassRegistry()
+{
+	guard(BuildClassRegistry);
+
+#if THREADING
+	CMutex::ScopedLock Lock(GClassRegistryMutex);
+#endif
+	if (GClassRegistryValid) return;
+
+	CClassRegistry* Registry = new CClassRegistry;
+	Registry->Build();
+#if THREADING
+	appMemoryBarrier();
+#endif
+	CClassRegistry* OldRegistry = GClassRegistry;
+	GClassRegistry = Registry;
+	GClassRegistryValid = true;
+	delete OldRegistry;
+#if DEBUG_TYPES
+	appPrintf("Class registry: %d classes\n", Registry->Classes.Num());
+#endif
+
+	unguard;
+}
+
+static FORCEINLINE const CClassRegistry* GetClassRegistry()
+{
+	if (!GClassRegistryValid)
+		BuildClassRegistry();
+	return GClassRegistry;
+}
+
 // todo: 'ClassType' probably should be dropped
 const CTypeInfo* FindClassType(const char* Name, bool ClassType)
 {
@@ -91,20 +225,11 @@ const CTypeInfo* FindClassType(const char* Name, bool ClassType)
 #if DEBUG_TYPES
 	appPrintf("--- find %s %s ... ", ClassType ? "class" : "struct", Name);
 #endif
-	for (int i = 0; i < GClassCount; i++)
+	// skip 1st char only for ClassType==true?
+	const CClassRegistry::CClassEntry* Entry = GetClassRegistry()->FindClass(Name, ClassType);
+	if (Entry)
 	{
-		// skip 1st char only for ClassType==true?
-		if (ClassType)
-		{
-			if (stricmp(GClasses[i].Name + 1, Name) != 0) continue;
-		}
-		else
-		{
-			if (stricmp(GClasses[i].Name, Name) != 0) continue;
-		}
-
-		if (!GClasses[i].TypeInfo) appError("No typeinfo for class");
-		const CTypeInfo *Type = GClasses[i].TypeInfo();
+		const CTypeInfo *Type = Entry->Type;
 		// FindUnversionedProp() calls FindStructType for classes and structs, so disable the comparison for now
 		// if (Type->IsClass() != ClassType) continue;
 #if DEBUG_TYPES
@@ -294,6 +294,9 @@ struct CClassInfo
 void RegisterClasses(const CClassInfo* Table, int Count);
 void UnregisterClass(const char* Name, bool WholeTree = false);
 void SuppressUnknownClass(const char* ClassNameWildcard);
+// Prepare lookup tables for FindClassType(). Should be called after all classes are registered,
+// otherwise tables will be rebuilt on the first use.
+void BuildClassRegistry();
 
 const CTypeInfo* FindClassType(const char* Name, bool ClassType = true);
 bool IsSuppressedClass(const char* Name);
@@ -496,33 +496,62 @@ void FString::TrimStartAndEndInline()
 	FName (string) pool
 -----------------------------------------------------------------------------*/
 
-#define STRING_HASH_SIZE		(65536*4)		// 1Mb of 32-bit pointers
+#define STRING_HASH_BITS		18
+#define STRING_HASH_SIZE		(1 << STRING_HASH_BITS)		// 1Mb of 32-bit pointers
+
+// The hash table is split into shards, each shard owns a contiguous range of hash buckets, a lock and
+// a memory pool. Lookup of an existing string doesn't require any locks: new entries are fully set up
+// before being linked into the collision chain, and entries are never removed. The lock is taken only
+// when a string should be added to the pool, so threads adding different strings rarely wait for each other.
+#define STRING_POOL_SHARD_BITS	6
+#define NUM_STRING_POOL_SHARDS	(1 << STRING_POOL_SHARD_BITS)
 
 struct CStringPoolEntry
 {
-	CStringPoolEntry*	HashNext;
+	CStringPoolEntry* volatile HashNext;
 	uint16				Length;
 	char				Str[1];
 };
 
-static CStringPoolEntry* StringHashTable[STRING_HASH_SIZE];
-static CMemoryChain* StringPool;
-
+struct CStringPoolShard
+{
+	CMemoryChain*		Pool;
+	int					NumStrings;
+	int					MemoryUsed;
+	int					NumLocks;				// number of lock acquisitions
+	int					NumContentions;			// number of times the lock was held by another thread
 #if THREADING
-static CMutex GStrdupPoolMutex;
+	CMutex				Mutex;
 #endif
+	// Keep shards in separate cache lines
+	char				Padding[64];
+};
 
-const char* appStrdupPool(const char* str)
+static CStringPoolEntry* volatile StringHashTable[STRING_HASH_SIZE];
+static CStringPoolShard StringPoolShards[NUM_STRING_POOL_SHARDS];
+
+static FORCEINLINE const char* FindPoolString(CStringPoolEntry* volatile* prevPoint, const char* str, int len, CStringPoolEntry* volatile*& insertPoint)
 {
-	int len = strlen(str);
-#if 0
-	unsigned int hash = 0;
-	for (int i = 0; i < len; i++)
+	while (true)
 	{
-		char c = str[i];
-		hash = ROL32(hash, 1) + c;
+		CStringPoolEntry* current = *prevPoint;
+		// Keep items sorted by string length - it is almost free, but will
+		// allow faster rejection during search.
+		if (!current || current->Length > len) break;
+		if (current->Length == len && !memcmp(str, current->Str, len))
+		{
+			// Found a string
+			return current->Str;
+		}
+		prevPoint = &current->HashNext;
 	}
-#else
+	insertPoint = prevPoint;
+	return NULL;
+}
+
+const char* appStrdupPool(const char* str)
+{
+	int len = strlen(str);
 	// The FNV Non-Cryptographic Hash Algorithm
 	// https://tools.ietf.org/html/draft-eastlake-fnv-16
 	// It produces much better has collision distribution and smaller
@@ -534,122 +563,94 @@ const char* appStrdupPool(const char* str)
 	{
 		hash = FNV32prime * (hash ^ *s);
 	}
-
-#endif
 	hash &= (STRING_HASH_SIZE - 1);
 
-#if THREADING
-	// Make appStrdupPool thread-safe
-	CMutex::ScopedLock Lock(GStrdupPoolMutex);
-#endif
+	// Find existing string in a pool, without locking
+	CStringPoolEntry* volatile* prevPoint;
+	const char* found = FindPoolString(&StringHashTable[hash], str, len, prevPoint);
+	if (found) return found;
 
-	// Find existing string in a pool
-	CStringPoolEntry** prevPoint = &StringHashTable[hash];
-	while (true)
+	CStringPoolShard& Shard = StringPoolShards[hash >> (STRING_HASH_BITS - STRING_POOL_SHARD_BITS)];
+
+#if THREADING
+	if (!Shard.Mutex.TryLock())
 	{
-		CStringPoolEntry* current = *prevPoint;
-		// Keep items sorted by string length - it is almost free, but will
-		// allow faster rejection during search.
-		if (!current || current->Length > len) break;
-		if (current->Length == len && !memcmp(str, current->Str, len))
-		{
-			// Found a string
-			return current->Str;
-		}
-		prevPoint = &current->HashNext;
+		Shard.Mutex.Lock();
+		Shard.NumContentions++;
+	}
+	Shard.NumLocks++;
+	// The string could be added by another thread while we didn't hold the lock, so repeat
+	// the search. It is enough to scan from the previously found place because the list is sorted.
+	found = FindPoolString(prevPoint, str, len, prevPoint);
+	if (found)
+	{
+		Shard.Mutex.Unlock();
+		return found;
 	}
+#endif
 
-	if (!StringPool) StringPool = new CMemoryChain();
+	if (!Shard.Pool) Shard.Pool = new CMemoryChain();
 
 	// Allocate new string from pool
-	CStringPoolEntry* n = (CStringPoolEntry*)StringPool->Alloc(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
+	int size = sizeof(CStringPoolEntry) + len;		// note: null byte is taken into account in CStringPoolEntry
+	CStringPoolEntry* n = (CStringPoolEntry*)Shard.Pool->Alloc(size);
 	n->Length = len;
 	memcpy(n->Str, str, len+1);
-	// Insert into the hash collision chain
 	n->HashNext = *prevPoint;
+	Shard.NumStrings++;
+	Shard.MemoryUsed += size;
+#if THREADING
+	// Make the entry visible to other threads only after it was filled
+	appMemoryBarrier();
+#endif
+	// Insert into the hash collision chain
 	*prevPoint = n;
 
+#if THREADING
+	Shard.Mutex.Unlock();
+#endif
+
 	return n->Str;
 }
 
-#if 0
-void PrintStringHashDistribution()
+void appPrintStringPoolStats()
 {
-	int totalCount = 0;
-	uint32 memoryUsed = sizeof(StringHashTable);
-	int hashCounts[1024];
-	int* bucketSizes = new int[STRING_HASH_SIZE];
-	memset(hashCounts, 0, sizeof(hashCounts));
-	memset(bucketSizes, 0, sizeof(bucketSizes));
+	int NumStrings = 0, NumLocks = 0, NumContentions = 0;
+	size_t MemoryUsed = sizeof(StringHashTable), MemoryAllocated = sizeof(StringHashTable);
+	int MaxShardStrings = 0;
+	for (int i = 0; i < NUM_STRING_POOL_SHARDS; i++)
+	{
+		CStringPoolShard& Shard = StringPoolShards[i];
+#if THREADING
+		CMutex::ScopedLock Lock(Shard.Mutex);
+#endif
+		NumStrings += Shard.NumStrings;
+		NumLocks += Shard.NumLocks;
+		NumContentions += Shard.NumContentions;
+		MemoryUsed += Shard.MemoryUsed;
+		if (Shard.Pool) MemoryAllocated += Shard.Pool->GetSize();
+		MaxShardStrings = max(MaxShardStrings, Shard.NumStrings);
+	}
+	if (!NumStrings) return;
 
-	// Collect statistics
+	// Hash distribution
+	int NumChains = 0, MaxChain = 0;
 	for (int hash = 0; hash < STRING_HASH_SIZE; hash++)
 	{
 		int count = 0;
-		for (CStringPoolEntry* info = StringHashTable[hash]; info; info = info->HashNext)
-		{
+		for (const CStringPoolEntry* info = StringHashTable[hash]; info; info = info->HashNext)
 			count++;
-			memoryUsed += sizeof(CStringPoolEntry) + info->Length;
-		}
-		assert(count < ARRAY_COUNT(hashCounts));
-		hashCounts[count]++;
-		bucketSizes[hash] = count;
-		totalCount += count;
+		if (count) NumChains++;
+		MaxChain = max(MaxChain, count);
 	}
 
-	// Print statistics
-	FILE* f = fopen("StringTableInfo.txt", "w");
-	fprintf(f, "%d strings, %.2f Mb used\n", totalCount, memoryUsed / (1024.0f * 1024.0f));
-	fprintf(f, "String hash distribution: collision count -> num chains\n");
-	int totalCount2 = 0;
-	for (int i = 0; i < ARRAY_COUNT(hashCounts); i++)
-	{
-		int count = hashCounts[i];
-		if (count > 0)
-		{
-			totalCount2 += count * i;
-			float percent = totalCount2 * 100.0f / totalCount;
-			fprintf(f, "%d -> %d [%.1f%%]\n", i, count, percent);
-		}
-	}
-	fclose(f);
-	assert(totalCount == totalCount2);
-
-	// Store string table to a file
-	f = fopen("StringTable.txt", "w");
-	// Sort by bucket sizes
-	for (int i = ARRAY_COUNT(hashCounts) - 1; i > 0; i--)
-	{
-		if (hashCounts[i] == 0) continue; // no buckets of this size
-
-		for (int hash = 0; hash < STRING_HASH_SIZE; hash++)
-		{
-			if (bucketSizes[hash] != i) continue;
-			fprintf(f, "# bucket %d items\n", i);
-			TStaticArray<const CStringPoolEntry*, 1024> Entries;
-			for (CStringPoolEntry* info = StringHashTable[hash]; info; info = info->HashNext)
-			{
-				Entries.Add(info);
-			}
-			Entries.Sort([](const CStringPoolEntry* const& A, const CStringPoolEntry* const& B) -> int
-				{
-					int Diff = A->Length - B->Length;
-					if (Diff) return Diff; // note: already have items sorted by string length
-					return stricmp(A->Str, B->Str);
-				});
-			for (const CStringPoolEntry* info : Entries)
-			{
-				fprintf(f, "%s\n", info->Str);
-			}
-			fprintf(f, "\n");
-		}
-	}
-	fclose(f);
-
-	// Cleanup
-	delete[] bucketSizes;
+	appPrintf("String pool: %d strings, %.2f MBytes used, %.2f MBytes allocated, %d shards (max %d strings per shard)\n",
+		NumStrings, MemoryUsed / (1024.0f * 1024.0f), MemoryAllocated / (1024.0f * 1024.0f),
+		NUM_STRING_POOL_SHARDS, MaxShardStrings);
+	appPrintf("String pool locks: %d acquisitions, %d contended\n", NumLocks, NumContentions);
+	appPrintf("String hash: %d of %d buckets used, %.2f strings per used bucket, longest chain %d\n",
+		NumChains, STRING_HASH_SIZE, (float)NumStrings / NumChains, MaxChain);
 }
-#endif
 
 
 /*-----------------------------------------------------------------------------
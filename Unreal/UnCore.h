@@ -252,6 +252,8 @@ extern const char *GStartupPackage;
 -----------------------------------------------------------------------------*/
 
 const char* appStrdupPool(const char* str);
+// Print string pool memory and locking statistics
+void appPrintStringPoolStats();
 
 class FName
 {
@@ -867,6 +869,7 @@ public:
 
 	virtual void Serialize(void *data, int size);
 	virtual bool Open();
+	virtual void Close();
 	virtual void Seek(int Pos);
 	virtual void Seek64(int64 Pos);
 	virtual int Tell() const;
@@ -874,11 +877,25 @@ public:
 	virtual int64 GetFileSize64() const;
 	virtual bool IsEof() const;
 
+	// Read data from the specified position without affecting the archive position and buffer.
+	// Could be used from multiple threads simultaneously, while the file is kept open.
+	void ReadAt(int64 Pos, void* data, int size);
+
+	// Large files are memory-mapped when opened. Returns pointer to the file data when the file is
+	// mapped, or NULL otherwise. Returned memory is valid until the file is closed.
+	FORCEINLINE const byte* GetMappedData(int64 Pos, int size) const
+	{
+		if (!MappedData || Pos < 0 || Pos + size > MappedSize) return NULL;
+		return MappedData + Pos;
+	}
+
 protected:
 	int64		SeekPos;
 	int64		FileSize;
 	int			BufferBytesLeft;
 	int			LocalReadPos;
+	const byte*	MappedData;		// when not NULL, 'Buffer' points to a window inside of this memory
+	int64		MappedSize;
 };
 
 
@@ -2606,12 +2623,17 @@ struct FByteBulkData //?? separate FUntypedBulkData
 	void SerializeHeader(FArchive &Ar);
 	void SerializeData(FArchive &Ar);
 	bool SerializeData(const UObject* MainObj) const;
+	// Load the first bulk record of MainObj, and following records when they're stored right after
+	// it in the same file (e.g. texture mips) - these are read with a single Serialize() call.
+	// Returns false when the first record couldn't be loaded.
+	static bool SerializeData(const UObject* MainObj, const FByteBulkData* const* Bulks, int NumBulks);
 	// main functions
 	void Serialize(FArchive &Ar);
 	void Skip(FArchive &Ar);
 
 protected:
 	void SerializeDataChunk(FArchive &Ar);
+	bool CanBatchRead() const;
 };
 
 struct FWordBulkData : public FByteBulkData
@@ -2664,7 +2686,76 @@ struct FIntBulkData : public FByteBulkData
 #define PKG_UnversionedProperties	0x00002000		// UE4.25+
 #define PKG_FilterEditorOnly		0x80000000		// UE4
 
-int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags);
+// Per-container storage for appDecompress(): compression method detected with the first block, which is
+// used then for all other blocks of the same container, and the decompressor resolved for the container,
+// so it is not looked up for every block. Could be shared by threads decompressing the same container.
+struct CDecompressCache
+{
+	int				DetectedFlags;
+	volatile int	Resolved;		// compression flags and decompressor index, packed to be updated atomically
+
+	CDecompressCache()
+	:	DetectedFlags(0)
+	,	Resolved(0)
+	{}
+};
+
+// Decompress a block of data. When Flags is COMPRESS_FIND, compression method is detected using the data.
+// Cache is an optional per-container storage, see CDecompressCache.
+int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags, CDecompressCache* Cache = NULL);
+
+// Base class for decompression methods. Global objects of derived classes are automatically registered
+// and used by appDecompress(). Decompress() could be called from different threads simultaneously.
+class CDecompressor
+{
+public:
+	CDecompressor(const char* InName, int InFlags);
+
+	// Returns size of decompressed data
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize) = 0;
+
+	static CDecompressor* Find(int Flags);
+
+	static void PrintStats();
+
+	const char*		Name;
+	int				Flags;			// one of COMPRESS_... constants
+	int				Index;			// index in registration order
+
+	// Statistics, updated with atomic operations
+	volatile int32	NumBlocks;
+	volatile int64	CompressedBytes;
+	volatile int64	UncompressedBytes;
+	volatile int64	Time;			// in microseconds, collected only in PROFILE builds
+
+	enum { MAX_DECOMPRESSORS = 32 };
+
+protected:
+	CDecompressor*	Next;
+	static CDecompressor* First;
+
+	static CDecompressor* Registered[MAX_DECOMPRESSORS];
+	static int		NumRegistered;
+
+	friend int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags, CDecompressCache* Cache);
+};
+
+// Game-specific processing of compressed data (usually decryption) performed before decompression.
+// Global objects of derived classes are automatically registered.
+class CDecompressFilter
+{
+public:
+	CDecompressFilter();
+
+	// Process compressed data in place, returns compression flags which should be used for decompression
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags) = 0;
+
+	static int ApplyAll(byte *CompressedBuffer, int CompressedSize, int Flags);
+
+protected:
+	CDecompressFilter* Next;
+	static CDecompressFilter* First;
+};
 
 // UE4 has built-in AES encryption
 
@@ -2673,6 +2764,32 @@ extern TArray<FString> GAesKeys;
 // Decrypt with arbitrary key
 void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen = -1);
 
+// Expanded AES-256 key. Key expansion is relatively expensive, so containers which are decrypting
+// many small blocks should set up the key once and reuse it. AES-NI instructions are used when
+// supported by the CPU.
+struct CAesKey
+{
+	CAesKey()
+	:	bReady(false)
+	{}
+
+	// Expand the key. Thread-safe, does nothing if the key is already set up.
+	void Setup(const char* Key, int KeyLen = -1);
+
+	// Returns true when the key was set up, and the key schedule is visible to the calling thread.
+	bool IsReady() const;
+
+	// Decrypt data in ECB mode, Size should be a multiple of 16.
+	void Decrypt(byte* Data, int Size) const;
+
+protected:
+	unsigned long	rk[60];				// rijndael key schedule, RKLENGTH(256) items
+	byte			RoundKeys[15*16];	// AES-NI decryption round keys
+	int				NumRounds;
+	bool			bUseAESNI;
+	volatile bool	bReady;
+};
+
 // Callback called when encrypted pak file is attempted to load
 bool UE4EncryptedPak();
 
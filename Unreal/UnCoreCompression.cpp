@@ -6,6 +6,8 @@
 
 #include "UnCore.h"
 
+#include "Parallel.h"
+
 // includes for package decompression
 #include "lzo/lzo1x.h"
 #include <zlib.h>
@@ -214,41 +216,57 @@ typedef size_t (__stdcall *OodleDecompress_t)(
 	void* mem, size_t memSize,
 	int unk2);
 
-static bool bOodleLoaded = false;
+static volatile bool bOodleLoaded = false;
 static HMODULE hOodleDll = NULL;
 static OodleDecompress_t OodleLZ_Decompress = NULL;
 
-static void appDecompressOodle(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
+#if THREADING
+static CMutex OodleLoadMutex;
+#endif
+
+static void LoadOodleDll()
 {
-	guard(appDecompressOodle);
+	guard(LoadOodleDll);
 
-	if (!bOodleLoaded)
-	{
-		// Find the dll
-		// Try loading from default path(s) first
-		hOodleDll = LoadLibrary(OodleDllName);
+#if THREADING
+	CMutex::ScopedLock Lock(OodleLoadMutex);
+#endif
+	if (bOodleLoaded) return;	// loaded by another thread
+
+	// Find the dll
+	// Try loading from default path(s) first
+	hOodleDll = LoadLibrary(OodleDllName);
 
-		if (!hOodleDll)
+	if (!hOodleDll)
+	{
+		static const char* SearchPaths[] =
 		{
-			static const char* SearchPaths[] =
-			{
-				".", ".\\libs"
-			};
-			for (const char* Path : SearchPaths)
-			{
-				hOodleDll = LoadLibrary(va("%s\\%s", Path, OodleDllName));
-				if (hOodleDll) break;
-			}
+			".", ".\\libs"
+		};
+		for (const char* Path : SearchPaths)
+		{
+			hOodleDll = LoadLibrary(va("%s\\%s", Path, OodleDllName));
+			if (hOodleDll) break;
 		}
+	}
 
-		if (!hOodleDll)
-			appErrorNoLog("Internal Oodle decompressor failed, %s not found", OodleDllName);
+	if (!hOodleDll)
+		appErrorNoLog("Internal Oodle decompressor failed, %s not found", OodleDllName);
 
-		OodleLZ_Decompress = (OodleDecompress_t)GetProcAddress(hOodleDll, OodleFuncName);
-		assert(OodleLZ_Decompress != NULL);
+	OodleLZ_Decompress = (OodleDecompress_t)GetProcAddress(hOodleDll, OodleFuncName);
+	assert(OodleLZ_Decompress != NULL);
 
-		bOodleLoaded = true;
-	}
+	bOodleLoaded = true;
+
+	unguard;
+}
+
+static void appDecompressOodle(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
+{
+	guard(appDecompressOodle);
+
+	if (!bOodleLoaded)
+		LoadOodleDll();
 
 	size_t ret = OodleLZ_Decompress(CompressedBuffer, CompressedSize, UncompressedBuffer, UncompressedSize,
 		true, false, 1, NULL, 0, NULL, NULL, NULL, 0, 0);
@@ -269,136 +287,133 @@ inline void appDecompressOodle(byte *CompressedBuffer, int CompressedSize, byte
 #endif
 
 /*-----------------------------------------------------------------------------
-	appDecompress()
+	Decompressors
 -----------------------------------------------------------------------------*/
 
-// Decryptors for compressed data
-void DecryptBladeAndSoul(byte* CompressedBuffer, int CompressedSize);
-void DecryptTaoYuan(byte* CompressedBuffer, int CompressedSize);
-void DecryptDevlsThird(byte* CompressedBuffer, int CompressedSize);
-
-static int FoundCompression = -1;
-
-static int DetectCompressionMethod(byte* CompressedBuffer)
+CDecompressor* CDecompressor::First = NULL;
+CDecompressor* CDecompressor::Registered[CDecompressor::MAX_DECOMPRESSORS];
+int CDecompressor::NumRegistered = 0;
+
+CDecompressor::CDecompressor(const char* InName, int InFlags)
+:	Name(InName)
+,	Flags(InFlags)
+,	NumBlocks(0)
+,	CompressedBytes(0)
+,	UncompressedBytes(0)
+,	Time(0)
 {
-	int Flags = 0;
+	// Register the decompressor
+	Next = First;
+	First = this;
+	assert(NumRegistered < MAX_DECOMPRESSORS);
+	Index = NumRegistered;
+	Registered[NumRegistered++] = this;
+}
 
-	byte b1 = CompressedBuffer[0];
-	byte b2 = CompressedBuffer[1];
-	// zlib:
-	//   http://tools.ietf.org/html/rfc1950
-	//   http://stackoverflow.com/questions/9050260/what-does-a-zlib-header-look-like
-	// oodle:
-	//   https://github.com/powzix/ooz, kraken.cpp, Kraken_ParseHeader()
-	if ( b1 == 0x78 &&					// b1=CMF: 7=32k buffer (CINFO), 8=deflate (CM)
-		(b2 == 0x9C || b2 == 0xDA) )	// b2=FLG
-	{
-		Flags = COMPRESS_ZLIB;
-	}
-#if USE_OODLE
-	else if ((b1 == 0x8C || b1 == 0xCC) && (b2 == 5 || b2 == 6 || b2 == 10 || b2 == 11 || b2 == 12))
+CDecompressor* CDecompressor::Find(int Flags)
+{
+	for (CDecompressor* Decompressor = First; Decompressor; Decompressor = Decompressor->Next)
 	{
-		Flags = COMPRESS_OODLE;
+		if (Decompressor->Flags == Flags)
+			return Decompressor;
 	}
-#endif // USE_OODLE
-#if USE_LZ4
-	else if (GForceGame >= GAME_UE4_BASE)
+	return NULL;
+}
+
+void CDecompressor::PrintStats()
+{
+	for (const CDecompressor* D = First; D; D = D->Next)
 	{
-		Flags = COMPRESS_LZ4;		// in most cases UE4 games are using either oodle or lz4 - the first one is explicitly recognizable
+		if (!D->NumBlocks) continue;
+		float Seconds = D->Time / 1000000.0f;
+		float UncompressedMB = D->UncompressedBytes / (1024.0f * 1024.0f);
+		appPrintf("Decompressed %s: %d blocks, %.2f -> %.2f MBytes in %.2f sec (%.1f MBytes/sec)\n",
+			D->Name, D->NumBlocks, D->CompressedBytes / (1024.0f * 1024.0f), UncompressedMB,
+			Seconds, Seconds > 0 ? UncompressedMB / Seconds : 0.0f);
 	}
-#endif // USE_LZ4
-	else
+}
+
+CDecompressFilter* CDecompressFilter::First = NULL;
+
+CDecompressFilter::CDecompressFilter()
+{
+	// Register the filter
+	Next = First;
+	First = this;
+}
+
+int CDecompressFilter::ApplyAll(byte *CompressedBuffer, int CompressedSize, int Flags)
+{
+	for (CDecompressFilter* Filter = First; Filter; Filter = Filter->Next)
 	{
-		Flags = COMPRESS_LZO;		// LZO was used only with UE3 games as standard compression method
+		Flags = Filter->Apply(CompressedBuffer, CompressedSize, Flags);
 	}
-
 	return Flags;
 }
 
-int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags)
+class CZlibDecompressor : public CDecompressor
 {
-	int OldFlags = Flags;
-
-	guard(appDecompress);
+public:
+	CZlibDecompressor()
+	:	CDecompressor("zlib", COMPRESS_ZLIB)
+	{}
 
-#if GEARSU
-	if (GForceGame == GAME_GoWU)
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
 	{
-		// It is strange, but this game has 2 Flags both used for LZ4 - probably they were used for different compression
-		// settings of the same algorithm.
-		if (Flags == 4 || Flags == 32) Flags = COMPRESS_LZ4;
-	}
-#endif // GEARSU
+		// Every thread reuses its inflate state, so the decompression window is not allocated for every block
+		struct FThreadStream
+		{
+			z_stream	Stream;
+			bool		bInitialized;
 
-#if BLADENSOUL
-	if (GForceGame == GAME_BladeNSoul && Flags == COMPRESS_LZO_ENC_BNS)	// note: GForceGame is required (to not pass 'Game' here)
-	{
-		DecryptBladeAndSoul(CompressedBuffer, CompressedSize);
-		// overide compression
-		Flags = COMPRESS_LZO;
-	}
-#endif // BLADENSOUL
+			~FThreadStream()
+			{
+				if (bInitialized) inflateEnd(&Stream);
+			}
+		};
+		static thread_local FThreadStream Local;
 
-#if SMITE
-	if (GForceGame == GAME_Smite)
-	{
-		if (Flags & 512)
+		z_stream& Stream = Local.Stream;
+		if (!Local.bInitialized)
 		{
-			// Simple encryption
-			for (int i = 0; i < CompressedSize; i++)
-				CompressedBuffer[i] ^= 0x2A;
-			// Remove encryption flag
-			Flags &= ~512;
+			memset(&Stream, 0, sizeof(Stream));
+			int r = inflateInit(&Stream);
+			if (r != Z_OK) appError("zlib inflateInit returned %d", r);
+			Local.bInitialized = true;
 		}
-	#if USE_OODLE
-		if (Flags == 8)
+		else
 		{
-			// Overide compression, appeared in late 2019 builds
-			Flags = COMPRESS_OODLE;
+			inflateReset(&Stream);
 		}
-	#endif
-	}
-#endif // SMITE
 
-#if TAO_YUAN
-	if (GForceGame == GAME_TaoYuan)	// note: GForceGame is required (to not pass 'Game' here);
-	{
-		DecryptTaoYuan(CompressedBuffer, CompressedSize);
+		Stream.next_in = CompressedBuffer;
+		Stream.avail_in = CompressedSize;
+		Stream.next_out = UncompressedBuffer;
+		Stream.avail_out = UncompressedSize;
+		int r = inflate(&Stream, Z_FINISH);
+		if (r != Z_STREAM_END) appError("zlib uncompress(%d,%d) returned %d", CompressedSize, UncompressedSize, r);
+//		if (Stream.total_out != UncompressedSize) appError("len mismatch: %d != %d", Stream.total_out, UncompressedSize); -- needed by Bioshock
+		return Stream.total_out;
 	}
-#endif // TAO_YUAN
+};
 
-#if DEVILS_THIRD
-	if ((GForceGame == GAME_DevilsThird) && (Flags & 8))
-	{
-		DecryptDevlsThird(CompressedBuffer, CompressedSize);
-		// override compression
-		Flags &= ~8;
-	}
-#endif // DEVILS_THIRD
+static CZlibDecompressor ZlibDecompressor;
 
-	if (Flags == COMPRESS_FIND && FoundCompression >= 0)
-	{
-		// Do not detect compression multiple times: there were cases (Sea of Thieves) when
-		// game is using LZ4 compression, however its first 2 bytes occasionally matched oodle,
-		// so one of blocks were mistakenly used oodle.
-		Flags = FoundCompression;
-	}
-	else if (Flags == COMPRESS_FIND && CompressedSize >= 2)
+class CLzoDecompressor : public CDecompressor
+{
+public:
+	CLzoDecompressor()
+	:	CDecompressor("lzo", COMPRESS_LZO)
 	{
-		Flags = DetectCompressionMethod(CompressedBuffer);
-		// Cache detected compression method
-		FoundCompression = Flags;
+		// Initialize the library once, before any threads are started
+		InitResult = lzo_init();
 	}
 
-restart_decompress:
-
-	if (Flags == COMPRESS_LZO)
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
 	{
-		int r;
-		r = lzo_init();
-		if (r != LZO_E_OK) appError("lzo_init() returned %d", r);
+		if (InitResult != LZO_E_OK) appError("lzo_init() returned %d", InitResult);
 		lzo_uint newLen = UncompressedSize;
-		r = lzo1x_decompress_safe(CompressedBuffer, CompressedSize, UncompressedBuffer, &newLen, NULL);
+		int r = lzo1x_decompress_safe(CompressedBuffer, CompressedSize, UncompressedBuffer, &newLen, NULL);
 		if (r != LZO_E_OK)
 		{
 			if (CompressedSize != UncompressedSize)
@@ -417,20 +432,20 @@ restart_decompress:
 		return newLen;
 	}
 
-	if (Flags == COMPRESS_ZLIB)
-	{
-#if 0
-		appError("appDecompress: Zlib compression is not supported");
-#else
-		unsigned long newLen = UncompressedSize;
-		int r = uncompress(UncompressedBuffer, &newLen, CompressedBuffer, CompressedSize);
-		if (r != Z_OK) appError("zlib uncompress(%d,%d) returned %d", CompressedSize, UncompressedSize, r);
-//		if (newLen != UncompressedSize) appError("len mismatch: %d != %d", newLen, UncompressedSize); -- needed by Bioshock
-		return newLen;
-#endif
-	}
+protected:
+	int			InitResult;
+};
+
+static CLzoDecompressor LzoDecompressor;
+
+class CLzxDecompressor : public CDecompressor
+{
+public:
+	CLzxDecompressor()
+	:	CDecompressor("lzx", COMPRESS_LZX)
+	{}
 
-	if (Flags == COMPRESS_LZX)
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
 	{
 #if SUPPORT_XBOX360
 #	if !USE_XDK
@@ -450,11 +465,23 @@ restart_decompress:
 #	endif // USE_XDK
 #else  // SUPPORT_XBOX360
 		appError("appDecompress: Lzx compression is not supported");
+		return 0;
 #endif // SUPPORT_XBOX360
 	}
+};
+
+static CLzxDecompressor LzxDecompressor;
 
 #if USE_LZ4
-	if (Flags == COMPRESS_LZ4)
+
+class CLz4Decompressor : public CDecompressor
+{
+public:
+	CLz4Decompressor()
+	:	CDecompressor("lz4", COMPRESS_LZ4)
+	{}
+
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
 	{
 		int newLen = LZ4_decompress_safe((const char*)CompressedBuffer, (char*)UncompressedBuffer, CompressedSize, UncompressedSize);
 		if (newLen <= 0)
@@ -462,15 +489,26 @@ restart_decompress:
 		if (newLen != UncompressedSize) appError("lz4 len mismatch: %d != %d", newLen, UncompressedSize);
 		return newLen;
 	}
+};
+
+static CLz4Decompressor Lz4Decompressor;
+
 #endif // USE_LZ4
 
 #if USE_OODLE // defined for supported engine versions
-	if (Flags == COMPRESS_OODLE)
+
+class COodleDecompressor : public CDecompressor
+{
+public:
+	COodleDecompressor()
+	:	CDecompressor("oodle", COMPRESS_OODLE)
+	,	bUseDll(false)
+	{}
+
+	virtual int Decompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize)
 	{
 		//todo: review HAS_OODLE/USE_OODLE, move all stuff to appDecompressOodle
 	#if HAS_OODLE // defined in project file
-		static bool bUseDll = false;
-
 		if (!bUseDll)
 		{
 			extern int Kraken_Decompress(const byte *src, size_t src_len, byte *dst, size_t dst_len);
@@ -493,32 +531,260 @@ restart_decompress:
 		return UncompressedSize;
 	#else
 		appError("appDecompress: Oodle compression is not supported");
+		return 0;
 	#endif // HAS_OODLE
 	}
+
+protected:
+	// Set when built-in decompressor fails, then the dll is used for all data
+	volatile bool	bUseDll;
+};
+
+static COodleDecompressor OodleDecompressor;
+
 #endif // USE_OODLE
 
-	// Unknown compression flags
-	guard(UnknownCompression);
-#if 0
-	appError("appDecompress: unknown compression flags: %d", Flags);
-	return 0;
-#else
-	// Try to use compression detection
-	if (FoundCompression >= 0)
+/*-----------------------------------------------------------------------------
+	Game-specific filters
+-----------------------------------------------------------------------------*/
+
+// Decryptors for compressed data
+void DecryptBladeAndSoul(byte* CompressedBuffer, int CompressedSize);
+void DecryptTaoYuan(byte* CompressedBuffer, int CompressedSize);
+void DecryptDevlsThird(byte* CompressedBuffer, int CompressedSize);
+
+#if GEARSU
+
+class CGearsUFilter : public CDecompressFilter
+{
+public:
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags)
+	{
+		if (GForceGame == GAME_GoWU)
+		{
+			// It is strange, but this game has 2 Flags both used for LZ4 - probably they were used for different compression
+			// settings of the same algorithm.
+			if (Flags == 4 || Flags == 32) Flags = COMPRESS_LZ4;
+		}
+		return Flags;
+	}
+};
+
+static CGearsUFilter GearsUFilter;
+
+#endif // GEARSU
+
+#if BLADENSOUL
+
+class CBladeNSoulFilter : public CDecompressFilter
+{
+public:
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags)
+	{
+		if (GForceGame == GAME_BladeNSoul && Flags == COMPRESS_LZO_ENC_BNS)	// note: GForceGame is required (to not pass 'Game' here)
+		{
+			DecryptBladeAndSoul(CompressedBuffer, CompressedSize);
+			// overide compression
+			Flags = COMPRESS_LZO;
+		}
+		return Flags;
+	}
+};
+
+static CBladeNSoulFilter BladeNSoulFilter;
+
+#endif // BLADENSOUL
+
+#if SMITE
+
+class CSmiteFilter : public CDecompressFilter
+{
+public:
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags)
+	{
+		if (GForceGame == GAME_Smite)
+		{
+			if (Flags & 512)
+			{
+				// Simple encryption
+				for (int i = 0; i < CompressedSize; i++)
+					CompressedBuffer[i] ^= 0x2A;
+				// Remove encryption flag
+				Flags &= ~512;
+			}
+		#if USE_OODLE
+			if (Flags == 8)
+			{
+				// Overide compression, appeared in late 2019 builds
+				Flags = COMPRESS_OODLE;
+			}
+		#endif
+		}
+		return Flags;
+	}
+};
+
+static CSmiteFilter SmiteFilter;
+
+#endif // SMITE
+
+#if TAO_YUAN
+
+class CTaoYuanFilter : public CDecompressFilter
+{
+public:
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags)
+	{
+		if (GForceGame == GAME_TaoYuan)	// note: GForceGame is required (to not pass 'Game' here);
+		{
+			DecryptTaoYuan(CompressedBuffer, CompressedSize);
+		}
+		return Flags;
+	}
+};
+
+static CTaoYuanFilter TaoYuanFilter;
+
+#endif // TAO_YUAN
+
+#if DEVILS_THIRD
+
+class CDevilsThirdFilter : public CDecompressFilter
+{
+public:
+	virtual int Apply(byte *CompressedBuffer, int CompressedSize, int Flags)
+	{
+		if ((GForceGame == GAME_DevilsThird) && (Flags & 8))
+		{
+			DecryptDevlsThird(CompressedBuffer, CompressedSize);
+			// override compression
+			Flags &= ~8;
+		}
+		return Flags;
+	}
+};
+
+static CDevilsThirdFilter DevilsThirdFilter;
+
+#endif // DEVILS_THIRD
+
+/*-----------------------------------------------------------------------------
+	appDecompress()
+-----------------------------------------------------------------------------*/
+
+static int DetectCompressionMethod(byte* CompressedBuffer)
+{
+	int Flags = 0;
+
+	byte b1 = CompressedBuffer[0];
+	byte b2 = CompressedBuffer[1];
+	// zlib:
+	//   http://tools.ietf.org/html/rfc1950
+	//   http://stackoverflow.com/questions/9050260/what-does-a-zlib-header-look-like
+	// oodle:
+	//   https://github.com/powzix/ooz, kraken.cpp, Kraken_ParseHeader()
+	if ( b1 == 0x78 &&					// b1=CMF: 7=32k buffer (CINFO), 8=deflate (CM)
+		(b2 == 0x9C || b2 == 0xDA) )	// b2=FLG
+	{
+		Flags = COMPRESS_ZLIB;
+	}
+#if USE_OODLE
+	else if ((b1 == 0x8C || b1 == 0xCC) && (b2 == 5 || b2 == 6 || b2 == 10 || b2 == 11 || b2 == 12))
 	{
-		// Already detected a working decompressor (if it wouldn't be working, we'd already crash)
+		Flags = COMPRESS_OODLE;
 	}
+#endif // USE_OODLE
+#if USE_LZ4
+	else if (GForceGame >= GAME_UE4_BASE)
+	{
+		Flags = COMPRESS_LZ4;		// in most cases UE4 games are using either oodle or lz4 - the first one is explicitly recognizable
+	}
+#endif // USE_LZ4
 	else
 	{
-		assert(CompressedSize >= 2);
-		FoundCompression = DetectCompressionMethod(CompressedBuffer);
-		appNotify("appDecompress: unknown compression flags %X, detected %X, retrying ...", Flags, FoundCompression);
-		Flags = FoundCompression;
+		Flags = COMPRESS_LZO;		// LZO was used only with UE3 games as standard compression method
 	}
-	Flags = FoundCompression;
-	goto restart_decompress;
-	unguard;
+
+	return Flags;
+}
+
+template<typename T>
+static FORCEINLINE void AddDecompressStat(volatile T& Value, T Amount)
+{
+#if THREADING
+	InterlockedAdd(&Value, Amount);
+#else
+	Value += Amount;
 #endif
+}
+
+// Compression flags are packed into CDecompressCache::Resolved together with decompressor index
+#define RESOLVED_INDEX_BITS		6
+#define RESOLVED_MAX_FLAGS		(1 << (31 - RESOLVED_INDEX_BITS))
+static_assert(CDecompressor::MAX_DECOMPRESSORS < (1 << RESOLVED_INDEX_BITS), "Too many decompressors");
+
+int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags, CDecompressCache* Cache)
+{
+	int OldFlags = Flags;
+
+	guard(appDecompress);
+
+	Flags = CDecompressFilter::ApplyAll(CompressedBuffer, CompressedSize, Flags);
+
+	CDecompressor* Decompressor = NULL;
+	// Use the decompressor resolved for the container. Flags and decompressor are stored in a single
+	// value, so threads which are decompressing the same container will never see a mismatched pair.
+	int Resolved = Cache ? Cache->Resolved : 0;
+	if (Resolved && (Resolved >> RESOLVED_INDEX_BITS) == Flags)
+	{
+		Decompressor = CDecompressor::Registered[(Resolved & ((1 << RESOLVED_INDEX_BITS) - 1)) - 1];
+	}
+	if (!Decompressor && Flags != COMPRESS_FIND)
+	{
+		Decompressor = CDecompressor::Find(Flags);
+	}
+	if (!Decompressor)
+	{
+		// Compression method is either not specified or unknown, detect it.
+		// Do not detect compression multiple times for the same container: there were cases (Sea of Thieves)
+		// when game is using LZ4 compression, however its first 2 bytes occasionally matched oodle, so one
+		// of blocks were mistakenly used oodle.
+		int FoundCompression;
+		if (Cache && Cache->DetectedFlags > 0)
+		{
+			FoundCompression = Cache->DetectedFlags;
+		}
+		else
+		{
+			assert(CompressedSize >= 2);
+			FoundCompression = DetectCompressionMethod(CompressedBuffer);
+			if (Flags != COMPRESS_FIND)
+				appNotify("appDecompress: unknown compression flags %X, detected %X, retrying ...", Flags, FoundCompression);
+			if (Cache)
+				Cache->DetectedFlags = FoundCompression;
+		}
+		Decompressor = CDecompressor::Find(FoundCompression);
+		assert(Decompressor);
+	}
+	if (Cache && Flags > 0 && Flags < RESOLVED_MAX_FLAGS)
+	{
+		int NewResolved = (Flags << RESOLVED_INDEX_BITS) | (Decompressor->Index + 1);
+		if (NewResolved != Resolved)
+			Cache->Resolved = NewResolved;
+	}
+
+#if PROFILE
+	uint64 StartTime = appMicroseconds();
+#endif
+	int Result = Decompressor->Decompress(CompressedBuffer, CompressedSize, UncompressedBuffer, UncompressedSize);
+#if PROFILE
+	AddDecompressStat<int64>(Decompressor->Time, appMicroseconds() - StartTime);
+#endif
+	AddDecompressStat<int32>(Decompressor->NumBlocks, 1);
+	AddDecompressStat<int64>(Decompressor->CompressedBytes, CompressedSize);
+	AddDecompressStat<int64>(Decompressor->UncompressedBytes, Result);
+
+	return Result;
 
 	unguardf("CompSize=%d UncompSize=%d Flags=0x%X Bytes=%02X%02X", CompressedSize, UncompressedSize, OldFlags, CompressedBuffer[0], CompressedBuffer[1]);
 }
@@ -536,9 +802,125 @@ TArray<FString> GAesKeys;
 
 #define AES_KEYBITS		256
 
-void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define USE_AESNI		1
+#endif
+
+#if USE_AESNI
+
+#include <wmmintrin.h>
+#if _MSC_VER
+#include <intrin.h>
+#define AESNI_FUNC
+#else
+#include <cpuid.h>
+#define AESNI_FUNC		__attribute__((target("aes,sse2")))
+#endif
+
+static bool CpuHasAESNI()
 {
-	guard(appDecryptAES);
+	static int Result = -1;
+	if (Result < 0)
+	{
+#if _MSC_VER
+		int Info[4];
+		__cpuid(Info, 1);
+		Result = (Info[2] & (1 << 25)) != 0;
+#else
+		unsigned int a, b, c, d;
+		Result = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_AES) != 0;
+#endif
+	}
+	return Result != 0;
+}
+
+// Build decryption round keys for AESDEC instruction from rijndael encryption key schedule
+AESNI_FUNC static void SetupDecryptAESNI(const unsigned long* EncKey, int NumRounds, byte* RoundKeys)
+{
+	// rijndael stores round keys as big-endian 32-bit words, convert them to byte stream
+	byte Keys[15*16];
+	for (int i = 0; i < (NumRounds + 1) * 4; i++)
+	{
+		uint32 w = (uint32)EncKey[i];
+		Keys[i*4  ] = w >> 24;
+		Keys[i*4+1] = (w >> 16) & 0xFF;
+		Keys[i*4+2] = (w >> 8) & 0xFF;
+		Keys[i*4+3] = w & 0xFF;
+	}
+	// Decryption uses keys in reverse order, with InvMixColumns applied to middle round keys
+	memcpy(RoundKeys, Keys + NumRounds * 16, 16);
+	for (int i = 1; i < NumRounds; i++)
+	{
+		__m128i k = _mm_loadu_si128((const __m128i*)(Keys + (NumRounds - i) * 16));
+		_mm_storeu_si128((__m128i*)(RoundKeys + i * 16), _mm_aesimc_si128(k));
+	}
+	memcpy(RoundKeys + NumRounds * 16, Keys, 16);
+}
+
+AESNI_FUNC static void DecryptAESNI(const byte* RoundKeys, int NumRounds, byte* Data, int Size)
+{
+	__m128i k[15];
+	for (int i = 0; i <= NumRounds; i++)
+		k[i] = _mm_loadu_si128((const __m128i*)(RoundKeys + i * 16));
+
+	__m128i* p = (__m128i*)Data;
+	int NumBlocks = Size / 16;
+	int i = 0;
+
+	// Blocks are independent in ECB mode, so process 4 blocks at once to hide AESDEC latency
+	for ( ; i + 4 <= NumBlocks; i += 4)
+	{
+		__m128i b0 = _mm_xor_si128(_mm_loadu_si128(p + i    ), k[0]);
+		__m128i b1 = _mm_xor_si128(_mm_loadu_si128(p + i + 1), k[0]);
+		__m128i b2 = _mm_xor_si128(_mm_loadu_si128(p + i + 2), k[0]);
+		__m128i b3 = _mm_xor_si128(_mm_loadu_si128(p + i + 3), k[0]);
+		for (int r = 1; r < NumRounds; r++)
+		{
+			b0 = _mm_aesdec_si128(b0, k[r]);
+			b1 = _mm_aesdec_si128(b1, k[r]);
+			b2 = _mm_aesdec_si128(b2, k[r]);
+			b3 = _mm_aesdec_si128(b3, k[r]);
+		}
+		_mm_storeu_si128(p + i,     _mm_aesdeclast_si128(b0, k[NumRounds]));
+		_mm_storeu_si128(p + i + 1, _mm_aesdeclast_si128(b1, k[NumRounds]));
+		_mm_storeu_si128(p + i + 2, _mm_aesdeclast_si128(b2, k[NumRounds]));
+		_mm_storeu_si128(p + i + 3, _mm_aesdeclast_si128(b3, k[NumRounds]));
+	}
+	for ( ; i < NumBlocks; i++)
+	{
+		__m128i b = _mm_xor_si128(_mm_loadu_si128(p + i), k[0]);
+		for (int r = 1; r < NumRounds; r++)
+			b = _mm_aesdec_si128(b, k[r]);
+		_mm_storeu_si128(p + i, _mm_aesdeclast_si128(b, k[NumRounds]));
+	}
+}
+
+#endif // USE_AESNI
+
+#if THREADING
+static CMutex AesKeyMutex;
+#endif
+
+bool CAesKey::IsReady() const
+{
+	if (!bReady) return false;
+#if THREADING
+	// Pairs with the barrier in Setup(): don't read the key schedule before bReady
+	appMemoryBarrier();
+#endif
+	return true;
+}
+
+void CAesKey::Setup(const char* Key, int KeyLen)
+{
+	guard(CAesKey::Setup);
+
+	if (IsReady()) return;
+
+#if THREADING
+	CMutex::ScopedLock Lock(AesKeyMutex);
+	if (bReady) return;
+#endif
 
 	if (KeyLen <= 0)
 	{
@@ -554,15 +936,54 @@ void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
 		appErrorNoLog("AES key is too short");
 	}
 
+	static_assert(ARRAY_COUNT(rk) == RKLENGTH(AES_KEYBITS), "Wrong AES key schedule size");
+
+	bUseAESNI = false;
+#if USE_AESNI
+	if (CpuHasAESNI())
+	{
+		NumRounds = rijndaelSetupEncrypt(rk, (const byte*)Key, AES_KEYBITS);
+		SetupDecryptAESNI(rk, NumRounds, RoundKeys);
+		bUseAESNI = true;
+	}
+#endif
+	NumRounds = rijndaelSetupDecrypt(rk, (const byte*)Key, AES_KEYBITS);
+
+#if THREADING
+	// Publish the key schedule before bReady
+	appMemoryBarrier();
+#endif
+	bReady = true;
+
+	unguard;
+}
+
+void CAesKey::Decrypt(byte* Data, int Size) const
+{
+	assert(bReady);
 	assert((Size & 15) == 0);
 
-	unsigned long rk[RKLENGTH(AES_KEYBITS)];
-	int nrounds = rijndaelSetupDecrypt(rk, (const byte*)Key, AES_KEYBITS);
+#if USE_AESNI
+	if (bUseAESNI)
+	{
+		DecryptAESNI(RoundKeys, NumRounds, Data, Size);
+		return;
+	}
+#endif
 
 	for (int pos = 0; pos < Size; pos += 16)
 	{
-		rijndaelDecrypt(rk, nrounds, Data + pos, Data + pos);
+		rijndaelDecrypt(rk, NumRounds, Data + pos, Data + pos);
 	}
+}
+
+void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
+{
+	guard(appDecryptAES);
+
+	CAesKey AesKey;
+	AesKey.Setup(Key, KeyLen);
+	AesKey.Decrypt(Data, Size);
 
 	unguard;
 }
@@ -19,6 +19,13 @@
 
 #define FILE_BUFFER_SIZE		4096
 
+// Files larger than this size are memory-mapped instead of being read with stdio
+#define FILE_MAP_MIN_SIZE		(16 << 20)
+// Limit for mapping on 32-bit platforms, where address space is the bottleneck
+#define FILE_MAP_MAX_SIZE_32	(256 << 20)
+// Size of the window into mapped memory which is served as 'Buffer' to Serialize()
+#define FILE_MAP_WINDOW_SIZE	(1 << 30)
+
 
 //#define DEBUG_BULK			1
 //#define DEBUG_RAW_ARRAY		1
@@ -555,7 +562,7 @@ void FFileArchive::Close()
 	{
 		fclose(f);
 		f = NULL;
-		appFree(Buffer);
+		if (Buffer) appFree(Buffer);
 		Buffer = NULL;
 	}
 }
@@ -596,6 +603,8 @@ FFileReader::FFileReader(const char *Filename, unsigned InOptions)
 ,	FileSize(-1)
 ,	BufferBytesLeft(0)
 ,	LocalReadPos(0)
+,	MappedData(NULL)
+,	MappedSize(0)
 {
 	guard(FFileReader::FFileReader);
 	IsLoading = true;
@@ -650,6 +659,54 @@ void FFileReader::Serialize(void *data, int size)
 		else
 		{
 			// Buffer is empty
+			if (MappedData)
+			{
+				// Memory-mapped file: move the buffer window to the current position
+				int64 Pos = (SeekPos >= 0) ? SeekPos : FilePos;
+				if (Pos + size > MappedSize)
+					appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+				int64 WindowSize = MappedSize - Pos;
+				if (WindowSize > FILE_MAP_WINDOW_SIZE) WindowSize = FILE_MAP_WINDOW_SIZE;
+				Buffer = const_cast<byte*>(MappedData) + Pos;
+				BufferPos = Pos;
+				BufferSize = (int)WindowSize;
+				FilePos = Pos + WindowSize;
+				BufferBytesLeft = BufferSize;
+				LocalReadPos = 0;
+				SeekPos = -1;
+				continue;
+			}
+		#if _WIN32
+			if (!(Options & FAO_TextFile))
+			{
+				// ReadAt() could be called from other threads at any time, and ReadFile() moves the shared
+				// file pointer. So never use the file pointer for binary files: read from explicit position.
+				int64 Pos = (SeekPos >= 0) ? SeekPos : FilePos;
+				SeekPos = -1;
+				int ReadSize = (size >= FILE_BUFFER_SIZE / 2) ? size : FILE_BUFFER_SIZE;
+				int ReadBytes = appReadFileAt(f, Pos, (ReadSize == size) ? data : Buffer, ReadSize);
+				if (ReadBytes == 0 || (ReadSize == size && ReadBytes != size))
+					appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+			#if PROFILE
+				GNumSerialize++;
+				GSerializeBytes += ReadBytes;
+			#endif
+				FilePos = Pos + ReadBytes;
+				LocalReadPos = 0;
+				if (ReadSize == size)
+				{
+					// Large block was read directly to destination skipping buffer
+					BufferPos = FilePos;
+					BufferSize = 0;
+					BufferBytesLeft = 0;
+					return;
+				}
+				BufferPos = Pos;
+				BufferSize = ReadBytes;
+				BufferBytesLeft = ReadBytes;
+				continue;
+			}
+		#endif
 			if (SeekPos >= 0)
 			{
 				// Seek to desired position
@@ -707,7 +764,67 @@ void FFileReader::Serialize(void *data, int size)
 
 bool FFileReader::Open()
 {
-	return OpenFile();
+	guard(FFileReader::Open);
+
+	if (!OpenFile()) return false;
+
+	if (!(Options & FAO_TextFile))
+	{
+		// Map large files into memory: this saves a syscall and a copy for every random read
+		int64 Size = GetFileSize64();
+		if (Size >= FILE_MAP_MIN_SIZE && (sizeof(void*) >= 8 || Size <= FILE_MAP_MAX_SIZE_32))
+		{
+			MappedData = (const byte*)appMapFile(f, Size);
+			if (MappedData)
+			{
+				MappedSize = Size;
+				// Serialize() will use the mapped memory as a buffer
+				appFree(Buffer);
+				Buffer = NULL;
+			}
+		}
+	}
+	return true;
+
+	unguardf("%s", ShortName);
+}
+
+void FFileReader::Close()
+{
+	if (MappedData)
+	{
+		appUnmapFile(MappedData, MappedSize);
+		MappedData = NULL;
+		MappedSize = 0;
+		// Buffer pointed to the mapped memory
+		Buffer = NULL;
+		BufferSize = 0;
+		BufferBytesLeft = 0;
+		LocalReadPos = 0;
+	}
+	Super::Close();
+}
+
+void FFileReader::ReadAt(int64 Pos, void* data, int size)
+{
+	PROFILE_IF(size >= 1024);
+	guard(FFileReader::ReadAt);
+
+	assert(IsOpen());
+	if (MappedData)
+	{
+		if (Pos < 0 || Pos + size > MappedSize)
+			appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+		memcpy(data, MappedData + Pos, size);
+	}
+	else
+	{
+		// Doesn't touch archive state, so could be used from multiple threads
+		if (appReadFileAt(f, Pos, data, size) != size)
+			appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+	}
+
+	unguardf("File=%s", ShortName);
 }
 
 void FFileReader::Seek(int Pos)
@@ -1130,6 +1247,7 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 	// prepare buffer for reading compressed data
 	int BufferSize = ChunkHeader.BlockSize * 16;
 	byte *ReadBuffer = (byte*)appMallocNoInit(BufferSize);	// BlockSize is size of uncompressed data
+	CDecompressCache DecompressCache;
 	// read and decompress data
 	for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
 	{
@@ -1137,7 +1255,7 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 		assert(Block->CompressedSize <= BufferSize);
 		assert(Block->UncompressedSize <= Size);
 		Ar.Serialize(ReadBuffer, Block->CompressedSize);
-		appDecompress(ReadBuffer, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
+		appDecompress(ReadBuffer, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags, &DecompressCache);
 		Size   -= Block->UncompressedSize;
 		Buffer += Block->UncompressedSize;
 	}
@@ -1470,26 +1588,15 @@ void FByteBulkData::SerializeData(FArchive &Ar)
 		// UE4 compressed packages use uncompressed position for bulk data
 		/// reference: FUntypedBulkData::LoadDataIntoMemory
 
-		// open new FArchive for the current file
+		// use separate FArchive for the current file
 		UnPackage* Package = Ar.CastTo<UnPackage>();
 		assert(Package);
-		//!! should make the following code as separate function
-		const CGameFileInfo* info = Package->FileInfo;
-		FArchive* loader = NULL;
-		if (info)
-		{
-			loader = info->CreateReader();
-			assert(loader);
-		}
-		else
-		{
-			loader = new FFileReader(*Package->GetFilename());
-		}
-		loader->Game = Ar.Game;
+		FArchive* loader = Package->AcquireBulkReader(UnPackage::BULK_Package);
+		assert(loader);
 
 		loader->Seek64(BulkDataOffsetInFile);
 		SerializeDataChunk(*loader);
-		delete loader;
+		Package->ReleaseBulkReader(UnPackage::BULK_Package, loader);
 	}
 	else
 #endif // UNREAL4
@@ -1552,52 +1659,110 @@ void FByteBulkData::SerializeDataChunk(FArchive &Ar)
 }
 
 bool FByteBulkData::SerializeData(const UObject* MainObj) const
+{
+	const FByteBulkData* Bulk = this;
+	return SerializeData(MainObj, &Bulk, 1);
+}
+
+#if UNREAL4
+
+// Limit size of the buffer used for reading of adjacent bulk records
+#define MAX_BATCHED_BULK_SIZE		(256 << 20)
+
+static UnPackage::EBulkFile GetBulkFileType(const FByteBulkData& Bulk)
+{
+	// It seems UE4 may store both flags, but priority is to BULKDATA_OptionalPayload.
+	return (Bulk.BulkDataFlags & BULKDATA_OptionalPayload) ? UnPackage::BULK_Uptnl : UnPackage::BULK_Ubulk;
+}
+
+// Check if the record could be read together with other records: it should be stored in a separate
+// file without compression, and its size should match the size on disk.
+bool FByteBulkData::CanBatchRead() const
+{
+	if (!bIsUE4Data || !CanReloadBulk())
+		return false;
+	if (BulkDataFlags & (BULKDATA_CompressedLzo | BULKDATA_CompressedZlib | BULKDATA_CompressedLzx))
+		return false;
+	return BulkDataSizeOnDisk > 0 && ElementCount * GetElementSize() == BulkDataSizeOnDisk;
+}
+
+#endif // UNREAL4
+
+/*static*/ bool FByteBulkData::SerializeData(const UObject* MainObj, const FByteBulkData* const* Bulks, int NumBulks)
 {
 #if UNREAL4
 	guard(FByteBulkData::SerializeData(UObject*));
 
-	assert(bIsUE4Data); // the function is supported only for UE4 games
+	assert(NumBulks >= 1);
+	FByteBulkData* First = const_cast<FByteBulkData*>(Bulks[0]);
+	assert(First->bIsUE4Data); // the function is supported only for UE4 games
 
-	if (!(BulkDataFlags & (BULKDATA_OptionalPayload|BULKDATA_PayloadInSeperateFile)))
+	if (!(First->BulkDataFlags & (BULKDATA_OptionalPayload|BULKDATA_PayloadInSeperateFile)))
 	{
 		// Already serialized, see FByteBulkData::Serialize()
-		assert(CanReloadBulk() == false);
+		assert(First->CanReloadBulk() == false);
 		return true;
 	}
 
-	assert(CanReloadBulk() == true);
+	assert(First->CanReloadBulk() == true);
 
-	char bulkFileName[256];
-	bulkFileName[0] = 0;
+	// This function is called from exporter threads, the reader is used exclusively until released
+	UnPackage* Package = MainObj->Package;
+	UnPackage::EBulkFile BulkFile = GetBulkFileType(*First);
+	FArchive *Ar = Package->AcquireBulkReader(BulkFile);
+	if (!Ar)
+	{
+		// Missing file, AcquireBulkReader() has printed a message
+		return false;
+	}
 
-	const UnPackage* Package = MainObj->Package;
+#if DEBUG_BULK
+	appPrintf("%s: Bulk %X %llX [%d] f=%X (%d) +%d\n", MainObj->Name, First, First->BulkDataOffsetInFile, First->ElementCount, First->BulkDataFlags, BulkFile, NumBulks - 1);
+#endif
 
-	strcpy(bulkFileName, *Package->GetFilename());
-	//!! check for presence of BULKDATA_PayloadAtEndOfFile flag
-	if (BulkDataFlags & (BULKDATA_OptionalPayload|BULKDATA_PayloadInSeperateFile))
+	// Find records which are stored right after the first one
+	int NumAdjacent = 1;
+	int TotalSize = First->BulkDataSizeOnDisk;
+	if (First->CanBatchRead() && !Ar->IsCompressed())
 	{
-		// UE4.12+ store bulk payload in .ubulk file (BULKDATA_PayloadInSeperateFile)
-		// UE4.20+ store bulk payload in .uptnl file (BULKDATA_OptionalPayload)
-		// It seems UE4 may store both flags, but priority is to BULKDATA_OptionalPayload.
-		char* s = strrchr(bulkFileName, '.');
-		assert(s);
-		strcpy(s, (BulkDataFlags & BULKDATA_OptionalPayload) ? ".uptnl" : ".ubulk");
+		for ( ; NumAdjacent < NumBulks; NumAdjacent++)
+		{
+			const FByteBulkData* Prev = Bulks[NumAdjacent - 1];
+			const FByteBulkData* Next = Bulks[NumAdjacent];
+			if (Next->BulkData || !Next->CanBatchRead() || GetBulkFileType(*Next) != BulkFile)
+				break;
+			if (Next->BulkDataOffsetInFile != Prev->BulkDataOffsetInFile + Prev->BulkDataSizeOnDisk)
+				break;
+			if (TotalSize + (int64)Next->BulkDataSizeOnDisk > MAX_BATCHED_BULK_SIZE)
+				break;
+			TotalSize += Next->BulkDataSizeOnDisk;
+		}
 	}
 
-	const CGameFileInfo* bulkFile = CGameFileInfo::Find(bulkFileName);
-	if (!bulkFile)
+	if (NumAdjacent == 1)
 	{
-		appPrintf("FByteBulkData %s: file %s is missing\n", MainObj->Name, bulkFileName);
-		return false;
+		First->SerializeData(*Ar);
+	}
+	else
+	{
+		byte* Buffer = (byte*)appMallocNoInit(TotalSize);
+		Ar->Seek64(First->BulkDataOffsetInFile);
+		Ar->Serialize(Buffer, TotalSize);
+		// The first record keeps the whole buffer, so only following (for mips - smaller) records are copied
+		int Offset = First->BulkDataSizeOnDisk;
+		for (int i = 1; i < NumAdjacent; i++)
+		{
+			FByteBulkData* Bulk = const_cast<FByteBulkData*>(Bulks[i]);
+			int DataSize = Bulk->BulkDataSizeOnDisk;
+			Bulk->BulkData = (byte*)appMallocNoInit(DataSize);
+			memcpy(Bulk->BulkData, Buffer + Offset, DataSize);
+			Offset += DataSize;
+		}
+		First->ReleaseData();
+		First->BulkData = Buffer;
 	}
 
-	FArchive *Ar = bulkFile->CreateReader();
-	Ar->SetupFrom(*Package);
-#if DEBUG_BULK
-	appPrintf("%s: Bulk %X %llX [%d] f=%X (%s)\n", MainObj->Name, this, this->BulkDataOffsetInFile, this->ElementCount, this->BulkDataFlags, bulkFileName);
-#endif
-	const_cast<FByteBulkData*>(this)->SerializeData(*Ar);
-	delete Ar;
+	Package->ReleaseBulkReader(BulkFile, Ar);
 	return true;
 
 	unguard;
@@ -22,6 +22,7 @@ bool (*GBeforeLoadObjectCallback)(UObject*) = NULL;
 
 UObject::UObject()
 :	PackageIndex(INDEX_NONE)
+,	ObjectIndex(INDEX_NONE)
 {
 //	appPrintf("creating (%p)\n", this);
 }
@@ -30,16 +31,27 @@ UObject::~UObject()
 {
 //	appPrintf("deleting %s (%p) - package %s, index %d\n", Name, this, Package ? Package->Name : "None", PackageIndex);
 	// remove self from GObjObjects
-	GObjObjects.RemoveSingle(this);
+	if (ObjectIndex != INDEX_NONE)
+	{
+		assert(GObjObjects[ObjectIndex] == this);
+		// Objects are usually released in reverse order, so this is the last array item, and
+		// nothing should be moved. Otherwise fix indices of following objects.
+		GObjObjects.RemoveAt(ObjectIndex);
+		for (int i = ObjectIndex; i < GObjObjects.Num(); i++)
+			GObjObjects[i]->ObjectIndex = i;
+		ObjectIndex = INDEX_NONE;
+	}
 	// remove self from package export table
 	// note: we using PackageIndex==INDEX_NONE when creating dummy object, not exported from
 	// any package, but which still belongs to this package (for example check Rune's
 	// USkelModel)
+	// note: object could be already detached from the export table (see DetachAllObjects), in
+	// this case export could hold a newer instance of the same object
 	if (Package && PackageIndex != INDEX_NONE)
 	{
 		FObjectExport &Exp = Package->GetExport(PackageIndex);
-		assert(Exp.Object == this);
-		Exp.Object = NULL;
+		if (Exp.Object == this)
+			Exp.Object = NULL;
 		Package = NULL;
 	}
 }
@@ -139,6 +151,21 @@ TArray<UObject*> UObject::GObjObjects;
 UObject         *UObject::GLoadingObj = NULL;
 
 
+void UObject::RegisterObject(UObject* Obj)
+{
+	assert(Obj->ObjectIndex == INDEX_NONE);
+	Obj->ObjectIndex = GObjObjects.Add(Obj);
+}
+
+void UObject::UnregisterAllObjects(TArray<UObject*>& Objects)
+{
+	assert(Objects.Num() == 0);
+	Exchange(Objects, GObjObjects);
+	for (UObject* Obj : Objects)
+		Obj->ObjectIndex = INDEX_NONE;
+}
+
+
 void UObject::BeginLoad()
 {
 	assert(GObjBeginLoadCount >= 0);
@@ -163,10 +190,20 @@ void UObject::EndLoad()
 	while (GObjLoaded.Num())
 	{
 		TArray<UObject*> LoadedObjects;
-		while (GObjLoaded.Num())
+		TArray<UObject*> LoadQueue;
+		int QueueIndex = 0;
+		while (true)
 		{
-			UObject *Obj = GObjLoaded[0];
-			GObjLoaded.RemoveAt(0);
+			if (QueueIndex >= LoadQueue.Num())
+			{
+				// Take the whole GObjLoaded at once instead of removing its items one-by-one. Objects
+				// queued during serialization will be picked up in the next pass, in the same order.
+				if (!GObjLoaded.Num()) break;
+				LoadQueue.Empty();
+				Exchange(LoadQueue, GObjLoaded);
+				QueueIndex = 0;
+			}
+			UObject *Obj = LoadQueue[QueueIndex++];
 			UnPackage *Package = Obj->Package;
 
 			guard(LoadObject);
@@ -1967,7 +2004,7 @@ UObject *CreateClass(const char *Name)
 	// to allow runtime creation of objects without linked package
 	// Really, should add to this list after loading from package
 	// (in CreateExport/Import or after serialization)
-	UObject::GObjObjects.Add(Obj);
+	UObject::RegisterObject(Obj);
 	return Obj;
 
 	unguardf("%s", Name);
@@ -29,6 +29,7 @@ public:
 	const char*		Name;
 	UObject*		Outer;			// UObject containing this UObject (e.g. UAnimSet holding UAnimSequence). Not really used here.
 	int				PackageIndex;	// index in package export table; INDEX_NONE for non-packaged (transient) object
+	int				ObjectIndex;	// index in GObjObjects array; INDEX_NONE when object is not registered there
 #if UNREAL3
 	int32			NetIndex;
 #endif
@@ -87,6 +88,12 @@ public:
 	static void BeginLoad();
 	static void EndLoad();
 
+	// Append object to GObjObjects
+	static void RegisterObject(UObject* Obj);
+	// Move all objects from GObjObjects to the provided array, objects will not be removed from
+	// GObjObjects when deleted
+	static void UnregisterAllObjects(TArray<UObject*>& Objects);
+
 	// accessing object's package properties (here just to exclude UnPackage.h whenever possible)
 	const FArchive* GetPackageArchive() const;
 	int GetGame() const;
@@ -529,7 +529,7 @@ static int Upload2D(UUnrealMaterial *Tex, bool doMipmap, bool clampS, bool clamp
 
 	CTextureData TexData;
 	PROFILE_UPLOAD(appResetProfiler());
-	if (!Tex->GetTextureData(TexData))
+	if (!Tex->GetTextureData(TexData) || !TexData.LoadAllMips())
 	{
 		appPrintf("WARNING: %s %s has no valid mipmaps\n", Tex->GetClassName(), Tex->Name);
 		return BAD_TEXTURE;
@@ -577,7 +577,7 @@ static bool UploadCubeSide(UUnrealMaterial *Tex, int side, bool useSlices = fals
 	guard(UploadCubeSide);
 
 	CTextureData TexData;
-	if (!Tex->GetTextureData(TexData))
+	if (!Tex->GetTextureData(TexData) || !TexData.LoadAllMips())
 	{
 		appPrintf("WARNING: %s %s has no valid mipmaps\n", Tex->GetClassName(), Tex->Name);
 		return false;
@@ -154,6 +154,9 @@ struct CMipMap
 	int						USize;
 	int						VSize;
 	bool					ShouldFreeData;			// free CompressedData when set to true
+	// Mip which is described only by location of its data, CTextureData::LoadMip() will read it
+	bool					IsPending;
+	int						SourceMip;				// mip index inside texture object
 
 	CMipMap()
 	{
@@ -212,6 +215,10 @@ struct CTextureData
 	int						OriginalFormatEnum;		// ETextureFormat or EPixelFormat
 	bool					isNormalmap;
 	const UPalette*			Palette;				// for TPF_P8
+	// Lazy mip loading
+	const UUnrealMaterial*	MipLoader;				// object which will load pending mips
+	bool					bBulkFailed;			// external bulk file is missing, don't try to load other mips from it
+	bool					bBulkLoaded;			// used to display "reading" message only once
 
 protected:
 	const char*				ObjectName;
@@ -253,13 +260,22 @@ public:
 	{
 		if (Palette) return false;
 		for (const CMipMap& Mip : Mips)
-			if (!Mip.ShouldFreeData)
+			if (!Mip.ShouldFreeData || Mip.IsPending)
 				return false;
 		return true;
 	}
 
+	// GetTextureData() may provide mips which are not loaded yet, one of these functions should be
+	// called before accessing mip data. Loading should be done in the main thread.
+	bool LoadMip(int MipLevel, bool bLoadFollowingMips = false);
+	bool LoadFirstMip();			// load the first valid mip, drop all other mips
+	bool LoadAllMips();				// drop mips which couldn't be loaded
+
 	byte* Decompress(int MipLevel = 0, int Slice = -1);		// may return NULL in a case of error
 
+	// Decode platform-specific data layout of the loaded mip
+	bool DecodeMip(int MipLevel);
+
 #if SUPPORT_XBOX360
 	bool DecodeXBox360(int MipLevel);
 #endif
@@ -271,6 +287,29 @@ public:
 #endif
 };
 
+// Conversion of uncompressed pixel formats, implemented in UnTextureConvert.cpp. SIMD code
+// is selected at runtime, scalar code is used on older CPUs and as a reference.
+enum EPixelConvertLevel
+{
+	PIXEL_CONVERT_SCALAR,
+	PIXEL_CONVERT_SSE2,
+	PIXEL_CONVERT_SSSE3,
+	PIXEL_CONVERT_AVX2,
+};
+
+// Limit instruction set used for conversion (for testing), returns the level which will be used
+EPixelConvertLevel SetPixelConvertLevel(EPixelConvertLevel MaxLevel);
+
+void ConvertBGR8ToRGBA8(const byte* Src, byte* Dst, int NumPixels);
+void ConvertBGRA8ToRGBA8(const byte* Src, byte* Dst, int NumPixels);
+void ConvertRGBA4ToRGBA8(const byte* Src, byte* Dst, int NumPixels);
+void ConvertG8ToRGBA8(const byte* Src, byte* Dst, int NumPixels);
+void ConvertV8U8ToRGBA8(const byte* Src, byte* Dst, int NumPixels, byte Offset);
+void ConvertHalfToFloat(const uint16* Src, float* Dst, int NumValues);	// bit-exact half2float()
+
+// Returns false when all pixels of RGBA8 image are fully opaque, or all are fully transparent
+bool IsAlphaChannelUsed(const byte* Src, int NumPixels);
+
 // There's no such class in Unreal Engine, we use it as common base for UE1/UE2/UE3
 class UUnrealMaterial : public UObject
 {
@@ -290,6 +329,12 @@ public:
 	// Release data cached with GetTextureData().
 	virtual void ReleaseTextureData() const
 	{}
+	// Load data for mip which was left pending by GetTextureData(). When bLoadFollowingMips is set, data
+	// for following pending mips could be loaded too, if it's cheaper to read them at once.
+	virtual bool LoadTextureMip(CTextureData &TexData, int MipLevel, bool bLoadFollowingMips) const
+	{
+		return false;
+	}
 
 	void GetMetadata(FArchive& Ar) const
 	{
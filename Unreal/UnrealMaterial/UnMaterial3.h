@@ -490,12 +490,13 @@ public:
 
 	virtual void GetMetadata(FArchive& Ar) const;
 
-	const TArray<FTexture2DMipMap>* GetMipmapArray() const;
+	const TArray<FTexture2DMipMap>* GetMipmapArray(const char** tfcSuffix = NULL) const;
 
-	bool LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, const char* tfcSuffix, bool verbose) const;
+	bool LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, int NumMips, const char* tfcSuffix, bool verbose) const;
 	virtual ETexturePixelFormat GetTexturePixelFormat() const;
 	virtual bool GetTextureData(CTextureData &TexData) const;
 	virtual void ReleaseTextureData() const;
+	virtual bool LoadTextureMip(CTextureData &TexData, int MipLevel, bool bLoadFollowingMips) const;
 #if RENDERING
 	virtual void SetupGL();
 	virtual bool Upload();
@@ -8,6 +8,8 @@
 
 #include "Wrappers/TexturePNG.h"
 
+#include "Parallel.h"
+
 #if SUPPORT_IPHONE
 #	include <PVRTDecompress.h>
 #endif
@@ -45,6 +47,55 @@ static void PostProcessAlpha(byte *pic, int width, int height)
 	unguard;
 }
 
+// Minimal number of pixels decoded by a single task. Smaller textures are decoded on the calling
+// thread, larger ones are split into bands of block rows which are decoded in parallel.
+#define DECODE_BAND_PIXELS		(256*256)
+
+// Calls Func(FirstBlockRow, NumBlockRows) for bands covering all block rows of the image. Block
+// rows are independent: each one is decoded from its own part of the compressed data into its own
+// part of the destination image, so the result doesn't depend on how the image was split.
+template<typename F>
+static void DecodeBlockRows(int USize, int BlockSizeY, int NumBlockRows, F&& Func)
+{
+	int BlockRowsPerBand = max(DECODE_BAND_PIXELS / max(USize * BlockSizeY, 1), 1);
+	int NumBands = (NumBlockRows + BlockRowsPerBand - 1) / BlockRowsPerBand;
+	if (NumBands <= 1)
+	{
+		Func(0, NumBlockRows);
+		return;
+	}
+	ParallelFor(NumBands, [&Func, BlockRowsPerBand, NumBlockRows](int Band)
+		{
+			int FirstRow = Band * BlockRowsPerBand;
+			Func(FirstRow, min(BlockRowsPerBand, NumBlockRows - FirstRow));
+		});
+}
+
+// Decode 4x4 block texture with detex. Block rows are passed to detex as separate textures.
+static void DecompressDetex(uint32 TexFormat, const byte* Data, int USize, int VSize, byte* dst, uint32 PixelFormat)
+{
+	guard(DecompressDetex);
+
+	int WidthInBlocks = USize / 4;
+	int HeightInBlocks = VSize / 4;
+	int BlockRowBytes = WidthInBlocks * detexGetCompressedBlockSize(TexFormat);
+	int PixelRowBytes = USize * detexGetPixelSize(PixelFormat);
+
+	DecodeBlockRows(USize, 4, HeightInBlocks, [=](int FirstRow, int NumRows)
+		{
+			detexTexture tex;
+			tex.format = TexFormat;
+			tex.data = const_cast<byte*>(Data) + FirstRow * BlockRowBytes;	// will be used as 'const' anyway
+			tex.width = USize;
+			tex.height = min(NumRows * 4, VSize - FirstRow * 4);
+			tex.width_in_blocks = WidthInBlocks;
+			tex.height_in_blocks = NumRows;
+			detexDecompressTextureLinear(&tex, dst + FirstRow * 4 * PixelRowBytes, PixelFormat);
+		});
+
+	unguard;
+}
+
 // Some references:
 // https://msdn.microsoft.com/en-us/library/windows/desktop/hh308955.aspx
 // https://msdn.microsoft.com/en-us/library/bb694531.aspx
@@ -97,11 +148,90 @@ unsigned CTextureData::GetFourCC() const
 }
 
 
+bool CTextureData::LoadMip(int MipLevel, bool bLoadFollowingMips)
+{
+	guard(CTextureData::LoadMip);
+
+	CMipMap& Mip = Mips[MipLevel];
+	if (!Mip.IsPending)
+		return true;
+
+	if (!MipLoader || !MipLoader->LoadTextureMip(*this, MipLevel, bLoadFollowingMips))
+		return false;
+	Mip.IsPending = false;
+
+	return DecodeMip(MipLevel);
+
+	unguardf("%s'%s' mip %d", ObjectClass, ObjectName, MipLevel);
+}
+
+bool CTextureData::LoadFirstMip()
+{
+	while (Mips.Num())
+	{
+		if (LoadMip(0))
+		{
+			// Drop other mips, so they won't be loaded at all
+			Mips.RemoveAt(1, Mips.Num() - 1);
+			return true;
+		}
+		if (!Mips[0].IsPending)
+		{
+			// Data was loaded but failed to decode, smaller mips are unlikely better
+			Mips.Empty();
+			break;
+		}
+		Mips.RemoveAt(0);
+	}
+	return false;
+}
+
+bool CTextureData::LoadAllMips()
+{
+	for (int MipLevel = 0; MipLevel < Mips.Num(); /* empty */)
+	{
+		// All mips are needed, so let the loader read adjacent mips at once
+		if (LoadMip(MipLevel, true))
+		{
+			MipLevel++;
+		}
+		else if (Mips[MipLevel].IsPending)
+		{
+			// Missing data, skip this mip level
+			Mips.RemoveAt(MipLevel);
+		}
+		else
+		{
+			// Failed to decode this mip, drop it with all smaller mips
+			Mips.RemoveAt(MipLevel, Mips.Num() - MipLevel);
+		}
+	}
+	return Mips.Num() > 0;
+}
+
+bool CTextureData::DecodeMip(int MipLevel)
+{
+#if SUPPORT_XBOX360
+	if (Platform == PLATFORM_XBOX360)
+		return DecodeXBox360(MipLevel);
+#endif
+#if SUPPORT_PS4
+	if (Platform == PLATFORM_PS4)
+		return DecodePS4(MipLevel);
+#endif
+#if SUPPORT_SWITCH
+	if (Platform == PLATFORM_SWITCH)
+		return DecodeNSW(MipLevel);
+#endif
+	return true;
+}
+
+
 byte* CTextureData::Decompress(int MipLevel, int Slice)
 {
 	guard(CTextureData::Decompress);
 
-	if (!Mips.IsValidIndex(MipLevel))
+	if (!Mips.IsValidIndex(MipLevel) || !LoadMip(MipLevel))
 		return NULL;
 
 	const CMipMap& Mip = Mips[MipLevel];
@@ -165,19 +295,7 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 		}
 		return dst;
 	case TPF_RGB8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = 255;
-				s += 3;
-			}
-		}
+		ConvertBGR8ToRGBA8(Data, dst, USize * VSize);
 		return dst;
 	case TPF_RGBA8:
 		{
@@ -185,87 +303,20 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 		}
 		return dst;
 	case TPF_FLOAT_RGBA:
-		{
-			const uint16 *s = (uint16*)Data;
-			float *d = (float*)dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-			}
-		}
+		ConvertHalfToFloat((const uint16*)Data, (float*)dst, USize * VSize * 4);
 		return dst;
 	case TPF_BGRA8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = s[3];
-				s += 4;
-			}
-		}
+		ConvertBGRA8ToRGBA8(Data, dst, USize * VSize);
 		return dst;
 	case TPF_RGBA4:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b1 = s[0];
-				byte b2 = s[1];
-				// BGRA -> RGBA
-				*d++ = b2 & 0xF0;
-				*d++ = (b2 & 0xF) << 4;
-				*d++ = b1 & 0xF0;
-				*d++ = (b1 & 0xF) << 4;
-				s += 2;
-			}
-		}
+		ConvertRGBA4ToRGBA8(Data, dst, USize * VSize);
 		return dst;
 	case TPF_G8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b = *s++;
-				*d++ = b;
-				*d++ = b;
-				*d++ = b;
-				*d++ = 255;
-			}
-		}
+		ConvertG8ToRGBA8(Data, dst, USize * VSize);
 		return dst;
 	case TPF_V8U8:
 	case TPF_V8U8_2:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			byte offset = (Format == TPF_V8U8) ? 128 : 0;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte u = *s++ + offset;		// byte + byte -> byte, overflow is normal here
-				byte v = *s++ + offset;
-				d[0] = u;
-				d[1] = v;
-				float uf = (u - offset) / 255.0f * 2 - 1;
-				float vf = (v - offset) / 255.0f * 2 - 1;
-				float t  = 1.0f - uf * uf - vf * vf;
-				if (t >= 0)
-					d[2] = 255 - 255 * appFloor(sqrt(t));	//!! TODO: check for correct function here - should be (t+1.0)*127.5, at least for 'offset==0'
-				else
-					d[2] = 255;
-				d[3] = 255;
-				d += 4;
-			}
-		}
+		ConvertV8U8ToRGBA8(Data, dst, USize * VSize, (Format == TPF_V8U8) ? 128 : 0);
 		return dst;
 	case TPF_A1:
 		appNotify("TPF_A1 unsupported");	//!! easy to do, but need samples - I've got some PF_A1 textures with no mipmaps inside
@@ -284,7 +335,12 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 	case TPF_ETC1:
 #if 1
 		PROFILE_DDS(appResetProfiler());
-		PVRTDecompressETC(Data, USize, VSize, dst, 0);
+		DecodeBlockRows(USize, 4, (VSize + 3) / 4, [Data, dst, USize, VSize](int FirstRow, int NumRows)
+			{
+				int xBlocks = (USize + 3) / 4;
+				unsigned BandVSize = min(NumRows * 4, VSize - FirstRow * 4);
+				PVRTDecompressETC(Data + FirstRow * xBlocks * 8, USize, BandVSize, dst + FirstRow * 4 * USize * 4, 0);
+			});
 		PROFILE_DDS(appPrintProfiler());
 #else
 		{
@@ -303,32 +359,14 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 #endif
 		return dst;
 	case TPF_ETC2_RGB:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecompressDetex(DETEX_TEXTURE_FORMAT_ETC2, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_ETC2_RGBA:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2_EAC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecompressDetex(DETEX_TEXTURE_FORMAT_ETC2_EAC, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_ASTC_4x4:
 	case TPF_ASTC_6x6:
@@ -336,12 +374,6 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 	case TPF_ASTC_10x10:
 	case TPF_ASTC_12x12:
 		{
-			static bool initialized = false;
-			if (!initialized)
-			{
-				build_quantization_mode_table();
-				initialized = true;
-			}
 			int blockDim = PixelFormatInfo[Format].BlockSizeX;
 			assert(PixelFormatInfo[Format].BlockSizeY == blockDim);
 			int xBlocks = (USize + blockDim - 1) / blockDim;
@@ -349,25 +381,45 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 			const int xdim = blockDim, ydim = blockDim, zdim = 1, z = 0;
 			const astc_decode_mode decode_mode = DECODE_LDR;
 			static const swizzlepattern swz_decode = { 0, 1, 2, 3 };
-			imageblock pb;
-
-			astc_codec_image* img = allocate_image(8 /*bitness*/, USize, VSize, 1 /*zsize*/, 0);
-			initialize_image(img);
 
-			for (int y = 0; y < yBlocks; y++)
 			{
-				for (int x = 0; x < xBlocks; x++)
+				// ASTC codec builds its lookup tables on demand and doesn't protect them, so build
+				// everything needed for this block size before decoding blocks in parallel
+#if THREADING
+				static CMutex InitMutex;
+				CMutex::ScopedLock Lock(InitMutex);
+#endif
+				static bool initialized = false;
+				if (!initialized)
 				{
-					int offset = ((y * xBlocks) + x) * 16;
-					const byte* bp = Data + offset;
-					physical_compressed_block pcb = *(physical_compressed_block *) bp;
-					symbolic_compressed_block scb;
-					physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
-					decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
-					write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
+					build_quantization_mode_table();
+					initialized = true;
 				}
+				get_block_size_descriptor(xdim, ydim, zdim);
+				get_partition_table(xdim, ydim, zdim, 1);
 			}
 
+			astc_codec_image* img = allocate_image(8 /*bitness*/, USize, VSize, 1 /*zsize*/, 0);
+			initialize_image(img);
+
+			DecodeBlockRows(USize, blockDim, yBlocks, [&](int FirstRow, int NumRows)
+				{
+					imageblock pb;
+					for (int y = FirstRow; y < FirstRow + NumRows; y++)
+					{
+						for (int x = 0; x < xBlocks; x++)
+						{
+							int offset = ((y * xBlocks) + x) * 16;
+							const byte* bp = Data + offset;
+							physical_compressed_block pcb = *(physical_compressed_block *) bp;
+							symbolic_compressed_block scb;
+							physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
+							decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
+							write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
+						}
+					}
+				});
+
 			memcpy(dst, img->imagedata8[0][0], size);
 
 			if (isNormalmap)
@@ -395,33 +447,15 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 		return dst;
 #endif // SUPPORT_ANDROID
 	case TPF_BC6H:
-		{
-			// decompress HDR image as float[w*h*4]
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC_FLOAT;
-			tex.data = const_cast<byte*>(Data);
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		// decompress HDR image as float[w*h*4]
+		PROFILE_DDS(appResetProfiler());
+		DecompressDetex(DETEX_TEXTURE_FORMAT_BPTC_FLOAT, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_BC7:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecompressDetex(DETEX_TEXTURE_FORMAT_BPTC, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_PNG_BGRA:
 	case TPF_PNG_RGBA:
@@ -443,31 +477,27 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 
 	PROFILE_DDS(appResetProfiler());
 
-	nv::DDSHeader header;
-	nv::Image image;
-	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
-	header.setWidth(USize);
-	header.setHeight(VSize);
-	header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
-	DecodeDDS(Data, USize, VSize, header, image);
+	// Decode block rows as separate DDS images
+	int BlockRowBytes = (USize + 3) / 4 * PixelFormatInfo[Format].BytesPerBlock;
+	DecodeBlockRows(USize, 4, (VSize + 3) / 4, [this, fourCC, Data, dst, USize, VSize, BlockRowBytes](int FirstRow, int NumRows)
+		{
+			int BandVSize = min(NumRows * 4, VSize - FirstRow * 4);
+			nv::DDSHeader header;
+			nv::Image image;
+			header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
+			header.setWidth(USize);
+			header.setHeight(BandVSize);
+			header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
+			DecodeDDS(Data + FirstRow * BlockRowBytes, USize, BandVSize, header, image);
 
-	byte *s = (byte*)image.pixels();
-	byte *d = dst;
+			ConvertBGRA8ToRGBA8((byte*)image.pixels(), dst + FirstRow * 4 * USize * 4, USize * BandVSize);
 
-	for (int i = 0; i < USize * VSize; i++, s += 4, d += 4)
-	{
-		// BGRA -> RGBA
-		d[0] = s[2];
-		d[1] = s[1];
-		d[2] = s[0];
-		d[3] = s[3];
-	}
+			if (Format == TPF_DXT1)
+				PostProcessAlpha(dst + FirstRow * 4 * USize * 4, USize, BandVSize);	//??
+		});
 
 	PROFILE_DDS(appPrintProfiler());
 
-	if (Format == TPF_DXT1)
-		PostProcessAlpha(dst, USize, VSize);	//??
-
 	return dst;
 	unguardf("fmt=%s(%d)", OriginalFormatName, OriginalFormatEnum);
 }
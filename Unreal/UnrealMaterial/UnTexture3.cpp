@@ -644,7 +644,7 @@ static int GetRealTextureOffset_MH(const UTexture2D *Obj, int MipIndex)
 #endif // MARVEL_HEROES
 
 
-bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, const char* tfcSuffix, bool verbose) const
+bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, int NumMips, const char* tfcSuffix, bool verbose) const
 {
 	const CGameFileInfo* bulkFile = NULL;
 
@@ -698,8 +698,13 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 #if UNREAL4
 		if (GetGame() >= GAME_UE4_BASE)
 		{
-			// Special case for UE4, it doesn't have TFC but has different data placement
-			return Mip.Data.SerializeData(this);
+			// Special case for UE4, it doesn't have TFC but has different data placement. Mips are usually
+			// stored one after another, so following mips could be read together with this one.
+			const FByteBulkData* Bulks[32];
+			NumMips = min(NumMips, (int)ARRAY_COUNT(Bulks));
+			for (int i = 0; i < NumMips; i++)
+				Bulks[i] = &MipsArray[MipIndex + i].Data;
+			return FByteBulkData::SerializeData(this, Bulks, NumMips);
 		}
 		else
 #endif // UNREAL4
@@ -774,6 +779,46 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 }
 
 
+bool UTexture2D::LoadTextureMip(CTextureData &TexData, int MipLevel, bool bLoadFollowingMips) const
+{
+	guard(UTexture2D::LoadTextureMip);
+
+	CMipMap& DstMip = TexData.Mips[MipLevel];
+
+	const char* tfcSuffix;
+	const TArray<FTexture2DMipMap> *MipsArray = GetMipmapArray(&tfcSuffix);
+	const FTexture2DMipMap &Mip = (*MipsArray)[DstMip.SourceMip];
+
+	if (!Mip.Data.BulkData)
+	{
+		// some optimization in a case of missing bulk file
+		if (TexData.bBulkFailed) return false;		// already checked for previous mip levels - no TFC file exists
+		// Count following pending mips which could be loaded with this one
+		int NumMips = 1;
+		if (bLoadFollowingMips)
+		{
+			while (MipLevel + NumMips < TexData.Mips.Num())
+			{
+				const CMipMap& NextMip = TexData.Mips[MipLevel + NumMips];
+				if (!NextMip.IsPending || NextMip.SourceMip != DstMip.SourceMip + NumMips) break;
+				NumMips++;
+			}
+		}
+		if (!LoadBulkTexture(*MipsArray, DstMip.SourceMip, NumMips, tfcSuffix, !TexData.bBulkLoaded))
+		{
+			TexData.bBulkFailed = true;
+			return false;
+		}
+		TexData.bBulkLoaded = true;
+	}
+
+	DstMip.SetBulkData(Mip.Data);
+	return true;
+
+	unguardf("%s", Name);
+}
+
+
 void UTexture2D::ReleaseTextureData() const
 {
 	guard(UTexture2D::ReleaseTextureData);
@@ -795,22 +840,30 @@ void UTexture2D::ReleaseTextureData() const
 }
 
 
-const TArray<FTexture2DMipMap>* UTexture2D::GetMipmapArray() const
+const TArray<FTexture2DMipMap>* UTexture2D::GetMipmapArray(const char** tfcSuffix) const
 {
 	guard(UTexture2D::GetMipmapArray);
 
 	const TArray<FTexture2DMipMap> *MipsArray = &Mips;
+	const char* Suffix = NULL;
 #if SUPPORT_ANDROID
 	if (!MipsArray->Num())
 	{
 		if (CachedETCMips.Num())
+		{
 			MipsArray = &CachedETCMips;
+			Suffix = "ETC";
+		}
 		else if (CachedPVRTCMips.Num())
+		{
 			MipsArray = &CachedPVRTCMips;
+			Suffix = "PVRTC";
+		}
 		else if (CachedATITCMips.Num())
 			MipsArray = &CachedATITCMips;
 	}
 #endif // SUPPORT_ANDROID
+	if (tfcSuffix) *tfcSuffix = Suffix;
 
 	return MipsArray;
 
@@ -972,71 +1025,38 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 	}
 #endif // TRIBES4
 
-	const TArray<FTexture2DMipMap> *MipsArray = &Mips;
-	const char* tfcSuffix = NULL;
-
-#if SUPPORT_ANDROID
-	if (!Mips.Num())
-	{
-		// Partial copy-paste from UTexture2D::GetMipmapArray(), but also provides tfcSuffix
-		if (CachedETCMips.Num())
-		{
-			MipsArray = &CachedETCMips;
-			tfcSuffix = "ETC";
-		}
-		else if (CachedPVRTCMips.Num())
-		{
-			MipsArray = &CachedPVRTCMips;
-			tfcSuffix = "PVRTC";
-		}
-//		else if (CachedATITCMips.Num())
-//		{
-//			return false;
-//		}
-	}
-#endif // SUPPORT_ANDROID
+	const TArray<FTexture2DMipMap> *MipsArray = GetMipmapArray();
 
 	if (TexData.Mips.Num() == 0 && MipsArray->Num())
 	{
-		// Mips weren't read with code above, and there's cooked mips in known format
-		bool bulkFailed = false;
-		bool dataLoaded = false;
+		// Mips weren't read with code above, and there's cooked mips in known format.
+		// Only describe mips here, data will be read with LoadTextureMip() when the mip will be used.
 		int OrigUSize = (*MipsArray)[0].SizeX;
 		int OrigVSize = (*MipsArray)[0].SizeY;
 		for (int mipLevel = 0; mipLevel < MipsArray->Num(); mipLevel++)
 		{
-			// find 1st mipmap with non-null data array
 			const FTexture2DMipMap &Mip = (*MipsArray)[mipLevel];
 			const FByteBulkData &Bulk = Mip.Data;
 			if (!Mip.Data.BulkData)
 			{
 				// check for external bulk
-				//?? Separate this function ?
 				//!! * -notfc cmdline switch
 				//!! * material viewer: support switching mip levels (for xbox decompression testing)
 				if (Bulk.BulkDataFlags & BULKDATA_Unused) continue;		// mip level is stripped
 				if (!(Bulk.BulkDataFlags & BULKDATA_StoreInSeparateFile)) continue; // equals to BULKDATA_PayloadAtEndOfFile for UE4
-				// some optimization in a case of missing bulk file
-				if (bulkFailed) continue;				// already checked for previous mip levels - no TFC file exists
-				if (!LoadBulkTexture(*MipsArray, mipLevel, tfcSuffix, !dataLoaded))
-				{
-					bulkFailed = true;
-					continue;	// note: this could be called for any mip level, not for the 1st only
-				}
-				else
-				{
-					dataLoaded = true;
-				}
 			}
 			// this mipmap has data
 			CMipMap* DstMip = new (TexData.Mips) CMipMap;
-			DstMip->SetBulkData(Bulk);
+			DstMip->IsPending = true;
+			DstMip->SourceMip = mipLevel;
+			DstMip->DataSize = Bulk.ElementCount * Bulk.GetElementSize();
 			// Note: UE3 can store incorrect SizeX/SizeY for lowest mips - these values could have 4x4 for all smaller mips
 			// (perhaps minimal size of DXT block). So compute mip size by ourselves.
 			DstMip->USize = max(1, OrigUSize >> mipLevel);
 			DstMip->VSize = max(1, OrigVSize >> mipLevel);
 //			printf("+%d: %d x %d (%X)\n", mipLevel, DstMip->USize, DstMip->VSize, DstMip->DataSize);
 			TexData.Platform = Package->Platform;
+			TexData.MipLoader = this;
 		}
 	}
 
@@ -1052,52 +1072,16 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 //		printf("Source png texture %dx%d\n", Source.SizeX, Source.SizeY);
 	}
 
-	// Decode console textures
-
-#if SUPPORT_XBOX360
-	if (TexData.Platform == PLATFORM_XBOX360)
+	// Decode console textures. Pending mips will be decoded when loaded.
+	for (int MipLevel = 0; MipLevel < TexData.Mips.Num(); MipLevel++)
 	{
-		for (int MipLevel = 0; MipLevel < TexData.Mips.Num(); MipLevel++)
+		if (!TexData.Mips[MipLevel].IsPending && !TexData.DecodeMip(MipLevel))
 		{
-			if (!TexData.DecodeXBox360(MipLevel))
-			{
-				// failed to decode this mip
-				TexData.Mips.RemoveAt(MipLevel, TexData.Mips.Num() - MipLevel);
-				break;
-			}
-		}
-	}
-#endif // SUPPORT_XBOX360
-
-#if SUPPORT_PS4
-	if (TexData.Platform == PLATFORM_PS4)
-	{
-		for (int MipLevel = 0; MipLevel < TexData.Mips.Num(); MipLevel++)
-		{
-			if (!TexData.DecodePS4(MipLevel))
-			{
-				// failed to decode this mip
-				TexData.Mips.RemoveAt(MipLevel, TexData.Mips.Num() - MipLevel);
-				break;
-			}
-		}
-	}
-#endif // SUPPORT_PS4
-
-#if SUPPORT_SWITCH
-	if (TexData.Platform == PLATFORM_SWITCH)
-	{
-		for (int MipLevel = 0; MipLevel < TexData.Mips.Num(); MipLevel++)
-		{
-			if (!TexData.DecodeNSW(MipLevel))
-			{
-				// failed to decode this mip
-				TexData.Mips.RemoveAt(MipLevel, TexData.Mips.Num() - MipLevel);
-				break;
-			}
+			// failed to decode this mip
+			TexData.Mips.RemoveAt(MipLevel, TexData.Mips.Num() - MipLevel);
+			break;
 		}
 	}
-#endif // SUPPORT_SWITCH
 
 	return (TexData.Mips.Num() > 0);
 
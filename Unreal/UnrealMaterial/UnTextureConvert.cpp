@@ -0,0 +1,497 @@
+#include "Core.h"
+#include "UnCore.h"
+#include "UnObject.h"
+#include "UnMaterial.h"
+
+/*-----------------------------------------------------------------------------
+	Pixel format conversion
+-----------------------------------------------------------------------------*/
+
+// Every conversion has a scalar reference version, which is also used for processing the tail
+// of the pixel array, and SIMD versions which should produce exactly the same bytes.
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define USE_SIMD_CONVERT	1
+#endif
+
+#if USE_SIMD_CONVERT
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#if _MSC_VER
+#include <intrin.h>
+#define SSSE3_FUNC
+#define AVX2_FUNC
+#else
+#include <cpuid.h>
+#define SSSE3_FUNC		__attribute__((target("ssse3")))
+#define AVX2_FUNC		__attribute__((target("avx2")))
+#endif
+
+static EPixelConvertLevel DetectPixelConvertLevel()
+{
+	EPixelConvertLevel Level = PIXEL_CONVERT_SSE2;		// the whole project is compiled with SSE2
+#if _MSC_VER
+	int Info[4];
+	__cpuid(Info, 0);
+	int MaxLeaf = Info[0];
+	__cpuid(Info, 1);
+	bool HasSSSE3 = (Info[2] & (1 << 9)) != 0;
+	bool HasOSXSave = (Info[2] & (1 << 27)) != 0;
+	bool HasAVX2 = false;
+	if (HasOSXSave && MaxLeaf >= 7 && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(Info, 7, 0);
+		HasAVX2 = (Info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool HasSSSE3 = __builtin_cpu_supports("ssse3") != 0;
+	bool HasAVX2 = __builtin_cpu_supports("avx2") != 0;	// verifies OS support for YMM registers too
+#endif
+	if (HasSSSE3)
+	{
+		Level = PIXEL_CONVERT_SSSE3;
+		if (HasAVX2) Level = PIXEL_CONVERT_AVX2;
+	}
+	return Level;
+}
+
+#else // USE_SIMD_CONVERT
+
+static EPixelConvertLevel DetectPixelConvertLevel()
+{
+	return PIXEL_CONVERT_SCALAR;
+}
+
+#endif // USE_SIMD_CONVERT
+
+static EPixelConvertLevel MaxPixelConvertLevel = PIXEL_CONVERT_AVX2;
+
+static EPixelConvertLevel GetPixelConvertLevel()
+{
+	static const EPixelConvertLevel SupportedLevel = DetectPixelConvertLevel();
+	return min(SupportedLevel, MaxPixelConvertLevel);
+}
+
+EPixelConvertLevel SetPixelConvertLevel(EPixelConvertLevel MaxLevel)
+{
+	MaxPixelConvertLevel = MaxLevel;
+	return GetPixelConvertLevel();
+}
+
+
+/*-----------------------------------------------------------------------------
+	BGR8 -> RGBA8
+-----------------------------------------------------------------------------*/
+
+static void ConvertBGR8ToRGBA8_Scalar(const byte* s, byte* d, int NumPixels)
+{
+	for (int i = 0; i < NumPixels; i++)
+	{
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = 255;
+		s += 3;
+		d += 4;
+	}
+}
+
+#if USE_SIMD_CONVERT
+
+// Each 16-byte load covers 4 pixels (12 bytes), so a load needs at least 6 pixels left in the source
+SSSE3_FUNC static int ConvertBGR8ToRGBA8_SSSE3(const byte* s, byte* d, int NumPixels)
+{
+	const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i Alpha = _mm_set1_epi32(0xFF000000);
+	int i = 0;
+	for ( ; i + 6 <= NumPixels; i += 4, s += 12, d += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		_mm_storeu_si128((__m128i*)d, _mm_or_si128(_mm_shuffle_epi8(v, Shuffle), Alpha));
+	}
+	return i;
+}
+
+AVX2_FUNC static int ConvertBGR8ToRGBA8_AVX2(const byte* s, byte* d, int NumPixels)
+{
+	const __m256i Shuffle = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	const __m256i Alpha = _mm256_set1_epi32(0xFF000000);
+	int i = 0;
+	for ( ; i + 10 <= NumPixels; i += 8, s += 24, d += 32)
+	{
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)s)),
+			_mm_loadu_si128((const __m128i*)(s + 12)), 1);
+		_mm256_storeu_si256((__m256i*)d, _mm256_or_si256(_mm256_shuffle_epi8(v, Shuffle), Alpha));
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertBGR8ToRGBA8(const byte* Src, byte* Dst, int NumPixels)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	EPixelConvertLevel Level = GetPixelConvertLevel();
+	if (Level >= PIXEL_CONVERT_AVX2)
+		Done = ConvertBGR8ToRGBA8_AVX2(Src, Dst, NumPixels);
+	else if (Level >= PIXEL_CONVERT_SSSE3)
+		Done = ConvertBGR8ToRGBA8_SSSE3(Src, Dst, NumPixels);
+#endif
+	ConvertBGR8ToRGBA8_Scalar(Src + Done * 3, Dst + Done * 4, NumPixels - Done);
+}
+
+
+/*-----------------------------------------------------------------------------
+	BGRA8 -> RGBA8
+-----------------------------------------------------------------------------*/
+
+static void ConvertBGRA8ToRGBA8_Scalar(const byte* s, byte* d, int NumPixels)
+{
+	for (int i = 0; i < NumPixels; i++)
+	{
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = s[3];
+		s += 4;
+		d += 4;
+	}
+}
+
+#if USE_SIMD_CONVERT
+
+static int ConvertBGRA8ToRGBA8_SSE2(const byte* s, byte* d, int NumPixels)
+{
+	const __m128i MaskGA = _mm_set1_epi32(0xFF00FF00);
+	const __m128i MaskB = _mm_set1_epi32(0x000000FF);
+	int i = 0;
+	for ( ; i + 4 <= NumPixels; i += 4, s += 16, d += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		__m128i GA = _mm_and_si128(v, MaskGA);
+		__m128i R = _mm_and_si128(_mm_srli_epi32(v, 16), MaskB);
+		__m128i B = _mm_slli_epi32(_mm_and_si128(v, MaskB), 16);
+		_mm_storeu_si128((__m128i*)d, _mm_or_si128(GA, _mm_or_si128(R, B)));
+	}
+	return i;
+}
+
+SSSE3_FUNC static int ConvertBGRA8ToRGBA8_SSSE3(const byte* s, byte* d, int NumPixels)
+{
+	const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int i = 0;
+	for ( ; i + 4 <= NumPixels; i += 4, s += 16, d += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		_mm_storeu_si128((__m128i*)d, _mm_shuffle_epi8(v, Shuffle));
+	}
+	return i;
+}
+
+AVX2_FUNC static int ConvertBGRA8ToRGBA8_AVX2(const byte* s, byte* d, int NumPixels)
+{
+	const __m256i Shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int i = 0;
+	for ( ; i + 8 <= NumPixels; i += 8, s += 32, d += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)s);
+		_mm256_storeu_si256((__m256i*)d, _mm256_shuffle_epi8(v, Shuffle));
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertBGRA8ToRGBA8(const byte* Src, byte* Dst, int NumPixels)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	EPixelConvertLevel Level = GetPixelConvertLevel();
+	if (Level >= PIXEL_CONVERT_AVX2)
+		Done = ConvertBGRA8ToRGBA8_AVX2(Src, Dst, NumPixels);
+	else if (Level >= PIXEL_CONVERT_SSSE3)
+		Done = ConvertBGRA8ToRGBA8_SSSE3(Src, Dst, NumPixels);
+	else if (Level >= PIXEL_CONVERT_SSE2)
+		Done = ConvertBGRA8ToRGBA8_SSE2(Src, Dst, NumPixels);
+#endif
+	ConvertBGRA8ToRGBA8_Scalar(Src + Done * 4, Dst + Done * 4, NumPixels - Done);
+}
+
+
+/*-----------------------------------------------------------------------------
+	RGBA4 -> RGBA8
+-----------------------------------------------------------------------------*/
+
+static void ConvertRGBA4ToRGBA8_Scalar(const byte* s, byte* d, int NumPixels)
+{
+	for (int i = 0; i < NumPixels; i++)
+	{
+		byte b1 = s[0];
+		byte b2 = s[1];
+		// BGRA -> RGBA
+		d[0] = b2 & 0xF0;
+		d[1] = (b2 & 0xF) << 4;
+		d[2] = b1 & 0xF0;
+		d[3] = (b1 & 0xF) << 4;
+		s += 2;
+		d += 4;
+	}
+}
+
+#if USE_SIMD_CONVERT
+
+static int ConvertRGBA4ToRGBA8_SSE2(const byte* s, byte* d, int NumPixels)
+{
+	const __m128i MaskHi = _mm_set1_epi8((char)0xF0);
+	const __m128i MaskLo = _mm_set1_epi8(0x0F);
+	int i = 0;
+	for ( ; i + 8 <= NumPixels; i += 8, s += 16, d += 32)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		__m128i Hi = _mm_and_si128(v, MaskHi);
+		__m128i Lo = _mm_slli_epi16(_mm_and_si128(v, MaskLo), 4);	// nibbles don't cross byte boundary
+		// interleave to (b1 & F0, b1 << 4, b2 & F0, b2 << 4), then swap b1 and b2 parts
+		__m128i p0 = _mm_unpacklo_epi8(Hi, Lo);
+		__m128i p1 = _mm_unpackhi_epi8(Hi, Lo);
+		p0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p0, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		p1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p1, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i*)d, p0);
+		_mm_storeu_si128((__m128i*)(d + 16), p1);
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertRGBA4ToRGBA8(const byte* Src, byte* Dst, int NumPixels)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	if (GetPixelConvertLevel() >= PIXEL_CONVERT_SSE2)
+		Done = ConvertRGBA4ToRGBA8_SSE2(Src, Dst, NumPixels);
+#endif
+	ConvertRGBA4ToRGBA8_Scalar(Src + Done * 2, Dst + Done * 4, NumPixels - Done);
+}
+
+
+/*-----------------------------------------------------------------------------
+	G8 -> RGBA8
+-----------------------------------------------------------------------------*/
+
+static void ConvertG8ToRGBA8_Scalar(const byte* s, byte* d, int NumPixels)
+{
+	for (int i = 0; i < NumPixels; i++)
+	{
+		byte b = *s++;
+		d[0] = b;
+		d[1] = b;
+		d[2] = b;
+		d[3] = 255;
+		d += 4;
+	}
+}
+
+#if USE_SIMD_CONVERT
+
+static int ConvertG8ToRGBA8_SSE2(const byte* s, byte* d, int NumPixels)
+{
+	const __m128i Alpha = _mm_set1_epi8((char)0xFF);
+	int i = 0;
+	for ( ; i + 16 <= NumPixels; i += 16, s += 16, d += 64)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		__m128i GGLo = _mm_unpacklo_epi8(v, v);
+		__m128i GGHi = _mm_unpackhi_epi8(v, v);
+		__m128i GALo = _mm_unpacklo_epi8(v, Alpha);
+		__m128i GAHi = _mm_unpackhi_epi8(v, Alpha);
+		_mm_storeu_si128((__m128i*)d,        _mm_unpacklo_epi16(GGLo, GALo));
+		_mm_storeu_si128((__m128i*)(d + 16), _mm_unpackhi_epi16(GGLo, GALo));
+		_mm_storeu_si128((__m128i*)(d + 32), _mm_unpacklo_epi16(GGHi, GAHi));
+		_mm_storeu_si128((__m128i*)(d + 48), _mm_unpackhi_epi16(GGHi, GAHi));
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertG8ToRGBA8(const byte* Src, byte* Dst, int NumPixels)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	if (GetPixelConvertLevel() >= PIXEL_CONVERT_SSE2)
+		Done = ConvertG8ToRGBA8_SSE2(Src, Dst, NumPixels);
+#endif
+	ConvertG8ToRGBA8_Scalar(Src + Done, Dst + Done * 4, NumPixels - Done);
+}
+
+
+/*-----------------------------------------------------------------------------
+	V8U8 -> RGBA8
+-----------------------------------------------------------------------------*/
+
+static void ConvertV8U8ToRGBA8_Scalar(const byte* s, byte* d, int NumPixels, byte offset)
+{
+	for (int i = 0; i < NumPixels; i++)
+	{
+		byte u = *s++ + offset;		// byte + byte -> byte, overflow is normal here
+		byte v = *s++ + offset;
+		d[0] = u;
+		d[1] = v;
+		float uf = (u - offset) / 255.0f * 2 - 1;
+		float vf = (v - offset) / 255.0f * 2 - 1;
+		float t  = 1.0f - uf * uf - vf * vf;
+		if (t >= 0)
+			d[2] = 255 - 255 * appFloor(sqrt(t));	//!! TODO: check for correct function here - should be (t+1.0)*127.5, at least for 'offset==0'
+		else
+			d[2] = 255;
+		d[3] = 255;
+		d += 4;
+	}
+}
+
+#if USE_SIMD_CONVERT
+
+// t <= 1, so floor(sqrt(t)) is 1 only when t == 1, and the blue channel is either 0 or 255
+static int ConvertV8U8ToRGBA8_SSE2(const byte* s, byte* d, int NumPixels, byte offset)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Offset8 = _mm_set1_epi8(offset);
+	const __m128i Offset32 = _mm_set1_epi32(offset);
+	const __m128i Blue = _mm_set1_epi32(255);
+	const __m128i Alpha = _mm_set1_epi16((short)0xFF00);
+	const __m128 Scale = _mm_set1_ps(255.0f);
+	const __m128 Two = _mm_set1_ps(2.0f);
+	const __m128 One = _mm_set1_ps(1.0f);
+	int i = 0;
+	for ( ; i + 4 <= NumPixels; i += 4, s += 8, d += 16)
+	{
+		// (u0 v0 u1 v1 u2 v2 u3 v3) with offset applied
+		__m128i UV = _mm_add_epi8(_mm_loadl_epi64((const __m128i*)s), Offset8);
+		__m128i UV16 = _mm_unpacklo_epi8(UV, Zero);
+		__m128i UV01 = _mm_sub_epi32(_mm_unpacklo_epi16(UV16, Zero), Offset32);
+		__m128i UV23 = _mm_sub_epi32(_mm_unpackhi_epi16(UV16, Zero), Offset32);
+		// the same float operations as in scalar code
+		__m128 F01 = _mm_sub_ps(_mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(UV01), Scale), Two), One);
+		__m128 F23 = _mm_sub_ps(_mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(UV23), Scale), Two), One);
+		F01 = _mm_mul_ps(F01, F01);
+		F23 = _mm_mul_ps(F23, F23);
+		__m128 UU = _mm_shuffle_ps(F01, F23, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 VV = _mm_shuffle_ps(F01, F23, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 T = _mm_sub_ps(_mm_sub_ps(One, UU), VV);
+		__m128i B = _mm_andnot_si128(_mm_castps_si128(_mm_cmpge_ps(T, One)), Blue);
+		// (B, 255) words interleaved with (U, V) words
+		__m128i BA = _mm_or_si128(_mm_packs_epi32(B, B), Alpha);
+		_mm_storeu_si128((__m128i*)d, _mm_unpacklo_epi16(UV, BA));
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertV8U8ToRGBA8(const byte* Src, byte* Dst, int NumPixels, byte Offset)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	if (GetPixelConvertLevel() >= PIXEL_CONVERT_SSE2)
+		Done = ConvertV8U8ToRGBA8_SSE2(Src, Dst, NumPixels, Offset);
+#endif
+	ConvertV8U8ToRGBA8_Scalar(Src + Done * 2, Dst + Done * 4, NumPixels - Done, Offset);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Half -> float
+-----------------------------------------------------------------------------*/
+
+static void ConvertHalfToFloat_Scalar(const uint16* s, float* d, int NumValues)
+{
+	for (int i = 0; i < NumValues; i++)
+		d[i] = half2float(s[i]);
+}
+
+#if USE_SIMD_CONVERT
+
+// Bit-exact version of half2float(): exponent is rebased without special handling of zero,
+// denormals, infinity and NaN. Exponent can't exceed 8 bits, so a single addition does it.
+static FORCEINLINE __m128i HalfToFloatBits_SSE2(__m128i h)
+{
+	__m128i Sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+	__m128i ExpMant = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+	return _mm_or_si128(Sign, _mm_add_epi32(ExpMant, _mm_set1_epi32((127 - 15) << 23)));
+}
+
+static int ConvertHalfToFloat_SSE2(const uint16* s, float* d, int NumValues)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	int i = 0;
+	for ( ; i + 8 <= NumValues; i += 8)
+	{
+		__m128i h = _mm_loadu_si128((const __m128i*)(s + i));
+		_mm_storeu_si128((__m128i*)(d + i),     HalfToFloatBits_SSE2(_mm_unpacklo_epi16(h, Zero)));
+		_mm_storeu_si128((__m128i*)(d + i + 4), HalfToFloatBits_SSE2(_mm_unpackhi_epi16(h, Zero)));
+	}
+	return i;
+}
+
+AVX2_FUNC static int ConvertHalfToFloat_AVX2(const uint16* s, float* d, int NumValues)
+{
+	const __m256i MaskSign = _mm256_set1_epi32(0x8000);
+	const __m256i MaskExpMant = _mm256_set1_epi32(0x7FFF);
+	const __m256i ExpBias = _mm256_set1_epi32((127 - 15) << 23);
+	int i = 0;
+	for ( ; i + 8 <= NumValues; i += 8)
+	{
+		__m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + i)));
+		__m256i Sign = _mm256_slli_epi32(_mm256_and_si256(h, MaskSign), 16);
+		__m256i ExpMant = _mm256_slli_epi32(_mm256_and_si256(h, MaskExpMant), 13);
+		_mm256_storeu_si256((__m256i*)(d + i), _mm256_or_si256(Sign, _mm256_add_epi32(ExpMant, ExpBias)));
+	}
+	return i;
+}
+
+#endif // USE_SIMD_CONVERT
+
+void ConvertHalfToFloat(const uint16* Src, float* Dst, int NumValues)
+{
+	int Done = 0;
+#if USE_SIMD_CONVERT
+	EPixelConvertLevel Level = GetPixelConvertLevel();
+	if (Level >= PIXEL_CONVERT_AVX2)
+		Done = ConvertHalfToFloat_AVX2(Src, Dst, NumValues);
+	else if (Level >= PIXEL_CONVERT_SSE2)
+		Done = ConvertHalfToFloat_SSE2(Src, Dst, NumValues);
+#endif
+	ConvertHalfToFloat_Scalar(Src + Done, Dst + Done, NumValues - Done);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Alpha channel analysis
+-----------------------------------------------------------------------------*/
+
+// Find minimal and maximal alpha values of RGBA8 pixels
+static void FindAlphaRange(const byte* s, int NumPixels, byte& MinAlpha, byte& MaxAlpha)
+{
+	for (int i = 0; i < NumPixels; i++, s += 4)
+	{
+		byte a = s[3];
+		if (a < MinAlpha) MinAlpha = a;
+		if (a > MaxAlpha) MaxAlpha = a;
+	}
+}
+
+bool IsAlphaChannelUsed(const byte* Src, int NumPixels)
+{
+	// Note: there's no SIMD version, the compiler vectorizes the scalar loop well, and hand-written
+	// SSE2 code was slower (see "pixel" test in Tools/Benchmark).
+	byte MinAlpha = 255, MaxAlpha = 0;
+	FindAlphaRange(Src, NumPixels, MinAlpha, MaxAlpha);
+	// Alpha is not needed when image is fully opaque or fully transparent
+	return MinAlpha != 255 && MaxAlpha != 0;
+}
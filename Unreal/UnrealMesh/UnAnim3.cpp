@@ -581,6 +581,27 @@ void ReadBnS_ZOnlyRLE(FArchive& Reader, int RotKeys, CAnimTrack* A)
 
 #endif // BLADENSOUL
 
+static int GetOffsetsPerBone(const UAnimSequence* Seq, int ArGame)
+{
+	int offsetsPerBone = 4;
+	if (Seq->KeyEncodingFormat == AKF_PerTrackCompression)
+		offsetsPerBone = 2;
+#if TLR
+	if (ArGame == GAME_TLR) offsetsPerBone = 6;
+#endif
+#if XMEN
+	if (ArGame == GAME_XMen) offsetsPerBone = 6;		// has additional CutInfo array
+#endif
+	return offsetsPerBone;
+}
+
+// Callback for CAnimSequence, decodes tracks when the sequence is used for the first time
+static void DecodeAnimSetSequence(const UObject* Owner, CAnimSequence& Dst)
+{
+	const UAnimSet* AnimSet = static_cast<const UAnimSet*>(Owner);
+	AnimSet->DecodeSequence(static_cast<const UAnimSequence*>(Dst.OriginalSequence), &Dst);
+}
+
 void UAnimSet::ConvertAnims()
 {
 	guard(UAnimSet::ConvertAnims);
@@ -590,7 +611,6 @@ void UAnimSet::ConvertAnims()
 	CAnimSet *AnimSet = new CAnimSet(this);
 	ConvertedAnim = AnimSet;
 
-	int ArVer  = GetArVer();
 	int ArGame = GetGame();
 
 #if MASSEFF
@@ -617,9 +637,6 @@ void UAnimSet::ConvertAnims()
 	}
 	CopyArray(AnimSet->TrackBoneNames, TrackBoneNames);
 
-#if FIND_HOLES
-	bool findHoles = true;
-#endif
 	int NumTracks = TrackBoneNames.Num();
 
 	if (UseTranslationBoneNames.Num() || ForceMeshTranslationBoneNames.Num())
@@ -735,15 +752,7 @@ void UAnimSet::ConvertAnims()
 		}
 #endif // BATMAN
 		// some checks
-		int offsetsPerBone = 4;
-		if (Seq->KeyEncodingFormat == AKF_PerTrackCompression)
-			offsetsPerBone = 2;
-#if TLR
-		if (ArGame == GAME_TLR) offsetsPerBone = 6;
-#endif
-#if XMEN
-		if (ArGame == GAME_XMen) offsetsPerBone = 6;		// has additional CutInfo array
-#endif
+		int offsetsPerBone = GetOffsetsPerBone(Seq, ArGame);
 		if (Seq->CompressedTrackOffsets.Num() != NumTracks * offsetsPerBone && !Seq->RawAnimData.Num())
 		{
 			appNotify("AnimSequence %s/%s has wrong CompressedTrackOffsets size (has %d, expected %d), removing track",
@@ -759,546 +768,567 @@ void UAnimSet::ConvertAnims()
 		Dst->Rate      = Seq->NumFrames / Seq->SequenceLength * Seq->RateScale;
 		Dst->bAdditive = Seq->bIsAdditive;
 
-		// bone tracks ...
-		Dst->Tracks.Empty(NumTracks);
+		// tracks will be decoded when the sequence is sampled or exported
+		Dst->SetDecoder(DecodeAnimSetSequence, this);
+	}
 
-		// There could be an animation consisting of only trans with offsets == -1, what means
-		// use of RefPose. In this case there's no point adding the animation to AnimSet. We'll
-		// create FMemReader even for empty CompressedByteStream, otherwise it would be hard to
-		// create a valid CAnimSequence which won't crash animation export.
-		FMemReader Reader(
-			Seq->CompressedByteStream.Num() ? Seq->CompressedByteStream.GetData() : (const uint8*)"",
-			Seq->CompressedByteStream.Num());
-		Reader.SetupFrom(*Package);
+	unguard;
+}
 
-		bool HasTimeTracks = (Seq->KeyEncodingFormat == AKF_VariableKeyLerp);
+void UAnimSet::DecodeSequence(const UAnimSequence* Seq, CAnimSequence* Dst) const
+{
+	guard(UAnimSet::DecodeSequence);
 
-		int offsetIndex = 0;
-		for (j = 0; j < NumTracks; j++, offsetIndex += offsetsPerBone)
-		{
-			CAnimTrack *A = new CAnimTrack;
-			Dst->Tracks.Add(A);
+	int j;
 
-			int k;
+	int ArVer  = GetArVer();
+	int ArGame = GetGame();
 
-			if (!Seq->CompressedTrackOffsets.Num())	//?? or if RawAnimData.Num() != 0
-			{
-				// using RawAnimData array
-				assert(Seq->RawAnimData.Num() == NumTracks);
-				CopyArray(A->KeyPos,  CVT(Seq->RawAnimData[j].PosKeys));
-				CopyArray(A->KeyQuat, CVT(Seq->RawAnimData[j].RotKeys));
-				CopyArray(A->KeyTime, Seq->RawAnimData[j].KeyTimes);	// may be empty
-				for (int k = 0; k < A->KeyTime.Num(); k++)
-					A->KeyTime[k] *= Dst->Rate;
-				continue;
-			}
+#if FIND_HOLES
+	bool findHoles = true;
+#endif
+	int NumTracks = TrackBoneNames.Num();
+	int offsetsPerBone = GetOffsetsPerBone(Seq, ArGame);
 
-			FVector Mins, Ranges;	// common ...
-			static const CVec3 nullVec  = { 0, 0, 0 };
-			static const CQuat nullQuat = { 0, 0, 0, 1 };
+	// bone tracks ...
+	Dst->Tracks.Empty(NumTracks);
 
-			//----------------------------------------------
-			// decode AKF_PerTrackCompression data
-			//----------------------------------------------
-			if (Seq->KeyEncodingFormat == AKF_PerTrackCompression)
-			{
-				// this format uses different key storage
-				guard(PerTrackCompression);
-				assert(Seq->TranslationCompressionFormat == ACF_Identity);
-				assert(Seq->RotationCompressionFormat == ACF_Identity);
+	// There could be an animation consisting of only trans with offsets == -1, what means
+	// use of RefPose. In this case there's no point adding the animation to AnimSet. We'll
+	// create FMemReader even for empty CompressedByteStream, otherwise it would be hard to
+	// create a valid CAnimSequence which won't crash animation export.
+	FMemReader Reader(
+		Seq->CompressedByteStream.Num() ? Seq->CompressedByteStream.GetData() : (const uint8*)"",
+		Seq->CompressedByteStream.Num());
+	Reader.SetupFrom(*Package);
 
-				int TransOffset = Seq->CompressedTrackOffsets[offsetIndex  ];
-				int RotOffset   = Seq->CompressedTrackOffsets[offsetIndex+1];
+	bool HasTimeTracks = (Seq->KeyEncodingFormat == AKF_VariableKeyLerp);
 
-				uint32 PackedInfo;
-				AnimationCompressionFormat KeyFormat;
-				int ComponentMask;
-				int NumKeys;
+	int offsetIndex = 0;
+	for (j = 0; j < NumTracks; j++, offsetIndex += offsetsPerBone)
+	{
+		CAnimTrack *A = new CAnimTrack;
+		Dst->Tracks.Add(A);
+
+		int k;
+
+		if (!Seq->CompressedTrackOffsets.Num())	//?? or if RawAnimData.Num() != 0
+		{
+			// using RawAnimData array
+			assert(Seq->RawAnimData.Num() == NumTracks);
+			CopyArray(A->KeyPos,  CVT(Seq->RawAnimData[j].PosKeys));
+			CopyArray(A->KeyQuat, CVT(Seq->RawAnimData[j].RotKeys));
+			CopyArray(A->KeyTime, Seq->RawAnimData[j].KeyTimes);	// may be empty
+			for (int k = 0; k < A->KeyTime.Num(); k++)
+				A->KeyTime[k] *= Dst->Rate;
+			continue;
+		}
+
+		FVector Mins, Ranges;	// common ...
+		static const CVec3 nullVec  = { 0, 0, 0 };
+		static const CQuat nullQuat = { 0, 0, 0, 1 };
+
+		//----------------------------------------------
+		// decode AKF_PerTrackCompression data
+		//----------------------------------------------
+		if (Seq->KeyEncodingFormat == AKF_PerTrackCompression)
+		{
+			// this format uses different key storage
+			guard(PerTrackCompression);
+			assert(Seq->TranslationCompressionFormat == ACF_Identity);
+			assert(Seq->RotationCompressionFormat == ACF_Identity);
+
+			int TransOffset = Seq->CompressedTrackOffsets[offsetIndex  ];
+			int RotOffset   = Seq->CompressedTrackOffsets[offsetIndex+1];
+
+			uint32 PackedInfo;
+			AnimationCompressionFormat KeyFormat;
+			int ComponentMask;
+			int NumKeys;
 
 #define DECODE_PER_TRACK_INFO(info)										\
-				KeyFormat = (AnimationCompressionFormat)(info >> 28);	\
-				ComponentMask = (info >> 24) & 0xF;						\
-				NumKeys       = info & 0xFFFFFF;						\
-				HasTimeTracks = (ComponentMask & 8) != 0;
-
-				guard(TransKeys);
-				// read translation keys
-				if (TransOffset == -1)
+			KeyFormat = (AnimationCompressionFormat)(info >> 28);	\
+			ComponentMask = (info >> 24) & 0xF;						\
+			NumKeys       = info & 0xFFFFFF;						\
+			HasTimeTracks = (ComponentMask & 8) != 0;
+
+			guard(TransKeys);
+			// read translation keys
+			if (TransOffset == -1)
+			{
+				A->KeyPos.Add(nullVec);
+				DBG("    [%d] no translation data\n", j);
+			}
+			else
+			{
+				Reader.Seek(TransOffset);
+				Reader << PackedInfo;
+				DECODE_PER_TRACK_INFO(PackedInfo);
+				A->KeyPos.Empty(NumKeys);
+				DBG("    [%d] trans: fmt=%d (%s), %d keys, mask %d\n", j,
+					KeyFormat, EnumToName(KeyFormat), NumKeys, ComponentMask
+				);
+				if (KeyFormat == ACF_IntervalFixed32NoW)
 				{
-					A->KeyPos.Add(nullVec);
-					DBG("    [%d] no translation data\n", j);
+					// read mins/maxs
+					Mins.Set(0, 0, 0);
+					Ranges.Set(0, 0, 0);
+					if (ComponentMask & 1) Reader << Mins.X << Ranges.X;
+					if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
+					if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
 				}
-				else
+				for (k = 0; k < NumKeys; k++)
 				{
-					Reader.Seek(TransOffset);
-					Reader << PackedInfo;
-					DECODE_PER_TRACK_INFO(PackedInfo);
-					A->KeyPos.Empty(NumKeys);
-					DBG("    [%d] trans: fmt=%d (%s), %d keys, mask %d\n", j,
-						KeyFormat, EnumToName(KeyFormat), NumKeys, ComponentMask
-					);
-					if (KeyFormat == ACF_IntervalFixed32NoW)
-					{
-						// read mins/maxs
-						Mins.Set(0, 0, 0);
-						Ranges.Set(0, 0, 0);
-						if (ComponentMask & 1) Reader << Mins.X << Ranges.X;
-						if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
-						if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
-					}
-					for (k = 0; k < NumKeys; k++)
+					switch (KeyFormat)
 					{
-						switch (KeyFormat)
-						{
 //						case ACF_None:
-						case ACF_Float96NoW:
+					case ACF_Float96NoW:
+						{
+							FVector v;
+							if (ComponentMask & 7)
 							{
-								FVector v;
-								if (ComponentMask & 7)
-								{
-									v.Set(0, 0, 0);
-									if (ComponentMask & 1) Reader << v.X;
-									if (ComponentMask & 2) Reader << v.Y;
-									if (ComponentMask & 4) Reader << v.Z;
-								}
-								else
-								{
-									// ACF_Float96NoW has a special case for ((ComponentMask & 7) == 0)
-									Reader << v;
-								}
-								A->KeyPos.Add(CVT(v));
+								v.Set(0, 0, 0);
+								if (ComponentMask & 1) Reader << v.X;
+								if (ComponentMask & 2) Reader << v.Y;
+								if (ComponentMask & 4) Reader << v.Z;
 							}
-							break;
-						TPR(ACF_IntervalFixed32NoW, FVectorIntervalFixed32)
-						case ACF_Fixed48NoW:
+							else
 							{
-								uint16 X, Y, Z;
-								CVec3 v;
-								v.Set(0, 0, 0);
-								if (ComponentMask & 1)
-								{
-									Reader << X; v[0] = DecodeFixed48_PerTrackComponent<7>(X);
-								}
-								if (ComponentMask & 2)
-								{
-									Reader << Y; v[1] = DecodeFixed48_PerTrackComponent<7>(Y);
-								}
-								if (ComponentMask & 4)
-								{
-									Reader << Z; v[2] = DecodeFixed48_PerTrackComponent<7>(Z);
-								}
-								A->KeyPos.Add(v);
+								// ACF_Float96NoW has a special case for ((ComponentMask & 7) == 0)
+								Reader << v;
 							}
-							break;
-						case ACF_Identity:
-							A->KeyPos.Add(nullVec);
-							break;
-						default:
-							appError("Unknown translation compression method: %d (%s)", KeyFormat, EnumToName(KeyFormat));
+							A->KeyPos.Add(CVT(v));
 						}
+						break;
+					TPR(ACF_IntervalFixed32NoW, FVectorIntervalFixed32)
+					case ACF_Fixed48NoW:
+						{
+							uint16 X, Y, Z;
+							CVec3 v;
+							v.Set(0, 0, 0);
+							if (ComponentMask & 1)
+							{
+								Reader << X; v[0] = DecodeFixed48_PerTrackComponent<7>(X);
+							}
+							if (ComponentMask & 2)
+							{
+								Reader << Y; v[1] = DecodeFixed48_PerTrackComponent<7>(Y);
+							}
+							if (ComponentMask & 4)
+							{
+								Reader << Z; v[2] = DecodeFixed48_PerTrackComponent<7>(Z);
+							}
+							A->KeyPos.Add(v);
+						}
+						break;
+					case ACF_Identity:
+						A->KeyPos.Add(nullVec);
+						break;
+					default:
+						appError("Unknown translation compression method: %d (%s)", KeyFormat, EnumToName(KeyFormat));
 					}
-					// align to 4 bytes
-					Reader.Seek(Align(Reader.Tell(), 4));
-					if (HasTimeTracks)
-						ReadTimeArray(Reader, NumKeys, A->KeyPosTime, Seq->NumFrames);
 				}
-				unguard;
+				// align to 4 bytes
+				Reader.Seek(Align(Reader.Tell(), 4));
+				if (HasTimeTracks)
+					ReadTimeArray(Reader, NumKeys, A->KeyPosTime, Seq->NumFrames);
+			}
+			unguard;
 
-				guard(RotKeys);
-				// read rotation keys
-				if (RotOffset == -1)
+			guard(RotKeys);
+			// read rotation keys
+			if (RotOffset == -1)
+			{
+				A->KeyQuat.Add(nullQuat);
+				DBG("    [%d] no rotation data\n", j);
+			}
+			else
+			{
+				Reader.Seek(RotOffset);
+				Reader << PackedInfo;
+				DECODE_PER_TRACK_INFO(PackedInfo);
+#if BORDERLANDS
+				if (ArGame == GAME_Borderlands || ArGame == GAME_AliensCM)	// Borderlands 2
 				{
-					A->KeyQuat.Add(nullQuat);
-					DBG("    [%d] no rotation data\n", j);
+					// this game has more different key formats; each described by number. which
+					// could differ from numbers in UnMesh3.h; so, transcode format
+					switch (KeyFormat)
+					{
+					case 6:  KeyFormat = ACF_Delta40NoW; break; // not used
+					case 7:  KeyFormat = ACF_Delta48NoW; break; // not used
+					case 8:  KeyFormat = ACF_Identity;   break;
+					case 9:  KeyFormat = ACF_PolarEncoded32; break;
+					case 10: KeyFormat = ACF_PolarEncoded48; break;
+					}
 				}
-				else
+#endif // BORDERLANDS
+				A->KeyQuat.Empty(NumKeys);
+				DBG("    [%d] rot  : fmt=%d (%s), %d keys, mask %d\n", j,
+					KeyFormat, EnumToName(KeyFormat), NumKeys, ComponentMask
+				);
+				if (KeyFormat == ACF_IntervalFixed32NoW)
 				{
-					Reader.Seek(RotOffset);
-					Reader << PackedInfo;
-					DECODE_PER_TRACK_INFO(PackedInfo);
-#if BORDERLANDS
-					if (ArGame == GAME_Borderlands || ArGame == GAME_AliensCM)	// Borderlands 2
+					// read mins/maxs
+					Mins.Set(0, 0, 0);
+					Ranges.Set(0, 0, 0);
+					if (ComponentMask & 1) Reader << Mins.X << Ranges.X;
+					if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
+					if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
+				}
+				for (k = 0; k < NumKeys; k++)
+				{
+					switch (KeyFormat)
 					{
-						// this game has more different key formats; each described by number. which
-						// could differ from numbers in UnMesh3.h; so, transcode format
-						switch (KeyFormat)
+//						TR (ACF_None, FQuat)
+					case ACF_Float96NoW:
 						{
-						case 6:  KeyFormat = ACF_Delta40NoW; break; // not used
-						case 7:  KeyFormat = ACF_Delta48NoW; break; // not used
-						case 8:  KeyFormat = ACF_Identity;   break;
-						case 9:  KeyFormat = ACF_PolarEncoded32; break;
-						case 10: KeyFormat = ACF_PolarEncoded48; break;
+							FQuatFloat96NoW q;
+							Reader << q;
+							FQuat q2 = q;				// convert
+							A->KeyQuat.Add(CVT(q2));
 						}
-					}
-#endif // BORDERLANDS
-					A->KeyQuat.Empty(NumKeys);
-					DBG("    [%d] rot  : fmt=%d (%s), %d keys, mask %d\n", j,
-						KeyFormat, EnumToName(KeyFormat), NumKeys, ComponentMask
-					);
-					if (KeyFormat == ACF_IntervalFixed32NoW)
-					{
-						// read mins/maxs
-						Mins.Set(0, 0, 0);
-						Ranges.Set(0, 0, 0);
-						if (ComponentMask & 1) Reader << Mins.X << Ranges.X;
-						if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
-						if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
-					}
-					for (k = 0; k < NumKeys; k++)
-					{
-						switch (KeyFormat)
+						break;
+					case ACF_Fixed48NoW:
 						{
-//						TR (ACF_None, FQuat)
-						case ACF_Float96NoW:
-							{
-								FQuatFloat96NoW q;
-								Reader << q;
-								FQuat q2 = q;				// convert
-								A->KeyQuat.Add(CVT(q2));
-							}
-							break;
-						case ACF_Fixed48NoW:
-							{
-								FQuatFixed48NoW q;
-								q.X = q.Y = q.Z = 32767;	// corresponds to 0
-								if (ComponentMask & 1) Reader << q.X;
-								if (ComponentMask & 2) Reader << q.Y;
-								if (ComponentMask & 4) Reader << q.Z;
-								FQuat q2 = q;				// convert
-								A->KeyQuat.Add(CVT(q2));
-							}
-							break;
-						TR (ACF_Fixed32NoW, FQuatFixed32NoW)
-						TRR(ACF_IntervalFixed32NoW, FQuatIntervalFixed32NoW)
-						TR (ACF_Float32NoW, FQuatFloat32NoW)
+							FQuatFixed48NoW q;
+							q.X = q.Y = q.Z = 32767;	// corresponds to 0
+							if (ComponentMask & 1) Reader << q.X;
+							if (ComponentMask & 2) Reader << q.Y;
+							if (ComponentMask & 4) Reader << q.Z;
+							FQuat q2 = q;				// convert
+							A->KeyQuat.Add(CVT(q2));
+						}
+						break;
+					TR (ACF_Fixed32NoW, FQuatFixed32NoW)
+					TRR(ACF_IntervalFixed32NoW, FQuatIntervalFixed32NoW)
+					TR (ACF_Float32NoW, FQuatFloat32NoW)
 #if BORDERLANDS
-						TR (ACF_PolarEncoded32, FQuatPolarEncoded32)
-						TR (ACF_PolarEncoded48, FQuatPolarEncoded48)
+					TR (ACF_PolarEncoded32, FQuatPolarEncoded32)
+					TR (ACF_PolarEncoded48, FQuatPolarEncoded48)
 #endif // BORDERLANDS
-						case ACF_Identity:
-							A->KeyQuat.Add(nullQuat);
-							break;
-						default:
-							appError("Unknown rotation compression method: %d (%s)", KeyFormat, EnumToName(KeyFormat));
-						}
+					case ACF_Identity:
+						A->KeyQuat.Add(nullQuat);
+						break;
+					default:
+						appError("Unknown rotation compression method: %d (%s)", KeyFormat, EnumToName(KeyFormat));
 					}
-					// align to 4 bytes
-					Reader.Seek(Align(Reader.Tell(), 4));
-					if (HasTimeTracks)
-						ReadTimeArray(Reader, NumKeys, A->KeyQuatTime, Seq->NumFrames);
 				}
-				unguard;
-
-				unguard;
-				continue;
-				// end of AKF_PerTrackCompression block ...
+				// align to 4 bytes
+				Reader.Seek(Align(Reader.Tell(), 4));
+				if (HasTimeTracks)
+					ReadTimeArray(Reader, NumKeys, A->KeyQuatTime, Seq->NumFrames);
 			}
+			unguard;
 
-			//----------------------------------------------
-			// end of AKF_PerTrackCompression decoder
-			//----------------------------------------------
+			unguard;
+			continue;
+			// end of AKF_PerTrackCompression block ...
+		}
 
-			// read animations
-			int TransOffset = Seq->CompressedTrackOffsets[offsetIndex  ];
-			int TransKeys   = Seq->CompressedTrackOffsets[offsetIndex+1];
-			int RotOffset   = Seq->CompressedTrackOffsets[offsetIndex+2];
-			int RotKeys     = Seq->CompressedTrackOffsets[offsetIndex+3];
+		//----------------------------------------------
+		// end of AKF_PerTrackCompression decoder
+		//----------------------------------------------
+
+		// read animations
+		int TransOffset = Seq->CompressedTrackOffsets[offsetIndex  ];
+		int TransKeys   = Seq->CompressedTrackOffsets[offsetIndex+1];
+		int RotOffset   = Seq->CompressedTrackOffsets[offsetIndex+2];
+		int RotKeys     = Seq->CompressedTrackOffsets[offsetIndex+3];
 #if TLR
-			int ScaleOffset = 0, ScaleKeys = 0;
-			if (ArGame == GAME_TLR)
-			{
-				ScaleOffset  = Seq->CompressedTrackOffsets[offsetIndex+4];
-				ScaleKeys    = Seq->CompressedTrackOffsets[offsetIndex+5];
-			}
+		int ScaleOffset = 0, ScaleKeys = 0;
+		if (ArGame == GAME_TLR)
+		{
+			ScaleOffset  = Seq->CompressedTrackOffsets[offsetIndex+4];
+			ScaleKeys    = Seq->CompressedTrackOffsets[offsetIndex+5];
+		}
 #endif // TLR
 //			appPrintf("[%d:%d:%d] :  %d[%d]  %d[%d]  %d[%d]\n", j, Seq->RotationCompressionFormat, Seq->TranslationCompressionFormat, TransOffset, TransKeys, RotOffset, RotKeys, ScaleOffset, ScaleKeys);
 
-			A->KeyPos.Empty(TransKeys);
-			A->KeyQuat.Empty(RotKeys);
+		A->KeyPos.Empty(TransKeys);
+		A->KeyQuat.Empty(RotKeys);
 
-			// read translation keys
-			if (TransKeys)
-			{
+		// read translation keys
+		if (TransKeys)
+		{
 #if FIND_HOLES
-				int hole = TransOffset - Reader.Tell();
-				if (findHoles && hole/** && abs(hole) > 4*/)	//?? should not be holes at all
-				{
-					appNotify("AnimSet:%s Seq:%s [%d] hole (%d) before TransTrack (KeyFormat=%d/%d)",
-						Name, *Seq->SequenceName, j, hole, Seq->KeyEncodingFormat, Seq->TranslationCompressionFormat);
+			int hole = TransOffset - Reader.Tell();
+			if (findHoles && hole/** && abs(hole) > 4*/)	//?? should not be holes at all
+			{
+				appNotify("AnimSet:%s Seq:%s [%d] hole (%d) before TransTrack (KeyFormat=%d/%d)",
+					Name, *Seq->SequenceName, j, hole, Seq->KeyEncodingFormat, Seq->TranslationCompressionFormat);
 ///					findHoles = false;
-				}
+			}
 #endif // FIND_HOLES
-				Reader.Seek(TransOffset);
-				AnimationCompressionFormat TranslationCompressionFormat = Seq->TranslationCompressionFormat;
+			Reader.Seek(TransOffset);
+			AnimationCompressionFormat TranslationCompressionFormat = Seq->TranslationCompressionFormat;
 #if ARGONAUTS
-				if (ArGame == GAME_Argonauts) goto do_not_override_trans_format;
+			if (ArGame == GAME_Argonauts) goto do_not_override_trans_format;
 #endif
-				if (TransKeys == 1)
-					TranslationCompressionFormat = ACF_None;	// single key is stored without compression
-			do_not_override_trans_format:
-				// read mins/ranges
-				if (TranslationCompressionFormat == ACF_IntervalFixed32NoW)
-				{
-					assert(ArVer >= 761);
-					Reader << Mins << Ranges;
-				}
+			if (TransKeys == 1)
+				TranslationCompressionFormat = ACF_None;	// single key is stored without compression
+		do_not_override_trans_format:
+			// read mins/ranges
+			if (TranslationCompressionFormat == ACF_IntervalFixed32NoW)
+			{
+				assert(ArVer >= 761);
+				Reader << Mins << Ranges;
+			}
 #if BORDERLANDS
-				FVector Base;
-				if (ArGame == GAME_Borderlands && (TranslationCompressionFormat == ACF_Delta40NoW || TranslationCompressionFormat == ACF_Delta48NoW))
-				{
-					Reader << Mins << Ranges << Base;
-				}
+			FVector Base;
+			if (ArGame == GAME_Borderlands && (TranslationCompressionFormat == ACF_Delta40NoW || TranslationCompressionFormat == ACF_Delta48NoW))
+			{
+				Reader << Mins << Ranges << Base;
+			}
 #endif // BORDERLANDS
 
 #if TRANSFORMERS
-				if (ArGame == GAME_Transformers && TransKeys >= 4 && GetLicenseeVer() >= 100)
+			if (ArGame == GAME_Transformers && TransKeys >= 4 && GetLicenseeVer() >= 100)
+			{
+				FVector Scale, Offset;
+				Reader << Scale.X;
+				if (Scale.X != -1)
 				{
-					FVector Scale, Offset;
-					Reader << Scale.X;
-					if (Scale.X != -1)
-					{
-						Reader << Scale.Y << Scale.Z << Offset;
+					Reader << Scale.Y << Scale.Z << Offset;
 //						appPrintf("  trans: %g %g %g -- %g %g %g\n", FVECTOR_ARG(Offset), FVECTOR_ARG(Scale));
-						for (k = 0; k < TransKeys; k++)
-						{
-							FPackedVector_Trans pos;
-							Reader << pos;
-							FVector pos2 = pos.ToVector(Offset, Scale); // convert
-							A->KeyPos.Add(CVT(pos2));
-						}
-						goto trans_keys_done;
-					} // else - original code with 4-byte overhead
-				} // else - original code for uncompressed vector
+					for (k = 0; k < TransKeys; k++)
+					{
+						FPackedVector_Trans pos;
+						Reader << pos;
+						FVector pos2 = pos.ToVector(Offset, Scale); // convert
+						A->KeyPos.Add(CVT(pos2));
+					}
+					goto trans_keys_done;
+				} // else - original code with 4-byte overhead
+			} // else - original code for uncompressed vector
 #endif // TRANSFORMERS
 
-				for (k = 0; k < TransKeys; k++)
+			for (k = 0; k < TransKeys; k++)
+			{
+				switch (TranslationCompressionFormat)
 				{
-					switch (TranslationCompressionFormat)
-					{
-					TP (ACF_None,               FVector)
-					TP (ACF_Float96NoW,         FVector)
-					TPR(ACF_IntervalFixed32NoW, FVectorIntervalFixed32)
-					TP (ACF_Fixed48NoW,         FVectorFixed48)
-					case ACF_Identity:
-						A->KeyPos.Add(nullVec);
-						break;
+				TP (ACF_None,               FVector)
+				TP (ACF_Float96NoW,         FVector)
+				TPR(ACF_IntervalFixed32NoW, FVectorIntervalFixed32)
+				TP (ACF_Fixed48NoW,         FVectorFixed48)
+				case ACF_Identity:
+					A->KeyPos.Add(nullVec);
+					break;
 #if BORDERLANDS
-					case ACF_Delta48NoW:
+				case ACF_Delta48NoW:
+					{
+						if (k == 0)
 						{
-							if (k == 0)
-							{
-								// "Base" works as 1st key
-								A->KeyPos.Add(CVT(Base));
-								continue;
-							}
-							FVectorDelta48NoW V;
-							Reader << V;
-							FVector V2;
-							V2 = V.ToVector(Mins, Ranges, Base);
-							Base = V2;			// for delta
-							A->KeyPos.Add(CVT(V2));
+							// "Base" works as 1st key
+							A->KeyPos.Add(CVT(Base));
+							continue;
 						}
-						break;
+						FVectorDelta48NoW V;
+						Reader << V;
+						FVector V2;
+						V2 = V.ToVector(Mins, Ranges, Base);
+						Base = V2;			// for delta
+						A->KeyPos.Add(CVT(V2));
+					}
+					break;
 #endif // BORDERLANDS
 #if ARGONAUTS
-					case ATCF_Float16:
-						{
-							uint16 x, y, z;
-							Reader << x << y << z;
-							FVector v;
-							v.X = half2float(x) / 2;	// Argonauts has "half" with biased exponent, so fix it with division by 2
-							v.Y = half2float(y) / 2;
-							v.Z = half2float(z) / 2;
-							A->KeyPos.Add(CVT(v));
-						}
-						break;
-#endif // ARGONAUTS
-					default:
-						appError("Unknown translation compression method: %d (%s)", TranslationCompressionFormat, EnumToName(TranslationCompressionFormat));
+				case ATCF_Float16:
+					{
+						uint16 x, y, z;
+						Reader << x << y << z;
+						FVector v;
+						v.X = half2float(x) / 2;	// Argonauts has "half" with biased exponent, so fix it with division by 2
+						v.Y = half2float(y) / 2;
+						v.Z = half2float(z) / 2;
+						A->KeyPos.Add(CVT(v));
 					}
+					break;
+#endif // ARGONAUTS
+				default:
+					appError("Unknown translation compression method: %d (%s)", TranslationCompressionFormat, EnumToName(TranslationCompressionFormat));
 				}
-
-			trans_keys_done:
-				// align to 4 bytes
-				Reader.Seek(Align(Reader.Tell(), 4));
-				if (HasTimeTracks)
-					ReadTimeArray(Reader, TransKeys, A->KeyPosTime, Seq->NumFrames);
 			}
-			else
-			{
+
+		trans_keys_done:
+			// align to 4 bytes
+			Reader.Seek(Align(Reader.Tell(), 4));
+			if (HasTimeTracks)
+				ReadTimeArray(Reader, TransKeys, A->KeyPosTime, Seq->NumFrames);
+		}
+		else
+		{
 //				A->KeyPos.Add(nullVec);
 //				appNotify("No translation keys!");
-			}
+		}
 
 #if DEBUG_DECOMPRESS
-			int TransEnd = Reader.Tell();
+		int TransEnd = Reader.Tell();
 #endif
 #if FIND_HOLES
-			int hole = RotOffset - Reader.Tell();
-			if (findHoles && hole/** && abs(hole) > 4*/)	//?? should not be holes at all
-			{
-				appNotify("AnimSet:%s Seq:%s [%d] hole (%d) before RotTrack (KeyFormat=%d/%d)",
-					Name, *Seq->SequenceName, j, hole, Seq->KeyEncodingFormat, Seq->RotationCompressionFormat);
+		int hole = RotOffset - Reader.Tell();
+		if (findHoles && hole/** && abs(hole) > 4*/)	//?? should not be holes at all
+		{
+			appNotify("AnimSet:%s Seq:%s [%d] hole (%d) before RotTrack (KeyFormat=%d/%d)",
+				Name, *Seq->SequenceName, j, hole, Seq->KeyEncodingFormat, Seq->RotationCompressionFormat);
 ///				findHoles = false;
-			}
+		}
 #endif // FIND_HOLES
-			// read rotation keys
-			Reader.Seek(RotOffset);
-			AnimationCompressionFormat RotationCompressionFormat = Seq->RotationCompressionFormat;
-			if (RotKeys <= 0)
-				goto rot_keys_done;
-			if (RotKeys == 1)
-			{
-				RotationCompressionFormat = ACF_Float96NoW;	// single key is stored without compression
-			}
-			else if (RotationCompressionFormat == ACF_IntervalFixed32NoW || ArVer < 761)
-			{
+		// read rotation keys
+		Reader.Seek(RotOffset);
+		AnimationCompressionFormat RotationCompressionFormat = Seq->RotationCompressionFormat;
+		if (RotKeys <= 0)
+			goto rot_keys_done;
+		if (RotKeys == 1)
+		{
+			RotationCompressionFormat = ACF_Float96NoW;	// single key is stored without compression
+		}
+		else if (RotationCompressionFormat == ACF_IntervalFixed32NoW || ArVer < 761)
+		{
 #if SHADOWS_DAMNED
-				if (ArGame == GAME_ShadowsDamned) goto skip_ranges;
+			if (ArGame == GAME_ShadowsDamned) goto skip_ranges;
 #endif
-				// starting with version 761 Mins/Ranges are read only when needed - i.e. for ACF_IntervalFixed32NoW
-				Reader << Mins << Ranges;
-			skip_ranges: ;
-			}
+			// starting with version 761 Mins/Ranges are read only when needed - i.e. for ACF_IntervalFixed32NoW
+			Reader << Mins << Ranges;
+		skip_ranges: ;
+		}
 #if BORDERLANDS
-			FQuat Base;
-			if (ArGame == GAME_Borderlands && (RotationCompressionFormat == ACF_Delta40NoW || RotationCompressionFormat == ACF_Delta48NoW))
-			{
-				Reader << Base;			// in addition to Mins and Ranges
-			}
+		FQuat Base;
+		if (ArGame == GAME_Borderlands && (RotationCompressionFormat == ACF_Delta40NoW || RotationCompressionFormat == ACF_Delta48NoW))
+		{
+			Reader << Base;			// in addition to Mins and Ranges
+		}
 #endif // BORDERLANDS
 #if TRANSFORMERS
-			FQuat TransQuatBase;
-			if (ArGame == GAME_Transformers && RotKeys >= 2)
-				Reader << TransQuatBase;
+		FQuat TransQuatBase;
+		if (ArGame == GAME_Transformers && RotKeys >= 2)
+			Reader << TransQuatBase;
 #endif // TRANSFORMERS
 #if BLADENSOUL
-			if (ArGame == GAME_BladeNSoul && RotationCompressionFormat == ACF_ZOnlyRLE)
-			{
-				ReadBnS_ZOnlyRLE(Reader, RotKeys, A);
-				goto rot_keys_done;
-			}
+		if (ArGame == GAME_BladeNSoul && RotationCompressionFormat == ACF_ZOnlyRLE)
+		{
+			ReadBnS_ZOnlyRLE(Reader, RotKeys, A);
+			goto rot_keys_done;
+		}
 #endif // BLADENSOUL
 
-			for (k = 0; k < RotKeys; k++)
+		for (k = 0; k < RotKeys; k++)
+		{
+			switch (RotationCompressionFormat)
 			{
-				switch (RotationCompressionFormat)
-				{
-				TR (ACF_None, FQuat)
-				TR (ACF_Float96NoW, FQuatFloat96NoW)
-				TR (ACF_Fixed48NoW, FQuatFixed48NoW)
-				TR (ACF_Fixed32NoW, FQuatFixed32NoW)
-				TRR(ACF_IntervalFixed32NoW, FQuatIntervalFixed32NoW)
-				TR (ACF_Float32NoW, FQuatFloat32NoW)
-				case ACF_Identity:
-					A->KeyQuat.Add(nullQuat);
-					break;
+			TR (ACF_None, FQuat)
+			TR (ACF_Float96NoW, FQuatFloat96NoW)
+			TR (ACF_Fixed48NoW, FQuatFixed48NoW)
+			TR (ACF_Fixed32NoW, FQuatFixed32NoW)
+			TRR(ACF_IntervalFixed32NoW, FQuatIntervalFixed32NoW)
+			TR (ACF_Float32NoW, FQuatFloat32NoW)
+			case ACF_Identity:
+				A->KeyQuat.Add(nullQuat);
+				break;
 #if BATMAN
-				TR (ACF_Fixed48Max, FQuatFixed48Max)
+			TR (ACF_Fixed48Max, FQuatFixed48Max)
 #endif
 #if MASSEFF
-				TR (ACF_BioFixed48, FQuatBioFixed48)	// Mass Effect 2 animation compression
+			TR (ACF_BioFixed48, FQuatBioFixed48)	// Mass Effect 2 animation compression
 #endif
 #if BORDERLANDS
-				case ACF_Delta48NoW:
+			case ACF_Delta48NoW:
+				{
+					if (k == 0)
 					{
-						if (k == 0)
-						{
-							// "Base" works as 1st key
-							A->KeyQuat.Add(CVT(Base));
-							continue;
-						}
-						FQuatDelta48NoW q;
-						Reader << q;
-						FQuat q2;
-						q2 = q.ToQuat(Mins, Ranges, Base);
-						Base = q2;			// for delta
-						A->KeyQuat.Add(CVT(q2));
+						// "Base" works as 1st key
+						A->KeyQuat.Add(CVT(Base));
+						continue;
 					}
-					break;
-				TR (ACF_PolarEncoded32, FQuatPolarEncoded32)
-				TR (ACF_PolarEncoded48, FQuatPolarEncoded48)
+					FQuatDelta48NoW q;
+					Reader << q;
+					FQuat q2;
+					q2 = q.ToQuat(Mins, Ranges, Base);
+					Base = q2;			// for delta
+					A->KeyQuat.Add(CVT(q2));
+				}
+				break;
+			TR (ACF_PolarEncoded32, FQuatPolarEncoded32)
+			TR (ACF_PolarEncoded48, FQuatPolarEncoded48)
 #endif // BORDERLANDS
 #if TRANSFORMERS || ARGONAUTS
-				case ACF_IntervalFixed48NoW:
-	#if TRANSFORMERS
-					if (ArGame == GAME_Transformers)
-					{
-						FQuatIntervalFixed48NoW_Trans q;
-						FQuat q2;
-						Reader << q;
-						q2 = q.ToQuat(Mins, Ranges);
-						A->KeyQuat.Add(CVT(q2));
-					}
-	#endif
-	#if ARGONAUTS
-					if (ArGame == GAME_Argonauts)
-					{
-						FQuatIntervalFixed48NoW_Argo q;
-						FQuat q2;
-						Reader << q;
-						q2 = q.ToQuat(Mins, Ranges);
-						A->KeyQuat.Add(CVT(q2));
-					}
-	#endif // ARGONAUTS
-					break;
+			case ACF_IntervalFixed48NoW:
+#if TRANSFORMERS
+				if (ArGame == GAME_Transformers)
+				{
+					FQuatIntervalFixed48NoW_Trans q;
+					FQuat q2;
+					Reader << q;
+					q2 = q.ToQuat(Mins, Ranges);
+					A->KeyQuat.Add(CVT(q2));
+				}
+#endif
+#if ARGONAUTS
+				if (ArGame == GAME_Argonauts)
+				{
+					FQuatIntervalFixed48NoW_Argo q;
+					FQuat q2;
+					Reader << q;
+					q2 = q.ToQuat(Mins, Ranges);
+					A->KeyQuat.Add(CVT(q2));
+				}
+#endif // ARGONAUTS
+				break;
 #endif // TRANSFORMERS || ARGONAUTS
 #if ARGONAUTS
-				TR (ACF_Fixed64NoW, FQuatFixed64NoW_Argo)
-				TR (ACF_Float48NoW, FQuatFloat48NoW_Argo)
+			TR (ACF_Fixed64NoW, FQuatFixed64NoW_Argo)
+			TR (ACF_Float48NoW, FQuatFloat48NoW_Argo)
 #endif // ARGONAUTS
-				default:
-					appError("Unknown rotation compression method: %d (%s)", RotationCompressionFormat, EnumToName(RotationCompressionFormat));
-				}
+			default:
+				appError("Unknown rotation compression method: %d (%s)", RotationCompressionFormat, EnumToName(RotationCompressionFormat));
 			}
+		}
 
 #if TRANSFORMERS
-			if (ArGame == GAME_Transformers && RotKeys >= 2 &&
-				(RotationCompressionFormat == ACF_IntervalFixed32NoW || RotationCompressionFormat == ACF_IntervalFixed48NoW))
+		if (ArGame == GAME_Transformers && RotKeys >= 2 &&
+			(RotationCompressionFormat == ACF_IntervalFixed32NoW || RotationCompressionFormat == ACF_IntervalFixed48NoW))
+		{
+			for (int i = 0; i < RotKeys; i++)
 			{
-				for (int i = 0; i < RotKeys; i++)
-				{
-					CQuat q = A->KeyQuat[i];
-					q.Mul(CVT(TransQuatBase));
-					A->KeyQuat[i] = q;
-				}
+				CQuat q = A->KeyQuat[i];
+				q.Mul(CVT(TransQuatBase));
+				A->KeyQuat[i] = q;
 			}
+		}
 #endif // TRANSFORMERS
 
-		rot_keys_done:
-			// align to 4 bytes
-			Reader.Seek(Align(Reader.Tell(), 4));
-			if (HasTimeTracks)
-				ReadTimeArray(Reader, RotKeys, A->KeyQuatTime, Seq->NumFrames);
+	rot_keys_done:
+		// align to 4 bytes
+		Reader.Seek(Align(Reader.Tell(), 4));
+		if (HasTimeTracks)
+			ReadTimeArray(Reader, RotKeys, A->KeyQuatTime, Seq->NumFrames);
 
 #if TLR
-			if (ScaleKeys)
-			{
-				// no ScaleKeys support, simply drop data
-				Reader.Seek(ScaleOffset + ScaleKeys * 12);
-				Reader.Seek(Align(Reader.Tell(), 4));
-			}
+		if (ScaleKeys)
+		{
+			// no ScaleKeys support, simply drop data
+			Reader.Seek(ScaleOffset + ScaleKeys * 12);
+			Reader.Seek(Align(Reader.Tell(), 4));
+		}
 #endif // TLR
 
 #if ARGONAUTS
-			if (ArGame == GAME_Argonauts && Seq->CompressedTrackTimeOffsets.Num())
-			{
-				// convert time tracks
-				ReadArgonautsTimeArray(Seq->CompressedTrackTimes, Seq->CompressedTrackTimeOffsets[j*2  ], TransKeys, A->KeyPosTime,  Seq->NumFrames);
-				ReadArgonautsTimeArray(Seq->CompressedTrackTimes, Seq->CompressedTrackTimeOffsets[j*2+1], RotKeys,   A->KeyQuatTime, Seq->NumFrames);
-			}
+		if (ArGame == GAME_Argonauts && Seq->CompressedTrackTimeOffsets.Num())
+		{
+			// convert time tracks
+			ReadArgonautsTimeArray(Seq->CompressedTrackTimes, Seq->CompressedTrackTimeOffsets[j*2  ], TransKeys, A->KeyPosTime,  Seq->NumFrames);
+			ReadArgonautsTimeArray(Seq->CompressedTrackTimes, Seq->CompressedTrackTimeOffsets[j*2+1], RotKeys,   A->KeyQuatTime, Seq->NumFrames);
+		}
 #endif // ARGONAUTS
 
 #if DEBUG_DECOMPRESS
 //			appPrintf("[%s : %s] Frames=%d KeyPos.Num=%d KeyQuat.Num=%d KeyFmt=%s\n", *Seq->SequenceName, *TrackBoneNames[j],
 //				Seq->NumFrames, A->KeyPos.Num(), A->KeyQuat.Num(), *Seq->KeyEncodingFormat);
-			appPrintf("  ->[%d]: t %d .. %d + r %d .. %d (%d/%d keys)\n", j,
-				TransOffset, TransEnd, RotOffset, Reader.Tell(), TransKeys, RotKeys);
+		appPrintf("  ->[%d]: t %d .. %d + r %d .. %d (%d/%d keys)\n", j,
+			TransOffset, TransEnd, RotOffset, Reader.Tell(), TransKeys, RotKeys);
 #endif // DEBUG_DECOMPRESS
-		}
 	}
 
-	unguard;
+	unguardf("AnimSet=%s Seq=%s", Name, *Seq->SequenceName);
 }
 
 
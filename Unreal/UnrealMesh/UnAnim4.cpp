@@ -592,7 +592,7 @@ static void FixRotationKeys(CAnimSequence* Anim)
 }
 
 // Use skeleton's bone settings to adjust animation sequences
-static void AdjustSequenceBySkeleton(USkeleton* Skeleton, const TArray<FTransform>& Transforms, CAnimSequence* Anim)
+static void AdjustSequenceBySkeleton(const USkeleton* Skeleton, const TArray<FTransform>& Transforms, CAnimSequence* Anim)
 {
 	guard(AdjustSequenceBySkeleton);
 
@@ -626,6 +626,55 @@ static void AdjustSequenceBySkeleton(USkeleton* Skeleton, const TArray<FTransfor
 	unguard;
 }
 
+// Find the pose which should be used as a retarget base for the animation sequence.
+// Reference: UAnimSequence::GetRetargetTransforms()
+const TArray<FTransform>* USkeleton::GetRetargetTransforms(const UAnimSequence4* Seq) const
+{
+	const TArray<FTransform>* RetargetTransforms = NULL;
+	if (Seq->RetargetSource == "None" && Seq->RetargetSourceAssetReferencePose.Num())
+	{
+		// We'll use RetargetSourceAssetReferencePose as a retarget base
+		RetargetTransforms = &Seq->RetargetSourceAssetReferencePose;
+#if DEBUG_RETARGET
+		appPrintf("  .. %s: Use RetargetSourceAssetReferencePose\n", Seq->Name);
+#endif
+	}
+	else
+	{
+		// Use USkeleton pose for retarget base.
+		// Reference: USkeleton::GetRefLocalPoses()
+#if DEBUG_RETARGET
+		appPrintf("  .. %s: Use RetargetSource '%s'\n", Name, *Seq->RetargetSource);
+#endif
+		if (Seq->RetargetSource != "None")
+		{
+			const FReferencePose* RefPose = AnimRetargetSources.Find(Seq->RetargetSource);
+			// The result might be NULL if there's no RetargetSource for this animation
+			if (RefPose)
+			{
+				RetargetTransforms = &RefPose->ReferencePose;
+#if DEBUG_RETARGET
+				appPrintf("  .. Found RefPose for '%s'\n", *Seq->RetargetSource);
+#endif
+			}
+		}
+		if (!RetargetTransforms)
+		{
+			// Animation will use ReferenceSkeleton for retargeting, we've already copied the
+			// information into CAnimSet::BonePositions array/
+		}
+	}
+
+	return RetargetTransforms;
+}
+
+// Callback for CAnimSequence, decodes tracks when the sequence is used for the first time
+static void DecodeSkeletonSequence(const UObject* Owner, CAnimSequence& Dst)
+{
+	const USkeleton* Skeleton = static_cast<const USkeleton*>(Owner);
+	Skeleton->DecodeSequence(static_cast<const UAnimSequence4*>(Dst.OriginalSequence), &Dst);
+}
+
 void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 {
 	guard(USkeleton::ConvertAnims);
@@ -777,42 +826,7 @@ void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 	Dst->bAdditive = Seq->AdditiveAnimType != AAT_None;
 
 	// Store information for animation retargeting.
-	// Reference: UAnimSequence::GetRetargetTransforms()
-	const TArray<FTransform>* RetargetTransforms = NULL;
-	if (Seq->RetargetSource == "None" && Seq->RetargetSourceAssetReferencePose.Num())
-	{
-		// We'll use RetargetSourceAssetReferencePose as a retarget base
-		RetargetTransforms = &Seq->RetargetSourceAssetReferencePose;
-#if DEBUG_RETARGET
-		appPrintf("  .. %s: Use RetargetSourceAssetReferencePose\n", Seq->Name);
-#endif
-	}
-	else
-	{
-		// Use USkeleton pose for retarget base.
-		// Reference: USkeleton::GetRefLocalPoses()
-#if DEBUG_RETARGET
-		appPrintf("  .. %s: Use RetargetSource '%s'\n", Name, *Seq->RetargetSource);
-#endif
-		if (Seq->RetargetSource != "None")
-		{
-			const FReferencePose* RefPose = AnimRetargetSources.Find(Seq->RetargetSource);
-			// The result might be NULL if there's no RetargetSource for this animation
-			if (RefPose)
-			{
-				RetargetTransforms = &RefPose->ReferencePose;
-#if DEBUG_RETARGET
-				appPrintf("  .. Found RefPose for '%s'\n", *Seq->RetargetSource);
-#endif
-			}
-		}
-		if (!RetargetTransforms)
-		{
-			// Animation will use ReferenceSkeleton for retargeting, we've already copied the
-			// information into CAnimSet::BonePositions array/
-		}
-	}
-
+	const TArray<FTransform>* RetargetTransforms = GetRetargetTransforms(Seq);
 	if (RetargetTransforms)
 	{
 		//todo: Solve this: RetargetTransforms size may not match ReferenceSkeleton and sequence's track count.
@@ -833,6 +847,20 @@ void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 		}
 	}
 
+	// Tracks will be decoded when the sequence is sampled or exported
+	Dst->SetDecoder(DecodeSkeletonSequence, this);
+
+	unguardf("Skel=%s Anim=%s", Name, Seq->Name);
+}
+
+void USkeleton::DecodeSequence(const UAnimSequence4* Seq, CAnimSequence* Dst) const
+{
+	guard(USkeleton::DecodeSequence);
+
+	int NumTracks = Seq->GetNumTracks();
+	int offsetsPerBone = (Seq->KeyEncodingFormat == AKF_PerTrackCompression) ? 2 : 4;
+	const TArray<FTransform>* RetargetTransforms = GetRetargetTransforms(Seq);
+
 	// bone tracks ...
 	Dst->Tracks.Empty(NumTracks);
 
@@ -1602,13 +1630,9 @@ void UAnimSequence4::PostLoad()
 		AdjustBoneScales(Skeleton->ReferenceSkeleton, RetargetSourceAssetReferencePose);
 	}
 
+	// Original animation data is kept: CAnimSequence tracks are decoded from it on demand
 	Skeleton->ConvertAnims(this);
 
-	// Release original animation data to save memory
-	RawAnimationData.Empty();
-	CompressedByteStream.Empty();
-	CompressedTrackOffsets.Empty();
-
 	unguard;
 }
 
@@ -81,8 +81,6 @@ inline void ComputeBounds(const T *Data, int NumVerts, int Stride, CVec3 &Mins,
 }
 
 
-#define USE_HASHING	1		// can disable this to compare performance
-
 // structure which helps to share vertices between wedges
 //?? rename to "CVertexWelder"?
 struct CVertexShare
@@ -94,72 +92,57 @@ struct CVertexShare
 	TArray<int>		VertToWedge;
 	int				WedgeIndex;
 
-#if USE_HASHING
-	// hashing
-	CVec3			Mins, Maxs;
-	CVec3			Extents;
-	int				Hash[16384];
+	// hashing, table size is a power of 2 and depends on vertex count
+	TArray<int>		Hash;
 	TArray<int>		HashNext;
-#endif // USE_HASHING
+	uint32			HashMask;
+
+	void Prepare(const CMeshVertex *Verts, int NumVerts, int VertexSize);
+
+	// Weld all vertices at once. Gives the same result as Prepare() followed by AddVertex() for
+	// every vertex, but large meshes are processed in parallel. ExtraInfo array is optional, normals
+	// are ignored when UseNormals is false.
+	void WeldVertices(const CMeshVertex *Verts, int NumVerts, int VertexSize, const uint32* ExtraInfo = NULL, bool UseNormals = true);
 
-	void Prepare(const CMeshVertex *Verts, int NumVerts, int VertexSize)
+	static FORCEINLINE uint32 GetHash(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo)
 	{
-		WedgeIndex = 0;
-		Points.Empty(NumVerts);
-		Normals.Empty(NumVerts);
-		ExtraInfos.Empty(NumVerts);
-		WedgeToVert.Empty(NumVerts);
-		VertToWedge.Empty(NumVerts);
-		VertToWedge.AddZeroed(NumVerts);
-#if USE_HASHING
-		// compute bounds for better hashing
-		ComputeBounds(&Verts->Position, NumVerts, VertexSize, Mins, Maxs);
-		VectorSubtract(Maxs, Mins, Extents);
-		Extents[0] += 1; Extents[1] += 1; Extents[2] += 1; // avoid zero divide
-		// initialize Hash and HashNext with -1
-		HashNext.Init(-1, NumVerts);
-		memset(Hash, -1, sizeof(Hash));
-#endif // USE_HASHING
+		// Hash exact bits, because CVec3 operator== uses memcmp (so -0 and +0 are different points)
+		uint32 h = 0;
+		for (int i = 0; i < 3; i++)
+			h = (h ^ reinterpret_cast<const uint32&>(Pos[i])) * 0x9E3779B1;
+		h = (h ^ (Normal.Data & 0xFFFFFF)) * 0x85EBCA77;
+		h ^= ExtraInfo;
+		// final mixing, so low bits depend on all input bits
+		h ^= h >> 16;
+		h *= 0x85EBCA6B;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35;
+		h ^= h >> 16;
+		return h;
 	}
 
 	int AddVertex(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo = 0)
 	{
-		int PointIndex = -1;
+		int PointIndex;
 
 		Normal.Data &= 0xFFFFFF;		// clear W component which is used for binormal computation
 
-#if USE_HASHING
-		// compute hash
-		int h = appFloor(
-			( (Pos[0] - Mins[0]) / Extents[0] + (Pos[1] - Mins[1]) / Extents[1] + (Pos[2] - Mins[2]) / Extents[2] ) // 0..3
-			* (ARRAY_COUNT(Hash) / 3.0f * 16)			// multiply to 16 for better spreading inside Hash array
-		) % ARRAY_COUNT(Hash);
 		// find point with the same position and normal
+		int h = GetHash(Pos, Normal, ExtraInfo) & HashMask;
 		for (PointIndex = Hash[h]; PointIndex >= 0; PointIndex = HashNext[PointIndex])
 		{
 			if (Points[PointIndex] == Pos && Normals[PointIndex] == Normal && ExtraInfos[PointIndex] == ExtraInfo)
 				break;		// found it
 		}
-#else
-		// find wedge with the same position and normal
-		while (true)
-		{
-			PointIndex = Points.FindItem(Pos, PointIndex + 1);
-			if (PointIndex == INDEX_NONE) break;
-			if (Normals[PointIndex] == Normal && ExtraInfos[PointIndex] == ExtraInfo) break;
-		}
-#endif // USE_HASHING
 		if (PointIndex == INDEX_NONE)
 		{
 			// point was not found - create it
 			PointIndex = Points.Add(Pos);
 			Normals.Add(Normal);
 			ExtraInfos.Add(ExtraInfo);
-#if USE_HASHING
 			// add to Hash
-			HashNext[PointIndex] = Hash[h];
+			HashNext.Add(Hash[h]);
 			Hash[h] = PointIndex;
-#endif // USE_HASHING
 		}
 
 		// remember vertex <-> wedge map
@@ -722,6 +722,8 @@ public:
 	END_PROP_TABLE
 
 	void ConvertAnims();
+	// Decompress animation tracks, called by CAnimSequence on demand
+	void DecodeSequence(const UAnimSequence* Seq, CAnimSequence* Dst) const;
 	virtual void Serialize(FArchive &Ar);
 
 	virtual void PostLoad()
@@ -203,6 +203,9 @@ public:
 
 	// Convert a single UAnimSequence to internal animation format
 	void ConvertAnims(UAnimSequence4* Seq);
+	// Decompress animation tracks, called by CAnimSequence on demand
+	void DecodeSequence(const UAnimSequence4* Seq, CAnimSequence* Dst) const;
+	const TArray<FTransform>* GetRetargetTransforms(const UAnimSequence4* Seq) const;
 };
 
 
@@ -5,6 +5,7 @@
 #include "UnPackage.h"
 
 #include "PackageUtils.h"
+#include "Parallel.h"
 
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
@@ -43,6 +44,21 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 	unguardf("%s", *Package->GetFilename());
 }
 
+static void PrintMemoryStats()
+{
+	// Print currently used memory statistics, but only if it differs from previous one.
+	// This lets to avoid console spam when doing export of packages which has nothing exportable inside.
+	static size_t lastAllocsSize = 0;
+	static int lastAllocsCount = 0;
+	if (GTotalAllocationSize != lastAllocsSize || GTotalAllocationCount != lastAllocsCount)
+	{
+		lastAllocsSize = GTotalAllocationSize;
+		lastAllocsCount = GTotalAllocationCount;
+		appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
+	}
+//	appDumpMemoryAllocations();
+}
+
 void ReleaseAllObjects()
 {
 	guard(ReleaseAllObjects);
@@ -56,9 +72,11 @@ void ReleaseAllObjects()
 	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
 	appDumpMemoryAllocations();
 #endif
-	for (int i = UObject::GObjObjects.Num() - 1; i >= 0; i--)
-		delete UObject::GObjObjects[i];
-	UObject::GObjObjects.Empty();
+	// Take all objects from GObjObjects, so object destructors will not spend time on updating the list
+	TArray<UObject*> Objects;
+	UObject::UnregisterAllObjects(Objects);
+	for (int i = Objects.Num() - 1; i >= 0; i--)
+		delete Objects[i];
 
 #if 0
 	// verify that all object pointers were set to NULL
@@ -73,17 +91,45 @@ void ReleaseAllObjects()
 	}
 #endif
 
-	// Print currently used memory statistics, but only if it differs from previous one.
-	// This lets to avoid console spam when doing export of packages which has nothing exportable inside.
-	static size_t lastAllocsSize = 0;
-	static int lastAllocsCount = 0;
-	if (GTotalAllocationSize != lastAllocsSize || GTotalAllocationCount != lastAllocsCount)
+	PrintMemoryStats();
+
+	unguard;
+}
+
+void DetachAllObjects(TArray<UObject*>& Objects)
+{
+	guard(DetachAllObjects);
+
+	GFullyLoadedPackages.Empty();
+
+	UObject::UnregisterAllObjects(Objects);
+
+	// Unlink objects from export tables, so the next loaded package will create its own copies
+	// of shared objects instead of referencing these ones
+	for (UObject* Obj : Objects)
 	{
-		lastAllocsSize = GTotalAllocationSize;
-		lastAllocsCount = GTotalAllocationCount;
-		appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
+		if (Obj->Package && Obj->PackageIndex != INDEX_NONE)
+		{
+			FObjectExport& Exp = Obj->Package->GetExport(Obj->PackageIndex);
+			if (Exp.Object == Obj)
+				Exp.Object = NULL;
+		}
 	}
-//	appDumpMemoryAllocations();
+
+	unguard;
+}
+
+void ReleaseObjects(TArray<UObject*>& Objects)
+{
+	guard(ReleaseObjects);
+
+	if (!Objects.Num()) return;
+
+	for (int i = Objects.Num() - 1; i >= 0; i--)
+		delete Objects[i];
+	Objects.Empty();
+
+	PrintMemoryStats();
 
 	unguard;
 }
@@ -93,34 +139,13 @@ void ReleaseAllObjects()
 	Package version scanner
 -----------------------------------------------------------------------------*/
 
-struct ScanPackageData
-{
-	ScanPackageData()
-	:	Progress(NULL)
-	,	Cancelled(false)
-	,	Index(0)
-	{}
-
-	TArray<FileInfo>*	PkgInfo;
-	IProgressCallback*	Progress;
-	bool				Cancelled;
-	int					Index;
-};
-
-static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
-{
-	guard(ScanPackage);
+// Number of packages processed by worker threads between progress updates
+#define SCAN_BATCH_SIZE		256
 
-	if (data.Progress)
-	{
-		FStaticString<MAX_PACKAGE_PATH> RelativeName;
-		file->GetRelativeName(RelativeName);
-		if (!data.Progress->Progress(*RelativeName, data.Index++, GNumPackageFiles))
-		{
-			data.Cancelled = true;
-			return false;
-		}
-	}
+// Read a few first bytes of the package file and extract version information
+static bool ReadPackageVersion(const CGameFileInfo *file, int& OutVer, int& OutLicVer)
+{
+	guard(ReadPackageVersion);
 
 	// read a few first bytes as integers
 	FArchive *Ar = file->CreateReader();
@@ -139,35 +164,42 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
 		//!! do that only when something "strange" within data noticed.
 		//!! Also, this function could react on custom package tags.
-		return true;
+		return false;
 	}
 	uint32 Version = FileData[1];
 
-	FileInfo Info;
-
 #if UNREAL4
 	if ((Version & 0xFFFFF000) == 0xFFFFF000)
 	{
 		// next fields are: int VersionUE3, Version, LicenseeVersion
-		Info.Ver    = FileData[3];
-		Info.LicVer = FileData[4];
+		OutVer    = FileData[3];
+		OutLicVer = FileData[4];
 	}
 	else
 #endif // UNREAL4
 	{
-		Info.Ver    = Version & 0xFFFF;
-		Info.LicVer = Version >> 16;
+		OutVer    = Version & 0xFFFF;
+		OutLicVer = Version >> 16;
 	}
+	return true;
+
+	unguardf("%s", *file->GetRelativeName());
+}
 
+static void AddPackageVersion(TArray<FileInfo>& PkgInfo, const CGameFileInfo *file, int Ver, int LicVer)
+{
+	FileInfo Info;
+	Info.Ver    = Ver;
+	Info.LicVer = LicVer;
 	Info.Count  = 0;
 	FStaticString<MAX_PACKAGE_PATH> RelativeName;
 	file->GetRelativeName(RelativeName);
 	strcpy(Info.FileName, *RelativeName);
 //	printf("%s - %d/%d\n", *RelativeName, Info.Ver, Info.LicVer);
 	int Index = INDEX_NONE;
-	for (int i = 0; i < data.PkgInfo->Num(); i++)
+	for (int i = 0; i < PkgInfo.Num(); i++)
 	{
-		FileInfo &Info2 = (*data.PkgInfo)[i];
+		FileInfo &Info2 = PkgInfo[i];
 		if (Info2.Ver == Info.Ver && Info2.LicVer == Info.LicVer)
 		{
 			Index = i;
@@ -175,9 +207,9 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		}
 	}
 	if (Index == INDEX_NONE)
-		Index = data.PkgInfo->Add(Info);
+		Index = PkgInfo.Add(Info);
 	// update info
-	FileInfo& fileInfo = (*data.PkgInfo)[Index];
+	FileInfo& fileInfo = PkgInfo[Index];
 	fileInfo.Count++;
 	// combine filename
 	char *s = fileInfo.FileName;
@@ -188,20 +220,63 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		d++;
 	}
 	*s = 0;
-
-	return true;
-
-	unguardf("%s", *file->GetRelativeName());
 }
 
 
 bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 {
+	guard(ScanPackageVersions);
+
 	info.Empty();
-	ScanPackageData data;
-	data.PkgInfo = &info;
-	data.Progress = progress;
-	appEnumGameFiles(ScanPackage, data);
+
+	TArray<const CGameFileInfo*> Files;
+	Files.Empty(GNumPackageFiles);
+	appEnumGameFiles<TArray<const CGameFileInfo*> >(
+		[](const CGameFileInfo* file, TArray<const CGameFileInfo*>& param) -> bool
+		{
+			param.Add(file);
+			return true;
+		}, Files);
+
+	struct VersionInfo
+	{
+		int		Ver;
+		int		LicVer;
+		bool	IsValid;
+	};
+	VersionInfo Versions[SCAN_BATCH_SIZE];
+
+	bool cancelled = false;
+	for (int first = 0; first < Files.Num(); first += SCAN_BATCH_SIZE)
+	{
+		int count = min(Files.Num() - first, SCAN_BATCH_SIZE);
+
+		if (progress)
+		{
+			FStaticString<MAX_PACKAGE_PATH> RelativeName;
+			Files[first]->GetRelativeName(RelativeName);
+			if (!progress->Progress(*RelativeName, first, Files.Num()))
+			{
+				cancelled = true;
+				break;
+			}
+		}
+
+		// Read file headers in worker threads, then merge results on the main thread, in file order
+		ParallelForSlow(count, [&Files, &Versions, first](int Index)
+			{
+				VersionInfo& V = Versions[Index];
+				V.IsValid = ReadPackageVersion(Files[first + Index], V.Ver, V.LicVer);
+			});
+
+		for (int i = 0; i < count; i++)
+		{
+			const VersionInfo& V = Versions[i];
+			if (V.IsValid)
+				AddPackageVersion(info, Files[first + i], V.Ver, V.LicVer);
+		}
+	}
+
 	info.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
 		{
 			int dif = p1.Ver - p2.Ver;
@@ -209,7 +284,9 @@ bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 			return p1.LicVer - p2.LicVer;
 		});
 
-	return !data.Cancelled;
+	return !cancelled;
+
+	unguard;
 }
 
 
@@ -241,6 +318,40 @@ static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
 	} */
 }
 
+// Scan package using its headers only. Called from worker threads.
+static void ScanPackageHeaders(CGameFileInfo* file)
+{
+	// Loaded packages are processed on the main thread, as well as the first scanned package
+	if (file->IsPackageScanned || file->Package)
+		return;
+
+	bool bNeedsFullLoad;
+	UnPackage* package = UnPackage::LoadPackageHeaders(file, bNeedsFullLoad);
+	if (bNeedsFullLoad) return;		// will be loaded on the main thread
+
+	file->IsPackageScanned = true;
+	if (!package) return;			// not a valid package
+
+	ScanPackageExports(package, file);
+	UnPackage::UnloadPackage(package);
+}
+
+// Scan package, loading it with LoadPackage() when needed. Called from the main thread.
+static void ScanPackageFull(CGameFileInfo* file)
+{
+	file->IsPackageScanned = true;
+
+	UnPackage* package = file->Package;
+	if (!package)
+	{
+		package = UnPackage::LoadPackage(file, /*silent=*/ true);
+		if (!package) return;		// should not happen
+		// Don't keep the package's reader open
+		package->CloseReader();
+	}
+	ScanPackageExports(package, file);
+}
+
 bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress)
 {
 	guard(ScanContent);
@@ -248,59 +359,61 @@ bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback
 #if PROFILE
 	appResetProfiler();
 #endif
-	bool cancelled = false;
-	bool scanned = false; // says if anywhing was scanned or not, just for profiler message
-
-	// Preallocate PackageMap
-	UnPackage::ReservePackageMap(Packages.Num());
 
+	// Collect packages which weren't scanned yet
+	TArray<CGameFileInfo*> Files;
+	Files.Empty(Packages.Num());
 	for (int i = 0; i < Packages.Num(); i++)
 	{
 		CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
-		if (file->IsPackageScanned) continue;
+		if (!file->IsPackageScanned)
+			Files.Add(file);
+	}
+
+	// Load the first package on the main thread: it could ask user for the engine version, or detect the game
+	// with a custom package tag, so worker threads will see the final GForceGame value
+	if (Files.Num())
+		ScanPackageFull(Files[0]);
+
+	bool cancelled = false;
+	for (int first = 0; first < Files.Num(); first += SCAN_BATCH_SIZE)
+	{
+		int count = min(Files.Num() - first, SCAN_BATCH_SIZE);
 
 		// Update progress dialog
-		FStaticString<MAX_PACKAGE_PATH> RelativeName;
-		file->GetRelativeName(RelativeName);
-		if (Progress && !Progress->Progress(*RelativeName, i, Packages.Num()))
+		if (Progress)
 		{
-			cancelled = true;
-			break;
+			FStaticString<MAX_PACKAGE_PATH> RelativeName;
+			Files[first]->GetRelativeName(RelativeName);
+			if (!Progress->Progress(*RelativeName, first, Files.Num()))
+			{
+				cancelled = true;
+				break;
+			}
 		}
 
-		file->IsPackageScanned = true;
+		// Header-only packages are not registered, so these could be scanned in parallel
+		ParallelForSlow(count, [&Files, first](int Index)
+			{
+				ScanPackageHeaders(Files[first + Index]);
+			});
 
-		if (file->Package)
+		// Process packages which were skipped by ScanPackageHeaders()
+		for (int i = first; i < first + count; i++)
 		{
-			// package already loaded
-			ScanPackageExports(file->Package, file);
+			CGameFileInfo* file = Files[i];
+			if (!file->IsPackageScanned)
+				ScanPackageFull(file);
 		}
-		else
-		{
-			UnPackage* package = UnPackage::LoadPackage(file, /*silent=*/ true);	// should always return non-NULL
-			if (!package) continue;		// should not happen
-			// Don't keep the package's reader open
-			package->CloseReader();
-
-			ScanPackageExports(package, file);
-		#if 0
-			// this code is disabled: it works, however we're going to use ScanContent not just to get objects counts,
-			// but also for collecting object references
-
-			// now unload package to not waste memory
-			UnPackage::UnloadPackage(package);
-			assert(file->Package == NULL);
-		#endif
-		}
-		scanned = true;
 	}
+
+	bool scanned = Files.Num() > 0; // says if anywhing was scanned or not, just for profiler message
 #if PROFILE
 	if (scanned)
+	{
 		appPrintProfiler("Scanned packages");
-#endif
-#if 0
-	void PrintStringHashDistribution();
-	PrintStringHashDistribution();
+		appPrintStringPoolStats();
+	}
 #endif
 	return !cancelled;
 
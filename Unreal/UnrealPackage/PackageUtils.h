@@ -24,6 +24,11 @@ public:
 bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress = NULL);
 void ReleaseAllObjects();
 
+// Move all loaded objects from GObjObjects to the provided array and unlink them from their packages.
+// After this call, objects could be used independently of the loader, and should be freed with ReleaseObjects().
+void DetachAllObjects(TArray<UObject*>& Objects);
+void ReleaseObjects(TArray<UObject*>& Objects);
+
 
 // Package scanner
 
@@ -7,6 +7,8 @@
 
 #include "GameDatabase.h"		// for GetGameTag()
 
+#include "Parallel.h"
+
 //#define PROFILE_PACKAGE_TABLES	1
 
 /*-----------------------------------------------------------------------------
@@ -128,10 +130,9 @@ tag_ok:
 	{
 		LegacyVersion = Version;
 		Ar.Game = GAME_UE4_BASE;
-		Serialize4(Ar);
 		//!! note: UE4 requires different DetectGame way, perhaps it's not possible at all
 		//!! (but can use PAK file names for game detection)
-		return true;
+		return Serialize4(Ar);
 	}
 #endif // UNREAL4
 
@@ -247,11 +248,14 @@ void FObjectImport::Serialize(FArchive& Ar)
 	Package loading (creation) / unloading
 -----------------------------------------------------------------------------*/
 
-UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent)
+UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent, bool headersOnly)
 :	Loader(NULL)
 #if UNREAL4
 ,	ExportIndices_IOS(NULL)
+,	BulkFiles()
+,	BulkFilesResolved()
 #endif
+,	HeadersOnly(headersOnly)
 {
 	guard(UnPackage::UnPackage);
 
@@ -376,6 +380,13 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 	LoadImportTable();
 	LoadExportTable();
 
+	if (HeadersOnly)
+	{
+		// Don't register the package and don't look for .uexp: nothing will be loaded from this package
+		CloseReader();
+		return;
+	}
+
 #if UNREAL4
 	// Process Event Driven Loader packages: such packages are split into 2 pieces: .uasset with headers
 	// and .uexp with object's data. At this moment we already have FPackageFileSummary fully loaded,
@@ -581,13 +592,40 @@ void UnPackage::LoadExportTable()
 }
 
 
+static TArray<UnPackage*> OpenReaders;
+
+#if UNREAL4
+#if THREADING
+// Bulk data is loaded from exporter threads, protect resolving of bulk files and the reader pools.
+static CMutex BulkFilesMutex;
+#define LOCK_BULK_FILES()	CMutex::ScopedLock BulkFilesLock(BulkFilesMutex)
+#else
+#define LOCK_BULK_FILES()
+#endif
+#endif // UNREAL4
+
 UnPackage::~UnPackage()
 {
 	guard(UnPackage::~UnPackage);
 
-	UnregisterPackage();
+	if (!HeadersOnly)
+	{
+		UnregisterPackage();
+		OpenReaders.RemoveSingle(this);
+	}
 
 	if (Loader) delete Loader;
+#if UNREAL4
+	{
+		LOCK_BULK_FILES();
+		for (TArray<FArchive*>& Pool : BulkReaderPool)
+		{
+			for (FArchive* Reader : Pool)
+				delete Reader;
+			Pool.Empty();
+		}
+	}
+#endif // UNREAL4
 
 	if (!IsValid())
 	{
@@ -633,8 +671,6 @@ static FFileArchive* FindFileArchive(FArchive* Ar)
 }
 #endif
 
-static TArray<UnPackage*> OpenReaders;
-
 void UnPackage::SetupReader(int ExportIndex)
 {
 	guard(UnPackage::SetupReader);
@@ -691,6 +727,98 @@ void UnPackage::CloseAllReaders()
 	unguard;
 }
 
+#if UNREAL4
+
+// Maximal number of idle readers kept for every bulk file, there's usually one reader per
+// export thread working with the package.
+#define MAX_POOLED_BULK_READERS		4
+
+FArchive* UnPackage::AcquireBulkReader(EBulkFile Type)
+{
+	guard(UnPackage::AcquireBulkReader);
+
+	const CGameFileInfo* BulkFile;
+	{
+		LOCK_BULK_FILES();
+		if (!BulkFilesResolved[Type])
+		{
+			// Find the file only once, CGameFileInfo::Find() is not cheap
+			BulkFilesResolved[Type] = true;
+			if (Type == BULK_Package)
+			{
+				BulkFiles[Type] = FileInfo;
+			}
+			else
+			{
+				// UE4.12+ store bulk payload in .ubulk file (BULKDATA_PayloadInSeperateFile)
+				// UE4.20+ store bulk payload in .uptnl file (BULKDATA_OptionalPayload)
+				char BulkFileName[MAX_PACKAGE_PATH];
+				appStrncpyz(BulkFileName, *GetFilename(), ARRAY_COUNT(BulkFileName) - 8);
+				char* s = strrchr(BulkFileName, '.');
+				assert(s);
+				strcpy(s, (Type == BULK_Uptnl) ? ".uptnl" : ".ubulk");
+				BulkFiles[Type] = CGameFileInfo::Find(BulkFileName);
+				if (!BulkFiles[Type])
+				{
+					appPrintf("Package %s: bulk file %s is missing\n", *GetFilename(), BulkFileName);
+				}
+			}
+		}
+		BulkFile = BulkFiles[Type];
+
+		// Reuse an idle reader, it keeps the file open and its read buffer
+		TArray<FArchive*>& Pool = BulkReaderPool[Type];
+		if (Pool.Num())
+		{
+			FArchive* Reader = Pool[Pool.Num() - 1];
+			Pool.RemoveAt(Pool.Num() - 1);
+			return Reader;
+		}
+	}
+
+	// Bulk data could be read by several exporter threads at the same time, so every caller gets
+	// its own reader. These readers are not closed in EndLoad(), they're owned by the pool.
+	FArchive* Reader;
+	if (BulkFile)
+	{
+		Reader = BulkFile->CreateReader();
+	}
+	else if (Type == BULK_Package)
+	{
+		Reader = new FFileReader(FilenameNoInfo);
+	}
+	else
+	{
+		return NULL;
+	}
+	assert(Reader);
+	Reader->SetupFrom(*this);
+	return Reader;
+
+	unguardf("pkg=%s", *GetFilename());
+}
+
+void UnPackage::ReleaseBulkReader(EBulkFile Type, FArchive* Reader)
+{
+	guard(UnPackage::ReleaseBulkReader);
+
+	assert(Reader);
+	{
+		LOCK_BULK_FILES();
+		TArray<FArchive*>& Pool = BulkReaderPool[Type];
+		if (Pool.Num() < MAX_POOLED_BULK_READERS)
+		{
+			Pool.Add(Reader);
+			return;
+		}
+	}
+	delete Reader;
+
+	unguardf("pkg=%s", *GetFilename());
+}
+
+#endif // UNREAL4
+
 
 /*-----------------------------------------------------------------------------
 	UObject* and FName serializers
@@ -1353,3 +1481,36 @@ TArray<char*>		MissingPackages;
 
 	unguardf("%s", *File->GetRelativeName());
 }
+
+/*static*/ UnPackage* UnPackage::LoadPackageHeaders(const CGameFileInfo* File, bool& bNeedsFullLoad)
+{
+	guard(UnPackage::LoadPackageHeaders);
+
+	bNeedsFullLoad = false;
+	if (!File->IsPackage())
+		return NULL;
+#if UNREAL4
+	if (File->IsIOStoreFile())
+	{
+		bNeedsFullLoad = true;
+		return NULL;
+	}
+#endif
+
+	FStaticString<MAX_PACKAGE_PATH> RelativeName;
+	File->GetRelativeName(RelativeName);
+	UnPackage* package = new UnPackage(*RelativeName, File, /*silent=*/ true, /*headersOnly=*/ true);
+	if (!package->IsValid())
+	{
+#if UNREAL4
+		// FPackageFileSummary::Serialize4() refused to ask for the engine version
+		if (package->Summary.IsUnversioned && GForceGame == GAME_UNKNOWN)
+			bNeedsFullLoad = true;
+#endif
+		delete package;
+		return NULL;
+	}
+	return package;
+
+	unguardf("%s", *File->GetRelativeName());
+}
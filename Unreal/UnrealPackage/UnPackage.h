@@ -165,7 +165,7 @@ private:
 	// Engine-specific serializers
 	void Serialize2(FArchive& Ar);
 	void Serialize3(FArchive& Ar);
-	void Serialize4(FArchive& Ar);
+	bool Serialize4(FArchive& Ar);
 };
 
 #if UNREAL3
@@ -252,10 +252,26 @@ public:
 	FObjectExport*			ExportTable;
 #if UNREAL4
 	struct FPackageObjectIndex* ExportIndices_IOS;
-#endif
+
+	// UE4 files which could hold bulk data outside of the package loader
+	enum EBulkFile
+	{
+		BULK_Package,			// the package file itself, used for compressed packages
+		BULK_Ubulk,
+		BULK_Uptnl,
+		BULK_Count
+	};
+
+protected:
+	// Resolved bulk files are cached for the whole package lifetime, see AcquireBulkReader()
+	const CGameFileInfo*	BulkFiles[BULK_Count];
+	bool					BulkFilesResolved[BULK_Count];
+	// Idle bulk readers, reused by subsequent bulk reads and deleted with the package
+	TArray<FArchive*>		BulkReaderPool[BULK_Count];
+#endif // UNREAL4
 
 protected:
-	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false);
+	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false, bool headersOnly = false);
 	~UnPackage();
 
 public:
@@ -267,12 +283,22 @@ public:
 	// Check if valid package has been created by constructor
 	bool IsValid() const { return Summary.NameCount > 0; }
 
+	// Check if package was created with LoadPackageHeaders()
+	bool IsHeadersOnly() const { return HeadersOnly; }
+
 	// Load package using short name (without path and extension) or full path name.
 	// When the package is already loaded, this function will simply return a pointer
 	// to previously loaded UnPackage.
 	static UnPackage* LoadPackage(const char* Name, bool silent = false);
 	// Load package using existing CGameFileInfo
 	static UnPackage* LoadPackage(const CGameFileInfo* File, bool silent = false);
+	// Load package summary, name, import and export tables only. Such package is not registered in package
+	// map and can't be used for loading objects, it should be released with UnloadPackage() right after use.
+	// Could be called from any thread. Returns NULL for bad packages, and for packages which should be loaded
+	// with LoadPackage() on the main thread, bNeedsFullLoad is set in this case: IoStore packages require
+	// loading of other packages for resolving imports, unversioned UE4 packages may require asking user
+	// for the engine version.
+	static UnPackage* LoadPackageHeaders(const CGameFileInfo* File, bool& bNeedsFullLoad);
 	// We've protected UnPackage's destructor, however it is possible to use UnloadPackage to fully destroy it.
 	// This call is just more noticeable in code than use of 'operator delete'.
 	static void UnloadPackage(UnPackage* package);
@@ -307,6 +333,14 @@ public:
 
 	static void CloseAllReaders();
 
+#if UNREAL4
+	// Take a reader for bulk data file from the package's pool, or create a new one. Returns NULL when
+	// the file is missing. The reader is used exclusively by the caller until ReleaseBulkReader() is
+	// called. Could be called from any thread.
+	FArchive* AcquireBulkReader(EBulkFile Type);
+	void ReleaseBulkReader(EBulkFile Type, FArchive* Reader);
+#endif
+
 	const char* GetName(int index)
 	{
 		if (unsigned(index) >= Summary.NameCount)
@@ -439,6 +473,8 @@ public:
 	}
 
 private:
+	bool		HeadersOnly;				// created with LoadPackageHeaders(), not registered
+
 	void RegisterPackage(const char* filename);
 	void UnregisterPackage();
 
@@ -75,7 +75,7 @@ int GetUE4CustomVersion(const FArchive& Ar, const FGuid& Guid)
 	unguard;
 }
 
-void FPackageFileSummary::Serialize4(FArchive &Ar)
+bool FPackageFileSummary::Serialize4(FArchive &Ar)
 {
 	guard(FPackageFileSummary::Serialize4);
 
@@ -121,6 +121,13 @@ void FPackageFileSummary::Serialize4(FArchive &Ar)
 
 	if (IsUnversioned && GForceGame == GAME_UNKNOWN)
 	{
+		const UnPackage* Package = Ar.CastTo<UnPackage>();
+		if (Package && Package->IsHeadersOnly())
+		{
+			// Headers-only packages are loaded in worker threads which can't ask user for the engine
+			// version, such package should be loaded on the main thread
+			return false;
+		}
 		int ver = -LegacyVersion - 1;
 		int verMin = legacyVerToEngineVer[ver];
 		int verMax = legacyVerToEngineVer[ver+1] - 1;
@@ -277,6 +284,8 @@ void FPackageFileSummary::Serialize4(FArchive &Ar)
 
 	//!! other fields - useless for now
 
+	return true;
+
 	unguard;
 }
 
@@ -17,6 +17,7 @@ public:
 
 	// compression data
 	int						CompressionFlags;
+	CDecompressCache		DecompressCache;	// used by appDecompress()
 	TArray<FCompressedChunk> CompressedChunks;
 	// own file positions, overriding FArchive's one (because parent class is
 	// used for compressed data)
@@ -192,7 +193,7 @@ public:
 #if BATMAN
 			if (Game == GAME_Batman4 && CompressionFlags == 8) UsedCompressionFlags = COMPRESS_LZ4;
 #endif
-			appDecompress(CompressedBlock, Block->CompressedSize, Buffer, Block->UncompressedSize, UsedCompressionFlags);
+			appDecompress(CompressedBlock, Block->CompressedSize, Buffer, Block->UncompressedSize, UsedCompressionFlags, &DecompressCache);
 		}
 		else
 		{
@@ -116,10 +116,12 @@ void DecodeDDS(const unsigned char* Data, int USize, int VSize, nv::DDSHeader& h
 	dds.mipmap(&image, 0, 0);
 }
 
-// Data is 128 byte long array
-void WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header)
+// Data is 148 byte long array, returns number of bytes written: 128, or 148 when DX10 header is used
+int WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header)
 {
 	uint8 dummy[128];
-	NVTTStream stream(Data, 128, dummy, sizeof(dummy), false);
+	uint size = header.hasDX10Header() ? 148 : 128;
+	NVTTStream stream(Data, size, dummy, sizeof(dummy), false);
 	stream << header;
+	return size;
 }
@@ -1,7 +1,13 @@
 #include <png.h>
+#include <zlib.h>
 
 #include "Core.h"
 #include "UnCore.h"
+#include "UnObject.h"
+#include "UnrealMaterial/UnMaterial.h"		// for IsAlphaChannelUsed()
+#include "TexturePNG.h"
+
+#include "Parallel.h"
 
 struct PngReadCtx
 {
@@ -10,15 +16,6 @@ struct PngReadCtx
 	int ReadOffset;
 };
 
-struct PngWriteCtx
-{
-	TArray<byte>& CompressedData;
-
-	PngWriteCtx(TArray<byte>& pDst)
-	: CompressedData(pDst)
-	{}
-};
-
 static void user_read_compressed(png_structp png_ptr, png_bytep data, png_size_t length)
 {
 	PngReadCtx* ctx = (PngReadCtx*)png_get_io_ptr(png_ptr);
@@ -30,17 +27,6 @@ static void user_read_compressed(png_structp png_ptr, png_bytep data, png_size_t
 	ctx->ReadOffset += length;
 }
 
-static void user_write_compressed(png_structp png_ptr, png_bytep data, png_size_t length)
-{
-	PngWriteCtx* ctx = (PngWriteCtx*) png_get_io_ptr(png_ptr);
-	int Offset = ctx->CompressedData.AddUninitialized(length);
-	memcpy(ctx->CompressedData.GetData() + Offset, data, length);
-}
-
-static void user_flush_data(png_structp png_ptr)
-{
-}
-
 static void user_error_fn(png_structp png_ptr, png_const_charp error_msg)
 {
 	appError("Error in PNG data: %s", error_msg);
@@ -189,90 +175,303 @@ bool UncompressPNG(const unsigned char* CompressedData, int CompressedSize, int
 	unguard;
 }
 
-void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData)
-{
-	guard(CompressPNG);
 
-	int PixelChannels = /*(RawFormat == ERGBFormat::Gray) ? 1 :*/ 3;
+/*-----------------------------------------------------------------------------
+	PNG writer
+-----------------------------------------------------------------------------*/
 
-	// Verify alpha channels of texture, see the possibility to drop one. First pass: check if alpha is fully opaque
-	const unsigned char* p = pic + 3;
-	for (int i = Width * Height; i > 0; i--, p += 4)
+// Large images are filtered and deflated in independent bands of rows. Each band is
+// primed with the tail of the previous band as a dictionary, and all bands except the
+// last one are terminated with Z_SYNC_FLUSH, so concatenated output is a single valid
+// deflate stream (the same approach as used by pigz).
+#define PNG_BAND_SIZE		(256 << 10)		// amount of filtered data per band
+#define PNG_DICT_SIZE		32768			// deflate window size
+
+CPngCompression GPngCompression = { 1, EPngFilter::Adaptive };
+
+bool SetPngCompression(const char* Mode)
+{
+	if (!stricmp(Mode, "fast"))
 	{
-		if (*p != 255)
-		{
-			PixelChannels = 4;
-			break;
-		}
+		GPngCompression.Level = 1;
+		GPngCompression.Filter = EPngFilter::Up;
 	}
-	// Check again to see if image is fully transparent - will also remove the alpha channel
-	if (PixelChannels == 4)
+	else if (!stricmp(Mode, "normal"))
 	{
-		p = pic + 3;
-		bool bAllZero = true;
-		for (int i = Width * Height; i > 0; i--, p += 4)
-		{
-			if (*p != 0)
-			{
-				bAllZero = false;
-				break;
-			}
-		}
-		if (bAllZero) PixelChannels = 3;
+		GPngCompression.Level = 1;
+		GPngCompression.Filter = EPngFilter::Adaptive;
+	}
+	else if (!stricmp(Mode, "best"))
+	{
+		GPngCompression.Level = 9;
+		GPngCompression.Filter = EPngFilter::Adaptive;
 	}
+	else if (Mode[0] >= '0' && Mode[0] <= '9' && Mode[1] == 0)
+	{
+		GPngCompression.Level = Mode[0] - '0';
+		GPngCompression.Filter = EPngFilter::Adaptive;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
 
-	unsigned char* newPic = NULL;
-	if (PixelChannels == 3)
+// Copy a row of RGBA8 pixels to PNG row format
+static void PackPngRow(const byte* Src, byte* Dst, int Width, int Channels)
+{
+	if (Channels == 4)
 	{
-		// Squeeze pixel information if newly allocated memory block
-		newPic = new unsigned char[Width * Height * 3];
-		const unsigned char* s = pic;
-		unsigned char* d = newPic;
-		for (int i = Width * Height; i > 0; i--)
-		{
-			*d++ = *s++;
-			*d++ = *s++;
-			*d++ = *s++;
-			s++;
-		}
-		pic = newPic;
+		memcpy(Dst, Src, Width * 4);
+		return;
 	}
+	for (int i = 0; i < Width; i++, Src += 4, Dst += 3)
+	{
+		Dst[0] = Src[0];
+		Dst[1] = Src[1];
+		Dst[2] = Src[2];
+	}
+}
 
-	PngWriteCtx ctx(CompressedData);
-	ctx.CompressedData.Empty(Width * Height * PixelChannels); // preallocate
+static FORCEINLINE byte PaethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
 
-	png_structp png_ptr	= png_create_write_struct(PNG_LIBPNG_VER_STRING, &ctx, user_error_fn, user_warning_fn);
-	assert(png_ptr);
+// Apply PNG filter to a row. Returns sum of absolute values of filtered bytes (treated as signed),
+// which is used for adaptive filter selection.
+static unsigned FilterPngRow(int Filter, const byte* Row, const byte* Prev, byte* Dst, int RowBytes, int bpp)
+{
+	int i;
+	switch (Filter)
+	{
+	case 0: // None
+		memcpy(Dst, Row, RowBytes);
+		break;
+	case 1: // Sub
+		for (i = 0; i < bpp; i++)
+			Dst[i] = Row[i];
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Row[i] - Row[i - bpp];
+		break;
+	case 2: // Up
+		for (i = 0; i < RowBytes; i++)
+			Dst[i] = Row[i] - Prev[i];
+		break;
+	case 3: // Average
+		for (i = 0; i < bpp; i++)
+			Dst[i] = Row[i] - (Prev[i] >> 1);
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Row[i] - ((Row[i - bpp] + Prev[i]) >> 1);
+		break;
+	case 4: // Paeth
+		for (i = 0; i < bpp; i++)
+			Dst[i] = Row[i] - Prev[i];
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Row[i] - PaethPredictor(Row[i - bpp], Prev[i], Prev[i - bpp]);
+		break;
+	}
 
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	assert(info_ptr);
+	unsigned Sum = 0;
+	for (i = 0; i < RowBytes; i++)
+	{
+		int v = Dst[i];
+		Sum += (v < 128) ? v : 256 - v;
+	}
+	return Sum;
+}
 
-	png_bytep* row_pointers = (png_bytep*) png_malloc( png_ptr, Height*sizeof(png_bytep) );
+struct CPngBand
+{
+	int				FirstRow;
+	int				NumRows;
+	int				FilteredOffset;
+	int				FilteredSize;
+	uLong			Adler;
+	TArray<byte>	Chunk;			// complete IDAT chunk
+};
 
-	const int RawBitDepth = 8;
-	png_set_compression_level(png_ptr, 1); // zlib compression level: 0 (uncompressed), 1 (fast) - 9 (slow)
-	png_set_IHDR(png_ptr, info_ptr, Width, Height, RawBitDepth, (PixelChannels == 4) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-	png_set_write_fn(png_ptr, &ctx, user_write_compressed, user_flush_data);
+static void PutBE32(byte* Dst, uint32 Value)
+{
+	Dst[0] = (Value >> 24) & 0xFF;
+	Dst[1] = (Value >> 16) & 0xFF;
+	Dst[2] = (Value >> 8) & 0xFF;
+	Dst[3] = Value & 0xFF;
+}
 
-	const int BytesPerPixel = (RawBitDepth * PixelChannels) / 8;
-	const int BytesPerRow = BytesPerPixel * Width;
+static void WritePngChunk(TArray<byte>& Dst, const char* Type, const byte* Data, int Size)
+{
+	int Offset = Dst.AddUninitialized(Size + 12);
+	byte* p = Dst.GetData() + Offset;
+	PutBE32(p, Size);
+	memcpy(p + 4, Type, 4);
+	if (Size) memcpy(p + 8, Data, Size);
+	PutBE32(p + 8 + Size, crc32(0, p + 4, Size + 4));
+}
 
-	for (int i = 0; i < Height; i++)
+void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData)
+{
+	guard(CompressPNG);
+
+	// Drop alpha channel when it is fully opaque or fully transparent
+	const int Channels = IsAlphaChannelUsed(pic, Width * Height) ? 4 : 3;
+	const int RowBytes = Width * Channels;
+	const int FilteredRowBytes = RowBytes + 1;		// with filter type byte
+
+	const int Level = GPngCompression.Level;
+	const EPngFilter Filter = GPngCompression.Filter;
+
+	// Split image into bands
+	int RowsPerBand = max(PNG_BAND_SIZE / FilteredRowBytes, 1);
+	int NumBands = (Height + RowsPerBand - 1) / RowsPerBand;
+	TArray<CPngBand> Bands;
+	Bands.AddDefaulted(NumBands);
+	for (int i = 0; i < NumBands; i++)
 	{
-		row_pointers[i]= (png_bytep)&pic[i * BytesPerRow];
+		CPngBand& Band = Bands[i];
+		Band.FirstRow = i * RowsPerBand;
+		Band.NumRows = min(RowsPerBand, Height - Band.FirstRow);
+		Band.FilteredOffset = Band.FirstRow * FilteredRowBytes;
+		Band.FilteredSize = Band.NumRows * FilteredRowBytes;
 	}
-	png_set_rows(png_ptr, info_ptr, row_pointers);
 
-	int Transform = PNG_TRANSFORM_IDENTITY;
-	png_write_png(png_ptr, info_ptr, Transform, NULL);
+	byte* Filtered = (byte*)appMallocNoInit(Height * FilteredRowBytes);
 
-	png_free(png_ptr, row_pointers);
-	png_destroy_write_struct(&png_ptr, &info_ptr);
+	// Filter rows. Each band works with its own previous row, so all bands are independent.
+	ParallelFor(NumBands, [&](int BandIndex)
+	{
+		const CPngBand& Band = Bands[BandIndex];
+		byte* Buffer = (byte*)appMalloc(RowBytes * 3);		// Prev and Row are zero-initialized
+		byte* Prev = Buffer;
+		byte* Row = Buffer + RowBytes;
+		byte* Candidate = Buffer + RowBytes * 2;
+		if (Band.FirstRow > 0)
+		{
+			PackPngRow(pic + (Band.FirstRow - 1) * Width * 4, Prev, Width, Channels);
+		}
+		byte* Dst = Filtered + Band.FilteredOffset;
+		for (int y = Band.FirstRow; y < Band.FirstRow + Band.NumRows; y++, Dst += FilteredRowBytes)
+		{
+			PackPngRow(pic + y * Width * 4, Row, Width, Channels);
+			if (Filter == EPngFilter::Adaptive)
+			{
+				unsigned BestSum = FilterPngRow(0, Row, Prev, Dst + 1, RowBytes, Channels);
+				Dst[0] = 0;
+				for (int Type = 1; Type <= 4; Type++)
+				{
+					unsigned Sum = FilterPngRow(Type, Row, Prev, Candidate, RowBytes, Channels);
+					if (Sum < BestSum)
+					{
+						BestSum = Sum;
+						Dst[0] = Type;
+						memcpy(Dst + 1, Candidate, RowBytes);
+					}
+				}
+			}
+			else
+			{
+				static const byte FilterTypes[] = { 0, 1, 2, 4 };
+				Dst[0] = FilterTypes[(int)Filter];
+				FilterPngRow(Dst[0], Row, Prev, Dst + 1, RowBytes, Channels);
+			}
+			Exchange(Prev, Row);
+		}
+		appFree(Buffer);
+	});
 
-	if (newPic)
+	// Deflate bands
+	ParallelFor(NumBands, [&](int BandIndex)
 	{
-		delete[] newPic;
+		CPngBand& Band = Bands[BandIndex];
+		const byte* Data = Filtered + Band.FilteredOffset;
+
+		z_stream Stream;
+		memset(&Stream, 0, sizeof(Stream));
+		int Result = deflateInit2(&Stream, Level, Z_DEFLATED, -MAX_WBITS, 8,
+			(Filter == EPngFilter::None) ? Z_DEFAULT_STRATEGY : Z_FILTERED);
+		assert(Result == Z_OK);
+		if (BandIndex > 0)
+		{
+			int DictSize = min(Band.FilteredOffset, PNG_DICT_SIZE);
+			deflateSetDictionary(&Stream, Data - DictSize, DictSize);
+		}
+
+		// Reserve space for chunk header and zlib header
+		int HeaderSize = (BandIndex == 0) ? 10 : 8;
+		int MaxSize = deflateBound(&Stream, Band.FilteredSize) + 16;		// deflateBound() doesn't count Z_SYNC_FLUSH marker
+		Band.Chunk.AddUninitialized(HeaderSize + MaxSize + 4);
+		byte* Chunk = Band.Chunk.GetData();
+
+		if (BandIndex == 0)
+		{
+			// zlib header: deflate with 32K window, compression level hint, and check bits
+			int LevelHint = (Level < 2) ? 0 : (Level < 6) ? 1 : (Level == 6) ? 2 : 3;
+			int CMF = 0x78;
+			int FLG = LevelHint << 6;
+			FLG += (31 - (CMF * 256 + FLG) % 31) % 31;
+			Chunk[8] = CMF;
+			Chunk[9] = FLG;
+		}
+
+		Stream.next_in = (Bytef*)Data;
+		Stream.avail_in = Band.FilteredSize;
+		Stream.next_out = Chunk + HeaderSize;
+		Stream.avail_out = MaxSize;
+		Result = deflate(&Stream, (BandIndex == NumBands - 1) ? Z_FINISH : Z_SYNC_FLUSH);
+		assert(Stream.avail_in == 0 && Result != Z_STREAM_ERROR);
+		int DataSize = HeaderSize - 8 + (MaxSize - Stream.avail_out);
+		deflateEnd(&Stream);
+
+		PutBE32(Chunk, DataSize);
+		memcpy(Chunk + 4, "IDAT", 4);
+		PutBE32(Chunk + 8 + DataSize, crc32(0, Chunk + 4, DataSize + 4));
+		Band.Chunk.RemoveAt(DataSize + 12, Band.Chunk.Num() - DataSize - 12);
+
+		Band.Adler = adler32(1, Data, Band.FilteredSize);
+	});
+
+	// Compose the file
+	int TotalSize = 8 + 25 + 16 + 12;
+	for (const CPngBand& Band : Bands)
+	{
+		TotalSize += Band.Chunk.Num();
+	}
+	CompressedData.Empty(TotalSize);
+
+	static const byte Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	CompressedData.AddUninitialized(sizeof(Signature));
+	memcpy(CompressedData.GetData(), Signature, sizeof(Signature));
+
+	byte Header[13];
+	PutBE32(Header, Width);
+	PutBE32(Header + 4, Height);
+	Header[8] = 8;									// bit depth
+	Header[9] = (Channels == 4) ? 6 : 2;			// color type: RGBA or RGB
+	Header[10] = Header[11] = Header[12] = 0;		// compression, filter method, no interlace
+	WritePngChunk(CompressedData, "IHDR", Header, sizeof(Header));
+
+	uLong Adler = adler32(0, NULL, 0);
+	for (const CPngBand& Band : Bands)
+	{
+		int Offset = CompressedData.AddUninitialized(Band.Chunk.Num());
+		memcpy(CompressedData.GetData() + Offset, Band.Chunk.GetData(), Band.Chunk.Num());
+		Adler = adler32_combine(Adler, Band.Adler, Band.FilteredSize);
 	}
 
+	// zlib stream trailer as a separate IDAT chunk
+	byte Trailer[4];
+	PutBE32(Trailer, Adler);
+	WritePngChunk(CompressedData, "IDAT", Trailer, sizeof(Trailer));
+	WritePngChunk(CompressedData, "IEND", NULL, 0);
+
+	appFree(Filtered);
+
 	unguard;
 }
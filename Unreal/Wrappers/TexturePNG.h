@@ -1,6 +1,27 @@
 #ifndef __UNTEXTUREPNG_H__
 #define __UNTEXTUREPNG_H__
 
+// Row filter used by CompressPNG
+enum class EPngFilter
+{
+	None,
+	Sub,
+	Up,
+	Paeth,
+	Adaptive,			// per-row choice, the same heuristic as libpng uses
+};
+
+struct CPngCompression
+{
+	int			Level;		// zlib compression level: 0 (uncompressed), 1 (fast) - 9 (slow)
+	EPngFilter	Filter;
+};
+
+extern CPngCompression GPngCompression;
+
+// Parse "fast", "normal", "best" or a single digit compression level
+bool SetPngCompression(const char* Mode);
+
 bool UncompressPNG(const unsigned char* CompressedData, int CompressedSize, int Width, int Height, unsigned char* pic, bool bgra);
 void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData);
 
@@ -998,7 +998,7 @@ void CSkelMeshViewer::FindUE4Animations()
 	progress.Show("Finding animations");
 	progress.SetDescription("Scanning package");
 
-	// Perform full scan to be able to locate AnimSequence objects
+	// Scan package headers to locate packages with AnimSequence objects
 	if (!ScanContent(PackageInfos, &progress))
 	{
 		appPrintf("Interrupted by user\n");
@@ -1013,17 +1013,10 @@ void CSkelMeshViewer::FindUE4Animations()
 	for (int i = 0; i < PackageInfos.Num(); i++)
 	{
 		const CGameFileInfo* info = PackageInfos[i];
-		UnPackage* package = info->Package;
-		if (!package)
-		{
-			// Shouldn't happen, but happens (ScanPackage() should fill Package for all CGameFileInfo).
-			// Example of appearance: ScanPackages may open a WRONG find in a case when game files are extracted from pak, and
-			// user supplies wrong (shorter) game path, e.g. -path=Extported/Meshes, and multiple files with the same name
-			// exists inside that folder. CGameFileInfo::Find has heuristic for finding files using partial path, but it may fail.
-			// In this case, CGameFileInfo will say "it's package", but actually file won't be scanned and/or loaded.
-			//appNotify("Strange package: IsPackage=true, Package is NULL: %s (size %d Kb)", *info->GetRelativeName(), info->SizeInKb + info->ExtraSizeInKb);
-			continue;
-		}
+		// ScanContent() doesn't keep packages loaded, so load only ones which have animation sequences
+		if (!info->NumAnimations) continue;
+		UnPackage* package = UnPackage::LoadPackage(info, /*silent=*/ true);
+		if (!package) continue;
 
 		bool found = false;
 		for (int importIndex = 0; importIndex < package->Summary.ImportCount; importIndex++)
@@ -1047,11 +1040,8 @@ void CSkelMeshViewer::FindUE4Animations()
 
 		if (!found) continue; // this package doesn't use our Skeleton
 
-		// Now, if this package has animation sequence - enqueue it for loading
-		if (PackageInfos[i]->NumAnimations)
-		{
-			packagesToLoad.Add(package);
-		}
+		// This package has animation sequence - enqueue it for loading
+		packagesToLoad.Add(package);
 	}
 
 	// Sort packages by name for easier navigation after loading